@@ -6,33 +6,37 @@ Please give feedback to the authors if improvement is realized. It is distribute
 */
 
 __kernel
-void ntt4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)
+void ntt4(__global rns * restrict x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)
 {
+	x += batch_offset(pconst_size);
+
 	const size_t k = get_global_id(0);
 
 	const size_t i = k & (m - 1), j = 4 * k - 3 * i;
 
-	const uint2 r2_i = r2[rindex + i];
-	const uint4 r1ir1_i = r1ir1[rindex + i];
+	const rns r2_i = r2[rindex + i];
+	const rns2 r1ir1_i = r1ir1[rindex + i];
 
-	const uint2 u0 = x[j + 0 * m], u2 = x[j + 2 * m], u1 = x[j + 1 * m], u3 = x[j + 3 * m];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = x[j + 0 * m], u2 = x[j + 2 * m], u1 = x[j + 1 * m], u3 = x[j + 3 * m];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	x[j + 0 * m] = addmod(v0, v1); x[j + 1 * m] = mulmod(submod(v0, v1), r2_i);
-	x[j + 2 * m] = mulmod(addmod(v2, v3), r1ir1_i.s23); x[j + 3 * m] = mulmod(submod(v2, v3), r1ir1_i.s01);
+	x[j + 2 * m] = mulmod(addmod(v2, v3), r1ir1_i.hi); x[j + 3 * m] = mulmod(submod(v2, v3), r1ir1_i.lo);
 }
 
 __kernel
-void intt4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)
+void intt4(__global rns * restrict x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)
 {
+	x += batch_offset(pconst_size);
+
 	const size_t k = get_global_id(0);
 
 	const size_t i = k & (m - 1), j = 4 * k - 3 * i;
 
-	const uint2 ir2_i = ir2[rindex + i];
-	const uint4 r1ir1_i = r1ir1[rindex + i];
+	const rns ir2_i = ir2[rindex + i];
+	const rns2 r1ir1_i = r1ir1[rindex + i];
 
-	const uint2 v0 = x[j + 0 * m], v1 = mulmod(x[j + 1 * m], ir2_i), v2 = mulmod(x[j + 2 * m], r1ir1_i.s01), v3 = mulmod(x[j + 3 * m], r1ir1_i.s23);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = x[j + 0 * m], v1 = mulmod(x[j + 1 * m], ir2_i), v2 = mulmod(x[j + 2 * m], r1ir1_i.lo), v3 = mulmod(x[j + 3 * m], r1ir1_i.hi);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	x[j + 0 * m] = addmod(u0, u2); x[j + 2 * m] = submod(u0, u2);
 	x[j + 1 * m] = addmod(u1, u3); x[j + 3 * m] = submod(u1, u3);
 }
@@ -54,11 +58,16 @@ void intt4(__global uint2 * restrict const x, __global const uint4 * restrict co
 	_backward4(M * CHUNK, &X[i * CHUNK | chunk_idx], ir2[R + j], r1ir1[R + j]); \
 }
 
+#if defined(RADIX)
+// The first stage was computed by radix_sub: the input of the radix-4 stages is not zero-padded.
+#define SUB_FORWARD4i(M, CHUNK)	FORWARD4i(M, CHUNK, 0)
+#else
 #define SUB_FORWARD4i(M, CHUNK) \
 { \
 	const size_t j = threadIdx * m | bl_i; \
-	_sub_forward4i(M * CHUNK, &X[threadIdx * CHUNK | chunk_idx], M * m, &xo[j], r2[j], r1ir1[j]); \
+	_sub_forward4i(M * CHUNK, &X[threadIdx * CHUNK | chunk_idx], M * m, &xo[j], &bd[batch_offset(pconst_size / 2) + j], r2[j], r1ir1[j]); \
 }
+#endif
 
 #define FORWARD4i(M, CHUNK, R) \
 { \
@@ -86,18 +95,38 @@ void intt4(__global uint2 * restrict const x, __global const uint4 * restrict co
 
 
 #define SETVAR(M, CHUNK) \
-	__local uint2 X[M * CHUNK]; \
+	__local rns X[M * CHUNK]; \
 	const size_t local_id = get_local_id(0), chunk_idx = local_id % CHUNK, threadIdx = local_id / CHUNK, block_idx = get_group_id(0) * CHUNK;
 
+// If the size is RADIX * L then the first and the last stages are the transforms of the RADIX blocks of size L.
 #define SETVAR_FL_NTT(M) \
-	__global uint2 * const xo = x; \
-	const size_t bl_i = block_idx | chunk_idx; \
-	const size_t m = (pconst_size / 4) / (M / 4);
+	const size_t m = (pconst_L / 4) / (M / 4); \
+	__global rns * const xo = &x[batch_offset(pconst_size) + M * (block_idx & ~(m - 1))]; \
+	const size_t bl_i = (block_idx & (m - 1)) | chunk_idx;
 
 #define SETVAR_NTT(M) \
-	__global uint2 * const xo = &x[M * (block_idx & ~(m - 1))]; \
+	__global rns * const xo = &x[batch_offset(pconst_size) + M * (block_idx & ~(m - 1))]; \
 	const size_t bl_i = (block_idx & (m - 1)) | chunk_idx;
 
+// The last stage of the inverse transform is computed in local memory then the digits are converted as in poly2int0.
+// X[i * CHUNK | c] is x[i * m | block_idx | c]: if CHUNK >= 4 then a block of 4 digits is contiguous in local memory.
+#define P2I_LST(CHUNK) \
+{ \
+	barrier(CLK_LOCAL_MEM_FENCE); \
+	const size_t i = (4 * local_id) / CHUNK, c = (4 * local_id) % CHUNK; \
+	const size_t k = i * m | block_idx | c; \
+	__local const rns * const Xk = &X[4 * local_id]; \
+	long l = 0; \
+	for (size_t j = 0; j < 4; ++j) \
+	{ \
+		uint d; const long h = getcarry(mulmod(Xk[j], pconst_norm), &d); \
+		l += d; \
+		xo[k + j].s0 = (uint)(l) & digit_mask; \
+		l = (l >> digit_bit) + h; \
+	} \
+	cr[batch_offset(pconst_size / 4) + ((k / 4 + 1) & (pconst_size / 4 - 1))] = l; \
+}
+
 
 #define SUB_NTT64(CHUNK) \
 	SETVAR(64, CHUNK); \
@@ -113,6 +142,14 @@ void intt4(__global uint2 * restrict const x, __global const uint4 * restrict co
 	BACKWARD4(4, CHUNK, 16 * m); \
 	BACKWARD4o(16, CHUNK, 0);
 
+#define LST_INTT64_P2I(CHUNK) \
+	SETVAR(64, CHUNK); \
+	SETVAR_FL_NTT(64); \
+	BACKWARD4i(CHUNK, 16 * m + 4 * m); \
+	BACKWARD4(4, CHUNK, 16 * m); \
+	BACKWARD4(16, CHUNK, 0); \
+	P2I_LST(CHUNK);
+
 #define NTT64(CHUNK) \
 	SETVAR(64, CHUNK); \
 	SETVAR_NTT(64); \
@@ -143,6 +180,15 @@ void intt4(__global uint2 * restrict const x, __global const uint4 * restrict co
 	BACKWARD4(16, CHUNK, 64 * m); \
 	BACKWARD4o(64, CHUNK, 0);
 
+#define LST_INTT256_P2I(CHUNK) \
+	SETVAR(256, CHUNK); \
+	SETVAR_FL_NTT(256); \
+	BACKWARD4i(CHUNK, 64 * m + 16 * m + 4 * m); \
+	BACKWARD4(4, CHUNK, 64 * m + 16 * m); \
+	BACKWARD4(16, CHUNK, 64 * m); \
+	BACKWARD4(64, CHUNK, 0); \
+	P2I_LST(CHUNK);
+
 #define NTT256(CHUNK) \
 	SETVAR(256, CHUNK); \
 	SETVAR_NTT(256); \
@@ -177,6 +223,16 @@ void intt4(__global uint2 * restrict const x, __global const uint4 * restrict co
 	BACKWARD4(64, CHUNK, 256 * m); \
 	BACKWARD4o(256, CHUNK, 0);
 
+#define LST_INTT1024_P2I(CHUNK) \
+	SETVAR(1024, CHUNK); \
+	SETVAR_FL_NTT(1024); \
+	BACKWARD4i(CHUNK, 256 * m + 64 * m + 16 * m + 4 * m); \
+	BACKWARD4(4, CHUNK, 256 * m + 64 * m + 16 * m); \
+	BACKWARD4(16, CHUNK, 256 * m + 64 * m); \
+	BACKWARD4(64, CHUNK, 256 * m); \
+	BACKWARD4(256, CHUNK, 0); \
+	P2I_LST(CHUNK);
+
 #define NTT1024(CHUNK) \
 	SETVAR(1024, CHUNK); \
 	SETVAR_NTT(1024); \
@@ -196,76 +252,188 @@ void intt4(__global uint2 * restrict const x, __global const uint4 * restrict co
 	BACKWARD4o(256, CHUNK, rindex);
 
 
+#if defined(BALANCED)
+// The digits of R - Y are balanced before the forward transform: d = s0 - s1 is reduced into [-B/2, B/2[ and its carry
+// is added to the next digit. The carry is not propagated further, then |d| <= B/2 + 1.
+// x[k - 1] is read by the work-item k: x is not modified and the digits are written into bd, they are read by sub_ntt.
+inline int _carry_b(const rns ab) { return ((int)(ab.s0) - (int)(ab.s1) + (int)(1u << (digit_bit - 1))) >> digit_bit; }
+
+__kernel
+void balance(__global const rns * restrict x, __global int * restrict bd)
+{
+	x += batch_offset(pconst_size);
+	bd += batch_offset(pconst_size / 2);
+
+	const size_t k = get_global_id(0);
+	const rns ab = x[k];
+	const int c = _carry_b(ab), c_prev = (k != 0) ? _carry_b(x[k - 1]) : 0;
+	bd[k] = (int)(ab.s0) - (int)(ab.s1) - c * (int)(1u << digit_bit) + c_prev;
+}
+#endif
+
+#if defined(RADIX)
+// The first stage of a transform of size RADIX * L, the elements j + t.L, 0 <= t < RADIX. The blocks [s.L, (s + 1).L) are
+// then transformed by the radix-4 stages: x[j + s.L] = w^{j.s} sum_t x[j + t.L].w^{L.s.t}. The upper half of the input is zero.
+// The last stage of the inverse transform is the forward DFT with the reversed outputs. w[i] = w^i, w is a root of order size.
+// The arithmetic is modulo PG: w3^2 = -1 - w3 and, if s = 1 or 2, w5^s.a_1 + w5^-s.a_4 = u_s.(a_1 + a_4) + v_s.(a_1 - a_4),
+// where u_s = (w5^s + w5^-s) / 2 and v_s = (w5^s - w5^-s) / 2.
+inline uint2 halfmod(const uint2 lhs)
+{
+	const ulong l = as_ulong(lhs);
+	return as_uint2((l >> 1) + (((l & 1) != 0) ? (PG + 1) / 2 : 0));
+}
+
+inline void _dft(uint2 * const a, __global const uint2 * restrict const w)
+{
+#if RADIX == 3
+	const uint2 d = mulmod(submod(a[1], a[2]), w[pconst_L]);
+	const uint2 b0 = addmod(a[0], addmod(a[1], a[2])), b1 = addmod(submod(a[0], a[2]), d), b2 = submod(submod(a[0], a[1]), d);
+	a[0] = b0; a[1] = b1; a[2] = b2;
+#else
+	const uint2 w1 = w[1 * pconst_L], w2 = w[2 * pconst_L], w3 = w[3 * pconst_L], w4 = w[4 * pconst_L];
+	const uint2 u1 = halfmod(addmod(w1, w4)), u2 = halfmod(addmod(w2, w3)), v1 = halfmod(submod(w1, w4)), v2 = halfmod(submod(w2, w3));
+	const uint2 b1 = addmod(a[1], a[4]), c1 = submod(a[1], a[4]), b2 = addmod(a[2], a[3]), c2 = submod(a[2], a[3]);
+	const uint2 s1 = addmod(a[0], addmod(mulmod(u1, b1), mulmod(u2, b2)));
+	const uint2 s2 = addmod(a[0], addmod(mulmod(u2, b1), mulmod(u1, b2)));
+	const uint2 t1 = addmod(mulmod(v1, c1), mulmod(v2, c2)), t2 = submod(mulmod(v2, c1), mulmod(v1, c2));
+	a[0] = addmod(a[0], addmod(b1, b2));
+	a[1] = addmod(s1, t1); a[4] = submod(s1, t1);
+	a[2] = addmod(s2, t2); a[3] = submod(s2, t2);
+#endif
+}
+
+// The digits of R - Y are read from x or, if they are balanced, from bd
+__kernel
+void radix_sub(__global uint2 * restrict x, __global const uint2 * restrict const w, __global const int * restrict const bd)
+{
+	x += batch_offset(pconst_size);
+
+	const size_t j = get_global_id(0);
+
+	uint2 a[RADIX];
+	for (size_t t = 0; t < RADIX; ++t)
+	{
+		const size_t k = j + t * pconst_L;
+		if (k < pconst_size / 2)
+		{
+#if defined(BALANCED)
+			a[t] = toModInt(bd[batch_offset(pconst_size / 2) + k]);
+#else
+			const uint2 ab = x[k];
+			a[t] = submod(toMod(ab.s0), toMod(ab.s1));
+#endif
+		}
+		else a[t] = toMod(0);
+	}
+
+	_dft(a, w);
+
+	for (size_t s = 0; s < RADIX; ++s) x[j + s * pconst_L] = mulmod(a[s], w[j * s]);
+}
+
+__kernel
+void radix_lst(__global uint2 * restrict x, __global const uint2 * restrict const w, __global const uint2 * restrict const iw)
+{
+	x += batch_offset(pconst_size);
+
+	const size_t j = get_global_id(0);
+
+	uint2 a[RADIX];
+	for (size_t s = 0; s < RADIX; ++s) a[s] = mulmod(x[j + s * pconst_L], iw[j * s]);
+
+	_dft(a, w);
+
+	for (size_t t = 0; t < RADIX; ++t) x[j + t * pconst_L] = a[(RADIX - t) % RADIX];
+}
+#endif
+
 __kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))
-void sub_ntt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)
+void sub_ntt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,
+	__global const int * restrict const bd)
 {
 	SUB_NTT64(16);
 }
 
 __kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))
-void lst_intt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)
+void lst_intt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)
 {
 	LST_INTT64(16);
 }
 
 __kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))
-void ntt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)
+void lst_intt64_16_p2i(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2,
+	__global long * restrict const cr)
+{
+	LST_INTT64_P2I(16);
+}
+
+__kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))
+void ntt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)
 {
 	NTT64(16);
 }
 
 __kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))
-void intt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)
+void intt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)
 {
 	INTT64(16);
 }
 
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))
-void sub_ntt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)
+void sub_ntt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,
+	__global const int * restrict const bd)
 {
 	SUB_NTT256(4);
 }
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))
-void lst_intt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)
+void lst_intt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)
 {
 	LST_INTT256(4);
 }
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))
-void ntt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)
+void lst_intt256_4_p2i(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2,
+	__global long * restrict const cr)
+{
+	LST_INTT256_P2I(4);
+}
+
+__kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))
+void ntt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)
 {
 	NTT256(4);
 }
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))
-void intt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)
+void intt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)
 {
 	INTT256(4);
 }
 
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))
-void sub_ntt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)
+void sub_ntt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,
+	__global const int * restrict const bd)
 {
 	SUB_NTT1024(1);
 }
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))
-void lst_intt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)
+void lst_intt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)
 {
 	LST_INTT1024(1);
 }
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))
-void ntt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)
+void ntt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)
 {
 	NTT1024(1);
 }
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))
-void intt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)
+void intt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)
 {
 	INTT1024(1);
 }
@@ -6,15 +6,20 @@ Please give feedback to the authors if improvement is realized. It is distribute
 */
 
 __kernel
-void set_positive(__global uint2 * restrict const x)
+void set_positive(__global rns * restrict x, __global const uint * restrict pc)
 {
+	x += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	// x.s0 = R, x.s1 = Y
 	// if R < Y then add k.2^n + 1 to R.
 
+	const uint pconst_e = pc[0], pconst_s = pc[1], pconst_d = pc[2];
+
 	for (size_t i = 0; i < pconst_size / 2; ++i)
 	{
 		const size_t j = pconst_size / 2 - 1 - i;
-		const uint2 x_j = x[j];
+		const rns x_j = x[j];
 		if (x_j.s0 > x_j.s1) return;
 		if (x_j.s0 < x_j.s1)
 		{
@@ -42,13 +47,18 @@ void set_positive(__global uint2 * restrict const x)
 }
 
 __kernel
-void add1(__global uint2 * restrict const x, const uint a)
+void add1(__global rns * restrict x, __global const uint * restrict pc, const uint a)
 {
+	x += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	// s0: += a
 	// s1: 0 => k.2^n + 1 for reduce_z step
 
+	const uint pconst_e = pc[0], pconst_s = pc[1], pconst_d = pc[2];
+
 	uint c = x[0].s0 + a;
-	x[0] = (uint2)(c & digit_mask, 1);
+	x[0] = digits(c & digit_mask, 1);
 	c >>= digit_bit;
 
 	for (size_t k = 1; c != 0; ++k)
@@ -67,24 +77,34 @@ void add1(__global uint2 * restrict const x, const uint a)
 }
 
 __kernel
-void swap(__global uint2 * restrict const x, __global uint2 * restrict const y)
+void swap(__global rns * restrict x, __global rns * restrict y)
 {
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size);
+
 	const size_t k = get_global_id(0);
-	const uint2 x_k = x[k], y_k = y[k];
+	const rns x_k = x[k], y_k = y[k];
 	x[k] = y_k; y[k] = x_k;
 }
 
 __kernel
-void copy(__global uint2 * restrict const x, __global const uint2 * restrict const y)
+void copy(__global rns * restrict x, __global const rns * restrict y)
 {
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size);
+
 	const size_t k = get_global_id(0);
 	x[k] = y[k];
 }
 
 __kernel
-void compare(__global const uint2 * restrict const x, __global const uint2 * restrict const y, __global int * const err)
+void compare(__global const rns * restrict x, __global const rns * restrict y, __global int * err)
 {
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size);
+	err += batch_offset(2);
+
 	const size_t k = get_global_id(0);
-	const uint2 x_k = x[k], y_k = y[k];
+	const rns x_k = x[k], y_k = y[k];
 	if ((x_k.s0 != y_k.s0) || (x_k.s1 != y_k.s1)) atomic_or(err, 1);
 }
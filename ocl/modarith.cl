@@ -11,6 +11,16 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 #define digit_mask		((1u << digit_bit) - 1)
 
+// If the transform size is RADIX * L (RADIX = 3 or 5) then the radix-4 stages are the transforms of size L
+#if defined(RADIX)
+#define pconst_L		(pconst_size / RADIX)
+#else
+#define pconst_L		pconst_size
+#endif
+
+// In batched mode, the buffers of the candidates are laid out back-to-back and get_global_id(1) is the index of the candidate.
+inline size_t batch_offset(const size_t stride) { return get_global_id(1) * stride; }
+
 /*
 Barrett's product/reduction, where P is such that h (the number of iterations in the 'while loop') is 0 or 1.
 
@@ -22,21 +32,10 @@ Then -1 + 0 + 0 + 0 < h < 0 + (2^62/P - R) + R/2^32 + 1,
 
 P = 127 * 2^24 + 1 = 2130706433 => R = 2164392967, h < 1.56
 P =  63 * 2^25 + 1 = 2113929217 => R = 2181570688, h < 2.51 NOK
+P =  51 * 2^25 + 1 = 1711276033 => R = 2694881439, h < 1.68
 P =  15 * 2^27 + 1 = 2013265921 => R = 2290649223, h < 1.93
 */
 
-#define	P1			2130706433u		// 127 * 2^24 + 1 = 2^31 - 2^24 + 1
-#define	P2			2013265921u		//  15 * 2^27 + 1 = 2^31 - 2^27 + 1
-#define	P1_INV		2164392967u		// 2^62 / P1
-#define	P2_INV 		2290649223u		// 2^62 / P2
-#define	P1_I		2113994754u		// P1_PRIM_ROOT = 3,  P1_PRIM_ROOT^((P1 - 1) / 4)
-#define	P2_I		1728404513u		// P2_PRIM_ROOT = 31, P2_PRIM_ROOT^((P2 - 1) / 4)
-#define	P1_Ip		4261280761u		// (P1_I * 2^32) / P1
-#define	P2_Ip		3687262959u		// (P2_I * 2^32) / P2
-#define	InvP2_P1	913159918u		// 1 / P2 mod P1
-#define	InvP2_P1p	1840700306u		// (InvP2_P1 * 2^32) / P1
-#define	P1P2		(P1 * (ulong)(P2))
-
 inline uint _rem(const ulong q, const uint d, const uint d_inv, const int d_shift)
 {
 	const uint q_d = mul_hi((uint)(q >> d_shift), d_inv);
@@ -45,18 +44,110 @@ inline uint _rem(const ulong q, const uint d, const uint d_inv, const int d_shif
 	return r - t;
 }
 
-inline uint addmod_d(const uint lhs, const uint rhs)
+inline uint addmod_d(const uint lhs, const uint rhs, const uint d)
 {
 	const uint r = lhs + rhs;
-	const uint t = (r >= pconst_d) ? pconst_d : 0;
+	const uint t = (r >= d) ? d : 0;
 	return r - t;
 }
 
-inline uint rem_d(const ulong q)
+// rns is a residue, rns2 is a pair of residues or a residue and its Shoup's precomputation (.lo and .hi)
+#if defined(RNS3)
+typedef uint4	rns;
+typedef uint8	rns2;
+#else
+typedef uint2	rns;
+typedef uint4	rns2;
+#endif
+
+// In the integer domain, the digits of R and Y are the components s0 and s1 of a vector
+#if defined(RNS3)
+inline rns digits(const uint r, const uint y) { return (uint4)(r, y, 0, 0); }
+#else
+inline rns digits(const uint r, const uint y) { return (uint2)(r, y); }
+#endif
+
+#if defined(GOLDILOCKS)
+
+/*
+p = 2^64 - 2^32 + 1. A residue is the ulong value of a uint2 vector, the NTT is computed modulo p.
+We have 2^64 = 2^32 - 1 and 2^96 = -1 (mod p): the reduction of a 128-bit product is a sum of 32-bit words.
+*/
+
+#define	PG			0xffffffff00000001ul
+
+inline ulong _reduce128(const ulong lo, const ulong hi)
+{
+	// lo + hi_lo.2^64 + hi_hi.2^96 = lo - hi_hi + hi_lo.(2^32 - 1)
+	const ulong hi_hi = hi >> 32, hi_lo = hi & 0xffffffffu;
+	const ulong t = lo - hi_hi - ((lo < hi_hi) ? 0xffffffffu : 0);
+	const ulong u = hi_lo * 0xffffffffu;
+	const ulong r = t + u + ((t + u < u) ? 0xffffffffu : 0);
+	return (r >= PG) ? r - PG : r;
+}
+
+inline uint2 toMod(const uint d) { return (uint2)(d, 0); }
+
+inline long getlong(const uint2 lhs)
+{
+	const ulong r = as_ulong(lhs);
+	return (long)((r > PG / 2) ? r - PG : r);
+}
+
+// getlong(lhs) = carry.B + digit, 0 <= digit < B
+inline long getcarry(const uint2 lhs, uint * const digit)
+{
+	const long l = getlong(lhs);
+	*digit = (uint)(l) & digit_mask;
+	return l >> digit_bit;
+}
+
+inline uint2 addmod(const uint2 lhs, const uint2 rhs)
+{
+	const ulong l = as_ulong(lhs), r = as_ulong(rhs);
+	const ulong t = (l >= PG - r) ? PG : 0;
+	return as_uint2(l + r - t);
+}
+
+inline uint2 submod(const uint2 lhs, const uint2 rhs)
+{
+	const ulong l = as_ulong(lhs), r = as_ulong(rhs);
+	const ulong t = (l < r) ? PG : 0;
+	return as_uint2(l - r + t);
+}
+
+inline uint2 mulmod(const uint2 lhs, const uint2 rhs)
+{
+	const ulong l = as_ulong(lhs), r = as_ulong(rhs);
+	return as_uint2(_reduce128(l * r, mul_hi(l, r)));
+}
+
+// No precomputation: rhs.lo is the root
+inline uint2 mulmodp(const uint2 lhs, const uint4 rhs) { return mulmod(lhs, rhs.lo); }
+
+inline uint2 sqrmod(const uint2 lhs) { return mulmod(lhs, lhs); }
+
+// PG_PRIM_ROOT = 7, PG_PRIM_ROOT^((PG - 1) / 4) = 2^48
+inline uint2 mulI(const uint2 lhs)
 {
-	return _rem(q, pconst_d, pconst_d_inv, pconst_d_shift);
+	const ulong l = as_ulong(lhs);
+	return as_uint2(_reduce128(l << 48, l >> 16));
 }
 
+#else
+
+#define	P1			2130706433u		// 127 * 2^24 + 1 = 2^31 - 2^24 + 1
+#define	P2			2013265921u		//  15 * 2^27 + 1 = 2^31 - 2^27 + 1
+#define	P1_INV		2164392967u		// 2^62 / P1
+#define	P2_INV 		2290649223u		// 2^62 / P2
+#define	P1_I		2113994754u		// P1_PRIM_ROOT = 3,  P1_PRIM_ROOT^((P1 - 1) / 4)
+#define	P2_I		1728404513u		// P2_PRIM_ROOT = 31, P2_PRIM_ROOT^((P2 - 1) / 4)
+#define	P1_Ip		4261280761u		// (P1_I * 2^32) / P1
+#define	P2_Ip		3687262959u		// (P2_I * 2^32) / P2
+#define	InvP2_P1	913159918u		// 1 / P2 mod P1
+#define	InvP2_P1p	1840700306u		// (InvP2_P1 * 2^32) / P1
+#define	P1P2		(P1 * (ulong)(P2))
+
 inline uint _mulmodP1(const uint a, const uint b) { return _rem(a * (ulong)(b), P1, P1_INV, 30); }
 inline uint _mulmodP2(const uint a, const uint b) { return _rem(a * (ulong)(b), P2, P2_INV, 30); }
 
@@ -68,16 +159,106 @@ inline uint _mulmodp(const uint lhs, const uint p, const uint c, const uint cp)
 	return r - t;
 }
 
+// Garner Algorithm: x = u.P2 + a2 (mod P1P2), 0 <= u < P1
+inline uint _garnerP2(const uint a1, const uint a2)
+{
+	uint d = a1 - a2; const uint t = (a1 < a2) ? P1 : 0; d += t;	// mod P1
+	return _mulmodp(d, P1, InvP2_P1, InvP2_P1p);		// P2 < P1
+}
+
+#if defined(RNS3)
+
+/*
+A residue is a uint4 vector, the components s0, s1 and s2 are the residues modulo P1, P2 and P3, s3 is zero.
+The coefficients of the products are in ]-P1P2P3 / 2, P1P2P3 / 2[ (P1P2P3 ~ 2^92.6): they are not 64-bit integers
+but their carries are. getcarry splits a coefficient into a digit and a carry.
+*/
+
+#define	P3			1711276033u		//  51 * 2^25 + 1 = 2^31 - 2^28 - 2^27 - 2^25 + 1
+#define	P3_INV		2694881439u		// 2^62 / P3
+#define	P3_I		1270877673u		// P3_PRIM_ROOT = 29, P3_PRIM_ROOT^((P3 - 1) / 4)
+#define	P3_Ip		3189653765u		// (P3_I * 2^32) / P3
+#define	InvP1P2_P3	616059395u		// 1 / (P1 * P2) mod P3
+#define	InvP1P2_P3p	1546188284u		// (InvP1P2_P3 * 2^32) / P3
+#define	InvP1_P3	1300569781u		// 1 / P1 mod P3
+#define	InvP1_P3p	3264175134u		// (InvP1_P3 * 2^32) / P3
+
+inline uint _mulmodP3(const uint a, const uint b) { return _rem(a * (ulong)(b), P3, P3_INV, 30); }
+
+inline uint4 toMod(const uint d) { return (uint4)(d, d, d, 0); }
+
+// x = w.P1P2 + u.P2 + a2 and w = (a3 - a2).(1 / P1P2) - u.(1 / P1) (mod P3). The centered coefficient x = ws.P1P2 + r12,
+// with -P3/2 < ws <= P3/2, is split: P1P2 = q.B + r then x = (q.ws + [(r.ws + r12) / B]).B + (r.ws + r12) mod B.
+inline long getcarry(const uint4 lhs, uint * const digit)
+{
+	const uint u = _garnerP2(lhs.s0, lhs.s1);
+	const ulong r12 = u * (ulong)(P2) + lhs.s1;
+
+	const uint a2 = lhs.s1 - ((lhs.s1 >= P3) ? P3 : 0);		// P2 < 2 * P3
+	uint d = lhs.s2 - a2; const uint t = (lhs.s2 < a2) ? P3 : 0; d += t;
+	const uint w1 = _mulmodp(d, P3, InvP1P2_P3, InvP1P2_P3p), w2 = _mulmodp(u, P3, InvP1_P3, InvP1_P3p);
+	const uint w = w1 - w2 + ((w1 < w2) ? P3 : 0);
+
+	const bool neg = (w > P3 / 2) || ((w == P3 / 2) && (r12 > P1P2 / 2));
+	const long ws = (long)(w) - (neg ? (long)(P3) : 0);
+
+	const long s = (long)(P1P2 & digit_mask) * ws + (long)(r12);	// |s| < 2^63
+	*digit = (uint)(s) & digit_mask;
+	// modulo 2^64, the carry is smaller than 2^63
+	return (long)((P1P2 >> digit_bit) * (ulong)(ws) + (ulong)(s >> digit_bit));
+}
+
+inline uint4 addmod(const uint4 lhs, const uint4 rhs)
+{
+	const uint4 r = lhs + rhs;
+	const uint4 t = (uint4)((lhs.s0 >= P1 - rhs.s0) ? P1 : 0, (lhs.s1 >= P2 - rhs.s1) ? P2 : 0, (lhs.s2 >= P3 - rhs.s2) ? P3 : 0, 0);
+	return r - t;
+}
+
+inline uint4 submod(const uint4 lhs, const uint4 rhs)
+{
+	const uint4 r = lhs - rhs;
+	const uint4 t = (uint4)((lhs.s0 < rhs.s0) ? P1 : 0, (lhs.s1 < rhs.s1) ? P2 : 0, (lhs.s2 < rhs.s2) ? P3 : 0, 0);
+	return r + t;
+}
+
+inline uint4 mulmod(const uint4 lhs, const uint4 rhs)
+{
+	return (uint4)(_mulmodP1(lhs.s0, rhs.s0), _mulmodP2(lhs.s1, rhs.s1), _mulmodP3(lhs.s2, rhs.s2), 0);
+}
+
+// rhs.lo is the root, rhs.hi is its Shoup's precomputation
+inline uint4 mulmodp(const uint4 lhs, const uint8 rhs)
+{
+	return (uint4)(_mulmodp(lhs.s0, P1, rhs.s0, rhs.s4), _mulmodp(lhs.s1, P2, rhs.s1, rhs.s5), _mulmodp(lhs.s2, P3, rhs.s2, rhs.s6), 0);
+}
+
+inline uint4 sqrmod(const uint4 lhs) { return mulmod(lhs, lhs); }
+
+inline uint4 mulI(const uint4 lhs)
+{
+	return (uint4)(_mulmodp(lhs.s0, P1, P1_I, P1_Ip), _mulmodp(lhs.s1, P2, P2_I, P2_Ip), _mulmodp(lhs.s2, P3, P3_I, P3_Ip), 0);
+}
+
+#else
+
+inline uint2 toMod(const uint d) { return (uint2)(d, d); }
+
 inline long getlong(const uint2 lhs)
 {
-	// Garner Algorithm
-	uint d = lhs.s0 - lhs.s1; const uint t = (lhs.s0 < lhs.s1) ? P1 : 0; d += t;	// mod P1
-	const uint u = _mulmodp(d, P1, InvP2_P1, InvP2_P1p);		// P2 < P1
-	const ulong r = u * (ulong)(P2) + lhs.s1;
+	const ulong r = _garnerP2(lhs.s0, lhs.s1) * (ulong)(P2) + lhs.s1;
 	const ulong s = (r > P1P2 / 2) ? P1P2 : 0;
 	return (long)(r - s);
 }
 
+// getlong(lhs) = carry.B + digit, 0 <= digit < B
+inline long getcarry(const uint2 lhs, uint * const digit)
+{
+	const long l = getlong(lhs);
+	*digit = (uint)(l) & digit_mask;
+	return l >> digit_bit;
+}
+
 inline uint2 addmod(const uint2 lhs, const uint2 rhs)
 {
 	const uint2 r = lhs + rhs;
@@ -110,145 +291,209 @@ inline uint2 mulI(const uint2 lhs)
 	return (uint2)(_mulmodp(lhs.s0, P1, P1_I, P1_Ip), _mulmodp(lhs.s1, P2, P2_I, P2_Ip));
 }
 
-inline void _sub_forward4i(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x, const uint2 r2, const uint4 r1ir1)
+#endif
+
+#endif
+
+#if defined(BALANCED)
+inline rns toModInt(const int d) { return (d >= 0) ? toMod((uint)(d)) : submod(toMod(0), toMod((uint)(-d))); }
+#endif
+
+// If BALANCED is defined then the digits of R - Y were balanced by the kernel balance and are read from bd
+inline void _sub_forward4i(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x,
+	__global const int * restrict const bd, const rns r2, const rns2 r1ir1)
 {
-	const uint2 abi = x[0 * mg], abim = x[1 * mg];
-	const uint2 abi0 = (uint2)(abi.s0, abi.s0), abi1 = (uint2)(abi.s1, abi.s1);
-	const uint2 abim0 = (uint2)(abim.s0, abim.s0), abim1 = (uint2)(abim.s1, abim.s1);
-	const uint2 u0 = submod(abi0, abi1), u1 = submod(abim0, abim1), u3 = mulI(u1);
+#if defined(BALANCED)
+	const rns u0 = toModInt(bd[0 * mg]), u1 = toModInt(bd[1 * mg]), u3 = mulI(u1);
+#else
+	const rns abi = x[0 * mg], abim = x[1 * mg];
+	const rns u0 = submod(toMod(abi.s0), toMod(abi.s1)), u1 = submod(toMod(abim.s0), toMod(abim.s1)), u3 = mulI(u1);
+#endif
 	X[0 * ml] = addmod(u0, u1); X[1 * ml] = mulmod(submod(u0, u1), r2);
-	X[2 * ml] = mulmod(submod(u0, u3), r1ir1.s23); X[3 * ml] = mulmod(addmod(u0, u3), r1ir1.s01);
+	X[2 * ml] = mulmod(submod(u0, u3), r1ir1.hi); X[3 * ml] = mulmod(addmod(u0, u3), r1ir1.lo);
 }
 
-inline void _forward4i(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x, const uint2 r2, const uint4 r1ir1)
+inline void _forward4i(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x, const rns r2, const rns2 r1ir1)
 {
-	const uint2 u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	X[0 * ml] = addmod(v0, v1); X[1 * ml] = mulmod(submod(v0, v1), r2);
-	X[2 * ml] = mulmod(addmod(v2, v3), r1ir1.s23); X[3 * ml] = mulmod(submod(v2, v3), r1ir1.s01);
+	X[2 * ml] = mulmod(addmod(v2, v3), r1ir1.hi); X[3 * ml] = mulmod(submod(v2, v3), r1ir1.lo);
 }
 
-inline void _forward4(const size_t m, __local uint2 * restrict const X, const uint2 r2, const uint4 r1ir1)
+inline void _forward4(const size_t m, __local rns * restrict const X, const rns r2, const rns2 r1ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	X[0 * m] = addmod(v0, v1); X[1 * m] = mulmod(submod(v0, v1), r2);
-	X[2 * m] = mulmod(addmod(v2, v3), r1ir1.s23); X[3 * m] = mulmod(submod(v2, v3), r1ir1.s01);
+	X[2 * m] = mulmod(addmod(v2, v3), r1ir1.hi); X[3 * m] = mulmod(submod(v2, v3), r1ir1.lo);
 }
 
-inline void _forward4o(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X, const uint2 r2, const uint4 r1ir1)
+inline void _forward4o(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X, const rns r2, const rns2 r1ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	x[0 * mg] = addmod(v0, v1); x[1 * mg] = mulmod(submod(v0, v1), r2);
-	x[2 * mg] = mulmod(addmod(v2, v3), r1ir1.s23); x[3 * mg] = mulmod(submod(v2, v3), r1ir1.s01);
+	x[2 * mg] = mulmod(addmod(v2, v3), r1ir1.hi); x[3 * mg] = mulmod(submod(v2, v3), r1ir1.lo);
 }
 
-inline void _backward4i(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x, const uint2 ir2, const uint4 r1ir1)
+inline void _backward4i(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x, const rns ir2, const rns2 r1ir1)
 {
-	const uint2 v0 = x[0 * mg], v1 = mulmod(x[1 * mg], ir2), v2 = mulmod(x[2 * mg], r1ir1.s01), v3 = mulmod(x[3 * mg], r1ir1.s23);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = x[0 * mg], v1 = mulmod(x[1 * mg], ir2), v2 = mulmod(x[2 * mg], r1ir1.lo), v3 = mulmod(x[3 * mg], r1ir1.hi);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	X[0 * ml] = addmod(u0, u2); X[2 * ml] = submod(u0, u2); X[1 * ml] = addmod(u1, u3); X[3 * ml] = submod(u1, u3);
 }
 
-inline void _backward4(const size_t m, __local uint2 * restrict const X, const uint2 ir2, const uint4 r1ir1)
+inline void _backward4(const size_t m, __local rns * restrict const X, const rns ir2, const rns2 r1ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 v0 = X[0 * m], v1 = mulmod(X[1 * m], ir2), v2 = mulmod(X[2 * m], r1ir1.s01), v3 = mulmod(X[3 * m], r1ir1.s23);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = X[0 * m], v1 = mulmod(X[1 * m], ir2), v2 = mulmod(X[2 * m], r1ir1.lo), v3 = mulmod(X[3 * m], r1ir1.hi);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	X[0 * m] = addmod(u0, u2); X[2 * m] = submod(u0, u2); X[1 * m] = addmod(u1, u3); X[3 * m] = submod(u1, u3);
 }
 
-inline void _backward4o(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X, const uint2 ir2, const uint4 r1ir1)
+inline void _backward4o(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X, const rns ir2, const rns2 r1ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 v0 = X[0 * ml], v1 = mulmod(X[1 * ml], ir2), v2 = mulmod(X[2 * ml], r1ir1.s01), v3 = mulmod(X[3 * ml], r1ir1.s23);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = X[0 * ml], v1 = mulmod(X[1 * ml], ir2), v2 = mulmod(X[2 * ml], r1ir1.lo), v3 = mulmod(X[3 * ml], r1ir1.hi);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	x[0 * mg] = addmod(u0, u2); x[2 * mg] = submod(u0, u2); x[1 * mg] = addmod(u1, u3); x[3 * mg] = submod(u1, u3);
 }
 
-inline void _forward4pi(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x,
-	const uint4 r2, const uint4 r1, const uint4 ir1)
+inline void _forward4pi(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x,
+	const rns2 r2, const rns2 r1, const rns2 ir1)
 {
-	const uint2 u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	X[0 * ml] = addmod(v0, v1); X[1 * ml] = mulmodp(submod(v0, v1), r2);
 	X[2 * ml] = mulmodp(addmod(v2, v3), ir1); X[3 * ml] = mulmodp(submod(v2, v3), r1);
 }
 
-inline void _forward4p(const size_t m, __local uint2 * restrict const X,
-	const uint4 r2, const uint4 r1, const uint4 ir1)
+inline void _forward4p(const size_t m, __local rns * restrict const X,
+	const rns2 r2, const rns2 r1, const rns2 ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	X[0 * m] = addmod(v0, v1); X[1 * m] = mulmodp(submod(v0, v1), r2);
 	X[2 * m] = mulmodp(addmod(v2, v3), ir1); X[3 * m] = mulmodp(submod(v2, v3), r1);
 }
 
-inline void _forward4po(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X,
-	const uint4 r2, const uint4 r1, const uint4 ir1)
+inline void _forward4po(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X,
+	const rns2 r2, const rns2 r1, const rns2 ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
 	x[0 * mg] = addmod(v0, v1); x[1 * mg] = mulmodp(submod(v0, v1), r2);
 	x[2 * mg] = mulmodp(addmod(v2, v3), ir1); x[3 * mg] = mulmodp(submod(v2, v3), r1);
 }
 
-inline void _backward4pi(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x,
-	const uint4 ir2, const uint4 r1, const uint4 ir1)
+inline void _backward4pi(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x,
+	const rns2 ir2, const rns2 r1, const rns2 ir1)
 {
-	const uint2 v0 = x[0 * mg], v1 = mulmodp(x[1 * mg], ir2), v2 = mulmodp(x[2 * mg], r1), v3 = mulmodp(x[3 * mg], ir1);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = x[0 * mg], v1 = mulmodp(x[1 * mg], ir2), v2 = mulmodp(x[2 * mg], r1), v3 = mulmodp(x[3 * mg], ir1);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	X[0 * ml] = addmod(u0, u2); X[2 * ml] = submod(u0, u2); X[1 * ml] = addmod(u1, u3); X[3 * ml] = submod(u1, u3);
 }
 
-inline void _backward4p(const size_t m, __local uint2 * restrict const X,
-	const uint4 ir2, const uint4 r1, const uint4 ir1)
+inline void _backward4p(const size_t m, __local rns * restrict const X,
+	const rns2 ir2, const rns2 r1, const rns2 ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 v0 = X[0 * m], v1 = mulmodp(X[1 * m], ir2), v2 = mulmodp(X[2 * m], r1), v3 = mulmodp(X[3 * m], ir1);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = X[0 * m], v1 = mulmodp(X[1 * m], ir2), v2 = mulmodp(X[2 * m], r1), v3 = mulmodp(X[3 * m], ir1);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	X[0 * m] = addmod(u0, u2); X[2 * m] = submod(u0, u2); X[1 * m] = addmod(u1, u3); X[3 * m] = submod(u1, u3);
 }
 
-inline void _backward4po(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X,
-	const uint4 ir2, const uint4 r1, const uint4 ir1)
+inline void _backward4po(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X,
+	const rns2 ir2, const rns2 r1, const rns2 ir1)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 v0 = X[0 * ml], v1 = mulmodp(X[1 * ml], ir2), v2 = mulmodp(X[2 * ml], r1), v3 = mulmodp(X[3 * ml], ir1);
-	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
+	const rns v0 = X[0 * ml], v1 = mulmodp(X[1 * ml], ir2), v2 = mulmodp(X[2 * ml], r1), v3 = mulmodp(X[3 * ml], ir1);
+	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));
 	x[0 * mg] = addmod(u0, u2); x[2 * mg] = submod(u0, u2); x[1 * mg] = addmod(u1, u3); x[3 * mg] = submod(u1, u3);
 }
 
-inline void _square2(__local uint2 * restrict const X)
+inline void _square2(__local rns * restrict const X)
+{
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const rns u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];
+	const rns v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);
+	const rns s0 = sqrmod(v0), s1 = sqrmod(v1), s4 = sqrmod(v4), s5 = sqrmod(v5);
+	X[0] = addmod(s0, s1); X[1] = submod(s0, s1); X[4] = addmod(s4, s5); X[5] = submod(s4, s5);
+}
+
+inline void _square4(__local rns * restrict const X)
+{
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const rns u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns s0 = sqrmod(addmod(v0, v1)), s1 = sqrmod(submod(v0, v1)), s2 = sqrmod(addmod(v2, v3)), s3 = sqrmod(submod(v2, v3));
+	const rns t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));
+	X[0] = addmod(t0, t2); X[2] = submod(t0, t2); X[1] = addmod(t1, t3); X[3] = submod(t1, t3);
+}
+
+// The transformed x is the multiplicand y of mul2 or mul4, it is stored before the squaring.
+inline void _square2_tu(__local rns * restrict const X, __global rns * restrict const y)
+{
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const rns u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];
+	y[0] = u0; y[1] = u1; y[4] = u4; y[5] = u5;
+	const rns v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);
+	const rns s0 = sqrmod(v0), s1 = sqrmod(v1), s4 = sqrmod(v4), s5 = sqrmod(v5);
+	X[0] = addmod(s0, s1); X[1] = submod(s0, s1); X[4] = addmod(s4, s5); X[5] = submod(s4, s5);
+}
+
+inline void _square4_tu(__local rns * restrict const X, __global rns * restrict const y)
+{
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const rns u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];
+	y[0] = u0; y[1] = u1; y[2] = u2; y[3] = u3;
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns s0 = sqrmod(addmod(v0, v1)), s1 = sqrmod(submod(v0, v1)), s2 = sqrmod(addmod(v2, v3)), s3 = sqrmod(submod(v2, v3));
+	const rns t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));
+	X[0] = addmod(t0, t2); X[2] = submod(t0, t2); X[1] = addmod(t1, t3); X[3] = submod(t1, t3);
+}
+
+// The last stage of the forward transform of x and y, the pointwise product and the first stage of the inverse transform.
+// y is the transformed multiplicand, see mul2 and mul4.
+inline void _mul2(__local rns * restrict const X, __global const rns * restrict const y)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];
-	const uint2 v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);
-	const uint2 s0 = sqrmod(v0), s1 = sqrmod(v1), s4 = sqrmod(v4), s5 = sqrmod(v5);
+	const rns u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];
+	const rns v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);
+	const rns uy0 = y[0], uy1 = y[1], uy4 = y[4], uy5 = y[5];
+	const rns vy0 = addmod(uy0, uy1), vy1 = submod(uy0, uy1), vy4 = addmod(uy4, uy5), vy5 = submod(uy4, uy5);
+	const rns s0 = mulmod(v0, vy0), s1 = mulmod(v1, vy1), s4 = mulmod(v4, vy4), s5 = mulmod(v5, vy5);
 	X[0] = addmod(s0, s1); X[1] = submod(s0, s1); X[4] = addmod(s4, s5); X[5] = submod(s4, s5);
 }
 
-inline void _square4(__local uint2 * restrict const X)
+inline void _mul4(__local rns * restrict const X, __global const rns * restrict const y)
 {
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint2 u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];
-	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
-	const uint2 s0 = sqrmod(addmod(v0, v1)), s1 = sqrmod(submod(v0, v1)), s2 = sqrmod(addmod(v2, v3)), s3 = sqrmod(submod(v2, v3));
-	const uint2 t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));
+	const rns u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];
+	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));
+	const rns uy0 = y[0], uy2 = y[2], uy1 = y[1], uy3 = y[3];
+	const rns vy0 = addmod(uy0, uy2), vy2 = submod(uy0, uy2), vy1 = addmod(uy1, uy3), vy3 = mulI(submod(uy3, uy1));
+	const rns s0 = mulmod(addmod(v0, v1), addmod(vy0, vy1)), s1 = mulmod(submod(v0, v1), submod(vy0, vy1));
+	const rns s2 = mulmod(addmod(v2, v3), addmod(vy2, vy3)), s3 = mulmod(submod(v2, v3), submod(vy2, vy3));
+	const rns t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));
 	X[0] = addmod(t0, t2); X[2] = submod(t0, t2); X[1] = addmod(t1, t3); X[3] = submod(t1, t3);
 }
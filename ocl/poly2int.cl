@@ -10,17 +10,19 @@ Please give feedback to the authors if improvement is realized. It is distribute
 	__local uint X[P2I_WGS * P2I_BLK];
  
 inline void poly2int0(__local long * restrict const L, __local uint * restrict const X, const size_t P2I_BLK, const size_t P2I_WGS,
- 	__global uint2 * restrict const x, __global long * restrict const cr)
+ 	__global rns * restrict const x, __global long * restrict const cr)
  {
 	const size_t i = get_local_id(0), blk = get_group_id(0);
-	const size_t kc = (get_global_id(0) + 1) & (get_global_size(0) - 1);
+	const size_t kc = (get_global_id(0) + 1 != get_global_size(0)) ? get_global_id(0) + 1 : 0;	// the size is not a power of 2 if RADIX is defined
 
-	__global uint2 * const xo = &x[P2I_WGS * P2I_BLK * blk];
+	__global rns * const xo = &x[P2I_WGS * P2I_BLK * blk];
 
 	for (size_t j = 0; j < P2I_BLK; ++j)
 	{
 		const size_t k = P2I_WGS * j + i;
-		L[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = getlong(mulmod(xo[k], pconst_norm));	// -n/2 . (B-1)^2 <= l <= n/2 . (B-1)^2
+		// the coefficient is L.B + X, -n/2 . (B-1)^2 <= L.B + X <= n/2 . (B-1)^2
+		uint d; L[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = getcarry(mulmod(xo[k], pconst_norm), &d);
+		X[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = d;
 	}
 
 	barrier(CLK_LOCAL_MEM_FENCE);
@@ -29,9 +31,9 @@ inline void poly2int0(__local long * restrict const L, __local uint * restrict c
 //#pragma unroll
 	for (size_t j = 0; j < P2I_BLK; ++j)
 	{
-		l += L[P2I_WGS * j + i];
+		l += X[P2I_WGS * j + i];
 		X[P2I_WGS * j + i] = (uint)(l) & digit_mask;
-	 	l >>= digit_bit;
+	 	l = (l >> digit_bit) + L[P2I_WGS * j + i];
 	}
 	cr[kc] = l;
 
@@ -45,11 +47,42 @@ inline void poly2int0(__local long * restrict const L, __local uint * restrict c
 	}
 }
 
-inline void poly2int1(const size_t P2I_BLK, __global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)
+// poly2int1 and reduce_i_N are not followed by a second pass: the groups are counted in lb[1], as in poly2int_lb.
+// If the carry was propagated through a whole block then err[1] is set and the last group to complete
+// normalizes the digits serially.
+inline bool poly2int_last_group(__global uint * restrict const lb)
+{
+	barrier(CLK_GLOBAL_MEM_FENCE);
+	if (get_local_id(0) != 0) return false;
+	mem_fence(CLK_GLOBAL_MEM_FENCE);
+	if (atomic_inc(&lb[1]) != get_num_groups(0) - 1) return false;
+	lb[1] = 0;
+	mem_fence(CLK_GLOBAL_MEM_FENCE);
+	return true;
+}
+
+inline bool poly2int_fix(__global rns * restrict const x, __global int * const err)
+{
+	if (atomic_xchg(&err[1], 0) == 0) return false;
+
+	int f = 0;
+	for (size_t k = 0; k < pconst_size; ++k)
+	{
+		f += x[k].s0;
+		x[k] = (uint)(f) & digit_mask;
+		f >>= digit_bit;
+	}
+
+	if (f != 0) err[0] = f;	// an error is not cleared before it is read
+	return true;
+}
+
+inline void poly2int1(const size_t P2I_BLK, __global rns * restrict const x, __global const long * restrict const cr,
+	__global uint * restrict const lb, __global int * const err)
 {
 	const size_t k = get_global_id(0);
 
-	__global uint2 * const xi = &x[P2I_BLK * k];
+	__global rns * const xi = &x[P2I_BLK * k];
 
 	long l = cr[k] + xi[0].s0;
 	xi[0].s0 = (uint)(l) & digit_mask;
@@ -57,120 +90,392 @@ inline void poly2int1(const size_t P2I_BLK, __global uint2 * restrict const x, _
 
 	int f = (int)(l);
 //#pragma unroll
-	for (size_t j = 1; j < P2I_BLK - 1; ++j)
+	for (size_t j = 1; (f != 0) && (j < P2I_BLK - 1); ++j)
 	{
 		f += xi[j].s0;
 		xi[j].s0 = (uint)(f) & digit_mask;
 		f >>= digit_bit;					// f = -1, 0 or 1
-		if (f == 0) return;
 	}
 
-	f += xi[P2I_BLK - 1].s0;
-	xi[P2I_BLK - 1].s0 = (uint)(f);
-	f >>= digit_bit;
-	if (f != 0) atomic_or(&err[1], f);
+	if (f != 0)
+	{
+		f += xi[P2I_BLK - 1].s0;
+		xi[P2I_BLK - 1].s0 = (uint)(f);
+		f >>= digit_bit;
+		if (f != 0) atomic_or(&err[1], f);
+	}
+
+	if (poly2int_last_group(lb)) poly2int_fix(x, err);
 }
 
-__kernel
-void poly2int2(__global uint2 * restrict const x, __global int * const err)
+// Single-pass carry propagation with a decoupled look-back (D. Merrill, M. Garland, Single-pass Parallel Prefix Scan
+// with Decoupled Look-back, 2016). The groups are processed in the order of a ticket: the group g only waits for
+// the group g - 1, which was started. The carry of a group is normalized in local memory, |carry out| < B^3. If the digits
+// 3, 4, ... of a group are neither all zero nor all B - 1 then the incoming carry cannot be propagated through the group:
+// its carry out is published before the incoming carry is known. Otherwise the group waits for its incoming carry.
+// lb[0] is the ticket counter, lb[1] counts the completed groups and lb[2 + g] is set if the carry out of g is in cr[g].
+// The product is zero-padded then the carry out of the last group is zero.
+
+#define POLY2INT_LB_VAR(P2I_BLK, P2I_WGS) \
+	__local long L[P2I_WGS * P2I_BLK]; \
+	__local uint X[P2I_WGS * P2I_BLK]; \
+	__local long C[P2I_WGS]; \
+	__local uint S[4];
+
+inline void poly2int_lb(__local long * restrict const L, __local uint * restrict const X, __local long * restrict const C,
+	__local uint * restrict const S, const size_t P2I_BLK, const size_t P2I_WGS,
+	__global rns * restrict const x, __global long * restrict const cr, __global uint * restrict const lb, __global int * const err)
 {
-	if (err[1] == 0) return;
+	const size_t i = get_local_id(0), G = pconst_size / (P2I_WGS * P2I_BLK);
 
-	int f = 0;
-	for (size_t k = 0; k < pconst_size; ++k)
+	if (i == 0)
 	{
-		f += x[k].s0;
-		x[k] = (uint)(f) & digit_mask;
-		f >>= digit_bit;
+		S[0] = atomic_inc(&lb[0]);	// ticket
+		S[1] = 0; S[2] = 0; S[3] = 0;	// propagation, a digit != 0, a digit != B - 1
 	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const size_t g = S[0];
+	__global rns * const xo = &x[P2I_WGS * P2I_BLK * g];
+
+	for (size_t j = 0; j < P2I_BLK; ++j)
+	{
+		const size_t k = P2I_WGS * j + i;
+		// the coefficient is L.B + X, -n/2 . (B-1)^2 <= L.B + X <= n/2 . (B-1)^2
+		uint d; L[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = getcarry(mulmod(xo[k], pconst_norm), &d);
+		X[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = d;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	long l = 0;
+	for (size_t j = 0; j < P2I_BLK; ++j)
+	{
+		l += X[P2I_WGS * j + i];
+		X[P2I_WGS * j + i] = (uint)(l) & digit_mask;
+	 	l = (l >> digit_bit) + L[P2I_WGS * j + i];
+	}
+	C[i] = l;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// the carries are propagated in the group, the carry out of a block is -1, 0 or 1 after the first round
+	long c = (i != 0) ? C[i - 1] : 0, c_out = C[P2I_WGS - 1];
+	while (true)
+	{
+		for (size_t j = 0; (c != 0) && (j < P2I_BLK); ++j)
+		{
+			c += X[P2I_WGS * j + i];
+			X[P2I_WGS * j + i] = (uint)(c) & digit_mask;
+			c >>= digit_bit;
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+		C[i] = c;
+		if ((c != 0) && (i != P2I_WGS - 1)) S[1] = 1;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		const bool propagate = (S[1] != 0);
+		c_out += C[P2I_WGS - 1];
+		c = (i != 0) ? C[i - 1] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (!propagate) break;
+		if (i == 0) S[1] = 0;
+	}
+
+	for (size_t j = 0; j < P2I_BLK; ++j)
+	{
+		const uint d = X[P2I_WGS * j + i];
+		if (P2I_BLK * i + j >= 3)
+		{
+			if (d != 0) S[2] = 1;
+			if (d != digit_mask) S[3] = 1;
+		}
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (i == 0)
+	{
+		const bool independent = (S[2] != 0) && (S[3] != 0);
+		if (independent && (g != G - 1))
+		{
+			cr[g] = c_out;
+			mem_fence(CLK_GLOBAL_MEM_FENCE);
+			atomic_xchg(&lb[2 + g], 1);
+		}
+
+		long c_in = 0;
+		if (g != 0)
+		{
+			while (atomic_or(&lb[2 + g - 1], 0) == 0) {}
+			mem_fence(CLK_GLOBAL_MEM_FENCE);
+			c_in = ((volatile __global long *)cr)[g - 1];
+			lb[2 + g - 1] = 0;
+		}
+
+		for (size_t k = 0; (c_in != 0) && (k < P2I_WGS * P2I_BLK); ++k)
+		{
+			const size_t j = P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK);
+			c_in += X[j];
+			X[j] = (uint)(c_in) & digit_mask;
+			c_in >>= digit_bit;
+		}
+		c_out += c_in;
+
+		if (g == G - 1) { if (c_out != 0) atomic_or(&err[0], 1); }
+		else if (!independent)
+		{
+			cr[g] = c_out;
+			mem_fence(CLK_GLOBAL_MEM_FENCE);
+			atomic_xchg(&lb[2 + g], 1);
+		}
+
+		// the last group resets the counters
+		if (atomic_inc(&lb[1]) == G - 1) { lb[0] = 0; lb[1] = 0; }
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
 
-	err[0] = f;
-	err[1] = 0;
+	for (size_t j = 0; j < P2I_BLK; ++j)
+	{
+		const size_t k = P2I_WGS * j + i;
+		xo[k].s0 = X[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)];
+	}
 }
 
 // P2I_BLK = 4
 
 __kernel __attribute__((reqd_work_group_size(16, 1, 1)))
-void poly2int0_4_16(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_4_16(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(4, 16);
 	poly2int0(L, X, 4, 16, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(16, 1, 1)))
+void poly2int_lb_4_16(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(4, 16);
+	poly2int_lb(L, X, C, S, 4, 16, x, cr, lb, err);
+}
+
 __kernel __attribute__((reqd_work_group_size(32, 1, 1)))
-void poly2int0_4_32(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_4_32(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(4, 32);
 	poly2int0(L, X, 4, 32, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(32, 1, 1)))
+void poly2int_lb_4_32(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(4, 32);
+	poly2int_lb(L, X, C, S, 4, 32, x, cr, lb, err);
+}
+
 __kernel __attribute__((reqd_work_group_size(64, 1, 1)))
-void poly2int0_4_64(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_4_64(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(4, 64);
 	poly2int0(L, X, 4, 64, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+void poly2int_lb_4_64(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(4, 64);
+	poly2int_lb(L, X, C, S, 4, 64, x, cr, lb, err);
+}
+
 __kernel
-void poly2int1_4(__global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)
+void poly2int1_4(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err)
 {
-	poly2int1(4, x, cr, err);
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	poly2int1(4, x, cr, lb, err);
 }
 
 // P2I_BLK = 8
 
 __kernel __attribute__((reqd_work_group_size(16, 1, 1)))
-void poly2int0_8_16(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_8_16(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(8, 16);
 	poly2int0(L, X, 8, 16, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(16, 1, 1)))
+void poly2int_lb_8_16(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(8, 16);
+	poly2int_lb(L, X, C, S, 8, 16, x, cr, lb, err);
+}
+
 __kernel __attribute__((reqd_work_group_size(32, 1, 1)))
-void poly2int0_8_32(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_8_32(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(8, 32);
 	poly2int0(L, X, 8, 32, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(32, 1, 1)))
+void poly2int_lb_8_32(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(8, 32);
+	poly2int_lb(L, X, C, S, 8, 32, x, cr, lb, err);
+}
+
 __kernel __attribute__((reqd_work_group_size(64, 1, 1)))
-void poly2int0_8_64(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_8_64(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(8, 64);
 	poly2int0(L, X, 8, 64, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+void poly2int_lb_8_64(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(8, 64);
+	poly2int_lb(L, X, C, S, 8, 64, x, cr, lb, err);
+}
+
 __kernel
-void poly2int1_8(__global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)
+void poly2int1_8(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err)
 {
-	poly2int1(8, x, cr, err);
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	poly2int1(8, x, cr, lb, err);
 }
 
 // P2I_BLK = 16
 
 __kernel __attribute__((reqd_work_group_size(8, 1, 1)))
-void poly2int0_16_8(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_16_8(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(16, 8);
 	poly2int0(L, X, 16, 8, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(8, 1, 1)))
+void poly2int_lb_16_8(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(16, 8);
+	poly2int_lb(L, X, C, S, 16, 8, x, cr, lb, err);
+}
+
 __kernel __attribute__((reqd_work_group_size(16, 1, 1)))
-void poly2int0_16_16(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_16_16(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(16, 16);
 	poly2int0(L, X, 16, 16, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(16, 1, 1)))
+void poly2int_lb_16_16(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(16, 16);
+	poly2int_lb(L, X, C, S, 16, 16, x, cr, lb, err);
+}
+
 __kernel __attribute__((reqd_work_group_size(32, 1, 1)))
-void poly2int0_16_32(__global uint2 * restrict const x, __global long * restrict const cr)
+void poly2int0_16_32(__global rns * restrict x, __global long * restrict cr)
 {
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+
 	POLY2INT0_VAR(16, 32);
 	poly2int0(L, X, 16, 32, x, cr);
 }
 
+__kernel __attribute__((reqd_work_group_size(32, 1, 1)))
+void poly2int_lb_16_32(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	POLY2INT_LB_VAR(16, 32);
+	poly2int_lb(L, X, C, S, 16, 32, x, cr, lb, err);
+}
+
 __kernel
-void poly2int1_16(__global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)
+void poly2int1_16(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err)
 {
-	poly2int1(16, x, cr, err);
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+
+	poly2int1(16, x, cr, lb, err);
 }
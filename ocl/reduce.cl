@@ -5,11 +5,17 @@ proth20 is free source code, under the MIT license (see LICENSE). You can redist
 Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
 */
 
+// The constants of P = k.2^n + 1 = d.2^s * (2^digit_bit)^e + 1 are not compiled into the program, they are read from pc:
+// pc[0] = e, pc[1] = s, pc[2] = d, pc[3] = d_inv, pc[4] = d_shift
+
 #define	R64		(RED_BLK * 64 / 4)
 
 __kernel __attribute__((reqd_work_group_size(R64, 1, 1)))
-void reduce_upsweep64(__global uint * restrict const t, const uint s, const uint j)
+void reduce_upsweep64(__global uint * restrict t, __global const uint * restrict pc, const uint s, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint4 T_4[R64 / 4 + R64 / 16];	// alignment
 	__local uint4 * const T2_4 = &T_4[R64 / 4];
 	__local uint * const T = (__local uint *)T_4;
@@ -17,10 +23,11 @@ void reduce_upsweep64(__global uint * restrict const t, const uint s, const uint
 
 	const size_t i = get_local_id(0), blk = get_group_id(0), k = get_global_id(0);	// blk * R64 + i;
 	__global uint * const tj = &t[j];
+	const uint d = pc[2];
 
 	__global const uint4 * const tj1_4 = (__global const uint4 *)&tj[0];
 	const uint4 u = tj1_4[k];
-	const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);
+	const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);
 	T[i] = u0123;
 
 	barrier(CLK_LOCAL_MEM_FENCE);
@@ -31,7 +38,7 @@ void reduce_upsweep64(__global uint * restrict const t, const uint s, const uint
 	{
 		const size_t k_4 = blk * R64 / 4 + i;
 		const uint4 u = T_4[i];
-		const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);
+		const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);
 		tj[5 * (16 * s) + 4 * (4 * s) + k_4] = u23; tj[5 * (16 * s) + 5 * (4 * s) + k_4] = u0123; T_2[i] = u0123;
 	}
 
@@ -41,14 +48,17 @@ void reduce_upsweep64(__global uint * restrict const t, const uint s, const uint
 	{
 		const size_t k_16 = blk * R64 / 16 + i;
 		const uint4 u = T2_4[i];
-		const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);
+		const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);
 		tj[5 * (16 * s) + 5 * (4 * s) + 4 * s + k_16] = u23; tj[5 * (16 * s) + 5 * (4 * s) + 5 * s + k_16] = u0123;
 	}
 }
 
 __kernel __attribute__((reqd_work_group_size(R64, 1, 1)))
-void reduce_downsweep64(__global uint * restrict const t, const uint s, const uint j)
+void reduce_downsweep64(__global uint * restrict t, __global const uint * restrict pc, const uint s, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint4 T_4[R64 / 4 + R64 / 16];	// alignment
 	__local uint4 * const T2_4 = &T_4[R64 / 4];
 	__local uint * const T = (__local uint *)T_4;
@@ -56,14 +66,15 @@ void reduce_downsweep64(__global uint * restrict const t, const uint s, const ui
 
 	const size_t i = get_local_id(0), blk = get_group_id(0), k = get_global_id(0);	// blk * R64 + i;
 	__global uint * const tj = &t[j];
+	const uint d = pc[2];
 
 	if (i < R64 / 16)
 	{
 		const size_t k_16 = blk * R64 / 16 + i;
 		__global const uint4 * const tj16_4 = (__global uint4 *)&tj[5 * (16 * s) + 5 * (4 * s)];
-		const uint u2 = tj[5 * (16 * s) + 5 * (4 * s) + 4 * s + k_16], u0 = tj[5 * (16 * s) + 5 * (4 * s) + 5 * s + k_16], u02 = addmod_d(u0, u2);
+		const uint u2 = tj[5 * (16 * s) + 5 * (4 * s) + 4 * s + k_16], u0 = tj[5 * (16 * s) + 5 * (4 * s) + 5 * s + k_16], u02 = addmod_d(u0, u2, d);
 		const uint4 u13 = tj16_4[k_16];
-		const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);
+		const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);
 		T2_4[i] = (uint4)(u012, u02, u03, u0);
 	}
 
@@ -73,9 +84,9 @@ void reduce_downsweep64(__global uint * restrict const t, const uint s, const ui
 	{
 		const size_t k_4 = blk * R64 / 4 + i;
 		__global const uint4 * const tj4_4 = (__global uint4 *)&tj[5 * (16 * s)];
-		const uint u2 = tj[5 * (16 * s) + 4 * (4 * s) + k_4], u0 = T_2[i], u02 = addmod_d(u0, u2);
+		const uint u2 = tj[5 * (16 * s) + 4 * (4 * s) + k_4], u0 = T_2[i], u02 = addmod_d(u0, u2, d);
 		const uint4 u13 = tj4_4[k_4];
-		const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);
+		const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);
 		T_4[i] = (uint4)(u012, u02, u03, u0);
 	}
 
@@ -85,232 +96,538 @@ void reduce_downsweep64(__global uint * restrict const t, const uint s, const ui
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	const uint u0 = T[i], u02 = addmod_d(u0, u2);
-	const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);
+	const uint u0 = T[i], u02 = addmod_d(u0, u2, d);
+	const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);
 	tj1_4[k] = (uint4)(u012, u02, u03, u0);
 }
 
-inline void _reduce_upsweep4i(__local uint * restrict const T, __global const uint * restrict const t, const uint s, const size_t k)
+inline void _reduce_upsweep4i(__local uint * restrict const T, __global const uint * restrict const t, const uint s, const size_t k, const uint d)
 {
 	__global const uint4 * const ti = (__global const uint4 *)&t[4 * k];
 	__local uint * const To = &T[k];
 
 	const uint4 u = ti[0];
-	const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);
+	const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);
 	To[0] = u23; To[s] = u0123;
 }
 
-inline void _reduce_upsweep4(__local uint * restrict const T, const uint s, const size_t k)
+inline void _reduce_upsweep4(__local uint * restrict const T, const uint s, const size_t k, const uint d)
 {
 	__local const uint * const Ti = &T[0 * s + 4 * k];
 	__local uint * const To = &T[4 * s + 1 * k];
 
 	const uint u0 = Ti[0], u1 = Ti[1], u2 = Ti[2], u3 = Ti[3];
-	const uint u01 = addmod_d(u0, u1), u23 = addmod_d(u2, u3), u0123 = addmod_d(u01, u23);
+	const uint u01 = addmod_d(u0, u1, d), u23 = addmod_d(u2, u3, d), u0123 = addmod_d(u01, u23, d);
 	To[0] = u23; To[s] = u0123;
 }
 
-inline void _reduce_downsweep4(__local uint * restrict const T, const uint s, const size_t k)
+inline void _reduce_downsweep4(__local uint * restrict const T, const uint s, const size_t k, const uint d)
 {
 	__local const uint * const Ti = &T[4 * s + 1 * k];
 	__local uint * const To = &T[0 * s + 4 * k];
 
-	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2);
+	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2, d);
 	const uint u1 = To[1], u3 = To[3];
-	const uint u012 = addmod_d(u02, u1), u03 = addmod_d(u0, u3);
+	const uint u012 = addmod_d(u02, u1, d), u03 = addmod_d(u0, u3, d);
 	To[0] = u012; To[1] = u02; To[2] = u03; To[3] = u0;
 }
 
-inline void _reduce_downsweep4o(__global uint * restrict const t, __local const uint * restrict const T, const uint s, const size_t k)
+inline void _reduce_downsweep4o(__global uint * restrict const t, __local const uint * restrict const T, const uint s, const size_t k, const uint d)
 {
 	__local const uint * const Ti = &T[k];
 	__global uint4 * const to = (__global uint4 *)&t[4 * k];
 
-	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2);
+	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2, d);
 	const uint4 u13 = to[0];
-	const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);
+	const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);
 	to[0] = (uint4)(u012, u02, u03, u0);
 }
 
-inline void _reduce_topsweep2(__global uint * restrict const t, __local uint * restrict const T)
+inline void _reduce_topsweep2(__global uint * restrict const t, __local uint * restrict const T, const uint d)
 {
 	const uint u0 = T[0], u1 = T[1];
-	const uint u01 = addmod_d(u0, u1);
+	const uint u01 = addmod_d(u0, u1, d);
 	t[0] = u01;
 	T[0] = u1; T[1] = 0;
 }
 
-inline void _reduce_topsweep4(__global uint * restrict const t, __local uint * restrict const T)
+inline void _reduce_topsweep4(__global uint * restrict const t, __local uint * restrict const T, const uint d)
 {
 	const uint u0 = T[0], u1 = T[1], u2 = T[2], u3 = T[3];
-	const uint u01 = addmod_d(u0, u1), u23 = addmod_d(u2, u3);
-	const uint u123 = addmod_d(u1, u23), u0123 = addmod_d(u01, u23);
+	const uint u01 = addmod_d(u0, u1, d), u23 = addmod_d(u2, u3, d);
+	const uint u123 = addmod_d(u1, u23, d), u0123 = addmod_d(u01, u23, d);
 	t[0] = u0123;
 	T[0] = u123; T[1] = u23; T[2] = u3; T[3] = 0;
 }
 
 #define	S32		(32 / 4)
 __kernel __attribute__((reqd_work_group_size(S32, 1, 1)))
-void reduce_topsweep32(__global uint * restrict const t, const uint j)
+void reduce_topsweep32(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint T[64];	// 20
 
 	const size_t i = get_local_id(0);
+	const uint d = pc[2];
 
-	_reduce_upsweep4i(T, &t[j], S32, i);
+	_reduce_upsweep4i(T, &t[j], S32, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S32 / 4) _reduce_upsweep4(&T[S32], S32 / 4, i);
+	if (i < S32 / 4) _reduce_upsweep4(&T[S32], S32 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i == 0) _reduce_topsweep2(t, &T[S32 + 5 * (S32 / 4)]);
+	if (i == 0) _reduce_topsweep2(t, &T[S32 + 5 * (S32 / 4)], d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S32 / 4) _reduce_downsweep4(&T[S32], S32 / 4, i);
+	if (i < S32 / 4) _reduce_downsweep4(&T[S32], S32 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	_reduce_downsweep4o(&t[j], T, S32, i);
+	_reduce_downsweep4o(&t[j], T, S32, i, d);
 }
 
 #define	S64		(64 / 4)
 __kernel __attribute__((reqd_work_group_size(S64, 1, 1)))
-void reduce_topsweep64(__global uint * restrict const t, const uint j)
+void reduce_topsweep64(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint T[64];	// 40
 
 	const size_t i = get_local_id(0);
+	const uint d = pc[2];
 
-	_reduce_upsweep4i(T, &t[j], S64, i);
+	_reduce_upsweep4i(T, &t[j], S64, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S64 / 4) _reduce_upsweep4(&T[S64], S64 / 4, i);
+	if (i < S64 / 4) _reduce_upsweep4(&T[S64], S64 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i == 0) _reduce_topsweep4(t, &T[S64 + 5 * (S64 / 4)]);
+	if (i == 0) _reduce_topsweep4(t, &T[S64 + 5 * (S64 / 4)], d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S64 / 4) _reduce_downsweep4(&T[S64], S64 / 4, i);
+	if (i < S64 / 4) _reduce_downsweep4(&T[S64], S64 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	_reduce_downsweep4o(&t[j], T, S64, i);
+	_reduce_downsweep4o(&t[j], T, S64, i, d);
 }
 
 #define	S128	(128 / 4)
 __kernel __attribute__((reqd_work_group_size(S128, 1, 1)))
-void reduce_topsweep128(__global uint * restrict const t, const uint j)
+void reduce_topsweep128(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint T[128];	// 82
 
 	const size_t i = get_local_id(0);
+	const uint d = pc[2];
 
-	_reduce_upsweep4i(T, &t[j], S128, i);
+	_reduce_upsweep4i(T, &t[j], S128, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S128 / 4) _reduce_upsweep4(&T[S128], S128 / 4, i);
+	if (i < S128 / 4) _reduce_upsweep4(&T[S128], S128 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S128 / 16) _reduce_upsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i);
+	if (i < S128 / 16) _reduce_upsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i == 0) _reduce_topsweep2(t, &T[S128 + 5 * (S128 / 4) + 5 * (S128 / 16)]);
+	if (i == 0) _reduce_topsweep2(t, &T[S128 + 5 * (S128 / 4) + 5 * (S128 / 16)], d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S128 / 16) _reduce_downsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i);
+	if (i < S128 / 16) _reduce_downsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S128 / 4) _reduce_downsweep4(&T[S128], S128 / 4, i);
+	if (i < S128 / 4) _reduce_downsweep4(&T[S128], S128 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	_reduce_downsweep4o(&t[j], T, S128, i);
+	_reduce_downsweep4o(&t[j], T, S128, i, d);
 }
 
 #define	S256	(256 / 4)
 __kernel __attribute__((reqd_work_group_size(S256, 1, 1)))
-void reduce_topsweep256(__global uint * restrict const t, const uint j)
+void reduce_topsweep256(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint T[256];	// 168
 
 	const size_t i = get_local_id(0);
+	const uint d = pc[2];
 
-	_reduce_upsweep4i(T, &t[j], S256, i);
+	_reduce_upsweep4i(T, &t[j], S256, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S256 / 4) _reduce_upsweep4(&T[S256], S256 / 4, i);
+	if (i < S256 / 4) _reduce_upsweep4(&T[S256], S256 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S256 / 16) _reduce_upsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i);
+	if (i < S256 / 16) _reduce_upsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i == 0) _reduce_topsweep4(t, &T[S256 + 5 * (S256 / 4) + 5 * (S256 / 16)]);
+	if (i == 0) _reduce_topsweep4(t, &T[S256 + 5 * (S256 / 4) + 5 * (S256 / 16)], d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S256 / 16) _reduce_downsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i);
+	if (i < S256 / 16) _reduce_downsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S256 / 4) _reduce_downsweep4(&T[S256], S256 / 4, i);
+	if (i < S256 / 4) _reduce_downsweep4(&T[S256], S256 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	_reduce_downsweep4o(&t[j], T, S256, i);
+	_reduce_downsweep4o(&t[j], T, S256, i, d);
 }
 
 #define	S512	(512 / 4)
 __kernel __attribute__((reqd_work_group_size(S512, 1, 1)))
-void reduce_topsweep512(__global uint * restrict const t, const uint j)
+void reduce_topsweep512(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint T[512];	// 340
 
 	const size_t i = get_local_id(0);
+	const uint d = pc[2];
 
-	_reduce_upsweep4i(T, &t[j], S512, i);
+	_reduce_upsweep4i(T, &t[j], S512, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S512 / 4) _reduce_upsweep4(&T[S512], S512 / 4, i);
+	if (i < S512 / 4) _reduce_upsweep4(&T[S512], S512 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S512 / 16) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i);
+	if (i < S512 / 16) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S512 / 64) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i);
+	if (i < S512 / 64) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i == 0) _reduce_topsweep2(t, &T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16) + 5 * (S512 / 64)]);
+	if (i == 0) _reduce_topsweep2(t, &T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16) + 5 * (S512 / 64)], d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S512 / 64) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i);
+	if (i < S512 / 64) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S512 / 16) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i);
+	if (i < S512 / 16) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S512 / 4) _reduce_downsweep4(&T[S512], S512 / 4, i);
+	if (i < S512 / 4) _reduce_downsweep4(&T[S512], S512 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	_reduce_downsweep4o(&t[j], T, S512, i);
+	_reduce_downsweep4o(&t[j], T, S512, i, d);
 }
 
 #define	S1024	(1024 / 4)
 __kernel __attribute__((reqd_work_group_size(S1024, 1, 1)))
-void reduce_topsweep1024(__global uint * restrict const t, const uint j)
+void reduce_topsweep1024(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
 	__local uint T[1024];	// 680
 
 	const size_t i = get_local_id(0);
+	const uint d = pc[2];
 
-	_reduce_upsweep4i(T, &t[j], S1024, i);
+	_reduce_upsweep4i(T, &t[j], S1024, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S1024 / 4) _reduce_upsweep4(&T[S1024], S1024 / 4, i);
+	if (i < S1024 / 4) _reduce_upsweep4(&T[S1024], S1024 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S1024 / 16) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i);
+	if (i < S1024 / 16) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S1024 / 64) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i);
+	if (i < S1024 / 64) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i == 0) _reduce_topsweep4(t, &T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16) + 5 * (S1024 / 64)]);
+	if (i == 0) _reduce_topsweep4(t, &T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16) + 5 * (S1024 / 64)], d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S1024 / 64) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i);
+	if (i < S1024 / 64) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S1024 / 16) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i);
+	if (i < S1024 / 16) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	if (i < S1024 / 4) _reduce_downsweep4(&T[S1024], S1024 / 4, i);
+	if (i < S1024 / 4) _reduce_downsweep4(&T[S1024], S1024 / 4, i, d);
 	barrier(CLK_LOCAL_MEM_FENCE);
-	_reduce_downsweep4o(&t[j], T, S1024, i);
+	_reduce_downsweep4o(&t[j], T, S1024, i, d);
 }
 
+// If the transform size is RADIX * 2^m then the top of the tree is 4.s remainders, s = RADIX * 2^i <= 256 is the local size.
+// The sums are computed as in reduce_scan, by a single group.
 __kernel
-void reduce_i(__global const uint2 * restrict const x, __global uint * restrict const y, __global uint * restrict const t,
-	__global const uint * restrict const bp)
+void reduce_topsweep_r(__global uint * restrict t, __global const uint * restrict pc, const uint j)
 {
-	const size_t k = get_global_id(0);
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
+	__local uint T[256];
+
+	const size_t i = get_local_id(0), s = get_local_size(0);
+	const uint d = pc[2];
+
+	__global uint4 * const tj_4 = (__global uint4 *)&t[j];
+	const uint4 u = tj_4[i];
+	const uint u3 = u.s3, u23 = addmod_d(u.s2, u3, d), u123 = addmod_d(u.s1, u23, d);
 
-	const uint xs = ((x[pconst_e + k].s0 >> pconst_s) | (x[pconst_e + k + 1].s0 << (digit_bit - pconst_s))) & digit_mask;
-	const uint u = rem_d(xs * (ulong)(bp[k]));
+	// T[i] is the sum of the remainders of the work-items i, i + 1, ...
+	T[i] = addmod_d(u.s0, u123, d);
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for (size_t m = 1; m < s; m *= 2)
+	{
+		const uint v = (i + m < s) ? T[i + m] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		T[i] = addmod_d(T[i], v, d);
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (i == 0) t[0] = T[0];
+	const uint u0 = (i + 1 < s) ? T[i + 1] : 0;
+	tj_4[i] = (uint4)(addmod_d(u0, u123, d), addmod_d(u0, u23, d), addmod_d(u0, u3, d), u0);
+}
+
+// Single-pass scan with a decoupled look-back (see poly2int_lb): the tree of the sweep kernels is replaced by one kernel.
+// t[4 + k] is replaced by the sum of the remainders t[4 + l], l > k, and t[0] is the sum of the remainders, modulo d.
+// The sum is computed from the top: the group of ticket g computes the block G - 1 - g. The status of a block is
+// its aggregate or its inclusive prefix (bit 30) and an epoch bit (bit 31): the status of the previous scan is not ready.
+// ls[0] is the ticket counter, ls[1] counts the completed groups, ls[2] is the epoch and ls[4 + b] is the status of the block b.
+
+#define REDUCE_SCAN_VAR(RS_WGS) \
+	__local uint T[RS_WGS]; \
+	__local uint S[2];
+
+inline void reduce_scan(__local uint * restrict const T, __local uint * restrict const S, const size_t RS_WGS,
+	__global uint * restrict const t, __global uint * restrict const ls, __global const uint * restrict const pc)
+{
+	const size_t i = get_local_id(0), G = (pconst_size / 2) / (4 * RS_WGS);
+	const uint d = pc[2];	// d < 2^29
+
+	if (i == 0) { S[0] = atomic_inc(&ls[0]); S[1] = ls[2]; }
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const size_t b = G - 1 - S[0];
+	const uint epoch = (S[1] == 0) ? (1u << 31) : 0, inclusive = 1u << 30;
+
+	__global uint4 * const tb = (__global uint4 *)&t[4 + 4 * RS_WGS * b];
+	const uint4 u = tb[i];
+	const uint u3 = u.s3, u23 = addmod_d(u.s2, u3, d), u123 = addmod_d(u.s1, u23, d);
+
+	// T[i] is the sum of the remainders of the work-items i, i + 1, ...
+	T[i] = addmod_d(u.s0, u123, d);
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for (size_t m = 1; m < RS_WGS; m *= 2)
+	{
+		const uint v = (i + m < RS_WGS) ? T[i + m] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		T[i] = addmod_d(T[i], v, d);
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (i == 0)
+	{
+		const uint aggregate = T[0];
+		uint prefix = 0;
+		if (b == G - 1) atomic_xchg(&ls[4 + b], epoch | inclusive | aggregate);
+		else
+		{
+			atomic_xchg(&ls[4 + b], epoch | aggregate);
+			for (size_t l = b + 1; true; ++l)
+			{
+				uint status;
+				do { status = atomic_or(&ls[4 + l], 0); } while ((status & (1u << 31)) != epoch);
+				prefix = addmod_d(prefix, status & (inclusive - 1), d);
+				if ((status & inclusive) != 0) break;
+			}
+			atomic_xchg(&ls[4 + b], epoch | inclusive | addmod_d(prefix, aggregate, d));
+		}
+		if (b == 0) t[0] = addmod_d(prefix, aggregate, d);
+		S[0] = prefix;
+
+		// the last group resets the counters and changes the epoch
+		if (atomic_inc(&ls[1]) == G - 1) { ls[0] = 0; ls[1] = 0; ls[2] = (S[1] == 0) ? 1 : 0; }
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const uint u0 = addmod_d(S[0], (i + 1 < RS_WGS) ? T[i + 1] : 0, d);
+	tb[i] = (uint4)(addmod_d(u0, u123, d), addmod_d(u0, u23, d), addmod_d(u0, u3, d), u0);
+}
+
+__kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+void reduce_scan_64(__global uint * restrict t, __global uint * restrict ls, __global const uint * restrict pc)
+{
+	t += batch_offset(pconst_size);
+	ls += batch_offset(4 + pconst_size / 512);
+	pc += batch_offset(PC_SIZE);
+
+	REDUCE_SCAN_VAR(64);
+	reduce_scan(T, S, 64, t, ls, pc);
+}
+
+__kernel __attribute__((reqd_work_group_size(128, 1, 1)))
+void reduce_scan_128(__global uint * restrict t, __global uint * restrict ls, __global const uint * restrict pc)
+{
+	t += batch_offset(pconst_size);
+	ls += batch_offset(4 + pconst_size / 512);
+	pc += batch_offset(PC_SIZE);
+
+	REDUCE_SCAN_VAR(128);
+	reduce_scan(T, S, 128, t, ls, pc);
+}
+
+// y[k] is extracted from the digits x[e + k] and x[e + k + 1]
+inline void _reduce_i(__global uint * restrict const y, __global uint * restrict const t, __global const uint * restrict const bp,
+	__global const uint * restrict const pc, const size_t k, const uint x_lo, const uint x_hi)
+{
+	const uint pconst_s = pc[1], pconst_d = pc[2], pconst_d_inv = pc[3], pconst_d_shift = pc[4];
+
+	const uint xs = ((x_lo >> pconst_s) | (x_hi << (digit_bit - pconst_s))) & digit_mask;
+	const uint u = _rem(xs * (ulong)(bp[k]), pconst_d, pconst_d_inv, pconst_d_shift);
 
 	y[k] = xs;
 	t[k + 4] = u;
 }
 
 __kernel
-void reduce_o(__global uint2 * restrict const x, __global const uint * restrict const y, __global const uint * restrict const t,
-	__global const uint * restrict const ibp)
+void reduce_i(__global const rns * restrict x, __global uint * restrict y, __global uint * restrict t,
+	__global const uint * restrict bp, __global const uint * restrict pc)
 {
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size / 2);
+	t += batch_offset(pconst_size);
+	bp += batch_offset(pconst_size / 2);
+	pc += batch_offset(PC_SIZE);
+
 	const size_t k = get_global_id(0);
+	const uint pconst_e = pc[0];
+
+	_reduce_i(y, t, bp, pc, k, x[pconst_e + k].s0, x[pconst_e + k + 1].s0);
+}
+
+// poly2int1 and reduce_i are fused: the digits of a block are read once, the carry is added and y is extracted.
+// The pair (x[i], x[i + 1]) is processed by the block of x[i + 1]. x[i] is the last digit of the previous block,
+// it is not modified by poly2int1 unless the carry is propagated through the whole block: then err[1] is set
+// and the digits and y are recomputed serially by the last group.
+inline void reduce_i_blk(const size_t P2I_BLK, __global rns * restrict const x, __global const long * restrict const cr,
+	__global uint * restrict const lb, __global int * const err, __global uint * restrict const y, __global uint * restrict const t,
+	__global const uint * restrict const bp, __global const uint * restrict const pc)
+{
+	const size_t k = get_global_id(0), i0 = P2I_BLK * k;
+	const uint pconst_e = pc[0];
+
+	__global rns * const xi = &x[i0];
+
+	uint X[16];
+	for (size_t j = 0; j < P2I_BLK; ++j) X[j] = xi[j].s0;
+	const uint x_prev = (k != 0) ? x[i0 - 1].s0 : 0;
+
+	long l = cr[k] + X[0];
+	X[0] = (uint)(l) & digit_mask;
+	l >>= digit_bit;						// |l| < n/2
+
+	int f = (int)(l);
+	size_t jf = 1;
+	for (; (f != 0) && (jf < P2I_BLK - 1); ++jf)
+	{
+		f += X[jf];
+		X[jf] = (uint)(f) & digit_mask;
+		f >>= digit_bit;					// f = -1, 0 or 1
+	}
+
+	if (f != 0)
+	{
+		X[P2I_BLK - 1] += (uint)(f);
+		jf = P2I_BLK;
+		atomic_or(&err[1], 1);
+	}
+
+	for (size_t j = 0; j < jf; ++j) xi[j].s0 = X[j];
+
+	for (size_t j = 0; j < P2I_BLK; ++j)
+	{
+		const size_t i = i0 + j;	// x[i - 1], x[i]
+		if ((i > pconst_e) && (i - 1 - pconst_e < pconst_size / 2)) _reduce_i(y, t, bp, pc, i - 1 - pconst_e, (j != 0) ? X[j - 1] : x_prev, X[j]);
+	}
+
+	if (poly2int_last_group(lb) && poly2int_fix(x, err))
+	{
+		for (size_t k = 0; k < pconst_size / 2; ++k) _reduce_i(y, t, bp, pc, k, x[pconst_e + k].s0, x[pconst_e + k + 1].s0);
+	}
+}
+
+__kernel
+void reduce_i_4(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err,
+	__global uint * restrict y, __global uint * restrict t, __global const uint * restrict bp, __global const uint * restrict pc)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+	y += batch_offset(pconst_size / 2);
+	t += batch_offset(pconst_size);
+	bp += batch_offset(pconst_size / 2);
+	pc += batch_offset(PC_SIZE);
+
+	reduce_i_blk(4, x, cr, lb, err, y, t, bp, pc);
+}
+
+__kernel
+void reduce_i_8(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err,
+	__global uint * restrict y, __global uint * restrict t, __global const uint * restrict bp, __global const uint * restrict pc)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+	y += batch_offset(pconst_size / 2);
+	t += batch_offset(pconst_size);
+	bp += batch_offset(pconst_size / 2);
+	pc += batch_offset(PC_SIZE);
+
+	reduce_i_blk(8, x, cr, lb, err, y, t, bp, pc);
+}
+
+__kernel
+void reduce_i_16(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err,
+	__global uint * restrict y, __global uint * restrict t, __global const uint * restrict bp, __global const uint * restrict pc)
+{
+	x += batch_offset(pconst_size);
+	cr += batch_offset(pconst_size / 4);
+	lb += batch_offset(2 + pconst_size / 64);
+	err += batch_offset(2);
+	y += batch_offset(pconst_size / 2);
+	t += batch_offset(pconst_size);
+	bp += batch_offset(pconst_size / 2);
+	pc += batch_offset(PC_SIZE);
+
+	reduce_i_blk(16, x, cr, lb, err, y, t, bp, pc);
+}
+
+// The checksums of R and Y modulo M31 = 2^31 - 1 are computed by the last reduce kernels of a square.
+// B^k = 2^(digit_bit.k mod 31) (mod M31), a slot is two 64-bit accumulators (R, Y) stored as 32-bit words.
+#define	M31		0x7fffffffu
+
+inline uint m31_mul_Bk(const uint a, const size_t k)
+{
+	const ulong t = (ulong)(a) << ((digit_bit * k) % 31);
+	const ulong s = (t & M31) + (t >> 31);		// < 2^33
+	const uint r = (uint)(s & M31) + (uint)(s >> 31);
+	return (r >= M31) ? r - M31 : r;
+}
+
+inline uint m31_add(const uint a, const uint b)
+{
+	const uint s = a + b;
+	return (s >= M31) ? s - M31 : s;
+}
+
+inline void cs_add(__global uint * const cs, const uint a)
+{
+	const uint prev = atomic_add(&cs[0], a);
+	if (prev > ~a) atomic_inc(&cs[1]);		// carry
+}
+
+inline void checksum(__global uint * const cs, const int cs_slot, __local uint2 * const T, const uint r, const uint y)
+{
+	const size_t i = get_local_id(0);
+	T[i] = (uint2)(r, y);
+	for (size_t m = CS_BLK / 2; m > 0; m /= 2)
+	{
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (i < m) T[i] = (uint2)(m31_add(T[i].s0, T[i + m].s0), m31_add(T[i].s1, T[i + m].s1));
+	}
+	if (i == 0) { cs_add(&cs[4 * cs_slot + 0], T[0].s0); cs_add(&cs[4 * cs_slot + 2], T[0].s1); }
+}
+
+// The digits of R are x[k].s0, k < e, the upper digits are computed by reduce_f
+__kernel __attribute__((reqd_work_group_size(CS_BLK, 1, 1)))
+void reduce_o(__global rns * restrict x, __global const uint * restrict y, __global const uint * restrict t,
+	__global const uint * restrict ibp, __global const uint * restrict pc, __global uint * restrict cs, const int cs_slot)
+{
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size / 2);
+	t += batch_offset(pconst_size);
+	ibp += batch_offset(pconst_size / 2);
+	pc += batch_offset(PC_SIZE);
+
+	__local uint2 T[CS_BLK];
+
+	const size_t k = get_global_id(0);
+	const uint pconst_e = pc[0], pconst_d = pc[2], pconst_d_inv = pc[3], pconst_d_shift = pc[4];
 
 	const uint tk = t[k + 4];
 	//const uint rbk_prev = (k != pconst_size / 2 - 1) ? tk : 0;	// NVidia compiler generates a conditionnal branch instruction then the code must be written with a mask
 	const uint mask = (k != pconst_size / 2 - 1) ? (uint)(-1) : 0;
 	const uint rbk_prev = tk & mask;
-	const uint r_prev = rem_d(rbk_prev * (ulong)(ibp[k]));
+	const uint r_prev = _rem(rbk_prev * (ulong)(ibp[k]), pconst_d, pconst_d_inv, pconst_d_shift);
 
 	const ulong q = ((ulong)(r_prev) << digit_bit) | y[k];
 
@@ -318,33 +635,92 @@ void reduce_o(__global uint2 * restrict const x, __global const uint * restrict
 	const uint r = (uint)(q) - q_d * pconst_d;
 	const uint c = (r >= pconst_d) ? 1 : 0;
 
-	x[k] = (uint2)((k > pconst_e) ? 0 : x[k].s0, q_d + c);
+	const uint x_k = (k > pconst_e) ? 0 : x[k].s0;
+	x[k] = digits(x_k, q_d + c);
+
+	if (cs_slot >= 0) checksum(cs, cs_slot, T, (k < pconst_e) ? m31_mul_Bk(x_k, k) : 0, m31_mul_Bk(q_d + c, k));
 }
 
 __kernel
-void reduce_f(__global uint2 * restrict const x, __global const uint * restrict const t)
+void reduce_f(__global rns * restrict x, __global const uint * restrict t, __global const uint * restrict pc,
+	__global uint * restrict cs, const int cs_slot)
 {
+	x += batch_offset(pconst_size);
+	t += batch_offset(pconst_size);
+	pc += batch_offset(PC_SIZE);
+
+	const uint pconst_e = pc[0], pconst_s = pc[1];
+
 	const uint rs = x[pconst_e].s0 & ((1u << pconst_s) - 1);
 	ulong l = ((ulong)(t[0]) << pconst_s) | rs;		// rds < 2^(29 + digit_bit - 1)
 
-	x[pconst_e].s0 = (uint)(l) & digit_mask;
+	uint x_k = (uint)(l) & digit_mask;
+	x[pconst_e].s0 = x_k;
+	uint r = m31_mul_Bk(x_k, pconst_e);
 	l >>= digit_bit;
 
 	for (size_t k = pconst_e + 1; l != 0; ++k)
 	{
-		x[k].s0 = (uint)(l) & digit_mask;
+		x_k = (uint)(l) & digit_mask;
+		x[k].s0 = x_k;
+		r = m31_add(r, m31_mul_Bk(x_k, k));
 		l >>= digit_bit;
 	}
+
+	if (cs_slot >= 0) cs_add(&cs[4 * cs_slot + 0], r);
+}
+
+// reduce_o and reduce_f are fused: the work-items k >= e compute the digits of r * 2^s + (X_lo mod 2^s).
+// The s low bits of x[e] are not modified by the work-item e then they can be read by the other work-items.
+__kernel __attribute__((reqd_work_group_size(CS_BLK, 1, 1)))
+void reduce_of(__global rns * restrict x, __global const uint * restrict y, __global const uint * restrict t,
+	__global const uint * restrict ibp, __global const uint * restrict pc, __global uint * restrict cs, const int cs_slot)
+{
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size / 2);
+	t += batch_offset(pconst_size);
+	ibp += batch_offset(pconst_size / 2);
+	pc += batch_offset(PC_SIZE);
+
+	__local uint2 T[CS_BLK];
+
+	const size_t k = get_global_id(0);
+	const uint pconst_e = pc[0], pconst_s = pc[1], pconst_d = pc[2], pconst_d_inv = pc[3], pconst_d_shift = pc[4];
+
+	const uint tk = t[k + 4];
+	const uint mask = (k != pconst_size / 2 - 1) ? (uint)(-1) : 0;
+	const uint rbk_prev = tk & mask;
+	const uint r_prev = _rem(rbk_prev * (ulong)(ibp[k]), pconst_d, pconst_d_inv, pconst_d_shift);
+
+	const ulong q = ((ulong)(r_prev) << digit_bit) | y[k];
+
+	const uint q_d = mul_hi((uint)(q >> pconst_d_shift), pconst_d_inv);	// d < 2^29
+	const uint r = (uint)(q) - q_d * pconst_d;
+	const uint c = (r >= pconst_d) ? 1 : 0;
+
+	uint x_k;
+	if (k < pconst_e) x_k = x[k].s0;
+	else
+	{
+		const uint rs = x[pconst_e].s0 & ((1u << pconst_s) - 1);
+		const ulong l = ((ulong)(t[0]) << pconst_s) | rs;		// rds < 2^(29 + digit_bit - 1)
+		const size_t shift = digit_bit * (k - pconst_e);
+		x_k = (shift < 64) ? (uint)(l >> shift) & digit_mask : 0;
+	}
+
+	x[k] = digits(x_k, q_d + c);
+
+	if (cs_slot >= 0) checksum(cs, cs_slot, T, m31_mul_Bk(x_k, k), m31_mul_Bk(q_d + c, k));
 }
 
-inline void _reduce_x(__global uint2 * restrict const x, __global int * const err)
+inline void _reduce_x(__global rns * restrict const x, __global int * const err)
 {
 	int c = 0;
 	for (size_t k = 0; k < pconst_size / 2; ++k)
 	{
-		const uint2 x_k = x[k];
+		const rns x_k = x[k];
 		c += x_k.s0 - x_k.s1;
-		x[k] = (uint2)((uint)(c) & digit_mask, 0);
+		x[k] = digits((uint)(c) & digit_mask, 0);
 		c >>= digit_bit;
 	}
 
@@ -352,20 +728,26 @@ inline void _reduce_x(__global uint2 * restrict const x, __global int * const er
 }
 
 __kernel
-void reduce_x(__global uint2 * restrict const x, __global int * const err)
+void reduce_x(__global rns * restrict x, __global int * err)
 {
+	x += batch_offset(pconst_size);
+	err += batch_offset(2);
+
 	_reduce_x(x, err);
 }
 
 __kernel
-void reduce_z(__global uint2 * restrict const x, __global int * const err)
+void reduce_z(__global rns * restrict x, __global int * err)
 {
+	x += batch_offset(pconst_size);
+	err += batch_offset(2);
+
 	// s0 = x, s1 = k.2^n + 1
 	// if s0 >= s1 then s0 -= s1;
 
 	for (size_t i = 0; i < pconst_size / 2; ++i)
 	{
-		const uint2 x_k = x[pconst_size / 2 - 1 - i];
+		const rns x_k = x[pconst_size / 2 - 1 - i];
 		if (x_k.s0 < x_k.s1) return;
 		if (x_k.s0 > x_k.s1) break;
 	}
@@ -0,0 +1,104 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+// Montgomery arithmetic modulo p, p < 2^63, q = -1/p mod 2^64 and r = x.2^64 mod p
+
+inline ulong m_add(const ulong a, const ulong b, const ulong p)
+{
+	const ulong c = (a >= p - b) ? p : 0;
+	return a + b - c;
+}
+
+inline ulong m_mul(const ulong a, const ulong b, const ulong p, const ulong q)
+{
+	const ulong ab_l = a * b, ab_h = mul_hi(a, b);
+	// ab_l + (ab_l.q).p = 0 (mod 2^64)
+	const ulong r = ab_h + mul_hi(ab_l * q, p) + ((ab_l != 0) ? 1 : 0);
+	return (r >= p) ? r - p : r;
+}
+
+inline ulong m_pow(const ulong a, const ulong e, const ulong one, const ulong p, const ulong q)
+{
+	if (e == 0) return one;
+	ulong r = a;
+	for (int b = 62 - (int)(clz(e)); b >= 0; --b)
+	{
+		r = m_mul(r, r, p, q);
+		if ((e & ((ulong)(1) << b)) != 0) r = m_mul(r, a, p, q);
+	}
+	return r;
+}
+
+inline void record(__global uint4 * restrict const factor, __global uint * restrict const factorCount, const ulong p, const uint i, const uint j)
+{
+	const uint pos = atomic_inc(factorCount);
+	if (pos < FACTOR_MAX) factor[pos] = (uint4)((uint)(p), (uint)(p >> 32), i, N_MIN + j);
+}
+
+// The solutions of k_i.2^(N_MIN + j) = -1 (mod p), 0 <= j < N_COUNT, are found with a baby-step giant-step algorithm.
+// The baby steps 2^b, 0 <= b < BABY_STEPS, are stored in a hash table. If the order of 2 is smaller than BABY_STEPS
+// then the solutions are periodic.
+__kernel
+void sieve(__global const ulong * restrict const prime, __constant uint * restrict const k,
+	__global uint4 * restrict const factor, __global uint * restrict const factorCount)
+{
+	const ulong p = prime[get_global_id(0)];
+
+	ulong ip = p;	// p.p = 1 (mod 8)
+	for (int i = 0; i < 5; ++i) ip *= 2 - p * ip;
+	const ulong q = -ip;
+
+	const ulong one = (0 - p) % p, two = m_add(one, one, p);
+	ulong r2 = one;
+	for (int i = 0; i < 64; ++i) r2 = m_add(r2, r2, p);
+
+	ulong h_val[HASH_SIZE];
+	uint h_idx[HASH_SIZE];
+	for (size_t h = 0; h < HASH_SIZE; ++h) h_val[h] = 0;	// 2^b != 0
+
+	uint ord = 0;
+	ulong x = one;
+	for (uint b = 0; b < BABY_STEPS; ++b)
+	{
+		if ((b != 0) && (x == one)) { ord = b; break; }
+		size_t h = (size_t)(x) % HASH_SIZE;
+		while (h_val[h] != 0) h = (h + 1) % HASH_SIZE;
+		h_val[h] = x; h_idx[h] = b;
+		x = m_mul(x, two, p, q);
+	}
+
+	// g = 2^-BABY_STEPS, t = 2^N_MIN
+	const ulong g = m_pow(x, p - 2, one, p, q), t = m_pow(two, N_MIN, one, p, q);
+
+	for (uint i = 0; i < K_COUNT; ++i)
+	{
+		const ulong k_p = k[i] % p;
+		if (k_p == 0) continue;
+
+		// c = -1 / (k.2^N_MIN)
+		ulong c = p - m_pow(m_mul(m_mul(k_p, r2, p, q), t, p, q), p - 2, one, p, q);
+
+		if (ord == 0)
+		{
+			for (uint a = 0; a < N_COUNT; a += BABY_STEPS)
+			{
+				for (size_t h = (size_t)(c) % HASH_SIZE; h_val[h] != 0; h = (h + 1) % HASH_SIZE)
+				{
+					if ((h_val[h] == c) && (a + h_idx[h] < N_COUNT)) record(factor, factorCount, p, i, a + h_idx[h]);
+				}
+				c = m_mul(c, g, p, q);
+			}
+		}
+		else
+		{
+			for (size_t h = (size_t)(c) % HASH_SIZE; h_val[h] != 0; h = (h + 1) % HASH_SIZE)
+			{
+				if (h_val[h] == c) for (uint j = h_idx[h]; j < N_COUNT; j += ord) record(factor, factorCount, p, i, j);
+			}
+		}
+	}
+}
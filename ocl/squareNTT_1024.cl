@@ -5,63 +5,81 @@ proth20 is free source code, under the MIT license (see LICENSE). You can redist
 Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
 */
 
-// __local 32k
+// __local 32k, 64k if RNS3
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 16, 1, 1)))
-void sub_ntt256_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)
+void sub_ntt256_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,
+	__global const int * restrict const bd)
 {
 	SUB_NTT256(16);
 }
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 16, 1, 1)))
-void lst_intt256_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)
+void lst_intt256_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)
 {
 	LST_INTT256(16);
 }
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 16, 1, 1)))
-void ntt256_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)
+void lst_intt256_16_p2i(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2,
+	__global long * restrict const cr)
+{
+	LST_INTT256_P2I(16);
+}
+
+__kernel __attribute__((reqd_work_group_size(256 / 4 * 16, 1, 1)))
+void ntt256_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)
 {
 	NTT256(16);
 }
 
 __kernel __attribute__((reqd_work_group_size(256 / 4 * 16, 1, 1)))
-void intt256_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)
+void intt256_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)
 {
 	INTT256(16);
 }
 
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 4, 1, 1)))
-void sub_ntt1024_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)
+void sub_ntt1024_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,
+	__global const int * restrict const bd)
 {
 	SUB_NTT1024(4);
 }
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 4, 1, 1)))
-void lst_intt1024_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)
+void lst_intt1024_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)
 {
 	LST_INTT1024(4);
 }
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 4, 1, 1)))
-void ntt1024_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)
+void lst_intt1024_4_p2i(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2,
+	__global long * restrict const cr)
+{
+	LST_INTT1024_P2I(4);
+}
+
+__kernel __attribute__((reqd_work_group_size(1024 / 4 * 4, 1, 1)))
+void ntt1024_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)
 {
 	NTT1024(4);
 }
 
 __kernel __attribute__((reqd_work_group_size(1024 / 4 * 4, 1, 1)))
-void intt1024_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)
+void intt1024_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)
 {
 	INTT1024(4);
 }
 
 
 __kernel __attribute__((reqd_work_group_size(4096 / 4, 1, 1)))
-void square4096(__global uint2 * restrict const x, __constmem const uint4 * restrict const r1, __constmem const uint4 * restrict const ir1,
-	__constmem const uint4 * restrict const r2, __constmem const uint4 * restrict const ir2)
+void square4096(__global rns * restrict x, __constmem const rns2 * restrict const r1, __constmem const rns2 * restrict const ir1,
+	__constmem const rns2 * restrict const r2, __constmem const rns2 * restrict const ir2)
 {
-	__local uint2 X[4096];	// 32k
+	x += batch_offset(pconst_size);
+
+	__local rns X[4096];	// 32k, 64k if RNS3
 
 	const size_t i = get_local_id(0);
 	const size_t i1024 = i, j1024 = i + 4 + 16 + 64 + 256;
@@ -71,15 +89,15 @@ void square4096(__global uint2 * restrict const x, __constmem const uint4 * rest
 	const size_t i_4 = i % 4, i4 = ((4 * i) & (size_t)~(4 * 4 - 1)) | i_4, j4 = i_4;
 	const size_t k1024 = get_group_id(0) * 4096 | i1024;
 
-	const uint4 r1_1024 = r1[j1024], ir1_1024 = ir1[j1024];
+	const rns2 r1_1024 = r1[j1024], ir1_1024 = ir1[j1024];
 	_forward4pi(1024, &X[i1024], 1024, &x[k1024], r2[j1024], r1_1024, ir1_1024);
-	const uint4 r1_256 = r1[j256], ir1_256 = ir1[j256];
+	const rns2 r1_256 = r1[j256], ir1_256 = ir1[j256];
 	_forward4p(256, &X[i256], r2[j256], r1_256, ir1_256);
-	const uint4 r1_64 = r1[j64], ir1_64 = ir1[j64];
+	const rns2 r1_64 = r1[j64], ir1_64 = ir1[j64];
 	_forward4p(64, &X[i64], r2[j64], r1_64, ir1_64);
-	const uint4 r1_16 = r1[j16], ir1_16 = ir1[j16];
+	const rns2 r1_16 = r1[j16], ir1_16 = ir1[j16];
 	_forward4p(16, &X[i16], r2[j16], r1_16, ir1_16);
-	const uint4 r1_4 = r1[j4], ir1_4 = ir1[j4];
+	const rns2 r1_4 = r1[j4], ir1_4 = ir1[j4];
 	_forward4p(4, &X[i4], r2[j4], r1_4, ir1_4);
 	_square4(&X[4 * i]);
 	_backward4p(4, &X[i4], ir2[j4], r1_4, ir1_4);
@@ -88,3 +106,73 @@ void square4096(__global uint2 * restrict const x, __constmem const uint4 * rest
 	_backward4p(256, &X[i256], ir2[j256], r1_256, ir1_256);
 	_backward4po(1024, &x[k1024], 1024, &X[i1024], ir2[j1024], r1_1024, ir1_1024);
 }
+
+__kernel __attribute__((reqd_work_group_size(4096 / 4, 1, 1)))
+void mul4096(__global rns * restrict x, __constmem const rns2 * restrict const r1, __constmem const rns2 * restrict const ir1,
+	__constmem const rns2 * restrict const r2, __constmem const rns2 * restrict const ir2, __global const rns * restrict y)
+{
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size);
+
+	__local rns X[4096];	// 32k, 64k if RNS3
+
+	const size_t i = get_local_id(0);
+	const size_t i1024 = i, j1024 = i + 4 + 16 + 64 + 256;
+	const size_t i_256 = i % 256, i256 = ((4 * i) & (size_t)~(4 * 256 - 1)) | i_256, j256 = i_256 + 4 + 16 + 64;
+	const size_t i_64 = i % 64, i64 = ((4 * i) & (size_t)~(4 * 64 - 1)) | i_64, j64 = i_64 + 4 + 16;
+	const size_t i_16 = i % 16, i16 = ((4 * i) & (size_t)~(4 * 16 - 1)) | i_16, j16 = i_16 + 4;
+	const size_t i_4 = i % 4, i4 = ((4 * i) & (size_t)~(4 * 4 - 1)) | i_4, j4 = i_4;
+	const size_t k1024 = get_group_id(0) * 4096 | i1024;
+
+	const rns2 r1_1024 = r1[j1024], ir1_1024 = ir1[j1024];
+	_forward4pi(1024, &X[i1024], 1024, &x[k1024], r2[j1024], r1_1024, ir1_1024);
+	const rns2 r1_256 = r1[j256], ir1_256 = ir1[j256];
+	_forward4p(256, &X[i256], r2[j256], r1_256, ir1_256);
+	const rns2 r1_64 = r1[j64], ir1_64 = ir1[j64];
+	_forward4p(64, &X[i64], r2[j64], r1_64, ir1_64);
+	const rns2 r1_16 = r1[j16], ir1_16 = ir1[j16];
+	_forward4p(16, &X[i16], r2[j16], r1_16, ir1_16);
+	const rns2 r1_4 = r1[j4], ir1_4 = ir1[j4];
+	_forward4p(4, &X[i4], r2[j4], r1_4, ir1_4);
+	_mul4(&X[4 * i], &y[get_group_id(0) * 4096 | 4 * i]);
+	_backward4p(4, &X[i4], ir2[j4], r1_4, ir1_4);
+	_backward4p(16, &X[i16], ir2[j16], r1_16, ir1_16);
+	_backward4p(64, &X[i64], ir2[j64], r1_64, ir1_64);
+	_backward4p(256, &X[i256], ir2[j256], r1_256, ir1_256);
+	_backward4po(1024, &x[k1024], 1024, &X[i1024], ir2[j1024], r1_1024, ir1_1024);
+}
+
+__kernel __attribute__((reqd_work_group_size(4096 / 4, 1, 1)))
+void square4096_tu(__global rns * restrict x, __constmem const rns2 * restrict const r1, __constmem const rns2 * restrict const ir1,
+	__constmem const rns2 * restrict const r2, __constmem const rns2 * restrict const ir2, __global rns * restrict y)
+{
+	x += batch_offset(pconst_size);
+	y += batch_offset(pconst_size);
+
+	__local rns X[4096];	// 32k, 64k if RNS3
+
+	const size_t i = get_local_id(0);
+	const size_t i1024 = i, j1024 = i + 4 + 16 + 64 + 256;
+	const size_t i_256 = i % 256, i256 = ((4 * i) & (size_t)~(4 * 256 - 1)) | i_256, j256 = i_256 + 4 + 16 + 64;
+	const size_t i_64 = i % 64, i64 = ((4 * i) & (size_t)~(4 * 64 - 1)) | i_64, j64 = i_64 + 4 + 16;
+	const size_t i_16 = i % 16, i16 = ((4 * i) & (size_t)~(4 * 16 - 1)) | i_16, j16 = i_16 + 4;
+	const size_t i_4 = i % 4, i4 = ((4 * i) & (size_t)~(4 * 4 - 1)) | i_4, j4 = i_4;
+	const size_t k1024 = get_group_id(0) * 4096 | i1024;
+
+	const rns2 r1_1024 = r1[j1024], ir1_1024 = ir1[j1024];
+	_forward4pi(1024, &X[i1024], 1024, &x[k1024], r2[j1024], r1_1024, ir1_1024);
+	const rns2 r1_256 = r1[j256], ir1_256 = ir1[j256];
+	_forward4p(256, &X[i256], r2[j256], r1_256, ir1_256);
+	const rns2 r1_64 = r1[j64], ir1_64 = ir1[j64];
+	_forward4p(64, &X[i64], r2[j64], r1_64, ir1_64);
+	const rns2 r1_16 = r1[j16], ir1_16 = ir1[j16];
+	_forward4p(16, &X[i16], r2[j16], r1_16, ir1_16);
+	const rns2 r1_4 = r1[j4], ir1_4 = ir1[j4];
+	_forward4p(4, &X[i4], r2[j4], r1_4, ir1_4);
+	_square4_tu(&X[4 * i], &y[get_group_id(0) * 4096 | 4 * i]);
+	_backward4p(4, &X[i4], ir2[j4], r1_4, ir1_4);
+	_backward4p(16, &X[i16], ir2[j16], r1_16, ir1_16);
+	_backward4p(64, &X[i64], ir2[j64], r1_64, ir1_64);
+	_backward4p(256, &X[i256], ir2[j256], r1_256, ir1_256);
+	_backward4po(1024, &x[k1024], 1024, &X[i1024], ir2[j1024], r1_1024, ir1_1024);
+}
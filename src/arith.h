@@ -13,6 +13,19 @@ struct arith
 {
 	static constexpr int log2(const size_t n) { return (n > 1) ? 1 + log2(n >> 1) : 0; }
 
+	// the high 64 bits of the product a.b
+	static uint64_t mulhi(const uint64_t a, const uint64_t b)
+	{
+#if defined (__SIZEOF_INT128__)
+		return uint64_t((static_cast<unsigned __int128>(a) * b) >> 64);
+#else
+		const uint64_t a_l = uint32_t(a), a_h = a >> 32, b_l = uint32_t(b), b_h = b >> 32;
+		const uint64_t ll = a_l * b_l, lh = a_l * b_h, hl = a_h * b_l, hh = a_h * b_h;
+		const uint64_t m = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+		return hh + (lh >> 32) + (hl >> 32) + (m >> 32);
+#endif
+	}
+
 	static constexpr uint32_t gcd(const uint32_t n, const uint32_t m) { return (m == 0) ? n : gcd(m, n % m); }
 
 	static constexpr uint32_t invert(const uint32_t n, const uint32_t m)
@@ -0,0 +1,1442 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include "arith.h"
+#include "engine.h"
+#include "pio.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
+
+// The AVX2 functions are compiled whatever the compiler options and are selected at runtime if the processor supports AVX2.
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define CPU_AVX2
+#include <immintrin.h>
+#define avx2_fn	__attribute__((target("avx2"), flatten))
+#endif
+
+// The calling thread is the worker #0, run() returns when the function was executed by all the workers.
+class threadPool
+{
+private:
+	const size_t _count;
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _start, _done;
+	const std::function<void(size_t)> * _fn = nullptr;
+	size_t _generation = 0, _pending = 0;
+	bool _quit = false;
+
+public:
+	threadPool(const size_t count) : _count(count)
+	{
+		for (size_t id = 1; id < count; ++id) _threads.push_back(std::thread(&threadPool::_worker, this, id));
+	}
+
+	virtual ~threadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_start.notify_all();
+		for (std::thread & t : _threads) t.join();
+	}
+
+public:
+	size_t getCount() const { return _count; }
+
+private:
+	void _worker(const size_t id)
+	{
+		size_t generation = 0;
+		while (true)
+		{
+			const std::function<void(size_t)> * fn;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_start.wait(lock, [&]{ return _quit || (_generation != generation); });
+				if (_quit) return;
+				generation = _generation;
+				fn = _fn;
+			}
+
+			(*fn)(id);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_pending == 0) _done.notify_one();
+		}
+	}
+
+public:
+	void run(const std::function<void(size_t)> & fn)
+	{
+		if (_count == 1) { fn(0); return; }
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_fn = &fn;
+			_pending = _count - 1;
+			++_generation;
+		}
+		_start.notify_all();
+
+		fn(0);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [&]{ return _pending == 0; });
+	}
+};
+
+// The kernels of the OpenCL engine, executed by the threads of the CPU.
+// The NTT stages are vectorized if the processor supports AVX2.
+// The division by k is a parallel long division instead of the Takahashi sweeps: the reduce_*sweep* functions are no-op.
+class cpuEngine : public engine
+{
+private:
+	struct u2 { uint32_t s0, s1; };
+
+	static const uint32_t P1 = 2130706433u, P2 = 2013265921u;	// see modarith.cl
+	static const uint32_t P1_INV = 2164392967u, P2_INV = 2290649223u;
+	static const uint32_t P1_I = 2113994754u, P2_I = 1728404513u, P1_Ip = 4261280761u, P2_Ip = 3687262959u;
+	static const uint32_t InvP2_P1 = 913159918u, InvP2_P1p = 1840700306u;
+	static const uint64_t PG = 0xffffffff00000001ull;	// 2^64 - 2^32 + 1
+
+	struct profile
+	{
+		size_t count;
+		cl_ulong time;
+
+		profile() : count(0), time(0) {}
+	};
+
+private:
+	threadPool _pool;
+	std::string _name;
+	const bool _avx2;
+	const std::string _driverVersion;
+	bool _profile = false;
+	std::map<std::string, profile> _profileMap;
+
+	size_t _size = 0, _radix = 1;	// size = radix * 2^m
+	bool _goldilocks = false, _balanced = false, _rns3 = false;
+	std::vector<u2> _x, _u, _tu, _v, _m1, _m2, _xs, _us, _vs;
+	std::vector<uint32_t> _y;
+	cl_int _err[2];
+	std::vector<cl_uint> _cs;	// the checksums, a slot is two 64-bit accumulators stored as 32-bit words
+	cl_int _csSlot = -1;
+	u2 _norm;
+
+	// NTT roots and their Shoup's precomputations
+	std::vector<u2> _r1, _ir1, _r2, _ir2, _r1p, _ir1p, _r2p, _ir2p;
+	// the powers of the root of order size and the constants of the radix-5 butterfly
+	std::vector<u2> _w, _iw;
+	uint64_t _c5[4];
+
+	// pc[0] = e, pc[1] = s, pc[2] = d, pc[3] = d_inv, pc[4] = d_shift, pc[5] = digit_bit
+	uint32_t _pc_e = 0, _pc_s = 0, _pc_d = 1, _pc_d_inv = 0, _pc_d_shift = 0, _digit_bit = 1;
+	uint32_t _t0 = 0;		// remainder of the division
+	std::vector<uint32_t> _rem;
+
+public:
+	cpuEngine(const size_t threadCount) : _pool((threadCount == 0) ? std::max(std::thread::hardware_concurrency(), 1u) : threadCount),
+		_avx2(hasAVX2()), _driverVersion(_avx2 ? "native avx2" : "native")
+	{
+		std::ostringstream ss; ss << "CPU (" << _pool.getCount() << " threads)";
+		_name = ss.str();
+		_err[0] = _err[1] = 0;
+
+		std::ostringstream ssd; ssd << "Running on " << _name << ", engine '" << _driverVersion << "'." << std::endl << std::endl;
+		pio::print(ssd.str());
+	}
+
+	virtual ~cpuEngine() { clearResident(); }
+
+public:
+	static bool hasAVX2()
+	{
+#if defined (CPU_AVX2)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+public:
+	size_t getMaxWorkGroupSize() const { return 1024; }
+	size_t getLocalMemSize() const { return 65536; }
+	const std::string & getName() const { return _name; }
+	const std::string & getDriverVersion() const { return _driverVersion; }
+
+public:
+	void setProfiling(const bool enable) { _profile = enable; resetProfiles(); }
+
+	void resetProfiles() { for (auto & it : _profileMap) it.second = profile(); }
+
+	cl_ulong getProfileTime() const
+	{
+		cl_ulong time = 0;
+		for (const auto & it : _profileMap) time += it.second.time;
+		return time;
+	}
+
+	void displayProfiles(const size_t count) const
+	{
+		cl_ulong ptime = 0;
+		for (const auto & it : _profileMap) ptime += it.second.time;
+		ptime /= count;
+
+		std::ostringstream ss;
+		for (const auto & it : _profileMap)
+		{
+			const profile & prof = it.second;
+			if (prof.count != 0)
+			{
+				const size_t ncount = prof.count / count;
+				const cl_ulong ntime = prof.time / count;
+				ss << "- " << it.first << ": " << ncount << ", " << std::setprecision(3)
+					<< ntime * 100.0 / ptime << " %, " << ntime << " (" << (ntime / ncount) << ")" << std::endl;
+			}
+		}
+		pio::display(ss.str());
+	}
+
+private:
+	typedef std::chrono::high_resolution_clock::time_point timePoint;
+
+	timePoint _tick() const { return _profile ? std::chrono::high_resolution_clock::now() : timePoint(); }
+
+	void _tock(const char * const name, const timePoint & t0)
+	{
+		if (!_profile) return;
+		const auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+		profile & prof = _profileMap[name];
+		prof.count++;
+		prof.time += cl_ulong(dt);
+	}
+
+public:
+	bool hasFastMul64() const { return sizeof(void *) == 8; }
+	void setGoldilocks(const bool enable) { _goldilocks = enable; }
+	bool hasOddRadix() const { return hasFastMul64(); }
+	bool hasBalancedDigits() const { return true; }
+	void setBalancedDigits(const bool enable) { _balanced = enable; }
+	// the native arithmetic is modulo P1 and P2 or modulo 2^64 - 2^32 + 1
+	bool hasRNS3() const { return false; }
+	void setRNS3(const bool enable) { _rns3 = enable; }
+
+public:
+	// the program is not compiled, the source code is the key of the resident data
+	std::string oclDefines() const { return std::string(); }
+	void loadProgram(const std::string &, const bool) {}
+	void createKernels(const bool, const bool) {}
+
+	void allocMemory(const size_t size, const size_t, const size_t batch)
+	{
+		// a CPU is filled by a single candidate
+		if (batch != 1) throw std::runtime_error("the native engine doesn't support the batched mode");
+
+		_size = size;
+		for (_radix = size; _radix % 2 == 0; _radix /= 2);
+		if ((_radix != 1) && !_goldilocks) throw std::runtime_error("the transform size must be a power of 2 modulo P1 and P2");
+		if (_rns3) throw std::runtime_error("the native engine doesn't support the three-prime transform");
+		_x.resize(size); _u.resize(size); _tu.resize(size);
+		_v.resize(size / 2); _m1.resize(size / 2); _m2.resize(size / 2);
+		_xs.resize(size / 2); _us.resize(size / 2); _vs.resize(size / 2);
+		_y.resize(size / 2);
+		_err[0] = _err[1] = 0;
+		_cs.assign(4 * CS_SLOTS, 0);
+		if (_goldilocks)
+		{
+			const uint64_t norm = PG - (PG - 1) / size;
+			_norm.s0 = uint32_t(norm); _norm.s1 = uint32_t(norm >> 32);
+		}
+		else { _norm.s0 = P1 - (P1 - 1) / uint32_t(size); _norm.s1 = P2 - (P2 - 1) / uint32_t(size); }
+
+		for (std::vector<u2> * const r : { &_r1, &_ir1, &_r2, &_ir2, &_r1p, &_ir1p, &_r2p, &_ir2p }) r->resize(size);
+		if (_radix != 1) { _w.resize(size); _iw.resize(size); }
+	}
+
+	void releaseMemory()
+	{
+		for (std::vector<u2> * const r : { &_x, &_u, &_tu, &_v, &_m1, &_m2, &_xs, &_us, &_vs, &_r1, &_ir1, &_r2, &_ir2, &_r1p, &_ir1p, &_r2p, &_ir2p, &_w, &_iw })
+		{
+			r->clear(); r->shrink_to_fit();
+		}
+		_y.clear(); _y.shrink_to_fit();
+		_cs.clear(); _cs.shrink_to_fit();
+		_size = 0; _radix = 1;
+	}
+
+protected:
+	void _clearContext() { releaseMemory(); }
+
+public:
+	void readMemory_x(cl_uint2 * const ptr) { std::memcpy(ptr, _x.data(), sizeof(u2) * _size / 2); }
+	void readMemory_u(cl_uint2 * const ptr) { std::memcpy(ptr, _u.data(), sizeof(u2) * _size / 2); }
+	void writeMemory_x(const cl_uint2 * const ptr) { std::memcpy(_x.data(), ptr, sizeof(u2) * _size); }
+	void writeMemory_u(const cl_uint2 * const ptr) { std::memcpy(_u.data(), ptr, sizeof(u2) * _size); }
+	void readMemory_v(cl_uint2 * const ptr) { std::memcpy(ptr, _v.data(), sizeof(u2) * _size / 2); }
+	void writeMemory_v(const cl_uint2 * const ptr) { std::memcpy(_v.data(), ptr, sizeof(u2) * _size / 2); }
+	void readMemory_m1(cl_uint2 * const ptr) { std::memcpy(ptr, _m1.data(), sizeof(u2) * _size / 2); }
+	void readMemory_err(cl_int * const ptr) { *ptr = _err[0]; }
+	void clearMemory_err() { _err[0] = _err[1] = 0; }
+	void readMemory_cs(cl_uint * const ptr) { std::memcpy(ptr, _cs.data(), sizeof(cl_uint) * 4 * CS_SLOTS); }
+	void clearMemory_cs() { std::fill(_cs.begin(), _cs.end(), 0); }
+
+private:
+	// Shoup's precomputation: floor(w * 2^32 / p)
+	static uint32_t _shoup(const uint32_t w, const uint32_t p) { return uint32_t((uint64_t(w) << 32) / p); }
+	static u2 _shoup(const u2 w) { u2 r; r.s0 = _shoup(w.s0, P1); r.s1 = _shoup(w.s1, P2); return r; }
+
+public:
+	void writeMemory_r(const cl_uint4 * const ptr_r1ir1, const cl_uint2 * const ptr_r2, const cl_uint2 * const ptr_ir2)
+	{
+		for (size_t i = 0; i < _size; ++i)
+		{
+			u2 & r1 = _r1[i]; r1.s0 = ptr_r1ir1[i].s[0]; r1.s1 = ptr_r1ir1[i].s[1];
+			u2 & ir1 = _ir1[i]; ir1.s0 = ptr_r1ir1[i].s[2]; ir1.s1 = ptr_r1ir1[i].s[3];
+			u2 & r2 = _r2[i]; r2.s0 = ptr_r2[i].s[0]; r2.s1 = ptr_r2[i].s[1];
+			u2 & ir2 = _ir2[i]; ir2.s0 = ptr_ir2[i].s[0]; ir2.s1 = ptr_ir2[i].s[1];
+			// modulo 2^64 - 2^32 + 1, the products have no precomputation
+			if (!_goldilocks) { _r1p[i] = _shoup(r1); _ir1p[i] = _shoup(ir1); _r2p[i] = _shoup(r2); _ir2p[i] = _shoup(ir2); }
+		}
+	}
+
+	// the square functions read the roots of the main table
+	void writeMemory_cr(const cl_uint4 * const, const cl_uint4 * const, const cl_uint4 * const, const cl_uint4 * const) {}
+	void writeMemory_r(const cl_uint8 * const, const cl_uint4 * const, const cl_uint4 * const) { throw std::runtime_error("the native engine doesn't support the three-prime transform"); }
+	void writeMemory_cr(const cl_uint8 * const, const cl_uint8 * const, const cl_uint8 * const, const cl_uint8 * const) { throw std::runtime_error("the native engine doesn't support the three-prime transform"); }
+	void writeMemory_w(const cl_uint2 * const ptr_w, const cl_uint2 * const ptr_iw)
+	{
+		for (size_t i = 0; i < _size; ++i)
+		{
+			_w[i] = set(ptr_w[i].s[0], ptr_w[i].s[1]);
+			_iw[i] = set(ptr_iw[i].s[0], ptr_iw[i].s[1]);
+		}
+
+		// w5^k = w^{k.size/5}: u_k = (w5^k + w5^-k) / 2, v_k = (w5^k - w5^-k) / 2
+		if (_radix == 5)
+		{
+			const size_t L = _size / 5;
+			const v1g h = v1g((PG + 1) / 2);
+			for (size_t k = 1; k <= 2; ++k)
+			{
+				const v1g w = v1g::load(&_w[k * L]), iw = v1g::load(&_w[(5 - k) * L]);
+				_c5[k - 1] = v1g::mulmod(v1g::add(w, iw), h).a;
+				_c5[k + 1] = v1g::mulmod(v1g::sub(w, iw), h).a;
+			}
+		}
+	}
+
+	// b^i mod k is not needed by the long division
+	void writeMemory_bp(const cl_uint * const, const cl_uint * const) {}
+
+	void writeMemory_pc(const cl_uint * const ptr_pc)
+	{
+		_pc_e = ptr_pc[0]; _pc_s = ptr_pc[1]; _pc_d = ptr_pc[2]; _pc_d_inv = ptr_pc[3]; _pc_d_shift = ptr_pc[4];
+		_digit_bit = ptr_pc[5];
+	}
+
+private:
+	// p < 2^31: the results are corrected without a branch
+	static uint32_t _addmod(const uint32_t lhs, const uint32_t rhs, const uint32_t p) { const uint32_t r = lhs + rhs; return std::min(r, r - p); }
+	static uint32_t _submod(const uint32_t lhs, const uint32_t rhs, const uint32_t p) { const uint32_t r = lhs - rhs; return std::min(r, r + p); }
+
+	// Barrett's product, see modarith.cl
+	static uint32_t _mulmod(const uint32_t lhs, const uint32_t rhs, const uint32_t p, const uint32_t p_inv)
+	{
+		const uint64_t q = uint64_t(lhs) * rhs;
+		const uint32_t q_d = uint32_t(((q >> 30) * p_inv) >> 32);
+		const uint32_t r = uint32_t(q) - q_d * p;
+		return std::min(r, r - p);
+	}
+
+	// Shoup's product
+	static uint32_t _mulmodp(const uint32_t lhs, const uint32_t c, const uint32_t cp, const uint32_t p)
+	{
+		const uint32_t r = lhs * c - uint32_t((uint64_t(lhs) * cp) >> 32) * p;
+		return std::min(r, r - p);
+	}
+
+	static u2 set(const uint32_t s0, const uint32_t s1) { u2 r; r.s0 = s0; r.s1 = s1; return r; }
+
+	static u2 addmod(const u2 lhs, const u2 rhs) { return set(_addmod(lhs.s0, rhs.s0, P1), _addmod(lhs.s1, rhs.s1, P2)); }
+	static u2 submod(const u2 lhs, const u2 rhs) { return set(_submod(lhs.s0, rhs.s0, P1), _submod(lhs.s1, rhs.s1, P2)); }
+	static u2 mulmod(const u2 lhs, const u2 rhs) { return set(_mulmod(lhs.s0, rhs.s0, P1, P1_INV), _mulmod(lhs.s1, rhs.s1, P2, P2_INV)); }
+	static u2 sqrmod(const u2 lhs) { return mulmod(lhs, lhs); }
+	static u2 mulI(const u2 lhs) { return set(_mulmodp(lhs.s0, P1_I, P1_Ip, P1), _mulmodp(lhs.s1, P2_I, P2_Ip, P2)); }
+
+	static int64_t getlong(const u2 lhs)
+	{
+		// Garner Algorithm
+		const uint32_t d = _submod(lhs.s0, lhs.s1, P1);
+		const uint32_t u = _mulmodp(d, InvP2_P1, InvP2_P1p, P1);
+		const uint64_t P1P2 = uint64_t(P1) * P2;
+		const uint64_t r = u * uint64_t(P2) + lhs.s1;
+		return int64_t((r > P1P2 / 2) ? r - P1P2 : r);
+	}
+
+	// 2^64 = 2^32 - 1 and 2^96 = -1 (mod PG), see _reduce128 in modarith.cl
+	static uint64_t _reduce128(const uint64_t lo, const uint64_t hi)
+	{
+		const uint64_t hi_hi = hi >> 32, hi_lo = hi & 0xffffffffu;
+		const uint64_t t = lo - hi_hi - ((lo < hi_hi) ? 0xffffffffu : 0);
+		const uint64_t u = hi_lo * 0xffffffffu;
+		const uint64_t r = t + u + ((t + u < u) ? 0xffffffffu : 0);
+		return (r >= PG) ? r - PG : r;
+	}
+
+private:
+	// One element
+	struct v1
+	{
+		static const size_t N = 1;
+		u2 a;
+
+		v1() {}
+		v1(const u2 a) : a(a) {}
+		static v1 load(const u2 * const p) { return v1(*p); }
+		static v1 loadw(const u2 * const p) { return v1(*p); }
+		static void store(const v1 & v, u2 * const p) { *p = v.a; }
+
+		// digits of the split: R - Y
+		static v1 loadRY(const u2 * const p) { return v1(cpuEngine::submod(set(p->s0, p->s0), set(p->s1, p->s1))); }
+
+		static v1 add(const v1 & lhs, const v1 & rhs) { return v1(cpuEngine::addmod(lhs.a, rhs.a)); }
+		static v1 sub(const v1 & lhs, const v1 & rhs) { return v1(cpuEngine::submod(lhs.a, rhs.a)); }
+		static v1 mulI(const v1 & lhs) { return v1(cpuEngine::mulI(lhs.a)); }
+		static v1 mulmod(const v1 & lhs, const v1 & rhs) { return v1(cpuEngine::mulmod(lhs.a, rhs.a)); }
+		static v1 mul(const v1 & lhs, const v1 & w, const v1 & wp)
+		{
+			return v1(set(_mulmodp(lhs.a.s0, w.a.s0, wp.a.s0, P1), _mulmodp(lhs.a.s1, w.a.s1, wp.a.s1, P2)));
+		}
+
+		static int64_t getlong(const v1 & lhs) { return cpuEngine::getlong(lhs.a); }
+	};
+
+	// One element modulo PG, the residue is the 64-bit value of (s0, s1). See the GOLDILOCKS functions in modarith.cl.
+	struct v1g
+	{
+		static const size_t N = 1;
+		uint64_t a;
+
+		v1g() {}
+		explicit v1g(const uint64_t a) : a(a) {}
+		v1g(const u2 a) : a(a.s0 | (uint64_t(a.s1) << 32)) {}
+		static v1g load(const u2 * const p) { return v1g(*p); }
+		static v1g loadw(const u2 * const p) { return v1g(*p); }
+		static void store(const v1g & v, u2 * const p) { p->s0 = uint32_t(v.a); p->s1 = uint32_t(v.a >> 32); }
+
+		static v1g loadRY(const u2 * const p) { return sub(v1g(uint64_t(p->s0)), v1g(uint64_t(p->s1))); }
+
+		static v1g add(const v1g & lhs, const v1g & rhs) { return v1g(lhs.a + rhs.a - ((lhs.a >= PG - rhs.a) ? PG : 0)); }
+		static v1g sub(const v1g & lhs, const v1g & rhs) { return v1g(lhs.a - rhs.a + ((lhs.a < rhs.a) ? PG : 0)); }
+		static v1g mulI(const v1g & lhs) { return v1g(_reduce128(lhs.a << 48, lhs.a >> 16)); }
+		static v1g mulmod(const v1g & lhs, const v1g & rhs) { return v1g(_reduce128(lhs.a * rhs.a, arith::mulhi(lhs.a, rhs.a))); }
+		static v1g mul(const v1g & lhs, const v1g & w, const v1g &) { return mulmod(lhs, w); }
+
+		static int64_t getlong(const v1g & lhs) { return int64_t((lhs.a > PG / 2) ? lhs.a - PG : lhs.a); }
+	};
+
+#if defined (CPU_AVX2)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+	// Four consecutive elements, the lanes are (P1, P2, P1, P2, ...)
+	struct v4
+	{
+		static const size_t N = 4;
+		__m256i a;
+
+		v4() {}
+		v4(const __m256i a) : a(a) {}
+		static v4 load(const u2 * const p) { return v4(_mm256_loadu_si256((const __m256i *)p)); }
+		static v4 loadw(const u2 * const p) { return v4(_mm256_loadu_si256((const __m256i *)p)); }
+		static void store(const v4 & v, u2 * const p) { _mm256_storeu_si256((__m256i *)p, v.a); }
+
+		static __m256i p() { return _mm256_set_epi32(P2, P1, P2, P1, P2, P1, P2, P1); }
+
+		static v4 loadRY(const u2 * const ptr)
+		{
+			const __m256i x = _mm256_loadu_si256((const __m256i *)ptr);
+			return sub(v4(_mm256_shuffle_epi32(x, 0xA0)), v4(_mm256_shuffle_epi32(x, 0xF5)));
+		}
+
+		static v4 add(const v4 & lhs, const v4 & rhs)
+		{
+			const __m256i r = _mm256_add_epi32(lhs.a, rhs.a);
+			return v4(_mm256_min_epu32(r, _mm256_sub_epi32(r, p())));
+		}
+
+		static v4 sub(const v4 & lhs, const v4 & rhs)
+		{
+			const __m256i r = _mm256_sub_epi32(lhs.a, rhs.a);
+			return v4(_mm256_min_epu32(r, _mm256_add_epi32(r, p())));
+		}
+
+		static __m256i mulhi(const __m256i lhs, const __m256i rhs)
+		{
+			const __m256i e = _mm256_srli_epi64(_mm256_mul_epu32(lhs, rhs), 32);
+			const __m256i o = _mm256_mul_epu32(_mm256_srli_epi64(lhs, 32), _mm256_srli_epi64(rhs, 32));
+			return _mm256_blend_epi32(e, o, 0xAA);
+		}
+
+		static v4 mul(const __m256i lhs, const __m256i w, const __m256i wp)
+		{
+			const __m256i q = mulhi(lhs, wp);
+			const __m256i r = _mm256_sub_epi32(_mm256_mullo_epi32(lhs, w), _mm256_mullo_epi32(q, p()));
+			return v4(_mm256_min_epu32(r, _mm256_sub_epi32(r, p())));
+		}
+
+		static v4 mul(const v4 & lhs, const v4 & w, const v4 & wp) { return mul(lhs.a, w.a, wp.a); }
+
+		static v4 mulI(const v4 & lhs)
+		{
+			return mul(lhs.a, _mm256_set_epi32(P2_I, P1_I, P2_I, P1_I, P2_I, P1_I, P2_I, P1_I),
+				_mm256_set_epi32(P2_Ip, P1_Ip, P2_Ip, P1_Ip, P2_Ip, P1_Ip, P2_Ip, P1_Ip));
+		}
+
+		// Barrett's product: the even lanes are modulo P1 and the odd lanes modulo P2
+		static v4 mulmod(const v4 & lhs, const v4 & rhs)
+		{
+			const __m256i qe = _mm256_mul_epu32(lhs.a, rhs.a);
+			const __m256i qo = _mm256_mul_epu32(_mm256_srli_epi64(lhs.a, 32), _mm256_srli_epi64(rhs.a, 32));
+			const __m256i qde = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(qe, 30), _mm256_set1_epi64x(P1_INV)), 32);
+			const __m256i qdo = _mm256_mul_epu32(_mm256_srli_epi64(qo, 30), _mm256_set1_epi64x(P2_INV));
+			const __m256i q = _mm256_blend_epi32(qe, _mm256_slli_epi64(qo, 32), 0xAA), q_d = _mm256_blend_epi32(qde, qdo, 0xAA);
+			const __m256i r = _mm256_sub_epi32(q, _mm256_mullo_epi32(q_d, p()));
+			return v4(_mm256_min_epu32(r, _mm256_sub_epi32(r, p())));
+		}
+
+		// (x0, x1, x2, x3), (x4, x5, x6, x7) <-> (x0, x4, x2, x6), (x1, x5, x3, x7)
+		static void transpose2(v4 & v0, v4 & v1)
+		{
+			const __m256i t0 = _mm256_unpacklo_epi64(v0.a, v1.a), t1 = _mm256_unpackhi_epi64(v0.a, v1.a);
+			v0.a = t0; v1.a = t1;
+		}
+
+		// 4x4 matrix of elements
+		static void transpose4(v4 & v0, v4 & v1, v4 & v2, v4 & v3)
+		{
+			const __m256i t0 = _mm256_unpacklo_epi64(v0.a, v1.a), t1 = _mm256_unpackhi_epi64(v0.a, v1.a);
+			const __m256i t2 = _mm256_unpacklo_epi64(v2.a, v3.a), t3 = _mm256_unpackhi_epi64(v2.a, v3.a);
+			v0.a = _mm256_permute2x128_si256(t0, t2, 0x20); v1.a = _mm256_permute2x128_si256(t1, t3, 0x20);
+			v2.a = _mm256_permute2x128_si256(t0, t2, 0x31); v3.a = _mm256_permute2x128_si256(t1, t3, 0x31);
+		}
+	};
+
+	// The stage m = 2 of two consecutive blocks of 8 elements: the lanes are (x[i], x[i + 1], x[i + 8], x[i + 9])
+	struct v4p
+	{
+		static v4 load(const u2 * const p) { return v4(_mm256_loadu2_m128i((const __m128i *)&p[8], (const __m128i *)p)); }
+		static v4 loadw(const u2 * const p) { return v4(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)p))); }
+		static void store(const v4 & v, u2 * const p) { _mm256_storeu2_m128i((__m128i *)&p[8], (__m128i *)p, v.a); }
+	};
+#pragma GCC pop_options
+#endif
+
+private:
+	// Radix-4 butterflies, see _forward4 and _backward4 in modarith.cl. L loads and stores the elements and the roots.
+	template <typename V, typename L = V>
+	void _forward4(u2 * const x, const size_t m, const size_t ri) const
+	{
+		const V u0 = L::load(&x[0 * m]), u2 = L::load(&x[2 * m]), u1 = L::load(&x[1 * m]), u3 = L::load(&x[3 * m]);
+		const V v0 = V::add(u0, u2), v2 = V::sub(u0, u2), v1 = V::add(u1, u3), v3 = V::mulI(V::sub(u3, u1));
+		L::store(V::add(v0, v1), &x[0 * m]);
+		L::store(V::mul(V::sub(v0, v1), L::loadw(&_r2[ri]), L::loadw(&_r2p[ri])), &x[1 * m]);
+		L::store(V::mul(V::add(v2, v3), L::loadw(&_ir1[ri]), L::loadw(&_ir1p[ri])), &x[2 * m]);
+		L::store(V::mul(V::sub(v2, v3), L::loadw(&_r1[ri]), L::loadw(&_r1p[ri])), &x[3 * m]);
+	}
+
+	template <typename V>
+	void _sub_forward4(u2 * const x, const size_t m, const size_t ri) const
+	{
+		const V u0 = V::loadRY(&x[0 * m]), u1 = V::loadRY(&x[1 * m]), u3 = V::mulI(u1);
+		V::store(V::add(u0, u1), &x[0 * m]);
+		V::store(V::mul(V::sub(u0, u1), V::loadw(&_r2[ri]), V::loadw(&_r2p[ri])), &x[1 * m]);
+		V::store(V::mul(V::sub(u0, u3), V::loadw(&_ir1[ri]), V::loadw(&_ir1p[ri])), &x[2 * m]);
+		V::store(V::mul(V::add(u0, u3), V::loadw(&_r1[ri]), V::loadw(&_r1p[ri])), &x[3 * m]);
+	}
+
+	template <typename V, typename L = V>
+	void _backward4(u2 * const x, const size_t m, const size_t ri) const
+	{
+		const V v0 = L::load(&x[0 * m]), v1 = V::mul(L::load(&x[1 * m]), L::loadw(&_ir2[ri]), L::loadw(&_ir2p[ri]));
+		const V v2 = V::mul(L::load(&x[2 * m]), L::loadw(&_r1[ri]), L::loadw(&_r1p[ri]));
+		const V v3 = V::mul(L::load(&x[3 * m]), L::loadw(&_ir1[ri]), L::loadw(&_ir1p[ri]));
+		const V u0 = V::add(v0, v1), u2 = V::add(v2, v3), u1 = V::sub(v0, v1), u3 = V::mulI(V::sub(v2, v3));
+		L::store(V::add(u0, u2), &x[0 * m]); L::store(V::sub(u0, u2), &x[2 * m]);
+		L::store(V::add(u1, u3), &x[1 * m]); L::store(V::sub(u1, u3), &x[3 * m]);
+	}
+
+	enum class EStage { Sub, Forward, Backward };
+
+	// butterflies k0 <= k < k1 of the stage m. k0 and k1 are multiples of 4.
+	template <typename V>
+	void _stageV(const EStage type, u2 * const x, const size_t m, const size_t rindex, const size_t k0, const size_t k1) const
+	{
+		for (size_t k = k0; k < k1; )
+		{
+			const size_t i = k & (m - 1), j = 4 * k - 3 * i, n = std::min(m - i, k1 - k);
+			if (type == EStage::Sub) for (size_t l = 0; l < n; l += V::N) _sub_forward4<V>(&x[j + l], m, rindex + i + l);
+			else if (type == EStage::Forward) for (size_t l = 0; l < n; l += V::N) _forward4<V>(&x[j + l], m, rindex + i + l);
+			else for (size_t l = 0; l < n; l += V::N) _backward4<V>(&x[j + l], m, rindex + i + l);
+			k += n;
+		}
+	}
+
+#if defined (CPU_AVX2)
+	avx2_fn void _stageAVX2(const EStage type, u2 * const x, const size_t m, const size_t rindex, const size_t k0, const size_t k1) const
+	{
+		if (m >= 4) _stageV<v4>(type, x, m, rindex, k0, k1);
+		// m = 2 is never the first stage of a sub-transform
+		else if (type == EStage::Forward) for (size_t k = k0; k < k1; k += 4) _forward4<v4, v4p>(&x[4 * k], 2, rindex);
+		else for (size_t k = k0; k < k1; k += 4) _backward4<v4, v4p>(&x[4 * k], 2, rindex);
+	}
+#endif
+
+	void _stage(const EStage type, u2 * const x, const size_t m, const size_t rindex, const size_t k0, const size_t k1) const
+	{
+		if (_goldilocks) _stageV<v1g>(type, x, m, rindex, k0, k1);
+#if defined (CPU_AVX2)
+		else if (_avx2) _stageAVX2(type, x, m, rindex, k0, k1);
+#endif
+		else _stageV<v1>(type, x, m, rindex, k0, k1);
+	}
+
+	// range of the thread id: [n * id / count, n * (id + 1) / count), aligned to a
+	void _range(const size_t n, const size_t id, const size_t a, size_t & i0, size_t & i1) const
+	{
+		const size_t count = _pool.getCount();
+		i0 = (n * id / count) & ~(a - 1); i1 = (id + 1 == count) ? n : ((n * (id + 1) / count) & ~(a - 1));
+	}
+
+	// The stages mHi, mHi / 4, ..., mLo. A block of 4 * mHi elements is processed by a single thread if the number of blocks is large enough.
+	void _ntt(const EStage type, u2 * const x, const size_t mHi, const size_t mLo, const size_t rindex)
+	{
+		const size_t count = _pool.getCount(), n = _size / 4, blockCount = n / mHi;
+		const bool forward = (type != EStage::Backward);
+
+		size_t stageCount = 0, sm[32], sri[32];	// m, rindex
+		for (size_t m = mHi, ri = rindex; m >= mLo; ri += m, m /= 4) { sm[stageCount] = m; sri[stageCount] = ri; ++stageCount; }
+		if (!forward) { std::reverse(&sm[0], &sm[stageCount]); std::reverse(&sri[0], &sri[stageCount]); }
+
+		// the ranges of the butterflies must be multiples of 4
+		if ((blockCount >= count) && (mHi >= 4))
+		{
+			_pool.run([&](const size_t id)
+			{
+				size_t b0, b1; _range(blockCount, id, 1, b0, b1);
+				for (size_t b = b0; b < b1; ++b)
+				{
+					for (size_t s = 0; s < stageCount; ++s)
+					{
+						const EStage t = ((type == EStage::Sub) && (s != 0)) ? EStage::Forward : type;
+						_stage(t, x, sm[s], sri[s], b * mHi, (b + 1) * mHi);
+					}
+				}
+			});
+		}
+		else
+		{
+			for (size_t s = 0; s < stageCount; ++s)
+			{
+				const EStage t = ((type == EStage::Sub) && (s != 0)) ? EStage::Forward : type;
+				_pool.run([&](const size_t id)
+				{
+					size_t k0, k1; _range(n, id, 4, k0, k1);
+					_stage(t, x, sm[s], sri[s], k0, k1);
+				});
+			}
+		}
+	}
+
+	// index of the roots of the stage m in the main table
+	size_t _rindex(const size_t m) const
+	{
+		size_t rindex = 0;
+		for (size_t mm = _size / _radix / 4; mm > m; mm /= 4) rindex += mm;
+		return rindex;
+	}
+
+private:
+	// The DFT of size 3 or 5 of a, w3 = w^{size/3}, w5 = w^{size/5}. The inverse transform is the forward transform with the
+	// reversed outputs. w3^2 = -1 - w3 and, if s = 1 or 2, w5^s.a_1 + w5^-s.a_4 = u_s.(a_1 + a_4) + v_s.(a_1 - a_4).
+	void _dft(v1g a[5]) const
+	{
+		if (_radix == 3)
+		{
+			const v1g d = v1g::mulmod(v1g::sub(a[1], a[2]), v1g::load(&_w[_size / 3]));
+			const v1g b0 = v1g::add(a[0], v1g::add(a[1], a[2])), b1 = v1g::add(v1g::sub(a[0], a[2]), d), b2 = v1g::sub(v1g::sub(a[0], a[1]), d);
+			a[0] = b0; a[1] = b1; a[2] = b2;
+		}
+		else
+		{
+			const v1g u1 = v1g(_c5[0]), u2 = v1g(_c5[1]), v1 = v1g(_c5[2]), v2 = v1g(_c5[3]);
+			const v1g b1 = v1g::add(a[1], a[4]), c1 = v1g::sub(a[1], a[4]), b2 = v1g::add(a[2], a[3]), c2 = v1g::sub(a[2], a[3]);
+			const v1g s1 = v1g::add(a[0], v1g::add(v1g::mulmod(u1, b1), v1g::mulmod(u2, b2)));
+			const v1g s2 = v1g::add(a[0], v1g::add(v1g::mulmod(u2, b1), v1g::mulmod(u1, b2)));
+			const v1g t1 = v1g::add(v1g::mulmod(v1, c1), v1g::mulmod(v2, c2)), t2 = v1g::sub(v1g::mulmod(v2, c1), v1g::mulmod(v1, c2));
+			a[0] = v1g::add(a[0], v1g::add(b1, b2));
+			a[1] = v1g::add(s1, t1); a[4] = v1g::sub(s1, t1);
+			a[2] = v1g::add(s2, t2); a[3] = v1g::sub(s2, t2);
+		}
+	}
+
+	// The first stage of a transform of size radix * L, the elements j + t.L, 0 <= t < radix. The blocks [s.L, (s + 1).L) are
+	// then transformed by the radix-4 stages: x[j + s.L] = w^{j.s} sum_t x[j + t.L].w^{L.s.t}. The upper half of the input is zero.
+	void _radixForward(u2 * const x, const size_t j) const
+	{
+		const size_t r = _radix, L = _size / r;
+		v1g a[5];
+		for (size_t t = 0; t < r; ++t) a[t] = (j + t * L < _size / 2) ? v1g::loadRY(&x[j + t * L]) : v1g(uint64_t(0));
+		_dft(a);
+		for (size_t s = 0; s < r; ++s) v1g::store(v1g::mulmod(a[s], v1g::load(&_w[j * s])), &x[j + s * L]);
+	}
+
+	void _radixBackward(u2 * const x, const size_t j) const
+	{
+		const size_t r = _radix, L = _size / r;
+		v1g a[5];
+		for (size_t s = 0; s < r; ++s) a[s] = v1g::mulmod(v1g::load(&x[j + s * L]), v1g::load(&_iw[j * s]));
+		_dft(a);
+		for (size_t t = 0; t < r; ++t) v1g::store(a[(r - t) % r], &x[j + t * L]);
+	}
+
+	void _radixStage(const EStage type, u2 * const x)
+	{
+		const size_t L = _size / _radix;
+		_pool.run([&](const size_t id)
+		{
+			size_t j0, j1; _range(L, id, 1, j0, j1);
+			if (type == EStage::Sub) for (size_t j = j0; j < j1; ++j) _radixForward(x, j);
+			else for (size_t j = j0; j < j1; ++j) _radixBackward(x, j);
+		});
+	}
+
+private:
+	// see _square2 and _square4 in modarith.cl
+	template <typename V>
+	static void _square2(V & u0, V & u1)
+	{
+		const V s0 = V::mulmod(V::add(u0, u1), V::add(u0, u1)), s1 = V::mulmod(V::sub(u0, u1), V::sub(u0, u1));
+		u0 = V::add(s0, s1); u1 = V::sub(s0, s1);
+	}
+
+	template <typename V>
+	static void _square4(V & u0, V & u1, V & u2, V & u3)
+	{
+		const V v0 = V::add(u0, u2), v2 = V::sub(u0, u2), v1 = V::add(u1, u3), v3 = V::mulI(V::sub(u3, u1));
+		const V a0 = V::add(v0, v1), a1 = V::sub(v0, v1), a2 = V::add(v2, v3), a3 = V::sub(v2, v3);
+		const V s0 = V::mulmod(a0, a0), s1 = V::mulmod(a1, a1), s2 = V::mulmod(a2, a2), s3 = V::mulmod(a3, a3);
+		const V t0 = V::add(s0, s1), t2 = V::add(s2, s3), t1 = V::sub(s0, s1), t3 = V::mulI(V::sub(s2, s3));
+		u0 = V::add(t0, t2); u2 = V::sub(t0, t2); u1 = V::add(t1, t3); u3 = V::sub(t1, t3);
+	}
+
+	// see mul2 and mul4 in square.cl
+	template <typename V>
+	static void _mul2(V & u0, V & u1, const V & w0, const V & w1)
+	{
+		const V s0 = V::mulmod(V::add(u0, u1), V::add(w0, w1)), s1 = V::mulmod(V::sub(u0, u1), V::sub(w0, w1));
+		u0 = V::add(s0, s1); u1 = V::sub(s0, s1);
+	}
+
+	template <typename V>
+	static void _mul4(V & u0, V & u1, V & u2, V & u3, const V & w0, const V & w1, const V & w2, const V & w3)
+	{
+		const V vx0 = V::add(u0, u2), vx2 = V::sub(u0, u2), vx1 = V::add(u1, u3), vx3 = V::mulI(V::sub(u3, u1));
+		const V vy0 = V::add(w0, w2), vy2 = V::sub(w0, w2), vy1 = V::add(w1, w3), vy3 = V::mulI(V::sub(w3, w1));
+		const V s0 = V::mulmod(V::add(vx0, vx1), V::add(vy0, vy1)), s1 = V::mulmod(V::sub(vx0, vx1), V::sub(vy0, vy1));
+		const V s2 = V::mulmod(V::add(vx2, vx3), V::add(vy2, vy3)), s3 = V::mulmod(V::sub(vx2, vx3), V::sub(vy2, vy3));
+		const V t0 = V::add(s0, s1), t2 = V::add(s2, s3), t1 = V::sub(s0, s1), t3 = V::mulI(V::sub(s2, s3));
+		u0 = V::add(t0, t2); u2 = V::sub(t0, t2); u1 = V::add(t1, t3); u3 = V::sub(t1, t3);
+	}
+
+	// The last stage on 16 elements, an element at a time
+	template <typename V>
+	static void _square2_16s(u2 * const x, const u2 * const)
+	{
+		for (size_t i = 0; i < 16; i += 2)
+		{
+			V u0 = V::load(&x[i]), u1 = V::load(&x[i + 1]);
+			_square2(u0, u1);
+			V::store(u0, &x[i]); V::store(u1, &x[i + 1]);
+		}
+	}
+
+	template <typename V>
+	static void _square4_16s(u2 * const x, const u2 * const)
+	{
+		for (size_t i = 0; i < 16; i += 4)
+		{
+			V u0 = V::load(&x[i + 0]), u1 = V::load(&x[i + 1]), u2 = V::load(&x[i + 2]), u3 = V::load(&x[i + 3]);
+			_square4(u0, u1, u2, u3);
+			V::store(u0, &x[i + 0]); V::store(u1, &x[i + 1]); V::store(u2, &x[i + 2]); V::store(u3, &x[i + 3]);
+		}
+	}
+
+	template <typename V>
+	static void _mul2_16s(u2 * const x, const u2 * const y)
+	{
+		for (size_t i = 0; i < 16; i += 2)
+		{
+			V u0 = V::load(&x[i]), u1 = V::load(&x[i + 1]);
+			_mul2(u0, u1, V::load(&y[i]), V::load(&y[i + 1]));
+			V::store(u0, &x[i]); V::store(u1, &x[i + 1]);
+		}
+	}
+
+	template <typename V>
+	static void _mul4_16s(u2 * const x, const u2 * const y)
+	{
+		for (size_t i = 0; i < 16; i += 4)
+		{
+			V u0 = V::load(&x[i + 0]), u1 = V::load(&x[i + 1]), u2 = V::load(&x[i + 2]), u3 = V::load(&x[i + 3]);
+			_mul4(u0, u1, u2, u3, V::load(&y[i + 0]), V::load(&y[i + 1]), V::load(&y[i + 2]), V::load(&y[i + 3]));
+			V::store(u0, &x[i + 0]); V::store(u1, &x[i + 1]); V::store(u2, &x[i + 2]); V::store(u3, &x[i + 3]);
+		}
+	}
+
+#if defined (CPU_AVX2)
+	// The last stage on 16 elements with AVX2, the elements are transposed such that each lane is a sub-transform.
+	avx2_fn static void _square2_16(u2 * const x, const u2 * const)
+	{
+		for (size_t i = 0; i < 16; i += 8)
+		{
+			v4 u0 = v4::load(&x[i]), u1 = v4::load(&x[i + 4]);
+			v4::transpose2(u0, u1); _square2(u0, u1); v4::transpose2(u0, u1);
+			v4::store(u0, &x[i]); v4::store(u1, &x[i + 4]);
+		}
+	}
+
+	avx2_fn static void _square4_16(u2 * const x, const u2 * const)
+	{
+		v4 u0 = v4::load(&x[0]), u1 = v4::load(&x[4]), u2 = v4::load(&x[8]), u3 = v4::load(&x[12]);
+		v4::transpose4(u0, u1, u2, u3); _square4(u0, u1, u2, u3); v4::transpose4(u0, u1, u2, u3);
+		v4::store(u0, &x[0]); v4::store(u1, &x[4]); v4::store(u2, &x[8]); v4::store(u3, &x[12]);
+	}
+
+	avx2_fn static void _mul2_16(u2 * const x, const u2 * const y)
+	{
+		for (size_t i = 0; i < 16; i += 8)
+		{
+			v4 u0 = v4::load(&x[i]), u1 = v4::load(&x[i + 4]), w0 = v4::load(&y[i]), w1 = v4::load(&y[i + 4]);
+			v4::transpose2(u0, u1); v4::transpose2(w0, w1); _mul2(u0, u1, w0, w1); v4::transpose2(u0, u1);
+			v4::store(u0, &x[i]); v4::store(u1, &x[i + 4]);
+		}
+	}
+
+	avx2_fn static void _mul4_16(u2 * const x, const u2 * const y)
+	{
+		v4 u0 = v4::load(&x[0]), u1 = v4::load(&x[4]), u2 = v4::load(&x[8]), u3 = v4::load(&x[12]);
+		v4 w0 = v4::load(&y[0]), w1 = v4::load(&y[4]), w2 = v4::load(&y[8]), w3 = v4::load(&y[12]);
+		v4::transpose4(u0, u1, u2, u3); v4::transpose4(w0, w1, w2, w3);
+		_mul4(u0, u1, u2, u3, w0, w1, w2, w3); v4::transpose4(u0, u1, u2, u3);
+		v4::store(u0, &x[0]); v4::store(u1, &x[4]); v4::store(u2, &x[8]); v4::store(u3, &x[12]);
+	}
+#endif
+
+	// Forward stages N / 4, ..., 4 or 2, square and backward stages on blocks of N elements.
+	// The stages are local to the blocks then two blocks of 8 elements are processed together.
+	// if mul then the pointwise product is the multiplication by tu. If keep then the forward transform of x is stored into tu.
+	void _square(const char * const name, const size_t N, const bool mul = false, const bool keep = false)
+	{
+		const timePoint t0 = _tick();
+
+		u2 * const x = _x.data();
+		u2 * const y = _tu.data();
+		const size_t L = std::max(N, size_t(16)), blockCount = _size / L;
+
+		size_t stageCount = 0, sm[16], sri[16];	// m, rindex
+		for (size_t m = N / 4; m >= 2; m /= 4) { sm[stageCount] = m; sri[stageCount] = _rindex(m); ++stageCount; }
+		const bool square4 = (sm[stageCount - 1] == 4);
+		void (* fn)(u2 *, const u2 *) = mul
+			? (_goldilocks ? (square4 ? _mul4_16s<v1g> : _mul2_16s<v1g>) : (square4 ? _mul4_16s<v1> : _mul2_16s<v1>))
+			: (_goldilocks ? (square4 ? _square4_16s<v1g> : _square2_16s<v1g>) : (square4 ? _square4_16s<v1> : _square2_16s<v1>));
+#if defined (CPU_AVX2)
+		if (_avx2 && !_goldilocks) fn = mul ? (square4 ? _mul4_16 : _mul2_16) : (square4 ? _square4_16 : _square2_16);
+#endif
+
+		_pool.run([&](const size_t id)
+		{
+			size_t b0, b1; _range(blockCount, id, 1, b0, b1);
+			for (size_t b = b0; b < b1; ++b)
+			{
+				u2 * const xb = &x[b * L];
+				for (size_t s = 0; s < stageCount; ++s) _stage(EStage::Forward, xb, sm[s], sri[s], 0, L / 4);
+				if (keep) std::copy(xb, xb + L, &y[b * L]);
+				for (size_t i = 0; i < L; i += 16) fn(&xb[i], mul ? &y[b * L + i] : nullptr);
+				for (size_t s = stageCount; s > 0; --s) _stage(EStage::Backward, xb, sm[s - 1], sri[s - 1], 0, L / 4);
+			}
+		});
+
+		_tock(name, t0);
+	}
+
+	void _fwd(const char * const name, const EStage type, std::vector<u2> & x, const size_t mHi, const size_t mLo, const size_t rindex)
+	{
+		const timePoint t0 = _tick();
+		_ntt(type, x.data(), mHi, mLo, rindex);
+		_tock(name, t0);
+	}
+
+	// The digits R - Y are replaced with the balanced digits d = s0 - s1, -B/2 <= d < B/2, before the forward transform.
+	// Each thread converts its digits and propagates the carry locally then the carries are propagated serially.
+	void _balance(u2 * const x)
+	{
+		const size_t n = _size / 2, count = _pool.getCount();
+		const uint32_t digit_bit = _digit_bit;
+		const int32_t half = int32_t(1) << (digit_bit - 1), digit_mask = (int32_t(1) << digit_bit) - 1;
+
+		// c = d + carry.B
+		auto balance = [&](u2 & x_k, int32_t & c)
+		{
+			const int32_t d = ((c + half) & digit_mask) - half;
+			c = (c - d) >> digit_bit;
+			x_k = (d >= 0) ? set(uint32_t(d), 0) : set(0, uint32_t(-d));
+		};
+
+		std::vector<int32_t> carry(count);
+		_pool.run([&](const size_t id)
+		{
+			size_t k0, k1; _range(n, id, 1, k0, k1);
+			int32_t c = 0;
+			for (size_t k = k0; k < k1; ++k) { c += int32_t(x[k].s0) - int32_t(x[k].s1); balance(x[k], c); }
+			carry[id] = c;
+		});
+
+		int32_t f = 0;
+		for (size_t id = 0; id < count; ++id)
+		{
+			size_t k0, k1; _range(n, id, 1, k0, k1);
+			for (size_t k = k0; (f != 0) && (k < k1); ++k) { f += int32_t(x[k].s0) - int32_t(x[k].s1); balance(x[k], f); }
+			f += carry[id];
+		}
+		// the upper digits of R - Y are zero
+		if (f != 0) _err[0] |= cl_int(f);
+	}
+
+	// The first stages of the forward transform and the last stages of the backward transform: the stages of the
+	// power-of-2 transforms of size L are L / 4, ..., L / chunk.
+	void _sub(const char * const name, std::vector<u2> & x, const size_t chunk)
+	{
+		const timePoint t0 = _tick();
+		const size_t L = _size / _radix;
+		if (_balanced) _balance(x.data());
+		if (_radix == 1) _ntt(EStage::Sub, x.data(), L / 4, L / chunk, 0);
+		else { _radixStage(EStage::Sub, x.data()); _ntt(EStage::Forward, x.data(), L / 4, L / chunk, 0); }
+		_tock(name, t0);
+	}
+
+	void _lst(const char * const name, std::vector<u2> & x, const size_t chunk)
+	{
+		const timePoint t0 = _tick();
+		const size_t L = _size / _radix;
+		_ntt(EStage::Backward, x.data(), L / 4, L / chunk, 0);
+		if (_radix != 1) _radixStage(EStage::Backward, x.data());
+		_tock(name, t0);
+	}
+
+public:
+	void sub_ntt64_16(const cl_uint, const cl_uint) { _sub("sub_ntt64", _x, 64); }
+	void sub_ntt256_4(const cl_uint, const cl_uint) { _sub("sub_ntt256", _x, 256); }
+	void sub_ntt256_8(const cl_uint, const cl_uint) { _sub("sub_ntt256", _x, 256); }
+	void sub_ntt256_16(const cl_uint, const cl_uint) { _sub("sub_ntt256", _x, 256); }
+	void sub_ntt1024_1(const cl_uint, const cl_uint) { _sub("sub_ntt1024", _x, 1024); }
+	void sub_ntt1024_2(const cl_uint, const cl_uint) { _sub("sub_ntt1024", _x, 1024); }
+	void sub_ntt1024_4(const cl_uint, const cl_uint) { _sub("sub_ntt1024", _x, 1024); }
+
+	void lst_intt64_16(const cl_uint, const cl_uint) { _lst("lst_intt64", _x, 64); }
+	void lst_intt256_4(const cl_uint, const cl_uint) { _lst("lst_intt256", _x, 256); }
+	void lst_intt256_8(const cl_uint, const cl_uint) { _lst("lst_intt256", _x, 256); }
+	void lst_intt256_16(const cl_uint, const cl_uint) { _lst("lst_intt256", _x, 256); }
+	void lst_intt1024_1(const cl_uint, const cl_uint) { _lst("lst_intt1024", _x, 1024); }
+	void lst_intt1024_2(const cl_uint, const cl_uint) { _lst("lst_intt1024", _x, 1024); }
+	void lst_intt1024_4(const cl_uint, const cl_uint) { _lst("lst_intt1024", _x, 1024); }
+	void lst_intt64_16_p2i(const cl_uint m, const cl_uint rindex) { lst_intt64_16(m, rindex); _poly2int(); }
+	void lst_intt256_4_p2i(const cl_uint m, const cl_uint rindex) { lst_intt256_4(m, rindex); _poly2int(); }
+	void lst_intt256_8_p2i(const cl_uint m, const cl_uint rindex) { lst_intt256_8(m, rindex); _poly2int(); }
+	void lst_intt256_16_p2i(const cl_uint m, const cl_uint rindex) { lst_intt256_16(m, rindex); _poly2int(); }
+	void lst_intt1024_4_p2i(const cl_uint m, const cl_uint rindex) { lst_intt1024_4(m, rindex); _poly2int(); }
+
+	void ntt64_16(const cl_uint m, const cl_uint rindex) { _fwd("ntt64", EStage::Forward, _x, 16 * m, m, rindex); }
+	void ntt256_4(const cl_uint m, const cl_uint rindex) { _fwd("ntt256", EStage::Forward, _x, 64 * m, m, rindex); }
+	void ntt256_8(const cl_uint m, const cl_uint rindex) { _fwd("ntt256", EStage::Forward, _x, 64 * m, m, rindex); }
+	void ntt256_16(const cl_uint m, const cl_uint rindex) { _fwd("ntt256", EStage::Forward, _x, 64 * m, m, rindex); }
+	void ntt1024_1(const cl_uint m, const cl_uint rindex) { _fwd("ntt1024", EStage::Forward, _x, 256 * m, m, rindex); }
+	void ntt1024_2(const cl_uint m, const cl_uint rindex) { _fwd("ntt1024", EStage::Forward, _x, 256 * m, m, rindex); }
+	void ntt1024_4(const cl_uint m, const cl_uint rindex) { _fwd("ntt1024", EStage::Forward, _x, 256 * m, m, rindex); }
+
+	void intt64_16(const cl_uint m, const cl_uint rindex) { _fwd("intt64", EStage::Backward, _x, 16 * m, m, rindex); }
+	void intt256_4(const cl_uint m, const cl_uint rindex) { _fwd("intt256", EStage::Backward, _x, 64 * m, m, rindex); }
+	void intt256_8(const cl_uint m, const cl_uint rindex) { _fwd("intt256", EStage::Backward, _x, 64 * m, m, rindex); }
+	void intt256_16(const cl_uint m, const cl_uint rindex) { _fwd("intt256", EStage::Backward, _x, 64 * m, m, rindex); }
+	void intt1024_1(const cl_uint m, const cl_uint rindex) { _fwd("intt1024", EStage::Backward, _x, 256 * m, m, rindex); }
+	void intt1024_2(const cl_uint m, const cl_uint rindex) { _fwd("intt1024", EStage::Backward, _x, 256 * m, m, rindex); }
+	void intt1024_4(const cl_uint m, const cl_uint rindex) { _fwd("intt1024", EStage::Backward, _x, 256 * m, m, rindex); }
+
+	void ntt4(const cl_uint m, const cl_uint rindex) { _fwd("ntt4", EStage::Forward, _x, m, m, rindex); }
+	void intt4(const cl_uint m, const cl_uint rindex) { _fwd("intt4", EStage::Backward, _x, m, m, rindex); }
+
+	void sub_ntt64_u(const cl_uint, const cl_uint) { _sub("sub_ntt64", _tu, 64); }
+	void sub_ntt256_4_u(const cl_uint, const cl_uint) { _sub("sub_ntt256", _tu, 256); }
+	void sub_ntt256_8_u(const cl_uint, const cl_uint) { _sub("sub_ntt256", _tu, 256); }
+	void sub_ntt256_16_u(const cl_uint, const cl_uint) { _sub("sub_ntt256", _tu, 256); }
+	void sub_ntt1024_1_u(const cl_uint, const cl_uint) { _sub("sub_ntt1024", _tu, 1024); }
+	void sub_ntt1024_2_u(const cl_uint, const cl_uint) { _sub("sub_ntt1024", _tu, 1024); }
+	void sub_ntt1024_4_u(const cl_uint, const cl_uint) { _sub("sub_ntt1024", _tu, 1024); }
+	void ntt64_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt64", EStage::Forward, _tu, 16 * m, m, rindex); }
+	void ntt256_4_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt256", EStage::Forward, _tu, 64 * m, m, rindex); }
+	void ntt256_8_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt256", EStage::Forward, _tu, 64 * m, m, rindex); }
+	void ntt256_16_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt256", EStage::Forward, _tu, 64 * m, m, rindex); }
+	void ntt1024_1_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt1024", EStage::Forward, _tu, 256 * m, m, rindex); }
+	void ntt1024_2_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt1024", EStage::Forward, _tu, 256 * m, m, rindex); }
+	void ntt1024_4_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt1024", EStage::Forward, _tu, 256 * m, m, rindex); }
+	void ntt4_u(const cl_uint m, const cl_uint rindex) { _fwd("ntt4", EStage::Forward, _tu, m, m, rindex); }
+
+public:
+	void square8(const cl_uint, const cl_uint) { _square("square8", 8); }
+	void square16(const cl_uint, const cl_uint) { _square("square16", 16); }
+	void square32(const cl_uint, const cl_uint) { _square("square32", 32); }
+	void square64(const cl_uint, const cl_uint) { _square("square64", 64); }
+	void square128(const cl_uint, const cl_uint) { _square("square128", 128); }
+	void square256(const cl_uint, const cl_uint) { _square("square256", 256); }
+	void square512(const cl_uint, const cl_uint) { _square("square512", 512); }
+	void square1024(const cl_uint, const cl_uint) { _square("square1024", 1024); }
+	void square2048(const cl_uint, const cl_uint) { _square("square2048", 2048); }
+	void square4096(const cl_uint, const cl_uint) { _square("square4096", 4096); }
+
+public:
+	void mul8(const cl_uint, const cl_uint) { _square("mul8", 8, true); }
+	void mul16(const cl_uint, const cl_uint) { _square("mul16", 16, true); }
+	void mul32(const cl_uint, const cl_uint) { _square("mul32", 32, true); }
+	void mul64(const cl_uint, const cl_uint) { _square("mul64", 64, true); }
+	void mul128(const cl_uint, const cl_uint) { _square("mul128", 128, true); }
+	void mul256(const cl_uint, const cl_uint) { _square("mul256", 256, true); }
+	void mul512(const cl_uint, const cl_uint) { _square("mul512", 512, true); }
+	void mul1024(const cl_uint, const cl_uint) { _square("mul1024", 1024, true); }
+	void mul2048(const cl_uint, const cl_uint) { _square("mul2048", 2048, true); }
+	void mul4096(const cl_uint, const cl_uint) { _square("mul4096", 4096, true); }
+
+public:
+	void square8_tu(const cl_uint, const cl_uint) { _square("square8_tu", 8, false, true); }
+	void square16_tu(const cl_uint, const cl_uint) { _square("square16_tu", 16, false, true); }
+	void square32_tu(const cl_uint, const cl_uint) { _square("square32_tu", 32, false, true); }
+	void square64_tu(const cl_uint, const cl_uint) { _square("square64_tu", 64, false, true); }
+	void square128_tu(const cl_uint, const cl_uint) { _square("square128_tu", 128, false, true); }
+	void square256_tu(const cl_uint, const cl_uint) { _square("square256_tu", 256, false, true); }
+	void square512_tu(const cl_uint, const cl_uint) { _square("square512_tu", 512, false, true); }
+	void square1024_tu(const cl_uint, const cl_uint) { _square("square1024_tu", 1024, false, true); }
+	void square2048_tu(const cl_uint, const cl_uint) { _square("square2048_tu", 2048, false, true); }
+	void square4096_tu(const cl_uint, const cl_uint) { _square("square4096_tu", 4096, false, true); }
+
+private:
+	void _mul(const char * const name, void (*fn)(u2 *, const u2 *))
+	{
+		const timePoint t0 = _tick();
+		u2 * const x = _x.data();
+		const u2 * const y = _tu.data();
+		_pool.run([&](const size_t id)
+		{
+			size_t i0, i1; _range(_size, id, 16, i0, i1);
+			for (size_t i = i0; i < i1; i += 16) fn(&x[i], &y[i]);
+		});
+		_tock(name, t0);
+	}
+
+public:
+	void mul2() { _mul("mul2", _goldilocks ? _mul2_16s<v1g> : _mul2_16); }
+	void mul4() { _mul("mul4", _goldilocks ? _mul4_16s<v1g> : _mul4_16); }
+
+private:
+	// Each thread converts its digits and propagates the carry locally then the carries are propagated serially.
+	template <typename V>
+	void _poly2intV()
+	{
+		const timePoint t0 = _tick();
+
+		u2 * const x = _x.data();
+		const size_t size = _size, count = _pool.getCount();
+		const uint32_t digit_bit = _digit_bit, digit_mask = (uint32_t(1) << digit_bit) - 1;
+		const V norm = V(_norm);
+
+		std::vector<int64_t> carry(count);
+		_pool.run([&](const size_t id)
+		{
+			size_t k0, k1; _range(size, id, 4, k0, k1);
+			int64_t l = 0;
+			for (size_t k = k0; k < k1; ++k)
+			{
+				l += V::getlong(V::mulmod(V::load(&x[k]), norm));	// -n/2 . (B-1)^2 <= l <= n/2 . (B-1)^2
+				x[k].s0 = uint32_t(l) & digit_mask;
+				l >>= digit_bit;
+			}
+			carry[id] = l;
+		});
+
+		int64_t f = 0;
+		for (size_t id = 0; id < count; ++id)
+		{
+			size_t k0, k1; _range(size, id, 4, k0, k1);
+			for (size_t k = k0; (f != 0) && (k < k1); ++k)
+			{
+				f += x[k].s0;
+				x[k].s0 = uint32_t(f) & digit_mask;
+				f >>= digit_bit;
+			}
+			f += carry[id];
+		}
+		if (f != 0) _err[0] |= cl_int(f);
+
+		_tock("poly2int", t0);
+	}
+
+	void _poly2int() { if (_goldilocks) _poly2intV<v1g>(); else _poly2intV<v1>(); }
+
+public:
+	void poly2int_4_16() { _poly2int(); }
+	void poly2int_4_32() { _poly2int(); }
+	void poly2int_4_64() { _poly2int(); }
+	void poly2int_8_16() { _poly2int(); }
+	void poly2int_8_32() { _poly2int(); }
+	void poly2int_8_64() { _poly2int(); }
+	void poly2int_16_8() { _poly2int(); }
+	void poly2int_16_16() { _poly2int(); }
+	void poly2int_16_32() { _poly2int(); }
+	// no global-memory pass is saved by a fusion: the kernels are executed in sequence
+	void poly2int_red_4_16() { _poly2int(); reduce_i(); }
+	void poly2int_red_4_32() { _poly2int(); reduce_i(); }
+	void poly2int_red_4_64() { _poly2int(); reduce_i(); }
+	void poly2int_red_8_16() { _poly2int(); reduce_i(); }
+	void poly2int_red_8_32() { _poly2int(); reduce_i(); }
+	void poly2int_red_8_64() { _poly2int(); reduce_i(); }
+	void poly2int_red_16_8() { _poly2int(); reduce_i(); }
+	void poly2int_red_16_16() { _poly2int(); reduce_i(); }
+	void poly2int_red_16_32() { _poly2int(); reduce_i(); }
+	void poly2int_lb_4_16() { _poly2int(); }
+	void poly2int_lb_4_32() { _poly2int(); }
+	void poly2int_lb_4_64() { _poly2int(); }
+	void poly2int_lb_8_16() { _poly2int(); }
+	void poly2int_lb_8_32() { _poly2int(); }
+	void poly2int_lb_8_64() { _poly2int(); }
+	void poly2int_lb_16_8() { _poly2int(); }
+	void poly2int_lb_16_16() { _poly2int(); }
+	void poly2int_lb_16_32() { _poly2int(); }
+	void poly2int_lst() {}
+	void poly2int_red_lst() { reduce_i(); }
+
+public:
+	void reduce_upsweep64(const cl_uint, const cl_uint) {}
+	void reduce_downsweep64(const cl_uint, const cl_uint) {}
+	void reduce_topsweep32(const cl_uint) {}
+	void reduce_topsweep64(const cl_uint) {}
+	void reduce_topsweep128(const cl_uint) {}
+	void reduce_topsweep256(const cl_uint) {}
+	void reduce_topsweep512(const cl_uint) {}
+	void reduce_topsweep1024(const cl_uint) {}
+	void reduce_topsweep_r(const cl_uint, const cl_uint) {}
+	void reduce_scan_64() {}
+	void reduce_scan_128() {}
+
+public:
+	// y = X / (B^e * 2^s)
+	void reduce_i()
+	{
+		const timePoint t0 = _tick();
+
+		const u2 * const x = _x.data();
+		uint32_t * const y = _y.data();
+		const uint32_t e = _pc_e, s = _pc_s, digit_bit = _digit_bit, digit_mask = (uint32_t(1) << digit_bit) - 1;
+		_pool.run([&](const size_t id)
+		{
+			size_t k0, k1; _range(_size / 2, id, 1, k0, k1);
+			for (size_t k = k0; k < k1; ++k) y[k] = ((x[e + k].s0 >> s) | (x[e + k + 1].s0 << (digit_bit - s))) & digit_mask;
+		});
+
+		_tock("reduce_i", t0);
+	}
+
+private:
+	// q = r * B + y, r < d: see reduce_o in reduce.cl
+	uint32_t _div(const uint64_t q, uint32_t & r) const
+	{
+		const uint32_t d = _pc_d;
+		uint32_t q_d = uint32_t((uint64_t(uint32_t(q >> _pc_d_shift)) * _pc_d_inv) >> 32);
+		r = uint32_t(q) - q_d * d;
+		if (r >= d) { r -= d; ++q_d; }
+		return q_d;
+	}
+
+public:
+	// Y = [y / d], x = (X mod B^n, Y): the remainder of each range of digits is computed in parallel,
+	// the remainders of the upper digits are combined then each thread computes its digits of the quotient.
+	void reduce_o()
+	{
+		const timePoint t0 = _tick();
+
+		u2 * const x = _x.data();
+		const uint32_t * const y = _y.data();
+		const size_t n = _size / 2, count = _pool.getCount();
+		const uint32_t e = _pc_e, d = _pc_d, digit_bit = _digit_bit;
+
+		_rem.resize(count);
+		_pool.run([&](const size_t id)
+		{
+			size_t k0, k1; _range(n, id, 1, k0, k1);
+			uint32_t r = 0;
+			for (size_t k = k1; k > k0; --k) _div((uint64_t(r) << digit_bit) | y[k - 1], r);
+			_rem[id] = r;
+		});
+
+		// r_in(id) = remainder of the digits above the range of the thread id
+		uint32_t r = 0;
+		for (size_t id = count; id > 0; --id)
+		{
+			size_t k0, k1; _range(n, id - 1, 1, k0, k1);
+			const uint32_t rem = _rem[id - 1];
+			_rem[id - 1] = r;
+			uint64_t b = (uint64_t(1) << digit_bit) % d, bl = 1;	// B^(k1 - k0) mod d
+			for (size_t l = k1 - k0; l != 0; l >>= 1)
+			{
+				if (l % 2 != 0) bl = (bl * b) % d;
+				b = (b * b) % d;
+			}
+			r = uint32_t((r * bl + rem) % d);
+		}
+		_t0 = r;
+
+		const cl_int cs_slot = _csSlot;
+		std::vector<uint64_t> cs(2 * count, 0);
+
+		_pool.run([&](const size_t id)
+		{
+			size_t k0, k1; _range(n, id, 1, k0, k1);
+			uint32_t r = _rem[id];
+			uint64_t cs_r = 0, cs_y = 0;
+			for (size_t k = k1; k > k0; --k)
+			{
+				const uint32_t q_d = _div((uint64_t(r) << digit_bit) | y[k - 1], r);
+				x[k - 1] = set((k - 1 > e) ? 0 : x[k - 1].s0, q_d);
+				if (cs_slot >= 0)
+				{
+					if (k - 1 < e) cs_r += _m31_mul_Bk(x[k - 1].s0, k - 1);
+					cs_y += _m31_mul_Bk(q_d, k - 1);
+				}
+			}
+			cs[2 * id + 0] = cs_r; cs[2 * id + 1] = cs_y;
+		});
+
+		if (cs_slot >= 0)
+		{
+			for (size_t id = 0; id < count; ++id)
+			{
+				_csAdd(4 * size_t(cs_slot) + 0, uint32_t(cs[2 * id + 0] % M31));
+				_csAdd(4 * size_t(cs_slot) + 2, uint32_t(cs[2 * id + 1] % M31));
+			}
+		}
+
+		_tock("reduce_o", t0);
+	}
+
+	// R = r * B^e + X_lo
+	void reduce_f()
+	{
+		u2 * const x = _x.data();
+		const uint32_t e = _pc_e, s = _pc_s, digit_bit = _digit_bit, digit_mask = (uint32_t(1) << digit_bit) - 1;
+
+		const uint32_t rs = x[e].s0 & ((uint32_t(1) << s) - 1);
+		uint64_t l = (uint64_t(_t0) << s) | rs;
+
+		x[e].s0 = uint32_t(l) & digit_mask;
+		uint64_t cs_r = _m31_mul_Bk(x[e].s0, e);
+		l >>= digit_bit;
+
+		for (size_t k = e + 1; l != 0; ++k)
+		{
+			x[k].s0 = uint32_t(l) & digit_mask;
+			cs_r += _m31_mul_Bk(x[k].s0, k);
+			l >>= digit_bit;
+		}
+
+		if (_csSlot >= 0) _csAdd(4 * size_t(_csSlot) + 0, uint32_t(cs_r % M31));
+	}
+
+	void reduce_of() { reduce_o(); reduce_f(); }
+
+	void setChecksumSlot(const cl_int slot) { _csSlot = slot; }
+
+private:
+	static const uint32_t M31 = 0x7fffffffu;
+
+	// B^k = 2^(digit_bit.k mod 31) (mod 2^31 - 1)
+	uint32_t _m31_mul_Bk(const uint32_t a, const size_t k) const
+	{
+		const uint64_t t = uint64_t(a) << ((_digit_bit * k) % 31);
+		const uint64_t s = (t & M31) + (t >> 31);
+		const uint32_t r = uint32_t(s & M31) + uint32_t(s >> 31);
+		return (r >= M31) ? r - M31 : r;
+	}
+
+	void _csAdd(const size_t i, const uint32_t a)
+	{
+		const uint64_t c = ((uint64_t(_cs[i + 1]) << 32) | _cs[i]) + a;
+		_cs[i] = uint32_t(c); _cs[i + 1] = uint32_t(c >> 32);
+	}
+
+private:
+	void _reduce_x(u2 * const x)
+	{
+		const uint32_t digit_bit = _digit_bit, digit_mask = (uint32_t(1) << digit_bit) - 1;
+
+		int32_t c = 0;
+		for (size_t k = 0, n = _size / 2; k < n; ++k)
+		{
+			const u2 x_k = x[k];
+			c += int32_t(x_k.s0 - x_k.s1);
+			x[k] = set(uint32_t(c) & digit_mask, 0);
+			c >>= digit_bit;
+		}
+
+		if (c != 0) _err[0] |= c;
+	}
+
+public:
+	void reduce_x() { _reduce_x(_x.data()); }
+
+	void reduce_z_m1()
+	{
+		// s0 = x, s1 = k.2^n + 1
+		// if s0 >= s1 then s0 -= s1;
+		const u2 * const x = _m1.data();
+		for (size_t i = 0, n = _size / 2; i < n; ++i)
+		{
+			const u2 x_k = x[n - 1 - i];
+			if (x_k.s0 < x_k.s1) return;
+			if (x_k.s0 > x_k.s1) break;
+		}
+
+		_reduce_x(_m1.data());
+	}
+
+private:
+	void _set_positive(u2 * const x)
+	{
+		// x.s0 = R, x.s1 = Y
+		// if R < Y then add k.2^n + 1 to R.
+		const uint32_t digit_bit = _digit_bit, digit_mask = (uint32_t(1) << digit_bit) - 1;
+
+		for (size_t i = 0, n = _size / 2; i < n; ++i)
+		{
+			const size_t j = n - 1 - i;
+			const u2 x_j = x[j];
+			if (x_j.s0 > x_j.s1) return;
+			if (x_j.s0 < x_j.s1)
+			{
+				// R += 1
+				uint32_t c = 1;
+				for (size_t k = 0; c != 0; ++k)
+				{
+					c += x[k].s0;
+					x[k].s0 = c & digit_mask;
+					c >>= digit_bit;
+				}
+
+				// R += k.2^n
+				uint64_t l = uint64_t(_pc_d) << _pc_s;
+				for (size_t k = _pc_e; l != 0; ++k)
+				{
+					l += x[k].s0;
+					x[k].s0 = uint32_t(l) & digit_mask;
+					l >>= digit_bit;
+				}
+
+				return;
+			}
+		}
+	}
+
+public:
+	void set_positive() { _set_positive(_x.data()); }
+	void set_positive_tu() { _set_positive(_tu.data()); }
+
+	void add1_m1(const cl_uint a)
+	{
+		// s0: += a
+		// s1: 0 => k.2^n + 1 for reduce_z step
+		u2 * const x = _m1.data();
+		const uint32_t digit_bit = _digit_bit, digit_mask = (uint32_t(1) << digit_bit) - 1;
+
+		uint32_t c = x[0].s0 + a;
+		x[0] = set(c & digit_mask, 1);
+		c >>= digit_bit;
+
+		for (size_t k = 1; c != 0; ++k)
+		{
+			c += x[k].s0;
+			x[k].s0 = c & digit_mask;
+			c >>= digit_bit;
+		}
+
+		uint64_t l = uint64_t(_pc_d) << _pc_s;
+		for (size_t k = _pc_e; l != 0; ++k)
+		{
+			x[k].s1 = uint32_t(l) & digit_mask;
+			l >>= digit_bit;
+		}
+	}
+
+private:
+	void _swap(std::vector<u2> & x, std::vector<u2> & y) { std::swap_ranges(x.begin(), x.begin() + _size / 2, y.begin()); }
+	void _copy(std::vector<u2> & dst, const std::vector<u2> & src) { std::memcpy(dst.data(), src.data(), sizeof(u2) * _size / 2); }
+	void _compare(const std::vector<u2> & x, const std::vector<u2> & y)
+	{
+		if (std::memcmp(x.data(), y.data(), sizeof(u2) * _size / 2) != 0) _err[0] |= 1;
+	}
+
+public:
+	void swap_x_u() { _swap(_x, _u); }
+	void swap_x_v() { _swap(_x, _v); }
+	void swap_x_m1() { _swap(_x, _m1); }
+	void swap_x_m2() { _swap(_x, _m2); }
+
+	void copy_x_u() { _copy(_u, _x); }
+	void copy_x_v() { _copy(_v, _x); }
+	void copy_x_m1() { _copy(_m1, _x); }
+	void copy_x_m2() { _copy(_m2, _x); }
+	void copy_u_x() { _copy(_x, _u); }
+	void copy_u_m1() { _copy(_m1, _u); }
+	void copy_u_tu() { _copy(_tu, _u); }
+	void copy_v_x() { _copy(_x, _v); }
+	void copy_v_u() { _copy(_u, _v); }
+	void copy_m1_u() { _copy(_u, _m1); }
+
+	void compare_x_v() { _compare(_x, _v); }
+	void compare_m1_m2() { _compare(_m1, _m2); }
+
+	void saveSnapshot() { _copy(_xs, _x); _copy(_us, _u); _copy(_vs, _v); }
+	void restoreSnapshot() { _copy(_x, _xs); _copy(_u, _us); _copy(_v, _vs); }
+
+	// the commands are serial, x and u are swapped
+	void beginGerbicz() { std::swap(_x, _u); }
+	void endGerbicz() { std::swap(_x, _u); }
+	void waitGerbicz() {}
+};
@@ -9,12 +9,293 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 #include "ocl.h"
 
-class engine : public ocl::device
+#include <map>
+#include <utility>
+
+// The operations of gpmp and plan. The OpenCL engine runs them on a GPU and the native engine on the CPU.
+// The two implementations compute the same values: the residues are identical.
+class engine
 {
 private:
-	size_t _size = 0, _constant_size = 0;
-	cl_mem _x = nullptr, _y = nullptr, _t = nullptr, _cr = nullptr, _u = nullptr, _tu = nullptr, _v = nullptr, _m1 = nullptr, _m2 = nullptr, _err = nullptr;
+	std::string _residentKey;	// the program, the buffers and the NTT roots are kept until the key changes
+
+public:
+	static const size_t PC_SIZE = 8;	// k, n-dependent constants: e, s, d, d_inv, d_shift, digit_bit
+	static const size_t CS_SLOTS = 256;	// the checksums of the last squares, a slot is R, Y mod 2^31 - 1 (two 64-bit accumulators)
+
+public:
+	engine() {}
+	virtual ~engine() {}
+
+public:
+	virtual size_t getMaxWorkGroupSize() const = 0;
+	virtual size_t getLocalMemSize() const = 0;
+	virtual const std::string & getName() const = 0;
+	virtual const std::string & getDriverVersion() const = 0;
+
+	virtual void setProfiling(const bool enable) = 0;
+	virtual void resetProfiles() = 0;
+	virtual cl_ulong getProfileTime() const = 0;
+	virtual void displayProfiles(const size_t count) const = 0;
+
+	// The NTT is computed modulo P1 and P2, or modulo 2^64 - 2^32 + 1 if GOLDILOCKS is defined by the program.
+	// The 64-bit arithmetic is an alternative on the devices with a fast 64-bit multiplier.
+	virtual bool hasFastMul64() const = 0;
+	virtual void setGoldilocks(const bool enable) = 0;
+	// The transform size can be 3.2^m or 5.2^m modulo 2^64 - 2^32 + 1: the first stage is a radix-3 or radix-5 stage.
+	virtual bool hasOddRadix() const = 0;
+	// The digits of the transforms are balanced if BALANCED is defined: digit_bit can be one bit larger.
+	virtual bool hasBalancedDigits() const = 0;
+	virtual void setBalancedDigits(const bool enable) = 0;
+	// The NTT is computed modulo P1, P2 and P3 if RNS3 is defined by the program: a residue is a cl_uint4 vector and digit_bit
+	// is about ten bits larger. The vectors of digits are still read and written as cl_uint2 vectors.
+	virtual bool hasRNS3() const = 0;
+	virtual void setRNS3(const bool enable) = 0;
+
+	virtual std::string oclDefines() const = 0;
+	virtual void loadProgram(const std::string & programSrc, const bool useCache) = 0;
+	virtual void allocMemory(const size_t size, const size_t constant_size, const size_t batch) = 0;
+	virtual void createKernels(const bool ext512, const bool ext1024) = 0;
+
+protected:
+	// release the program, the kernels and the buffers
+	virtual void _clearContext() = 0;
+
+public:
+	// A program and its buffers depend on the transform size but not on k and n: they can be reused by the next candidate.
+	bool isResident(const std::string & key) const { return !_residentKey.empty() && (_residentKey == key); }
+	void setResident(const std::string & key) { _residentKey = key; }
+
+	void clearResident()
+	{
+		if (_residentKey.empty()) return;
+		_clearContext();
+		_residentKey.clear();
+	}
+
+public:
+	// In batched mode, the vectors of the candidates are laid out back-to-back, the stride is size (bp, ibp: size / 2, pc: PC_SIZE).
+	// readMemory_err returns an error per candidate.
+	virtual void readMemory_x(cl_uint2 * const ptr) = 0;
+	virtual void readMemory_u(cl_uint2 * const ptr) = 0;
+	virtual void writeMemory_x(const cl_uint2 * const ptr) = 0;
+	virtual void writeMemory_u(const cl_uint2 * const ptr) = 0;
+	virtual void readMemory_v(cl_uint2 * const ptr) = 0;
+	virtual void writeMemory_v(const cl_uint2 * const ptr) = 0;
+	virtual void readMemory_m1(cl_uint2 * const ptr) = 0;
+	virtual void readMemory_err(cl_int * const ptr) = 0;
+	virtual void clearMemory_err() = 0;
+	// the checksums are computed for a single candidate: 4 * CS_SLOTS words
+	virtual void readMemory_cs(cl_uint * const ptr) = 0;
+	virtual void clearMemory_cs() = 0;
+
+	virtual void writeMemory_r(const cl_uint4 * const ptr_r1ir1, const cl_uint2 * const ptr_r2, const cl_uint2 * const ptr_ir2) = 0;
+	virtual void writeMemory_cr(const cl_uint4 * const ptr_cr1, const cl_uint4 * const ptr_cir1, const cl_uint4 * const ptr_cr2, const cl_uint4 * const ptr_cir2) = 0;
+	// the roots of the three-prime transform
+	virtual void writeMemory_r(const cl_uint8 * const ptr_r1ir1, const cl_uint4 * const ptr_r2, const cl_uint4 * const ptr_ir2) = 0;
+	virtual void writeMemory_cr(const cl_uint8 * const ptr_cr1, const cl_uint8 * const ptr_cir1, const cl_uint8 * const ptr_cr2, const cl_uint8 * const ptr_cir2) = 0;
+	// the powers of the root of order size if the size is not a power of 2
+	virtual void writeMemory_w(const cl_uint2 * const ptr_w, const cl_uint2 * const ptr_iw) = 0;
+	virtual void writeMemory_bp(const cl_uint * const ptr_bp, const cl_uint * const ptr_ibp) = 0;
+	virtual void writeMemory_pc(const cl_uint * const ptr_pc) = 0;
+
+public:
+	virtual void sub_ntt64_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt256_4(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt256_8(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt256_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt1024_1(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt1024_2(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt1024_4(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void lst_intt64_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt256_4(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt256_8(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt256_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt1024_1(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt1024_2(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt1024_4(const cl_uint m, const cl_uint rindex) = 0;
+	// lst_intt and poly2int0 are fused
+	virtual void lst_intt64_16_p2i(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt256_4_p2i(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt256_8_p2i(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt256_16_p2i(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void lst_intt1024_4_p2i(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void ntt64_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt256_4(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt256_8(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt256_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt1024_1(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt1024_2(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt1024_4(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void intt64_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt256_4(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt256_8(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt256_16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt1024_1(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt1024_2(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt1024_4(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void ntt4(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void intt4(const cl_uint m, const cl_uint rindex) = 0;
+
+	// the forward transform of the multiplicand tu
+	virtual void sub_ntt64_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt256_4_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt256_8_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt256_16_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt1024_1_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt1024_2_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void sub_ntt1024_4_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt64_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt256_4_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt256_8_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt256_16_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt1024_1_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt1024_2_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt1024_4_u(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void ntt4_u(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void square8(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square32(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square64(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square128(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square256(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square512(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square1024(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square2048(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square4096(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void mul2() = 0;
+	virtual void mul4() = 0;
+	// the square kernels, the pointwise product is the multiplication by tu
+	virtual void mul8(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul16(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul32(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul64(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul128(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul256(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul512(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul1024(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul2048(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void mul4096(const cl_uint m, const cl_uint rindex) = 0;
+	// the square kernels, the forward transform of x is stored into tu
+	virtual void square8_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square16_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square32_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square64_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square128_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square256_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square512_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square1024_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square2048_tu(const cl_uint m, const cl_uint rindex) = 0;
+	virtual void square4096_tu(const cl_uint m, const cl_uint rindex) = 0;
+
+	virtual void poly2int_4_16() = 0;
+	virtual void poly2int_4_32() = 0;
+	virtual void poly2int_4_64() = 0;
+	virtual void poly2int_8_16() = 0;
+	virtual void poly2int_8_32() = 0;
+	virtual void poly2int_8_64() = 0;
+	virtual void poly2int_16_8() = 0;
+	virtual void poly2int_16_16() = 0;
+	virtual void poly2int_16_32() = 0;
+	// poly2int and reduce_i are fused
+	virtual void poly2int_red_4_16() = 0;
+	virtual void poly2int_red_4_32() = 0;
+	virtual void poly2int_red_4_64() = 0;
+	virtual void poly2int_red_8_16() = 0;
+	virtual void poly2int_red_8_32() = 0;
+	virtual void poly2int_red_8_64() = 0;
+	virtual void poly2int_red_16_8() = 0;
+	virtual void poly2int_red_16_16() = 0;
+	virtual void poly2int_red_16_32() = 0;
+	// single-pass carry propagation
+	virtual void poly2int_lb_4_16() = 0;
+	virtual void poly2int_lb_4_32() = 0;
+	virtual void poly2int_lb_4_64() = 0;
+	virtual void poly2int_lb_8_16() = 0;
+	virtual void poly2int_lb_8_32() = 0;
+	virtual void poly2int_lb_8_64() = 0;
+	virtual void poly2int_lb_16_8() = 0;
+	virtual void poly2int_lb_16_16() = 0;
+	virtual void poly2int_lb_16_32() = 0;
+	// the carries of the blocks of 4 digits computed by lst_intt*_p2i are propagated
+	virtual void poly2int_lst() = 0;
+	virtual void poly2int_red_lst() = 0;
+
+	virtual void reduce_upsweep64(const cl_uint s, const cl_uint j) = 0;
+	virtual void reduce_downsweep64(const cl_uint s, const cl_uint j) = 0;
+	virtual void reduce_topsweep32(const cl_uint j) = 0;
+	virtual void reduce_topsweep64(const cl_uint j) = 0;
+	virtual void reduce_topsweep128(const cl_uint j) = 0;
+	virtual void reduce_topsweep256(const cl_uint j) = 0;
+	virtual void reduce_topsweep512(const cl_uint j) = 0;
+	virtual void reduce_topsweep1024(const cl_uint j) = 0;
+	// the top of the tree if the transform size is 3.2^m or 5.2^m: 4.s remainders, s <= 256
+	virtual void reduce_topsweep_r(const cl_uint s, const cl_uint j) = 0;
+	// single-pass scan, the alternative to the sweep kernels
+	virtual void reduce_scan_64() = 0;
+	virtual void reduce_scan_128() = 0;
+	virtual void reduce_i() = 0;
+	virtual void reduce_o() = 0;
+	virtual void reduce_f() = 0;
+	virtual void reduce_of() = 0;
+	virtual void reduce_x() = 0;
+	virtual void reduce_z_m1() = 0;
+
+	virtual void set_positive() = 0;
+	virtual void set_positive_tu() = 0;
+	virtual void add1_m1(const cl_uint a) = 0;
+
+	virtual void swap_x_u() = 0;
+	virtual void swap_x_v() = 0;
+	virtual void swap_x_m1() = 0;
+	virtual void swap_x_m2() = 0;
+
+	virtual void copy_x_u() = 0;
+	virtual void copy_x_v() = 0;
+	virtual void copy_x_m1() = 0;
+	virtual void copy_x_m2() = 0;
+	virtual void copy_u_x() = 0;
+	virtual void copy_u_m1() = 0;
+	virtual void copy_u_tu() = 0;
+	virtual void copy_v_x() = 0;
+	virtual void copy_v_u() = 0;
+	virtual void copy_m1_u() = 0;
+
+	virtual void compare_x_v() = 0;
+	virtual void compare_m1_m2() = 0;
+
+	// The checksums of the output of split() are accumulated by reduce_o, reduce_f and reduce_of in the slot, no checksum if slot < 0.
+	virtual void setChecksumSlot(const cl_int slot) = 0;
+
+	// x, u and v are copied to the snapshot registers on the device, the last known-good state is restored after an error.
+	virtual void saveSnapshot() = 0;
+	virtual void restoreSnapshot() = 0;
+
+	// Between beginGerbicz and endGerbicz, x is u and the commands are computed on the second queue with their own error and
+	// scratch buffers. They overlap the next squares, waitGerbicz must be called before u or tu is accessed.
+	virtual void beginGerbicz() = 0;
+	virtual void endGerbicz() = 0;
+	virtual void waitGerbicz() = 0;
+};
+
+class oclEngine : public engine, public ocl::device
+{
+private:
+	size_t _size = 0, _constant_size = 0, _batch = 1, _radix = 1;	// size = radix * 2^m
+	bool _balanced = false, _rns3 = false;
+	cl_mem _x = nullptr, _y = nullptr, _t = nullptr, _cr = nullptr, _lb = nullptr, _ls = nullptr, _u = nullptr, _tu = nullptr, _v = nullptr, _m1 = nullptr, _m2 = nullptr, _err = nullptr;
 	cl_mem _r1ir1 = nullptr, _r2 = nullptr, _ir2 = nullptr, _cr1 = nullptr, _cir1 = nullptr, _cr2 = nullptr, _cir2 = nullptr, _bp = nullptr, _ibp = nullptr;
+	cl_mem _pc = nullptr, _w = nullptr, _iw = nullptr;
+	cl_mem _xs = nullptr, _us = nullptr, _vs = nullptr, _cs = nullptr;
+	cl_int _csSlot = -1;
+	cl_mem _yg = nullptr, _tg = nullptr, _crg = nullptr, _lbg = nullptr, _lsg = nullptr, _errg = nullptr;	// the scratch buffers of the Gerbicz step
+	std::map<std::pair<cl_kernel, cl_uint>, const cl_mem *> _bufferArgs;	// the arguments bound to the swapped buffers
 	cl_kernel _sub_ntt64_16 = nullptr, _lst_intt64_16 = nullptr, _ntt64_16 = nullptr, _intt64_16 = nullptr;
 	cl_kernel _sub_ntt256_4 = nullptr, _lst_intt256_4 = nullptr, _ntt256_4 = nullptr, _intt256_4 = nullptr;
 	cl_kernel _sub_ntt256_8 = nullptr, _lst_intt256_8 = nullptr, _ntt256_8 = nullptr, _intt256_8 = nullptr;
@@ -22,24 +303,61 @@ private:
 	cl_kernel _sub_ntt1024_1 = nullptr, _lst_intt1024_1 = nullptr, _ntt1024_1 = nullptr, _intt1024_1 = nullptr;
 	cl_kernel _sub_ntt1024_2 = nullptr, _lst_intt1024_2 = nullptr, _ntt1024_2 = nullptr, _intt1024_2 = nullptr;
 	cl_kernel _sub_ntt1024_4 = nullptr, _lst_intt1024_4 = nullptr, _ntt1024_4 = nullptr, _intt1024_4 = nullptr;
+	cl_kernel _lst_intt64_16_p2i = nullptr, _lst_intt256_4_p2i = nullptr, _lst_intt256_8_p2i = nullptr;
+	cl_kernel _lst_intt256_16_p2i = nullptr, _lst_intt1024_4_p2i = nullptr;
 	cl_kernel _square8 = nullptr, _square16 = nullptr, _square32 = nullptr, _square64 = nullptr, _square128 = nullptr, _square256 = nullptr;
 	cl_kernel _square512 = nullptr, _square1024 = nullptr, _square2048 = nullptr, _square4096 = nullptr;
+	cl_kernel _mul8 = nullptr, _mul16 = nullptr, _mul32 = nullptr, _mul64 = nullptr, _mul128 = nullptr, _mul256 = nullptr;
+	cl_kernel _mul512 = nullptr, _mul1024 = nullptr, _mul2048 = nullptr, _mul4096 = nullptr;
+	cl_kernel _square8_tu = nullptr, _square16_tu = nullptr, _square32_tu = nullptr, _square64_tu = nullptr, _square128_tu = nullptr;
+	cl_kernel _square256_tu = nullptr, _square512_tu = nullptr, _square1024_tu = nullptr, _square2048_tu = nullptr, _square4096_tu = nullptr;
 	cl_kernel _poly2int0_4_16 = nullptr, _poly2int0_4_32 = nullptr, _poly2int0_4_64 = nullptr, _poly2int1_4 = nullptr;
 	cl_kernel _poly2int0_8_16 = nullptr, _poly2int0_8_32 = nullptr, _poly2int0_8_64 = nullptr, _poly2int1_8 = nullptr;
 	cl_kernel _poly2int0_16_8 = nullptr, _poly2int0_16_16 = nullptr, _poly2int0_16_32 = nullptr, _poly2int1_16 = nullptr;
-	cl_kernel _poly2int2  = nullptr;
+	cl_kernel _poly2int_lb_4_16 = nullptr, _poly2int_lb_4_32 = nullptr, _poly2int_lb_4_64 = nullptr;
+	cl_kernel _poly2int_lb_8_16 = nullptr, _poly2int_lb_8_32 = nullptr, _poly2int_lb_8_64 = nullptr;
+	cl_kernel _poly2int_lb_16_8 = nullptr, _poly2int_lb_16_16 = nullptr, _poly2int_lb_16_32 = nullptr;
 	cl_kernel _reduce_upsweep64 = nullptr, _reduce_downsweep64 = nullptr;
 	cl_kernel _reduce_topsweep32 = nullptr, _reduce_topsweep64 = nullptr, _reduce_topsweep128 = nullptr;
 	cl_kernel _reduce_topsweep256 = nullptr, _reduce_topsweep512 = nullptr, _reduce_topsweep1024 = nullptr;
+	cl_kernel _reduce_topsweep_r = nullptr, _reduce_scan_64 = nullptr, _reduce_scan_128 = nullptr;
 	cl_kernel _reduce_i = nullptr, _reduce_o = nullptr, _reduce_f = nullptr, _reduce_x = nullptr, _reduce_z = nullptr;
+	cl_kernel _reduce_i_4 = nullptr, _reduce_i_8 = nullptr, _reduce_i_16 = nullptr, _reduce_of = nullptr;
 	cl_kernel _ntt4 = nullptr, _intt4 = nullptr, _mul2 = nullptr, _mul4 = nullptr;
-	cl_kernel _set_positive = nullptr, _add1 = nullptr, _swap = nullptr, _copy = nullptr, _compare = nullptr;
+	cl_kernel _set_positive = nullptr, _add1 = nullptr, _swap = nullptr, _copy = nullptr, _compare = nullptr, _balance = nullptr;
+	cl_kernel _radix_sub = nullptr, _radix_lst = nullptr;
 
-	static const size_t BLK8 = 32, BLK16 = 16, BLK32 = 8, BLK64 = 4, BLK128 = 2, BLK256 = 1, RED_BLK = 4;
+	static const size_t BLK8 = 32, BLK16 = 16, BLK32 = 8, BLK64 = 4, BLK128 = 2, BLK256 = 1, RED_BLK = 4, CS_BLK = 64;
 
 public:
-	engine(const ocl::platform & platform, const size_t d) : ocl::device(platform, d) {}
-	virtual ~engine() {}
+	oclEngine(const ocl::platform & platform, const size_t d) : ocl::device(platform, d) {}
+	virtual ~oclEngine() { clearResident(); }
+
+public:
+	size_t getMaxWorkGroupSize() const { return ocl::device::getMaxWorkGroupSize(); }
+	size_t getLocalMemSize() const { return ocl::device::getLocalMemSize(); }
+	const std::string & getName() const { return ocl::device::getName(); }
+	const std::string & getDriverVersion() const { return ocl::device::getDriverVersion(); }
+
+	void setProfiling(const bool enable) { ocl::device::setProfiling(enable); }
+	void resetProfiles() { ocl::device::resetProfiles(); }
+	cl_ulong getProfileTime() const { return ocl::device::getProfileTime(); }
+	void displayProfiles(const size_t count) const { ocl::device::displayProfiles(count); }
+
+	// GPUs emulate 64-bit integer products with several 32-bit instructions
+	bool hasFastMul64() const { return ocl::device::isCPU(); }
+	// the arithmetic is selected by the defines of the program
+	void setGoldilocks(const bool) {}
+	// the radix-3 and radix-5 stages are computed modulo 2^64 - 2^32 + 1 (see radix_sub)
+	bool hasOddRadix() const { return hasFastMul64(); }
+	// the digits are balanced by the kernel balance, before the first stage of the forward transform
+	bool hasBalancedDigits() const { return true; }
+	void setBalancedDigits(const bool enable) { _balanced = enable; }
+	// the element size of the buffers depends on the arithmetic, it must be set before allocMemory
+	bool hasRNS3() const { return true; }
+	void setRNS3(const bool enable) { _rns3 = enable; }
+
+	void loadProgram(const std::string & programSrc, const bool useCache) { ocl::device::loadProgram(programSrc, useCache); }
 
 public:
 	std::string oclDefines() const
@@ -52,42 +370,74 @@ public:
 		ss << "#define\tBLK128\t" << BLK128 << std::endl;
 		ss << "#define\tBLK256\t" << BLK256 << std::endl;
 		ss << "#define\tRED_BLK\t" << RED_BLK << std::endl;
+		ss << "#define\tCS_BLK\t" << CS_BLK << std::endl;
 		return ss.str();
 	}
 
 public:
-	void allocMemory(const size_t size, const size_t constant_size)
+	// The B candidates of a batch have their own vectors, the NTT roots are shared.
+	void allocMemory(const size_t size, const size_t constant_size, const size_t batch)
 	{
 #if defined (ocl_debug)
 		std::ostringstream ss; ss << "Alloc gpu memory." << std::endl;
 		pio::display(ss.str());
 #endif
 		_size = size;
-		_x = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint2) * size);				// main buffer, square & mul multiplier, NTT => size
-		_y = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * (size / 2));		// reduce
-		_t = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * 2 * (size / 2));	// reduce: division algorithm
-		_cr = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_long) * size / 4);			// carry
-		_u = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint2) * size);				// mul multiplicand, NTT => size. d(t) in Gerbicz error checking
-		_tu = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint2) * size);			// NTT of mul multiplicand
-		_v = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint2) * size / 2);			// u(0) in Gerbicz error checking
-		_m1 = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint2) * (size / 2));		// memory register #1
-		_m2 = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint2) * (size / 2));		// memory register #2
-		_err = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_int) * 2);				// error checking
-
-		_r1ir1 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint4) * size);			// NTT roots
-		_r2 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint2) * size);				// NTT roots (square)
-		_ir2 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint2) * size);			// NTT roots (inverse square)
-		_bp = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint) * size / 2);			// b^i mod k (division algorithm)
-		_ibp = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint) * size / 2);			// (1/b)^(i+1) mod k (division algorithm)
+		for (_radix = size; _radix % 2 == 0; _radix /= 2);
+		_batch = batch;
+		const size_t bsize = batch * size, hsize = (batch - 1) * size + size / 2;	// the stride of v, m1 and m2 is size
+		const size_t es = _elementSize();
+		_x = _createBuffer(CL_MEM_READ_WRITE, es * bsize);			// main buffer, square & mul multiplier, NTT => size
+		_y = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * (bsize / 2));		// reduce
+		_t = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * 2 * (bsize / 2));	// reduce: division algorithm
+		_cr = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_long) * bsize / 4);		// carry
+		_lb = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * batch * (2 + size / 64));	// carry: look-back counters and flags
+		std::vector<cl_uint> lb(batch * (2 + size / 64), 0);
+		_writeBuffer(_lb, lb.data(), sizeof(cl_uint) * lb.size());
+		_ls = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * batch * (4 + size / 512));	// reduce: look-back scan status
+		std::vector<cl_uint> ls(batch * (4 + size / 512), 0);
+		_writeBuffer(_ls, ls.data(), sizeof(cl_uint) * ls.size());
+		_yg = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * (bsize / 2));		// Gerbicz step: y, t, cr, lb, ls and err
+		_tg = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * 2 * (bsize / 2));
+		_crg = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_long) * bsize / 4);
+		_lbg = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * lb.size());
+		_writeBuffer(_lbg, lb.data(), sizeof(cl_uint) * lb.size());
+		_lsg = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * ls.size());
+		_writeBuffer(_lsg, ls.data(), sizeof(cl_uint) * ls.size());
+		_errg = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_int) * 2 * batch);
+		_u = _createBuffer(CL_MEM_READ_WRITE, es * bsize);			// mul multiplicand, NTT => size. d(t) in Gerbicz error checking
+		_tu = _createBuffer(CL_MEM_READ_WRITE, es * bsize);			// NTT of mul multiplicand
+		_v = _createBuffer(CL_MEM_READ_WRITE, es * hsize);			// u(0) in Gerbicz error checking
+		_m1 = _createBuffer(CL_MEM_READ_WRITE, es * hsize);			// memory register #1
+		_m2 = _createBuffer(CL_MEM_READ_WRITE, es * hsize);			// memory register #2
+		_xs = _createBuffer(CL_MEM_READ_WRITE, es * hsize);			// snapshot of x
+		_us = _createBuffer(CL_MEM_READ_WRITE, es * hsize);			// snapshot of u
+		_vs = _createBuffer(CL_MEM_READ_WRITE, es * hsize);			// snapshot of v
+		_err = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_int) * 2 * batch);		// error checking
+		_cs = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint) * 4 * CS_SLOTS);		// checksums of the squares
+		clearMemory_cs();
+
+		_r1ir1 = _createBuffer(CL_MEM_READ_ONLY, 2 * es * size);					// NTT roots
+		_r2 = _createBuffer(CL_MEM_READ_ONLY, es * size);							// NTT roots (square)
+		_ir2 = _createBuffer(CL_MEM_READ_ONLY, es * size);							// NTT roots (inverse square)
+		_bp = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint) * bsize / 2);			// b^i mod k (division algorithm)
+		_ibp = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint) * bsize / 2);		// (1/b)^(i+1) mod k (division algorithm)
+		_pc = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint) * PC_SIZE * batch);	// k, n-dependent constants
+		if (_radix != 1)
+		{
+			_w = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint2) * size);			// powers of the root of order size
+			_iw = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint2) * size);			// powers of the inverse root of order size
+		}
 
 		_constant_size = constant_size;
 
-		_cr1 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint4) * constant_size);	// small NTT roots: squaring
-		_cir1 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint4) * constant_size);	// small NTT roots (inverse): squaring
-		_cr2 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint4) * constant_size);	// small NTT roots (square) squaring
-		_cir2 = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint4) * constant_size);	// small NTT roots (inverse of square): squaring
+		_cr1 = _createBuffer(CL_MEM_READ_ONLY, 2 * es * constant_size);	// small NTT roots: squaring
+		_cir1 = _createBuffer(CL_MEM_READ_ONLY, 2 * es * constant_size);	// small NTT roots (inverse): squaring
+		_cr2 = _createBuffer(CL_MEM_READ_ONLY, 2 * es * constant_size);	// small NTT roots (square) squaring
+		_cir2 = _createBuffer(CL_MEM_READ_ONLY, 2 * es * constant_size);	// small NTT roots (inverse of square): squaring
 
-		// allocated size ~ (1 * 4 + 5 * 2 + 4 * 1 + 3 * 1/2) * sizeof(cl_uint) * size = 78 * size bytes
+		// allocated size ~ (1 * 4 + 5 * 2 + 7 * 1 + 3 * 1/2 + 5/2) * sizeof(cl_uint) * size = 100 * size bytes per candidate,
+		// about twice as many if RNS3
 	}
 
 public:
@@ -99,10 +449,16 @@ public:
 #endif
 		if (_size != 0)
 		{
-			_releaseBuffer(_x); _releaseBuffer(_y); _releaseBuffer(_t); _releaseBuffer(_cr); _releaseBuffer(_u); _releaseBuffer(_tu);
+			_releaseBuffer(_x); _releaseBuffer(_y); _releaseBuffer(_t); _releaseBuffer(_cr); _releaseBuffer(_lb); _releaseBuffer(_ls); _releaseBuffer(_u); _releaseBuffer(_tu);
 			_releaseBuffer(_v); _releaseBuffer(_m1); _releaseBuffer(_m2); _releaseBuffer(_err);
+			_releaseBuffer(_xs); _releaseBuffer(_us); _releaseBuffer(_vs); _releaseBuffer(_cs);
 			_releaseBuffer(_r1ir1); _releaseBuffer(_r2); _releaseBuffer(_ir2); _releaseBuffer(_bp); _releaseBuffer(_ibp);
+			_releaseBuffer(_pc);
+			if (_radix != 1) { _releaseBuffer(_w); _releaseBuffer(_iw); }
+			_releaseBuffer(_yg); _releaseBuffer(_tg); _releaseBuffer(_crg); _releaseBuffer(_lbg); _releaseBuffer(_lsg); _releaseBuffer(_errg);
 			_size = 0;
+			_radix = 1;
+			_batch = 1;
 		}
 
 		if (_constant_size != 0)
@@ -112,6 +468,24 @@ public:
 		}
 	}
 
+private:
+	// the arguments bound to x, u, to the scratch buffers and to err are recorded, they are set again if the buffers are swapped
+	void _setKernelArg(cl_kernel kernel, const cl_uint arg_index, const size_t arg_size, const void * const arg_value)
+	{
+		const cl_mem * const mem = static_cast<const cl_mem *>(arg_value);
+		if ((mem == &_x) || (mem == &_u) || (mem == &_y) || (mem == &_t) || (mem == &_cr) || (mem == &_lb) || (mem == &_ls) || (mem == &_err))
+		{
+			_bufferArgs[std::make_pair(kernel, arg_index)] = mem;
+		}
+		ocl::device::_setKernelArg(kernel, arg_index, arg_size, arg_value);
+	}
+
+	void _swapGerbicz()
+	{
+		std::swap(_x, _u); std::swap(_y, _yg); std::swap(_t, _tg); std::swap(_cr, _crg); std::swap(_lb, _lbg); std::swap(_ls, _lsg); std::swap(_err, _errg);
+		for (const auto & it : _bufferArgs) ocl::device::_setKernelArg(it.first.first, it.first.second, sizeof(cl_mem), it.second);
+	}
+
 private:
 	inline cl_kernel _createNttKernel(const char * const kernelName, const bool forward)
 	{
@@ -122,6 +496,22 @@ private:
 		return kernel;
 	}
 
+private:
+	inline cl_kernel _createSubKernel(const char * const kernelName)
+	{
+		cl_kernel kernel = _createNttKernel(kernelName, true);
+		_setKernelArg(kernel, 3, sizeof(cl_mem), &_cr);	// the balanced digits
+		return kernel;
+	}
+
+private:
+	inline cl_kernel _createLstP2iKernel(const char * const kernelName)
+	{
+		cl_kernel kernel = _createNttKernel(kernelName, false);
+		_setKernelArg(kernel, 3, sizeof(cl_mem), &_cr);
+		return kernel;
+	}
+
 private:
 	inline cl_kernel _createSquareKernel(const char * const kernelName)
 	{
@@ -134,6 +524,14 @@ private:
 		return kernel;
 	}
 
+private:
+	inline cl_kernel _createMulKernel(const char * const kernelName)
+	{
+		cl_kernel kernel = _createSquareKernel(kernelName);
+		_setKernelArg(kernel, 5, sizeof(cl_mem), &_tu);
+		return kernel;
+	}
+
 private:
 	inline cl_kernel _createPoly2int0Kernel(const char * const kernelName)
 	{
@@ -149,7 +547,34 @@ private:
 		cl_kernel kernel = _createKernel(kernelName);
 		_setKernelArg(kernel, 0, sizeof(cl_mem), &_x);
 		_setKernelArg(kernel, 1, sizeof(cl_mem), &_cr);
-		_setKernelArg(kernel, 2, sizeof(cl_mem), &_err);
+		_setKernelArg(kernel, 2, sizeof(cl_mem), &_lb);
+		_setKernelArg(kernel, 3, sizeof(cl_mem), &_err);
+		return kernel;
+	}
+
+private:
+	inline cl_kernel _createReduceIKernel(const char * const kernelName)
+	{
+		cl_kernel kernel = _createKernel(kernelName);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_x);
+		_setKernelArg(kernel, 1, sizeof(cl_mem), &_cr);
+		_setKernelArg(kernel, 2, sizeof(cl_mem), &_lb);
+		_setKernelArg(kernel, 3, sizeof(cl_mem), &_err);
+		_setKernelArg(kernel, 4, sizeof(cl_mem), &_y);
+		_setKernelArg(kernel, 5, sizeof(cl_mem), &_t);
+		_setKernelArg(kernel, 6, sizeof(cl_mem), &_bp);
+		_setKernelArg(kernel, 7, sizeof(cl_mem), &_pc);
+		return kernel;
+	}
+
+private:
+	inline cl_kernel _createPoly2intLbKernel(const char * const kernelName)
+	{
+		cl_kernel kernel = _createKernel(kernelName);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_x);
+		_setKernelArg(kernel, 1, sizeof(cl_mem), &_cr);
+		_setKernelArg(kernel, 2, sizeof(cl_mem), &_lb);
+		_setKernelArg(kernel, 3, sizeof(cl_mem), &_err);
 		return kernel;
 	}
 
@@ -158,6 +583,17 @@ private:
 	{
 		cl_kernel kernel = _createKernel(kernelName);
 		_setKernelArg(kernel, 0, sizeof(cl_mem), &_t);
+		_setKernelArg(kernel, 1, sizeof(cl_mem), &_pc);
+		return kernel;
+	}
+
+private:
+	inline cl_kernel _createScanKernel(const char * const kernelName)
+	{
+		cl_kernel kernel = _createKernel(kernelName);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_t);
+		_setKernelArg(kernel, 1, sizeof(cl_mem), &_ls);
+		_setKernelArg(kernel, 2, sizeof(cl_mem), &_pc);
 		return kernel;
 	}
 
@@ -169,6 +605,7 @@ private:
 		_setKernelArg(kernel, 1, sizeof(cl_mem), &_y);
 		_setKernelArg(kernel, 2, sizeof(cl_mem), &_t);
 		_setKernelArg(kernel, 3, sizeof(cl_mem), forward ? &_bp : &_ibp);
+		_setKernelArg(kernel, 4, sizeof(cl_mem), &_pc);
 		return kernel;
 	}
 
@@ -179,9 +616,9 @@ public:
 		std::ostringstream ss; ss << "Create ocl kernels." << std::endl;
 		pio::display(ss.str());
 #endif
-		_sub_ntt64_16 = _createNttKernel("sub_ntt64_16", true);
-		_sub_ntt256_4 = _createNttKernel("sub_ntt256_4", true);
-		_sub_ntt1024_1 = _createNttKernel("sub_ntt1024_1", true);
+		_sub_ntt64_16 = _createSubKernel("sub_ntt64_16");
+		_sub_ntt256_4 = _createSubKernel("sub_ntt256_4");
+		_sub_ntt1024_1 = _createSubKernel("sub_ntt1024_1");
 		_lst_intt64_16 = _createNttKernel("lst_intt64_16", false);
 		_lst_intt256_4 = _createNttKernel("lst_intt256_4", false);
 		_lst_intt1024_1 = _createNttKernel("lst_intt1024_1", false);
@@ -191,29 +628,34 @@ public:
 		_intt64_16 = _createNttKernel("intt64_16", false);
 		_intt256_4 = _createNttKernel("intt256_4", false);
 		_intt1024_1 = _createNttKernel("intt1024_1", false);
+		_lst_intt64_16_p2i = _createLstP2iKernel("lst_intt64_16_p2i");
+		_lst_intt256_4_p2i = _createLstP2iKernel("lst_intt256_4_p2i");
 
 		if (ext512)
 		{
-			_sub_ntt256_8 = _createNttKernel("sub_ntt256_8", true);
-			_sub_ntt1024_2 = _createNttKernel("sub_ntt1024_2", true);
+			_sub_ntt256_8 = _createSubKernel("sub_ntt256_8");
+			_sub_ntt1024_2 = _createSubKernel("sub_ntt1024_2");
 			_lst_intt256_8 = _createNttKernel("lst_intt256_8", false);
 			_lst_intt1024_2 = _createNttKernel("lst_intt1024_2", false);
 			_ntt256_8 = _createNttKernel("ntt256_8", true);
 			_ntt1024_2 = _createNttKernel("ntt1024_2", true);
 			_intt256_8 = _createNttKernel("intt256_8", false);
 			_intt1024_2 = _createNttKernel("intt1024_2", false);
+			_lst_intt256_8_p2i = _createLstP2iKernel("lst_intt256_8_p2i");
 		}
 
 		if (ext1024)
 		{
-			_sub_ntt256_16 = _createNttKernel("sub_ntt256_16", true);
-			_sub_ntt1024_4 = _createNttKernel("sub_ntt1024_4", true);
+			_sub_ntt256_16 = _createSubKernel("sub_ntt256_16");
+			_sub_ntt1024_4 = _createSubKernel("sub_ntt1024_4");
 			_lst_intt256_16 = _createNttKernel("lst_intt256_16", false);
 			_lst_intt1024_4 = _createNttKernel("lst_intt1024_4", false);
 			_ntt256_16 = _createNttKernel("ntt256_16", true);
 			_ntt1024_4 = _createNttKernel("ntt1024_4", true);
 			_intt256_16 = _createNttKernel("intt256_16", false);
 			_intt1024_4 = _createNttKernel("intt1024_4", false);
+			_lst_intt256_16_p2i = _createLstP2iKernel("lst_intt256_16_p2i");
+			_lst_intt1024_4_p2i = _createLstP2iKernel("lst_intt1024_4_p2i");
 		}
 
 		_square8 = _createSquareKernel("square8");
@@ -227,6 +669,28 @@ public:
 		if (ext512) _square2048 = _createSquareKernel("square2048");
 		if (ext1024) _square4096 = _createSquareKernel("square4096");
 
+		_mul8 = _createMulKernel("mul8");
+		_mul16 = _createMulKernel("mul16");
+		_mul32 = _createMulKernel("mul32");
+		_mul64 = _createMulKernel("mul64");
+		_mul128 = _createMulKernel("mul128");
+		_mul256 = _createMulKernel("mul256");
+		_mul512 = _createMulKernel("mul512");
+		_mul1024 = _createMulKernel("mul1024");
+		if (ext512) _mul2048 = _createMulKernel("mul2048");
+		if (ext1024) _mul4096 = _createMulKernel("mul4096");
+
+		_square8_tu = _createMulKernel("square8_tu");
+		_square16_tu = _createMulKernel("square16_tu");
+		_square32_tu = _createMulKernel("square32_tu");
+		_square64_tu = _createMulKernel("square64_tu");
+		_square128_tu = _createMulKernel("square128_tu");
+		_square256_tu = _createMulKernel("square256_tu");
+		_square512_tu = _createMulKernel("square512_tu");
+		_square1024_tu = _createMulKernel("square1024_tu");
+		if (ext512) _square2048_tu = _createMulKernel("square2048_tu");
+		if (ext1024) _square4096_tu = _createMulKernel("square4096_tu");
+
 		_poly2int0_4_16 = _createPoly2int0Kernel("poly2int0_4_16");
 		_poly2int0_4_32 = _createPoly2int0Kernel("poly2int0_4_32");
 		_poly2int0_4_64 = _createPoly2int0Kernel("poly2int0_4_64");
@@ -242,9 +706,16 @@ public:
 		_poly2int0_16_32 = _createPoly2int0Kernel("poly2int0_16_32");
 		_poly2int1_16 = _createPoly2int1Kernel("poly2int1_16");
 
-		_poly2int2 = _createKernel("poly2int2");
-		_setKernelArg(_poly2int2, 0, sizeof(cl_mem), &_x);
-		_setKernelArg(_poly2int2, 1, sizeof(cl_mem), &_err);
+		_poly2int_lb_4_16 = _createPoly2intLbKernel("poly2int_lb_4_16");
+		_poly2int_lb_4_32 = _createPoly2intLbKernel("poly2int_lb_4_32");
+		_poly2int_lb_4_64 = _createPoly2intLbKernel("poly2int_lb_4_64");
+		_poly2int_lb_8_16 = _createPoly2intLbKernel("poly2int_lb_8_16");
+		_poly2int_lb_8_32 = _createPoly2intLbKernel("poly2int_lb_8_32");
+		_poly2int_lb_8_64 = _createPoly2intLbKernel("poly2int_lb_8_64");
+		_poly2int_lb_16_8 = _createPoly2intLbKernel("poly2int_lb_16_8");
+		_poly2int_lb_16_16 = _createPoly2intLbKernel("poly2int_lb_16_16");
+		_poly2int_lb_16_32 = _createPoly2intLbKernel("poly2int_lb_16_32");
+
 
 		_reduce_upsweep64 = _createSweepKernel("reduce_upsweep64");
 		_reduce_downsweep64 = _createSweepKernel("reduce_downsweep64");
@@ -257,11 +728,31 @@ public:
 		_reduce_topsweep1024 = _createSweepKernel("reduce_topsweep1024");
 
 		_reduce_i = _createReduceKernel("reduce_i", true);
+		_csSlot = -1;
+
 		_reduce_o = _createReduceKernel("reduce_o", false);
+		_setKernelArg(_reduce_o, 5, sizeof(cl_mem), &_cs);
+		_setKernelArg(_reduce_o, 6, sizeof(cl_int), &_csSlot);
 
 		_reduce_f = _createKernel("reduce_f");
 		_setKernelArg(_reduce_f, 0, sizeof(cl_mem), &_x);
 		_setKernelArg(_reduce_f, 1, sizeof(cl_mem), &_t);
+		_setKernelArg(_reduce_f, 2, sizeof(cl_mem), &_pc);
+		_setKernelArg(_reduce_f, 3, sizeof(cl_mem), &_cs);
+		_setKernelArg(_reduce_f, 4, sizeof(cl_int), &_csSlot);
+
+		_reduce_i_4 = _createReduceIKernel("reduce_i_4");
+		_reduce_i_8 = _createReduceIKernel("reduce_i_8");
+		_reduce_i_16 = _createReduceIKernel("reduce_i_16");
+
+
+		_reduce_of = _createReduceKernel("reduce_of", false);
+		_setKernelArg(_reduce_of, 5, sizeof(cl_mem), &_cs);
+		_setKernelArg(_reduce_of, 6, sizeof(cl_int), &_csSlot);
+
+		if (_radix != 1) _reduce_topsweep_r = _createSweepKernel("reduce_topsweep_r");
+		_reduce_scan_64 = _createScanKernel("reduce_scan_64");
+		_reduce_scan_128 = _createScanKernel("reduce_scan_128");
 
 		_reduce_x = _createKernel("reduce_x");
 		_setKernelArg(_reduce_x, 0, sizeof(cl_mem), &_x);
@@ -284,14 +775,36 @@ public:
 
 		_set_positive = _createKernel("set_positive");
 		_setKernelArg(_set_positive, 0, sizeof(cl_mem), &_x);
+		_setKernelArg(_set_positive, 1, sizeof(cl_mem), &_pc);
 
 		_add1 = _createKernel("add1");
 		_setKernelArg(_add1, 0, sizeof(cl_mem), &_m1);
+		_setKernelArg(_add1, 1, sizeof(cl_mem), &_pc);
 
 		_swap = _createKernel("swap");
 		_copy = _createKernel("copy");
 		_compare = _createKernel("compare");
 		_setKernelArg(_compare, 2, sizeof(cl_mem), &_err);
+
+		if (_balanced)
+		{
+			_balance = _createKernel("balance");
+			_setKernelArg(_balance, 0, sizeof(cl_mem), &_x);
+			_setKernelArg(_balance, 1, sizeof(cl_mem), &_cr);
+		}
+
+		if (_radix != 1)
+		{
+			_radix_sub = _createKernel("radix_sub");
+			_setKernelArg(_radix_sub, 0, sizeof(cl_mem), &_x);
+			_setKernelArg(_radix_sub, 1, sizeof(cl_mem), &_w);
+			_setKernelArg(_radix_sub, 2, sizeof(cl_mem), &_cr);	// the balanced digits
+
+			_radix_lst = _createKernel("radix_lst");
+			_setKernelArg(_radix_lst, 0, sizeof(cl_mem), &_x);
+			_setKernelArg(_radix_lst, 1, sizeof(cl_mem), &_w);
+			_setKernelArg(_radix_lst, 2, sizeof(cl_mem), &_iw);
+		}
 	}
 
 public:
@@ -308,14 +821,22 @@ public:
 		_releaseKernel(_sub_ntt1024_1); _releaseKernel(_lst_intt1024_1); _releaseKernel(_ntt1024_1); _releaseKernel(_intt1024_1);
 		_releaseKernel(_sub_ntt1024_2); _releaseKernel(_lst_intt1024_2); _releaseKernel(_ntt1024_2); _releaseKernel(_intt1024_2);
 		_releaseKernel(_sub_ntt1024_4); _releaseKernel(_lst_intt1024_4); _releaseKernel(_ntt1024_4); _releaseKernel(_intt1024_4);
+		_releaseKernel(_lst_intt64_16_p2i); _releaseKernel(_lst_intt256_4_p2i); _releaseKernel(_lst_intt256_8_p2i);
+		_releaseKernel(_lst_intt256_16_p2i); _releaseKernel(_lst_intt1024_4_p2i);
 
 		_releaseKernel(_square8); _releaseKernel(_square16); _releaseKernel(_square32); _releaseKernel(_square64); _releaseKernel(_square128);
 		_releaseKernel(_square256); _releaseKernel(_square512); _releaseKernel(_square1024); _releaseKernel(_square2048); _releaseKernel(_square4096);
+		_releaseKernel(_mul8); _releaseKernel(_mul16); _releaseKernel(_mul32); _releaseKernel(_mul64); _releaseKernel(_mul128);
+		_releaseKernel(_mul256); _releaseKernel(_mul512); _releaseKernel(_mul1024); _releaseKernel(_mul2048); _releaseKernel(_mul4096);
+		_releaseKernel(_square8_tu); _releaseKernel(_square16_tu); _releaseKernel(_square32_tu); _releaseKernel(_square64_tu); _releaseKernel(_square128_tu);
+		_releaseKernel(_square256_tu); _releaseKernel(_square512_tu); _releaseKernel(_square1024_tu); _releaseKernel(_square2048_tu); _releaseKernel(_square4096_tu);
 
 		_releaseKernel(_poly2int0_4_16); _releaseKernel(_poly2int0_4_32); _releaseKernel(_poly2int0_4_64); _releaseKernel(_poly2int1_4);
 		_releaseKernel(_poly2int0_8_16); _releaseKernel(_poly2int0_8_32); _releaseKernel(_poly2int0_8_64); _releaseKernel(_poly2int1_8);
 		_releaseKernel(_poly2int0_16_8); _releaseKernel(_poly2int0_16_16); _releaseKernel(_poly2int0_16_32); _releaseKernel(_poly2int1_16);
-		_releaseKernel(_poly2int2);
+		_releaseKernel(_poly2int_lb_4_16); _releaseKernel(_poly2int_lb_4_32); _releaseKernel(_poly2int_lb_4_64);
+		_releaseKernel(_poly2int_lb_8_16); _releaseKernel(_poly2int_lb_8_32); _releaseKernel(_poly2int_lb_8_64);
+		_releaseKernel(_poly2int_lb_16_8); _releaseKernel(_poly2int_lb_16_16); _releaseKernel(_poly2int_lb_16_32);
 
 		_releaseKernel(_reduce_upsweep64); _releaseKernel(_reduce_downsweep64);
 
@@ -323,28 +844,87 @@ public:
 		_releaseKernel(_reduce_topsweep256); _releaseKernel(_reduce_topsweep512); _releaseKernel(_reduce_topsweep1024);
 
 		_releaseKernel(_reduce_i); _releaseKernel(_reduce_o); _releaseKernel(_reduce_f); _releaseKernel(_reduce_x); _releaseKernel(_reduce_z);
+		_releaseKernel(_reduce_i_4); _releaseKernel(_reduce_i_8); _releaseKernel(_reduce_i_16); _releaseKernel(_reduce_of);
+		_releaseKernel(_reduce_topsweep_r); _releaseKernel(_reduce_scan_64); _releaseKernel(_reduce_scan_128);
 
 		_releaseKernel(_ntt4); _releaseKernel(_intt4); _releaseKernel(_mul2); _releaseKernel(_mul4);
 		_releaseKernel(_set_positive); _releaseKernel(_add1);
 
-		_releaseKernel(_swap); _releaseKernel(_copy); _releaseKernel(_compare);
+		_releaseKernel(_swap); _releaseKernel(_copy); _releaseKernel(_compare); _releaseKernel(_balance);
+		_releaseKernel(_radix_sub); _releaseKernel(_radix_lst);
+		_bufferArgs.clear();
+	}
+
+protected:
+	void _clearContext()
+	{
+		releaseKernels();
+		releaseMemory();
+		clearProgram();
+	}
+
+private:
+	// the launches of a batch have a second dimension: the index of the candidate
+	void _executeKernel(cl_kernel kernel, const size_t globalWorkSize, const size_t localWorkSize = 0)
+	{
+		ocl::device::_executeKernel(kernel, globalWorkSize, localWorkSize, _batch);
+	}
+
+	// half the size of the last candidate is not read
+	size_t _halfSize() const { return (_batch - 1) * _size + _size / 2; }
+
+	// a residue modulo P1, P2 (and P3)
+	size_t _elementSize() const { return _rns3 ? sizeof(cl_uint4) : sizeof(cl_uint2); }
+
+	// If RNS3 then the digits are the components s0 and s1 of the cl_uint4 elements, s2 and s3 are zero
+	void _readDigits(cl_mem & mem, cl_uint2 * const ptr, const size_t count)
+	{
+		if (!_rns3) { _readBuffer(mem, ptr, sizeof(cl_uint2) * count); return; }
+		std::vector<cl_uint4> v(count);
+		_readBuffer(mem, v.data(), sizeof(cl_uint4) * count);
+		for (size_t i = 0; i < count; ++i) { ptr[i].s[0] = v[i].s[0]; ptr[i].s[1] = v[i].s[1]; }
+	}
+
+	void _writeDigits(cl_mem & mem, const cl_uint2 * const ptr, const size_t count)
+	{
+		if (!_rns3) { _writeBuffer(mem, ptr, sizeof(cl_uint2) * count); return; }
+		std::vector<cl_uint4> v(count);
+		for (size_t i = 0; i < count; ++i) { v[i].s[0] = ptr[i].s[0]; v[i].s[1] = ptr[i].s[1]; v[i].s[2] = 0; v[i].s[3] = 0; }
+		_writeBuffer(mem, v.data(), sizeof(cl_uint4) * count);
 	}
 
 public:
 	// read half the size
-	void readMemory_x(cl_uint2 * const ptr) { _readBuffer(_x, ptr, sizeof(cl_uint2) * _size / 2); }
-	void readMemory_u(cl_uint2 * const ptr) { _readBuffer(_u, ptr, sizeof(cl_uint2) * _size / 2); }
+	void readMemory_x(cl_uint2 * const ptr) { _readDigits(_x, ptr, _halfSize()); }
+	void readMemory_u(cl_uint2 * const ptr) { _readDigits(_u, ptr, _halfSize()); }
 	// write full size
-	void writeMemory_x(const cl_uint2 * const ptr) { _writeBuffer(_x, ptr, sizeof(cl_uint2) * _size); }
-	void writeMemory_u(const cl_uint2 * const ptr) { _writeBuffer(_u, ptr, sizeof(cl_uint2) * _size); }
+	void writeMemory_x(const cl_uint2 * const ptr) { _writeDigits(_x, ptr, _batch * _size); }
+	void writeMemory_u(const cl_uint2 * const ptr) { _writeDigits(_u, ptr, _batch * _size); }
+
+	void readMemory_v(cl_uint2 * const ptr) { _readDigits(_v, ptr, _halfSize()); }
+	void writeMemory_v(const cl_uint2 * const ptr) { _writeDigits(_v, ptr, _halfSize()); }
 
-	void readMemory_v(cl_uint2 * const ptr) { _readBuffer(_v, ptr, sizeof(cl_uint2) * _size / 2); }
-	void writeMemory_v(const cl_uint2 * const ptr) { _writeBuffer(_v, ptr, sizeof(cl_uint2) * _size / 2); }
+	void readMemory_m1(cl_uint2 * const ptr) { _readDigits(_m1, ptr, _halfSize()); }
 
-	void readMemory_m1(cl_uint2 * const ptr) { _readBuffer(_m1, ptr, sizeof(cl_uint2) * _size / 2); }
+	// The errors of the Gerbicz step are in errg, the second queue must be completed.
+	void readMemory_err(cl_int * const ptr)
+	{
+		_waitSecondQueue();
+		std::vector<cl_int> err(2 * _batch), errg(2 * _batch);
+		_readBuffer(_err, err.data(), sizeof(cl_int) * 2 * _batch);
+		_readBuffer(_errg, errg.data(), sizeof(cl_int) * 2 * _batch);
+		for (size_t b = 0; b < _batch; ++b) ptr[b] = err[2 * b] | errg[2 * b];
+	}
+	void clearMemory_err()
+	{
+		_waitSecondQueue();
+		std::vector<cl_int> err(2 * _batch, 0);
+		_writeBuffer(_err, err.data(), sizeof(cl_int) * 2 * _batch);
+		_writeBuffer(_errg, err.data(), sizeof(cl_int) * 2 * _batch);
+	}
 
-	void readMemory_err(cl_int * const ptr) { _readBuffer(_err, ptr, sizeof(cl_int)); }
-	void clearMemory_err() { cl_int err[2]; err[0] = err[1] = 0; _writeBuffer(_err, err, sizeof(cl_int) * 2); }
+	void readMemory_cs(cl_uint * const ptr) { _readBuffer(_cs, ptr, sizeof(cl_uint) * 4 * CS_SLOTS); }
+	void clearMemory_cs() { std::vector<cl_uint> cs(4 * CS_SLOTS, 0); _writeBuffer(_cs, cs.data(), sizeof(cl_uint) * 4 * CS_SLOTS); }
 
 public:
 	void writeMemory_r(const cl_uint4 * const ptr_r1ir1, const cl_uint2 * const ptr_r2, const cl_uint2 * const ptr_ir2)
@@ -363,29 +943,74 @@ public:
 		_writeBuffer(_cir2, ptr_cir2, sizeof(cl_uint4) * _constant_size);
 	}
 
+	void writeMemory_r(const cl_uint8 * const ptr_r1ir1, const cl_uint4 * const ptr_r2, const cl_uint4 * const ptr_ir2)
+	{
+		_writeBuffer(_r1ir1, ptr_r1ir1, sizeof(cl_uint8) * _size);
+		_writeBuffer(_r2, ptr_r2, sizeof(cl_uint4) * _size);
+		_writeBuffer(_ir2, ptr_ir2, sizeof(cl_uint4) * _size);
+	}
+
+	void writeMemory_cr(const cl_uint8 * const ptr_cr1, const cl_uint8 * const ptr_cir1, const cl_uint8 * const ptr_cr2, const cl_uint8 * const ptr_cir2)
+	{
+		_writeBuffer(_cr1, ptr_cr1, sizeof(cl_uint8) * _constant_size);
+		_writeBuffer(_cir1, ptr_cir1, sizeof(cl_uint8) * _constant_size);
+		_writeBuffer(_cr2, ptr_cr2, sizeof(cl_uint8) * _constant_size);
+		_writeBuffer(_cir2, ptr_cir2, sizeof(cl_uint8) * _constant_size);
+	}
+
+	void writeMemory_w(const cl_uint2 * const ptr_w, const cl_uint2 * const ptr_iw)
+	{
+		_writeBuffer(_w, ptr_w, sizeof(cl_uint2) * _size);
+		_writeBuffer(_iw, ptr_iw, sizeof(cl_uint2) * _size);
+	}
+
 public:
 	void writeMemory_bp(const cl_uint * const ptr_bp, const cl_uint * const ptr_ibp)
 	{
-		_writeBuffer(_bp, ptr_bp, sizeof(cl_uint) * _size / 2);
-		_writeBuffer(_ibp, ptr_ibp, sizeof(cl_uint) * _size / 2);
+		_writeBuffer(_bp, ptr_bp, sizeof(cl_uint) * _batch * _size / 2);
+		_writeBuffer(_ibp, ptr_ibp, sizeof(cl_uint) * _batch * _size / 2);
 	}
 
 public:
-	void sub_ntt64_16(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt64_16, _size / 4, 64 / 4 * 16); }
-	void sub_ntt256_4(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt256_4, _size / 4, 256 / 4 * 4); }
-	void sub_ntt256_8(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt256_8, _size / 4, 256 / 4 * 8); }
-	void sub_ntt256_16(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt256_16, _size / 4, 256 / 4 * 16); }
-	void sub_ntt1024_1(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt1024_1, _size / 4, 1024 / 4 * 1); }
-	void sub_ntt1024_2(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt1024_2, _size / 4, 1024 / 4 * 2); }
-	void sub_ntt1024_4(const cl_uint, const cl_uint) { _executeKernel(_sub_ntt1024_4, _size / 4, 1024 / 4 * 4); }
+	void writeMemory_pc(const cl_uint * const ptr_pc) { _writeBuffer(_pc, ptr_pc, sizeof(cl_uint) * PC_SIZE * _batch); }
 
-	void lst_intt64_16(const cl_uint, const cl_uint) { _executeKernel(_lst_intt64_16, _size / 4, 64 / 4 * 16); }
-	void lst_intt256_4(const cl_uint, const cl_uint) { _executeKernel(_lst_intt256_4, _size / 4, 256 / 4 * 4); }
-	void lst_intt256_8(const cl_uint, const cl_uint) { _executeKernel(_lst_intt256_8, _size / 4, 256 / 4 * 8); }
-	void lst_intt256_16(const cl_uint, const cl_uint) { _executeKernel(_lst_intt256_16, _size / 4, 256 / 4 * 16); }
-	void lst_intt1024_1(const cl_uint, const cl_uint) { _executeKernel(_lst_intt1024_1, _size / 4, 1024 / 4 * 1); }
-	void lst_intt1024_2(const cl_uint, const cl_uint) { _executeKernel(_lst_intt1024_2, _size / 4, 1024 / 4 * 2); }
-	void lst_intt1024_4(const cl_uint, const cl_uint) { _executeKernel(_lst_intt1024_4, _size / 4, 1024 / 4 * 4); }
+private:
+	// If the digits are balanced then they are computed into cr, the sub_ntt kernels read them.
+	// If the size is radix * L then the first stage is computed by radix_sub and sub_ntt transforms the blocks of size L.
+	inline void _executeSubKernel(cl_kernel kernel, const size_t size)
+	{
+		if (_balanced) _executeKernel(_balance, _size / 2);
+		if (_radix != 1) _executeKernel(_radix_sub, _size / _radix);
+		_executeKernel(kernel, _size / 4, size);
+	}
+
+	inline void _executeLstKernel(cl_kernel kernel, const size_t size)
+	{
+		_executeKernel(kernel, _size / 4, size);
+		if (_radix != 1) _executeKernel(_radix_lst, _size / _radix);
+	}
+
+public:
+	void sub_ntt64_16(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt64_16, 64 / 4 * 16); }
+	void sub_ntt256_4(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt256_4, 256 / 4 * 4); }
+	void sub_ntt256_8(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt256_8, 256 / 4 * 8); }
+	void sub_ntt256_16(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt256_16, 256 / 4 * 16); }
+	void sub_ntt1024_1(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt1024_1, 1024 / 4 * 1); }
+	void sub_ntt1024_2(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt1024_2, 1024 / 4 * 2); }
+	void sub_ntt1024_4(const cl_uint, const cl_uint) { _executeSubKernel(_sub_ntt1024_4, 1024 / 4 * 4); }
+
+	void lst_intt64_16(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt64_16, 64 / 4 * 16); }
+	void lst_intt256_4(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt256_4, 256 / 4 * 4); }
+	void lst_intt256_8(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt256_8, 256 / 4 * 8); }
+	void lst_intt256_16(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt256_16, 256 / 4 * 16); }
+	void lst_intt1024_1(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt1024_1, 1024 / 4 * 1); }
+	void lst_intt1024_2(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt1024_2, 1024 / 4 * 2); }
+	void lst_intt1024_4(const cl_uint, const cl_uint) { _executeLstKernel(_lst_intt1024_4, 1024 / 4 * 4); }
+	void lst_intt64_16_p2i(const cl_uint, const cl_uint) { _executeKernel(_lst_intt64_16_p2i, _size / 4, 64 / 4 * 16); }
+	void lst_intt256_4_p2i(const cl_uint, const cl_uint) { _executeKernel(_lst_intt256_4_p2i, _size / 4, 256 / 4 * 4); }
+	void lst_intt256_8_p2i(const cl_uint, const cl_uint) { _executeKernel(_lst_intt256_8_p2i, _size / 4, 256 / 4 * 8); }
+	void lst_intt256_16_p2i(const cl_uint, const cl_uint) { _executeKernel(_lst_intt256_16_p2i, _size / 4, 256 / 4 * 16); }
+	void lst_intt1024_4_p2i(const cl_uint, const cl_uint) { _executeKernel(_lst_intt1024_4_p2i, _size / 4, 1024 / 4 * 4); }
 
 private:
 	inline void _executeNttKernel(cl_kernel kernel, const cl_uint m, const cl_uint rindex, const size_t size)
@@ -415,30 +1040,57 @@ public:
 	void ntt4(const cl_uint m, const cl_uint rindex) { _executeNttKernel(_ntt4, m, rindex, 0); }
 	void intt4(const cl_uint m, const cl_uint rindex) { _executeNttKernel(_intt4, m, rindex, 0); }
 
-public:
-	void sub_ntt64_u()
+private:
+	// the kernel is executed on tu rather than x
+	inline void _executeKernel_tu(cl_kernel kernel, const size_t size)
 	{
-		_setKernelArg(_sub_ntt64_16, 0, sizeof(cl_mem), &_tu);
-		_executeKernel(_sub_ntt64_16, _size / 4, 64 / 4 * 16);
-		_setKernelArg(_sub_ntt64_16, 0, sizeof(cl_mem), &_x);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_tu);
+		_executeKernel(kernel, _size / 4, size);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_x);
 	}
 
-public:
-	void ntt64_u(const cl_uint m, const cl_uint rindex)
+	inline void _executeSubKernel_tu(cl_kernel kernel, const size_t size)
 	{
-		_setKernelArg(_ntt64_16, 0, sizeof(cl_mem), &_tu);
-		_executeNttKernel(_ntt64_16, m, rindex, 64 / 4 * 16);
-		_setKernelArg(_ntt64_16, 0, sizeof(cl_mem), &_x);
+		if (_balanced)
+		{
+			_setKernelArg(_balance, 0, sizeof(cl_mem), &_tu);
+			_executeKernel(_balance, _size / 2);
+			_setKernelArg(_balance, 0, sizeof(cl_mem), &_x);
+		}
+		if (_radix != 1)
+		{
+			_setKernelArg(_radix_sub, 0, sizeof(cl_mem), &_tu);
+			_executeKernel(_radix_sub, _size / _radix);
+			_setKernelArg(_radix_sub, 0, sizeof(cl_mem), &_x);
+		}
+		_executeKernel_tu(kernel, size);
 	}
 
-public:
-	void ntt4_u(const cl_uint m, const cl_uint rindex)
+	inline void _executeNttKernel_tu(cl_kernel kernel, const cl_uint m, const cl_uint rindex, const size_t size)
 	{
-		_setKernelArg(_ntt4, 0, sizeof(cl_mem), &_tu);
-		_executeNttKernel(_ntt4, m, rindex, 0);
-		_setKernelArg(_ntt4, 0, sizeof(cl_mem), &_x);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_tu);
+		_executeNttKernel(kernel, m, rindex, size);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), &_x);
 	}
 
+public:
+	void sub_ntt64_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt64_16, 64 / 4 * 16); }
+	void sub_ntt256_4_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt256_4, 256 / 4 * 4); }
+	void sub_ntt256_8_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt256_8, 256 / 4 * 8); }
+	void sub_ntt256_16_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt256_16, 256 / 4 * 16); }
+	void sub_ntt1024_1_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt1024_1, 1024 / 4 * 1); }
+	void sub_ntt1024_2_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt1024_2, 1024 / 4 * 2); }
+	void sub_ntt1024_4_u(const cl_uint, const cl_uint) { _executeSubKernel_tu(_sub_ntt1024_4, 1024 / 4 * 4); }
+
+	void ntt64_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt64_16, m, rindex, 64 / 4 * 16); }
+	void ntt256_4_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt256_4, m, rindex, 256 / 4 * 4); }
+	void ntt256_8_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt256_8, m, rindex, 256 / 4 * 8); }
+	void ntt256_16_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt256_16, m, rindex, 256 / 4 * 16); }
+	void ntt1024_1_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt1024_1, m, rindex, 1024 / 4 * 1); }
+	void ntt1024_2_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt1024_2, m, rindex, 1024 / 4 * 2); }
+	void ntt1024_4_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt1024_4, m, rindex, 1024 / 4 * 4); }
+	void ntt4_u(const cl_uint m, const cl_uint rindex) { _executeNttKernel_tu(_ntt4, m, rindex, 0); }
+
 public:
 	void square8(const cl_uint, const cl_uint) { _executeKernel(_square8, _size / 4, BLK8 * 8 / 4); }
 	void square16(const cl_uint, const cl_uint) { _executeKernel(_square16, _size / 4, BLK16 * 16 / 4); }
@@ -451,6 +1103,30 @@ public:
 	void square2048(const cl_uint, const cl_uint) { _executeKernel(_square2048, _size / 4, 2048 / 4); }
 	void square4096(const cl_uint, const cl_uint) { _executeKernel(_square4096, _size / 4, 4096 / 4); }
 
+public:
+	void mul8(const cl_uint, const cl_uint) { _executeKernel(_mul8, _size / 4, BLK8 * 8 / 4); }
+	void mul16(const cl_uint, const cl_uint) { _executeKernel(_mul16, _size / 4, BLK16 * 16 / 4); }
+	void mul32(const cl_uint, const cl_uint) { _executeKernel(_mul32, _size / 4, BLK32 * 32 / 4); }
+	void mul64(const cl_uint, const cl_uint) { _executeKernel(_mul64, _size / 4, BLK64 * 64 / 4); }
+	void mul128(const cl_uint, const cl_uint) { _executeKernel(_mul128, _size / 4, BLK128 * 128 / 4); }
+	void mul256(const cl_uint, const cl_uint) { _executeKernel(_mul256, _size / 4, BLK256 * 256 / 4); }
+	void mul512(const cl_uint, const cl_uint) { _executeKernel(_mul512, _size / 4, 512 / 4); }
+	void mul1024(const cl_uint, const cl_uint) { _executeKernel(_mul1024, _size / 4, 1024 / 4); }
+	void mul2048(const cl_uint, const cl_uint) { _executeKernel(_mul2048, _size / 4, 2048 / 4); }
+	void mul4096(const cl_uint, const cl_uint) { _executeKernel(_mul4096, _size / 4, 4096 / 4); }
+
+public:
+	void square8_tu(const cl_uint, const cl_uint) { _executeKernel(_square8_tu, _size / 4, BLK8 * 8 / 4); }
+	void square16_tu(const cl_uint, const cl_uint) { _executeKernel(_square16_tu, _size / 4, BLK16 * 16 / 4); }
+	void square32_tu(const cl_uint, const cl_uint) { _executeKernel(_square32_tu, _size / 4, BLK32 * 32 / 4); }
+	void square64_tu(const cl_uint, const cl_uint) { _executeKernel(_square64_tu, _size / 4, BLK64 * 64 / 4); }
+	void square128_tu(const cl_uint, const cl_uint) { _executeKernel(_square128_tu, _size / 4, BLK128 * 128 / 4); }
+	void square256_tu(const cl_uint, const cl_uint) { _executeKernel(_square256_tu, _size / 4, BLK256 * 256 / 4); }
+	void square512_tu(const cl_uint, const cl_uint) { _executeKernel(_square512_tu, _size / 4, 512 / 4); }
+	void square1024_tu(const cl_uint, const cl_uint) { _executeKernel(_square1024_tu, _size / 4, 1024 / 4); }
+	void square2048_tu(const cl_uint, const cl_uint) { _executeKernel(_square2048_tu, _size / 4, 2048 / 4); }
+	void square4096_tu(const cl_uint, const cl_uint) { _executeKernel(_square4096_tu, _size / 4, 4096 / 4); }
+
 public:
 	void mul2() { _executeKernel(_mul2, _size / 4); }
 	void mul4() { _executeKernel(_mul4, _size / 4); }
@@ -466,13 +1142,32 @@ public:
 	void poly2int_16_8() { _executeKernel(_poly2int0_16_8, _size / 16, 8); _executeKernel(_poly2int1_16, _size / 16); }
 	void poly2int_16_16() { _executeKernel(_poly2int0_16_16, _size / 16, 16); _executeKernel(_poly2int1_16, _size / 16); }
 	void poly2int_16_32() { _executeKernel(_poly2int0_16_32, _size / 16, 32); _executeKernel(_poly2int1_16, _size / 16); }
-	void poly2int_fix() { _executeKernel(_poly2int2, 1); }
+	void poly2int_red_4_16() { _executeKernel(_poly2int0_4_16, _size / 4, 16); _executeKernel(_reduce_i_4, _size / 4); }
+	void poly2int_red_4_32() { _executeKernel(_poly2int0_4_32, _size / 4, 32); _executeKernel(_reduce_i_4, _size / 4); }
+	void poly2int_red_4_64() { _executeKernel(_poly2int0_4_64, _size / 4, 64); _executeKernel(_reduce_i_4, _size / 4); }
+	void poly2int_red_8_16() { _executeKernel(_poly2int0_8_16, _size / 8, 16); _executeKernel(_reduce_i_8, _size / 8); }
+	void poly2int_red_8_32() { _executeKernel(_poly2int0_8_32, _size / 8, 32); _executeKernel(_reduce_i_8, _size / 8); }
+	void poly2int_red_8_64() { _executeKernel(_poly2int0_8_64, _size / 8, 64); _executeKernel(_reduce_i_8, _size / 8); }
+	void poly2int_red_16_8() { _executeKernel(_poly2int0_16_8, _size / 16, 8); _executeKernel(_reduce_i_16, _size / 16); }
+	void poly2int_red_16_16() { _executeKernel(_poly2int0_16_16, _size / 16, 16); _executeKernel(_reduce_i_16, _size / 16); }
+	void poly2int_red_16_32() { _executeKernel(_poly2int0_16_32, _size / 16, 32); _executeKernel(_reduce_i_16, _size / 16); }
+	void poly2int_lb_4_16() { _executeKernel(_poly2int_lb_4_16, _size / 4, 16); }
+	void poly2int_lb_4_32() { _executeKernel(_poly2int_lb_4_32, _size / 4, 32); }
+	void poly2int_lb_4_64() { _executeKernel(_poly2int_lb_4_64, _size / 4, 64); }
+	void poly2int_lb_8_16() { _executeKernel(_poly2int_lb_8_16, _size / 8, 16); }
+	void poly2int_lb_8_32() { _executeKernel(_poly2int_lb_8_32, _size / 8, 32); }
+	void poly2int_lb_8_64() { _executeKernel(_poly2int_lb_8_64, _size / 8, 64); }
+	void poly2int_lb_16_8() { _executeKernel(_poly2int_lb_16_8, _size / 16, 8); }
+	void poly2int_lb_16_16() { _executeKernel(_poly2int_lb_16_16, _size / 16, 16); }
+	void poly2int_lb_16_32() { _executeKernel(_poly2int_lb_16_32, _size / 16, 32); }
+	void poly2int_lst() { _executeKernel(_poly2int1_4, _size / 4); }
+	void poly2int_red_lst() { _executeKernel(_reduce_i_4, _size / 4); }
 
 private:
 	inline void _executeUDsweepKernel(cl_kernel kernel, const cl_uint s, const cl_uint j, const size_t size)
 	{
-		_setKernelArg(kernel, 1, sizeof(cl_uint), &s);
-		_setKernelArg(kernel, 2, sizeof(cl_uint), &j);
+		_setKernelArg(kernel, 2, sizeof(cl_uint), &s);
+		_setKernelArg(kernel, 3, sizeof(cl_uint), &j);
 		_executeKernel(kernel, (size / 4) * s, RED_BLK * (size / 4));
 	}
 
@@ -483,7 +1178,7 @@ public:
 private:
 	inline void _executeTopsweepKernel(cl_kernel kernel, const cl_uint j, const size_t size)
 	{
-		_setKernelArg(kernel, 1, sizeof(cl_uint), &j);
+		_setKernelArg(kernel, 2, sizeof(cl_uint), &j);
 		_executeKernel(kernel, size / 4, size / 4);
 	}
 
@@ -494,11 +1189,30 @@ public:
 	void reduce_topsweep256(const cl_uint j) { _executeTopsweepKernel(_reduce_topsweep256, j, 256); }
 	void reduce_topsweep512(const cl_uint j) { _executeTopsweepKernel(_reduce_topsweep512, j, 512); }
 	void reduce_topsweep1024(const cl_uint j) { _executeTopsweepKernel(_reduce_topsweep1024, j, 1024); }
+	void reduce_topsweep_r(const cl_uint s, const cl_uint j)
+	{
+		_setKernelArg(_reduce_topsweep_r, 2, sizeof(cl_uint), &j);
+		_executeKernel(_reduce_topsweep_r, s, s);
+	}
+
+public:
+	void reduce_scan_64() { _executeKernel(_reduce_scan_64, _size / 8, 64); }
+	void reduce_scan_128() { _executeKernel(_reduce_scan_128, _size / 8, 128); }
 
 public:
 	void reduce_i() { _executeKernel(_reduce_i, _size / 2); }
-	void reduce_o() { _executeKernel(_reduce_o, _size / 2); }
+	void reduce_o() { _executeKernel(_reduce_o, _size / 2, CS_BLK); }
 	void reduce_f() { _executeKernel(_reduce_f, 1); }
+	void reduce_of() { _executeKernel(_reduce_of, _size / 2, CS_BLK); }
+
+	void setChecksumSlot(const cl_int slot)
+	{
+		if (slot == _csSlot) return;
+		_csSlot = slot;
+		_setKernelArg(_reduce_o, 6, sizeof(cl_int), &_csSlot);
+		_setKernelArg(_reduce_f, 4, sizeof(cl_int), &_csSlot);
+		_setKernelArg(_reduce_of, 6, sizeof(cl_int), &_csSlot);
+	}
 	void reduce_x() { _executeKernel(_reduce_x, 1); }
 	void reduce_z_m1() { _executeKernel(_reduce_z, 1); }
 
@@ -506,7 +1220,7 @@ public:
 	void set_positive() { _executeKernel(_set_positive, 1); }
 	void add1_m1(const cl_uint a)
 	{
-		_setKernelArg(_add1, 1, sizeof(cl_uint), &a);
+		_setKernelArg(_add1, 2, sizeof(cl_uint), &a);
 		_executeKernel(_add1, 1);
 	}
 
@@ -563,4 +1277,12 @@ private:
 public:
 	void compare_x_v() { _executeCompareKernel(&_x, &_v); }
 	void compare_m1_m2() { _executeCompareKernel(&_m1, &_m2); }
+
+	void saveSnapshot() { _executeCopyKernel(&_xs, &_x); _executeCopyKernel(&_us, &_u); _executeCopyKernel(&_vs, &_v); }
+	void restoreSnapshot() { _executeCopyKernel(&_x, &_xs); _executeCopyKernel(&_u, &_us); _executeCopyKernel(&_v, &_vs); }
+
+public:
+	void beginGerbicz() { _beginSecondQueue(); _swapGerbicz(); }
+	void endGerbicz() { _swapGerbicz(); _endSecondQueue(); }
+	void waitGerbicz() { _waitSecondQueue(); }
 };
@@ -11,11 +11,13 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include "engine.h"
 #include "pio.h"
 #include "plan.h"
+#include "plancache.h"
 
 #include <cstdint>
 #include <cmath>
 #include <sstream>
 #include <vector>
+#include <algorithm>
 
 #include "ocl/modarith.h"
 #include "ocl/NTT.h"
@@ -34,11 +36,24 @@ private:
 	static const uint32_t P1_PRIM_ROOT = 3u;
 	static const uint32_t P2_PRIM_ROOT = 31u;
 	static const uint64_t P1P2 = (P1 * uint64_t(P2));
+	static const uint32_t P3 = 1711276033u;		//  51 * 2^25 + 1, see RNS3 in modarith.cl
+	static const uint32_t P3_PRIM_ROOT = 29u;
+	static const uint64_t PG = 0xffffffff00000001ull;	// 2^64 - 2^32 + 1, see GOLDILOCKS in modarith.cl
+	static const uint64_t PG_PRIM_ROOT = 7u;
 
+	// The digits are the digits of the P1P2 arithmetic: (size / 2) * max_digit^2 < P1P2 / 2 < PG / 2
 	// 2^20 / 2 * (2^21 - 1)^2 > P1P2 / 2 > 2^19 / 2 * (2^21 - 1)^2 => max size = 2^19
 
+	// P1 - 1 = 127 * 2^24: the roots of unity of order 2^24 are the roots of the largest transform.
+	// digit_bit = 18 at size 2^24, then n < 151,000,000 (19 and n < 159,000,000 if the digits are balanced).
+	// Modulo P1, P2 and P3, (size / 2) * max_digit^2 < P1P2P3 / 2 ~ 2^91.6 and digit_bit = 29 at any size: the quotients
+	// of split() are computed with 32-bit words and the Barrett reduction by k needs 2^(digit_bit + 2) < 2^32 and one correction.
+	// Then n < 243,000,000 at size 2^24.
+	static const size_t size_max = size_t(1) << 24;
+
 private:
-	static constexpr size_t transformSize(const uint32_t k, const uint32_t n, const int digit_bit)
+	// radix = 3 or 5: size = radix * 2^m, the roots of unity of order size are modulo PG (P1 - 1 = 127 * 2^24)
+	static constexpr size_t transformSize(const uint32_t k, const uint32_t n, const int digit_bit, const size_t radix = 1)
 	{
 		// P = k.2^n + 1 = k.2^s * (2^digit_bit)^e + 1
 		const size_t e = n / digit_bit;
@@ -49,33 +64,106 @@ private:
 		// bit size of X_hi < 2 * (log2(k) + 1 + s) + digit_bit * e
 		const size_t x_hi_size = e + (2 * (arith::log2(k) + 1 + s) + digit_bit - 1) / digit_bit;
 
-		// Power of 2 such that size >= 2 * X_hi_size (we have to compute X^2 such that X < P)
-		size_t size = 2048;
+		// Power of 2, or radix * 2^m, such that size >= 2 * X_hi_size (we have to compute X^2 such that X < P)
+		// A negacyclic transform of size / 2 would compute X^2 mod B^e + 1, but P = k'.B^e + 1 with k' = k.2^s:
+		// the weights of the digits would be the powers of k'^(1/e), which are not in Z/pZ. The product is computed
+		// without modular reduction then split() divides it by k'.B^e.
+		size_t size = (radix == 1) ? 2048 : 1024 * radix;
 		while (size < 2 * x_hi_size) size *= 2;
 		return size;
 	}
 
+	// 3.2^m or 5.2^m, the smallest size of the odd radices
+	static constexpr size_t oddTransformSize(const uint32_t k, const uint32_t n, const int digit_bit)
+	{
+		return std::min(transformSize(k, n, digit_bit, 3), transformSize(k, n, digit_bit, 5));
+	}
+
+	static size_t radix(const size_t size) { size_t r = size; while (r % 2 == 0) r /= 2; return r; }
+
 private:
-	static constexpr int digitBit(const uint32_t k, const uint32_t n)
+	// The digits of R - Y are in ]-B, B[. If they are balanced, they are in [-B/2 - 1, B/2] and the bound is about 4 times smaller.
+	// The OpenCL kernels add the carry of the previous digit without propagating it: the bound is B/2 + 1.
+	static constexpr double maxDigit(const int digit_bit, const bool balanced)
 	{
-		for (int digit_bit = 21; digit_bit > 1; --digit_bit)
+		return balanced ? double((uint32_t(1) << (digit_bit - 1)) + 1) : double((uint32_t(1) << digit_bit) - 1);
+	}
+
+	// the bound of the coefficients of the products
+	static constexpr double maxCoef(const bool rns3) { return rns3 ? double(P1P2) * P3 / 2 : double(P1P2 / 2); }
+
+	static constexpr int digitBit(const uint32_t k, const uint32_t n, const bool balanced = false, const bool rns3 = false)
+	{
+		for (int digit_bit = rns3 ? 29 : 21; digit_bit > 1; --digit_bit)
 		{
 			const size_t size = transformSize(k, n, digit_bit);
-			const double max_digit = double((uint32_t(1) << digit_bit) - 1);
-			if ((size / 2) * max_digit * max_digit < P1P2 / 2) return digit_bit;
+			const double max_digit = maxDigit(digit_bit, balanced);
+			if ((size / 2) * max_digit * max_digit < maxCoef(rns3)) return digit_bit;
 		}
 		return 1;
 	}
 
+	static bool isValid(const int digit_bit, const size_t size, const bool balanced, const bool rns3 = false)
+	{
+		const double max_digit = maxDigit(digit_bit, balanced);
+		return (size <= size_max) && ((size / 2) * max_digit * max_digit < maxCoef(rns3));
+	}
+
+public:
+	// the transform of k.2^n + 1 is supported by the primes P1 and P2 or, if rns3 is true, by the primes P1, P2 and P3
+	static bool isSupported(const uint32_t k, const uint32_t n, const bool balanced = false, const bool rns3 = false)
+	{
+		if (n >= (uint32_t(1) << 30)) return false;
+		const int digit_bit = digitBit(k, n, balanced);
+		if (isValid(digit_bit, transformSize(k, n, digit_bit), balanced)) return true;
+		if (!rns3) return false;
+		const int digit_bit3 = digitBit(k, n, false, true);
+		return isValid(digit_bit3, transformSize(k, n, digit_bit3), false, true);
+	}
+
+public:
+	// the candidates of a batch have the same transform size and are tested with the same sequence of kernels
+	static const size_t batch_max_size = 16384;
+
+	static bool isBatchable(const uint32_t k1, const uint32_t n1, const uint32_t k2, const uint32_t n2)
+	{
+		const int digit_bit = digitBit(k1, n1);
+		const size_t size = transformSize(k1, n1, digit_bit);
+		return (size <= batch_max_size) && (digitBit(k2, n2) == digit_bit) && (transformSize(k2, n2, digit_bit) == size);
+	}
+
+private:
+	// a transform: its size, its digits and its arithmetic
+	struct config
+	{
+		size_t size;
+		int digit_bit;
+		bool balanced, goldilocks, rns3;
+
+		config(const size_t size, const int digit_bit, const bool balanced, const bool goldilocks, const bool rns3)
+			: size(size), digit_bit(digit_bit), balanced(balanced), goldilocks(goldilocks), rns3(rns3) {}
+
+		// 0: P1 and P2, 1: 2^64 - 2^32 + 1, 2: P1, P2 and P3 (see plancache::entry)
+		int arithmetic() const { return rns3 ? 2 : (goldilocks ? 1 : 0); }
+	};
+
 private:
-	const int _digit_bit;
-	const size_t _size;
-	const uint32_t _k, _n;
+	bool _balanced;
+	int _digit_bit;
+	size_t _size;	// a power of 2 or, modulo PG, 3.2^m or 5.2^m
+	const uint32_t _k, _n;	// the first candidate of the batch
+	const std::vector<std::pair<uint32_t, uint32_t>> _batch;
 	const bool _isBoinc;
-	bool _ext512, _ext1024;
+	bool _ext512, _ext1024, _goldilocks, _rns3;
 	engine & _engine;
 	plan _plan;
 	std::vector<cl_uint2> _mem;
+	bool _GerbiczPending = false;	// u *= x is computed by the next square with the forward transform of x
+	// The checksums of the squares modulo q = 2^31 - 1: if X = R - Y is the input of a square then its output (R', Y')
+	// satisfies R' + Y'.k.2^n = X^2 (mod q). If R < Y then the input is R - Y + k.2^n + 1 (set_positive).
+	bool _checksum = false, _csError = false, _csPrevValid = false;
+	size_t _csCount = 0;	// the number of squares in the slots
+	uint32_t _csPrev = 0;	// R - Y mod q, the output of the previous square
 
 private:
 	template <uint32_t p> class Zp
@@ -114,23 +202,110 @@ private:
 	public:
 		explicit RNS(const uint32_t r1, const uint32_t r2) : n1(r1), n2(r2) {}
 
-		uint32_t get1() const { return n1; }
-		uint32_t get2() const { return n2; }
-		uint32_t get1p() const { return cl_uint((uint64_t(n1) << 32) / P1); }
-		uint32_t get2p() const { return cl_uint((uint64_t(n2) << 32) / P2); }
+		// a residue, two residues or a residue and its Shoup's precomputation
+		typedef cl_uint2 vec;
+		typedef cl_uint4 vec2;
+
+		vec get() const { return set2(n1, n2); }
+		vec2 getp() const { return set4(n1, n2, cl_uint((uint64_t(n1) << 32) / P1), cl_uint((uint64_t(n2) << 32) / P2)); }
+		static vec2 concat(const RNS & lhs, const RNS & rhs) { return set4(lhs.n1, lhs.n2, rhs.n1, rhs.n2); }
 
 		RNS & operator*=(const RNS & rhs) { n1 *= rhs.n1; n2 *= rhs.n2; return *this; }
 		RNS operator*(const RNS & rhs) const { RNS r = *this; r *= rhs; return r; }
 
 		RNS invert() const { return RNS(n1.invert(), n2.invert()); }
+		static RNS one() { return RNS(1, 1); }
 		static RNS prRoot(const size_t n) { return RNS(Zp<P1>(P1_PRIM_ROOT).pow((P1 - 1) / n), Zp<P2>(P2_PRIM_ROOT).pow((P2 - 1) / n)); }
 	};
 
+	// The three-prime arithmetic: a residue is a cl_uint4 vector (n1, n2, n3, 0)
+	class RNS3
+	{
+	private:
+		Zp<P1> n1;
+		Zp<P2> n2;
+		Zp<P3> n3;
+
+	public:
+		explicit RNS3(const uint32_t r1, const uint32_t r2, const uint32_t r3) : n1(r1), n2(r2), n3(r3) {}
+
+		typedef cl_uint4 vec;
+		typedef cl_uint8 vec2;
+
+		vec get() const { return set4(n1, n2, n3, 0); }
+		vec2 getp() const
+		{
+			return set8(n1, n2, n3, 0, cl_uint((uint64_t(n1) << 32) / P1), cl_uint((uint64_t(n2) << 32) / P2), cl_uint((uint64_t(n3) << 32) / P3), 0);
+		}
+		static vec2 concat(const RNS3 & lhs, const RNS3 & rhs) { return set8(lhs.n1, lhs.n2, lhs.n3, 0, rhs.n1, rhs.n2, rhs.n3, 0); }
+
+		RNS3 & operator*=(const RNS3 & rhs) { n1 *= rhs.n1; n2 *= rhs.n2; n3 *= rhs.n3; return *this; }
+		RNS3 operator*(const RNS3 & rhs) const { RNS3 r = *this; r *= rhs; return r; }
+
+		RNS3 invert() const { return RNS3(n1.invert(), n2.invert(), n3.invert()); }
+		static RNS3 one() { return RNS3(1, 1, 1); }
+		static RNS3 prRoot(const size_t n)
+		{
+			return RNS3(Zp<P1>(P1_PRIM_ROOT).pow((P1 - 1) / n), Zp<P2>(P2_PRIM_ROOT).pow((P2 - 1) / n), Zp<P3>(P3_PRIM_ROOT).pow((P3 - 1) / n));
+		}
+	};
+
+	// The interface of RNS modulo PG: a residue is written as two 32-bit words and there is no Shoup's precomputation
+	class ZG
+	{
+	private:
+		uint64_t n;
+
+		// 2^64 = 2^32 - 1 and 2^96 = -1 (mod PG)
+		static uint64_t _mulmod(const uint64_t a, const uint64_t b)
+		{
+			const uint64_t lo = a * b, hi = arith::mulhi(a, b), hi_hi = hi >> 32, hi_lo = hi & 0xffffffffu;
+			const uint64_t t = lo - hi_hi - ((lo < hi_hi) ? 0xffffffffu : 0);
+			const uint64_t u = hi_lo * 0xffffffffu;
+			const uint64_t r = t + u + ((t + u < u) ? 0xffffffffu : 0);
+			return (r >= PG) ? r - PG : r;
+		}
+
+	public:
+		explicit ZG(const uint64_t i) : n(i % PG) {}
+
+		typedef cl_uint2 vec;
+		typedef cl_uint4 vec2;
+
+		vec get() const { return set2(uint32_t(n), uint32_t(n >> 32)); }
+		vec2 getp() const { return set4(uint32_t(n), uint32_t(n >> 32), 0, 0); }
+		static vec2 concat(const ZG & lhs, const ZG & rhs) { return set4(uint32_t(lhs.n), uint32_t(lhs.n >> 32), uint32_t(rhs.n), uint32_t(rhs.n >> 32)); }
+
+		ZG & operator*=(const ZG & rhs) { n = _mulmod(n, rhs.n); return *this; }
+		ZG operator*(const ZG & rhs) const { ZG r = *this; r *= rhs; return r; }
+
+		ZG pow(const uint64_t e) const
+		{
+			ZG r = ZG(1u), y = *this;
+			for (uint64_t i = e; i != 1; i /= 2)
+			{
+				if (i % 2 != 0) r *= y;
+				y *= y;
+			}
+			return r * y;
+		}
+
+		ZG invert() const { return pow(PG - 2); }
+		static ZG one() { return ZG(1u); }
+		static ZG prRoot(const size_t n) { return ZG(PG_PRIM_ROOT).pow((PG - 1) / n); }
+	};
+
 private:
 	bool readOpenCL(const char * const clFileName, const char * const headerFileName, const char * const varName, std::stringstream & src) const
 	{
 		if (_isBoinc) return false;
+		return readOpenCLFile(clFileName, headerFileName, varName, src);
+	}
 
+public:
+	// if the .cl file exists then its source is read and the header file is generated
+	static bool readOpenCLFile(const char * const clFileName, const char * const headerFileName, const char * const varName, std::stringstream & src)
+	{
 		std::ifstream clFile(clFileName);
 		if (!clFile.is_open()) return false;
 		
@@ -182,26 +357,43 @@ private:
 		return r;
 	}
 
+	static inline cl_uint8 set8(const cl_uint s0, const cl_uint s1, const cl_uint s2, const cl_uint s3,
+		const cl_uint s4, const cl_uint s5, const cl_uint s6, const cl_uint s7)
+	{
+		cl_uint8 r; r.s[0] = s0; r.s[1] = s1; r.s[2] = s2; r.s[3] = s3; r.s[4] = s4; r.s[5] = s5; r.s[6] = s6; r.s[7] = s7;
+		return r;
+	}
+
 private:
 	void _initEngine()
 	{
 		const size_t size = _size;
-		const size_t constant_max_m = 1024;
 		const size_t constant_size = 1024 + 256 + 64 + 16 + 4;	// 1364 * 4 * sizeof(cl_uint4) = 88576 bytes
 
 		std::stringstream src;
-		src << "#define\tdigit_bit\t" << _digit_bit << std::endl << std::endl;
+		src << "#define\tdigit_bit\t" << _digit_bit << std::endl;
+		if (_goldilocks) src << "#define\tGOLDILOCKS" << std::endl;
+		if (_rns3) src << "#define\tRNS3" << std::endl;
+		if (_balanced) src << "#define\tBALANCED" << std::endl;
+		if (radix(size) != 1) src << "#define\tRADIX\t" << radix(size) << std::endl;
+		src << std::endl;
 
 		src << _engine.oclDefines() << std::endl;
 
-		const cl_int k_shift = cl_int(arith::log2(_k) - 1);
+		// k and n are not defined: the program depends on the transform size only
 		src << "#define\tpconst_size\t" << size << "u" << std::endl;
-		src << "#define\tpconst_norm\t(uint2)(" << cl_uint(P1 - (P1 - 1) / size) << "u, " << cl_uint(P2 - (P2 - 1) / size) << "u)" << std::endl;
-		src << "#define\tpconst_e\t" << cl_uint(_n / _digit_bit) << "u" << std::endl;
-		src << "#define\tpconst_s\t" << cl_int(_n % _digit_bit) << std::endl;
-		src << "#define\tpconst_d\t" << cl_uint(_k) << "u" << std::endl;
-		src << "#define\tpconst_d_inv\t" << cl_uint((uint64_t(1) << (32 + k_shift)) / _k) << "u" << std::endl;
-		src << "#define\tpconst_d_shift\t" << k_shift << std::endl;
+		if (_goldilocks)
+		{
+			const uint64_t norm = PG - (PG - 1) / size;
+			src << "#define\tpconst_norm\t(uint2)(" << cl_uint(norm) << "u, " << cl_uint(norm >> 32) << "u)" << std::endl;
+		}
+		else if (_rns3)
+		{
+			src << "#define\tpconst_norm\t(uint4)(" << cl_uint(P1 - (P1 - 1) / size) << "u, " << cl_uint(P2 - (P2 - 1) / size) << "u, "
+				<< cl_uint(P3 - (P3 - 1) / size) << "u, 0u)" << std::endl;
+		}
+		else src << "#define\tpconst_norm\t(uint2)(" << cl_uint(P1 - (P1 - 1) / size) << "u, " << cl_uint(P2 - (P2 - 1) / size) << "u)" << std::endl;
+		src << "#define\tPC_SIZE\t" << engine::PC_SIZE << std::endl;
 		src << std::endl;
 
 		// if xxx.cl file is not found then source is src_ocl_xxx string in src/ocl/xxx.h
@@ -212,44 +404,96 @@ private:
 		if (!readOpenCL("ocl/reduce.cl", "src/ocl/reduce.h", "src_ocl_reduce", src)) src << src_ocl_reduce;
 		if (!readOpenCL("ocl/misc.cl", "src/ocl/misc.h", "src_ocl_misc", src)) src << src_ocl_misc;
 
-		if (_ext512)
+		if (_hasExt512())
 		{
 			if (!readOpenCL("ocl/squareNTT_512.cl", "src/ocl/squareNTT_512.h", "src_ocl_squareNTT_512", src)) src << src_ocl_squareNTT_512;	
 		}
-		if (_ext1024)
+		if (_hasExt1024())
 		{
 			if (!readOpenCL("ocl/squareNTT_1024.cl", "src/ocl/squareNTT_1024.h", "src_ocl_squareNTT_1024", src)) src << src_ocl_squareNTT_1024;	
 		}
 
-		_engine.loadProgram(src.str());
+		// the program, the buffers and the NTT roots of the previous candidate are reused if the transform size is unchanged
+		const std::string pgmSrc = src.str();
+		const std::string residentKey = pgmSrc + "// batch " + std::to_string(_batch.size());
+		if (!_engine.isResident(residentKey))
+		{
+			_engine.clearResident();
+			_engine.setGoldilocks(_goldilocks);
+			_engine.setBalancedDigits(_balanced);
+			_engine.setRNS3(_rns3);
+			_engine.loadProgram(pgmSrc, !_isBoinc);
+			_engine.allocMemory(size, constant_size, _batch.size());
+			_engine.createKernels(_hasExt512(), _hasExt1024());
+			if (_goldilocks) _initRoots<ZG>(); else if (_rns3) _initRoots<RNS3>(); else _initRoots<RNS>();
+			if (radix(size) != 1) _initRadixRoots();
+			_engine.setResident(residentKey);
+		}
+
+		std::vector<cl_uint> bp(_batch.size() * size / 2), ibp(_batch.size() * size / 2);
+		std::vector<cl_uint> pc(_batch.size() * engine::PC_SIZE, 0);
+		for (size_t b = 0; b < _batch.size(); ++b)
+		{
+			const uint32_t k = _batch[b].first, n = _batch[b].second;
+
+			const uint32_t ib = arith::invert(uint32_t(1) << _digit_bit, k);
+			uint32_t bp_i = 1, ibp_i = ib;
+			for (size_t i = b * size / 2, end = (b + 1) * size / 2; i < end; ++i)
+			{
+				bp[i] = cl_uint(bp_i);
+				ibp[i] = cl_uint(ibp_i);
+				bp_i = uint32_t((uint64_t(bp_i) << _digit_bit) % k);
+				ibp_i = uint32_t((uint64_t(ibp_i) * ib) % k);
+			}
+
+			// P = k.2^n + 1 = k.2^s * (2^digit_bit)^e + 1
+			const cl_int k_shift = cl_int(arith::log2(k) - 1);
+			cl_uint * const pc_b = &pc[b * engine::PC_SIZE];
+			pc_b[0] = cl_uint(n / _digit_bit);
+			pc_b[1] = cl_uint(n % _digit_bit);
+			pc_b[2] = cl_uint(k);
+			pc_b[3] = cl_uint((uint64_t(1) << (32 + k_shift)) / k);
+			pc_b[4] = cl_uint(k_shift);
+			pc_b[5] = cl_uint(_digit_bit);
+		}
+		_engine.writeMemory_bp(bp.data(), ibp.data());
+		_engine.writeMemory_pc(pc.data());
 
-		_engine.allocMemory(size, constant_size);
-		_engine.createKernels(_ext512, _ext1024);
+		_engine.clearMemory_err();
+	}
+
+private:
+	template <typename R>
+	void _initRoots()
+	{
+		const size_t size = _size, L = size / radix(size);
+		const size_t constant_max_m = 1024;
+		const size_t constant_size = 1024 + 256 + 64 + 16 + 4;	// must match the allocated size
 
-		// (size + 2) / 3 roots
-		std::vector<cl_uint4> r1ir1(size);
-		std::vector<cl_uint2> r2(size), ir2(size);
-		std::vector<cl_uint4> cr1(constant_size), cir1(constant_size), cr2(constant_size), cir2(constant_size);
-		RNS ps = RNS::prRoot(size), ips = ps.invert();
+		// (L + 2) / 3 roots, the radix-4 stages are the transforms of size L
+		std::vector<typename R::vec2> r1ir1(size);
+		std::vector<typename R::vec> r2(size), ir2(size);
+		std::vector<typename R::vec2> cr1(constant_size), cir1(constant_size), cr2(constant_size), cir2(constant_size);
+		R ps = R::prRoot(L), ips = ps.invert();
 		size_t j = 0;
-		for (size_t m = size / 4; m > 1; m /= 4)
+		for (size_t m = L / 4; m > 1; m /= 4)
 		{
-			RNS r1 = RNS(1, 1), ir1 = RNS(1, 1);
+			R r1 = R::one(), ir1 = R::one();
 			const size_t o = (m < 8) ? 0 : 2 * (m / 2 - 1) / 3;
 
 			for (size_t i = 0; i < m; ++i)
 			{
-				r1ir1[j] = set4(r1.get1(), r1.get2(), ir1.get1(), ir1.get2());
-				const RNS r1sq = r1 * r1, ir1sq = ir1 * ir1;
-				r2[j] = set2(r1sq.get1(), r1sq.get2()); ir2[j] = set2(ir1sq.get1(), ir1sq.get2());
+				r1ir1[j] = R::concat(r1, ir1);
+				const R r1sq = r1 * r1, ir1sq = ir1 * ir1;
+				r2[j] = r1sq.get(); ir2[j] = ir1sq.get();
 				++j;
 
 				if (m <= constant_max_m)
 				{
-					cr1[o + i] = set4(r1.get1(), r1.get2(), r1.get1p(), r1.get2p());
-					cir1[o + i] = set4(ir1.get1(), ir1.get2(), ir1.get1p(), ir1.get2p());
-					cr2[o + i] = set4(r1sq.get1(), r1sq.get2(), r1sq.get1p(), r1sq.get2p());
-					cir2[o + i] = set4(ir1sq.get1(), ir1sq.get2(), ir1sq.get1p(), ir1sq.get2p());
+					cr1[o + i] = r1.getp();
+					cir1[o + i] = ir1.getp();
+					cr2[o + i] = r1sq.getp();
+					cir2[o + i] = ir1sq.getp();
 				}
 
 				r1 *= ps; ir1 *= ips;
@@ -258,128 +502,316 @@ private:
 		}
 		_engine.writeMemory_r(r1ir1.data(), r2.data(), ir2.data());
 		_engine.writeMemory_cr(cr1.data(), cir1.data(), cr2.data(), cir2.data());
+	}
+
+	// the radix-3 and radix-5 stages are computed modulo PG
+	void _initRadixRoots()
+	{
+		const size_t size = _size;
 
-		std::vector<cl_uint> bp(size / 2), ibp(size / 2);
-		const uint32_t ib = arith::invert(uint32_t(1) << _digit_bit, _k);
-		uint32_t bp_i = 1, ibp_i = ib;
-		for (size_t i = 0; i < size / 2; ++i)
+		std::vector<cl_uint2> w(size), iw(size);
+		const ZG pw = ZG::prRoot(size), ipw = pw.invert();
+		ZG wi = ZG::one(), iwi = ZG::one();
+		for (size_t i = 0; i < size; ++i)
 		{
-			bp[i] = cl_uint(bp_i);
-			ibp[i] = cl_uint(ibp_i);
-			bp_i = uint32_t((uint64_t(bp_i) << _digit_bit) % _k);
-			ibp_i = uint32_t((uint64_t(ibp_i) * ib) % _k);
+			w[i] = wi.get(); iw[i] = iwi.get();
+			wi *= pw; iwi *= ipw;
 		}
-		_engine.writeMemory_bp(bp.data(), ibp.data());
-
-		_engine.clearMemory_err();
+		_engine.writeMemory_w(w.data(), iw.data());
 	}
 
 private:
 	void _clearEngine()
 	{
-		_engine.releaseKernels();
-		_engine.releaseMemory();
-		_engine.clearProgram();
+		_engine.clearResident();
 	}
 
 public:
 	gpmp(const uint32_t k, const uint32_t n, engine & engine, const bool isBoinc, const bool bestPlan = true, const bool profile = false) :
-		_digit_bit(digitBit(k, n)), _size(transformSize(k, n, _digit_bit)), _k(k), _n(n), _isBoinc(isBoinc),
-		_ext512(engine.getMaxWorkGroupSize() >= 512), _ext1024((engine.getMaxWorkGroupSize() >= 1024) && (engine.getLocalMemSize() >= 32768)),
-		_engine(engine), _mem(_size)
+		gpmp(std::vector<std::pair<uint32_t, uint32_t>>(1, std::make_pair(k, n)), engine, isBoinc, bestPlan, profile) {}
+
+	// A batch of candidates shares the buffers, a kernel launch processes all of them. A batch is not checkpointed.
+	gpmp(const std::vector<std::pair<uint32_t, uint32_t>> & batch, engine & engine, const bool isBoinc, const bool bestPlan = true, const bool profile = false) :
+		_balanced(engine.hasBalancedDigits() && (batch.size() == 1) && (digitBit(batch[0].first, batch[0].second, true) > digitBit(batch[0].first, batch[0].second))),
+		_digit_bit(digitBit(batch[0].first, batch[0].second, _balanced)), _size(transformSize(batch[0].first, batch[0].second, _digit_bit)),
+		_k(batch[0].first), _n(batch[0].second), _batch(batch), _isBoinc(isBoinc),
+		_ext512(engine.getMaxWorkGroupSize() >= 512), _ext1024((engine.getMaxWorkGroupSize() >= 1024) && (engine.getLocalMemSize() >= 32768)), _goldilocks(false),
+		_rns3(false), _engine(engine)
 	{
 		if (engine.getMaxWorkGroupSize() < 256) throw std::runtime_error("The maximum work-group size must be equal to or greater than 256");
 
 		const size_t size = _size;
 
-		const double max_digit = double((uint32_t(1) << _digit_bit) - 1);
-		if ((size / 2) * max_digit * max_digit >= P1P2 / 2)
+		for (const auto & c : batch)
+		{
+			if ((digitBit(c.first, c.second, _balanced) != _digit_bit) || (transformSize(c.first, c.second, _digit_bit) != size))
+			{
+				throw std::runtime_error("the candidates of a batch must have the same transform size");
+			}
+		}
+
+		// The arithmetic modulo PG is an alternative if the device has a fast 64-bit multiplier.
+		// Its transform size can be 3.2^m or 5.2^m, between two powers of 2.
+		std::vector<config> configs;
+		const bool isValidP1P2 = isValid(_digit_bit, size, _balanced);
+		if (isValidP1P2)
+		{
+			configs.push_back(config(size, _digit_bit, _balanced, false, false));
+			if (engine.hasFastMul64())
+			{
+				configs.push_back(config(size, _digit_bit, _balanced, true, false));
+				const size_t oddSize = oddTransformSize(_k, _n, _digit_bit);
+				if (engine.hasOddRadix() && (batch.size() == 1) && (oddSize < size)) configs.push_back(config(oddSize, _digit_bit, _balanced, true, false));
+			}
+		}
+
+		// The digits of the three-prime arithmetic are larger: its transform is smaller and its range of n is wider.
+		if (engine.hasRNS3() && (batch.size() == 1))
+		{
+			const int digit_bit3 = digitBit(_k, _n, false, true);
+			const size_t size3 = transformSize(_k, _n, digit_bit3);
+			if (isValid(digit_bit3, size3, false, true) && (!isValidP1P2 || (size3 < size))) configs.push_back(config(size3, digit_bit3, false, false, true));
+		}
+
+		if (configs.empty())
 		{
 			std::stringstream ss; ss << getDigits() << "-digit numbers are not supported";
 			throw std::runtime_error(ss.str());
 		}
 
+		size_t maxSize = 0;
+		for (const config & c : configs) maxSize = std::max(maxSize, c.size);
+		_mem.resize(maxSize * batch.size());
+
+		// the key is computed before any fallback: the cache remembers that the extensions must be disabled.
+		// The candidates with the same set of configurations share the entry.
+		std::ostringstream ssc;
+		for (size_t c = 0; c < configs.size(); ++c)
+		{
+			if (c != 0) ssc << ",";
+			ssc << configs[c].size << "_" << configs[c].arithmetic() << "_" << configs[c].digit_bit << (configs[c].balanced ? "b" : "");
+		}
+		const std::string planKey = plancache::key(engine.getName(), engine.getDriverVersion(), ssc.str(), batch.size(), _ext512, _ext1024, engine.oclDefines());
+		const bool useCache = bestPlan && !isBoinc;
+		plancache::entry cached;
+		const bool isCached = useCache && plancache::getInstance().find(planKey, cached);
+		if (isCached)
+		{
+			_ext512 = cached.ext512;
+			_ext1024 = cached.ext1024;
+		}
+
 reset:
-		_plan.init(size, _ext512, _ext1024);
+		size_t bestSq_i = 0, bestP2i_i = 0, bestRed_i = 0, bestMul_i = 0, best_c = 0;
+		bool tune = bestPlan;
+		if (isCached && (cached.ext512 == _ext512) && (cached.ext1024 == _ext1024))
+		{
+			for (size_t c = 0; tune && (c < configs.size()); ++c)
+			{
+				if ((configs[c].arithmetic() != cached.arithmetic) || (radix(configs[c].size) != cached.radix)) continue;
+				_setTransform(configs[c]);
+				if ((cached.square_i < _plan.getSquareSeqCount()) && (cached.poly2int_i < _plan.getPoly2intCount()) && (cached.reduce_i < _plan.getReduceCount())
+					&& (cached.mul_i < _plan.getMulSeqCount()))
+				{
+					// the plan set may have changed since the cache was written
+					_plan.setSquareSeq(_nttSize(), cached.square_i);
+					_plan.setPoly2intFn(cached.poly2int_i);
+					_plan.setReduceFn(cached.reduce_i);
+					_plan.setMulSeq(_nttSize(), cached.mul_i);
+					if (_plan.getPlanString(_nttSize()) == cached.planString)
+					{
+						bestSq_i = cached.square_i;
+						bestP2i_i = cached.poly2int_i;
+						bestRed_i = cached.reduce_i;
+						bestMul_i = cached.mul_i;
+						best_c = c;
+						tune = false;
+					}
+				}
+			}
+		}
 
-		size_t bestSq_i = 0, bestP2i_i = 0;
-		if (bestPlan)
+		if (tune)
 		{
 			engine.setProfiling(true);
-			_initEngine();
 
-			cl_ulong bestSqTime = cl_ulong(-1);
-			for (size_t i = 0, cnt = _plan.getSquareSeqCount(); i < cnt; ++i)
+			// the time of the squares of a configuration is the time of its best plan
+			cl_ulong bestTime = cl_ulong(-1);
+			for (size_t c = 0; c < configs.size(); ++c)
 			{
-				initProfiling();
-				_plan.setSquareSeq(size, i);
-				try
+				_setTransform(configs[c]);
+				_initEngine();
+
+				size_t sq_i = 0;
+				cl_ulong bestSqTime = cl_ulong(-1);
+				for (size_t i = 0, cnt = _plan.getSquareSeqCount(); i < cnt; ++i)
 				{
+					initProfiling();
+					_plan.setSquareSeq(_nttSize(), i);
+					try
+					{
+						for (size_t j = 0; j < 16; ++j) square();
+						const cl_ulong time = engine.getProfileTime();
+						if (time < bestSqTime)
+						{
+							bestSqTime = time;
+							sq_i = i;
+						}
+					}
+					catch (const std::runtime_error & e)
+					{
+						if (_ext512 == false) throw e;
+						// try to fix runtime error
+						std::ostringstream ss; ss << "warning: " << e.what() << ", trying to fix it..." << std::endl;
+						pio::error(ss.str(), true);
+						_ext512 = _ext1024 = false;
+						engine.resetProfiles();
+						_clearEngine();
+						goto reset;
+					}
+
+					engine.resetProfiles();
+				}
+				_plan.setSquareSeq(_nttSize(), sq_i);
+
+				size_t p2i_i = 0;
+				cl_ulong bestP2iTime = cl_ulong(-1);
+				for (size_t i = 0, cnt = _plan.getPoly2intCount(); i < cnt; ++i)
+				{
+					initProfiling();
+					_plan.setPoly2intFn(i);
 					for (size_t j = 0; j < 16; ++j) square();
 					const cl_ulong time = engine.getProfileTime();
-					if (time < bestSqTime)
+					if (time < bestP2iTime)
 					{
-						bestSqTime = time;
-						bestSq_i = i;
+						bestP2iTime = time;
+						p2i_i = i;
 					}
+					engine.resetProfiles();
 				}
-				catch (const std::runtime_error & e)
+				_plan.setPoly2intFn(p2i_i);
+
+				// the fused kernels of split() are alternatives
+				size_t red_i = 0;
+				cl_ulong bestRedTime = cl_ulong(-1);
+				for (size_t i = 0, cnt = _plan.getReduceCount(); i < cnt; ++i)
 				{
-					if (_ext512 == false) throw e;
-					// try to fix runtime error
-					std::ostringstream ss; ss << "warning: " << e.what() << ", trying to fix it..." << std::endl;
-					pio::error(ss.str(), true);
-					_ext512 = _ext1024 = false;
+					initProfiling();
+					_plan.setReduceFn(i);
+					for (size_t j = 0; j < 16; ++j) square();
+					const cl_ulong time = engine.getProfileTime();
+					if (time < bestRedTime)
+					{
+						bestRedTime = time;
+						red_i = i;
+					}
 					engine.resetProfiles();
-					_clearEngine();
-					goto reset;
 				}
+				_plan.setReduceFn(red_i);
 
-				engine.resetProfiles();
-			}
-			_plan.setSquareSeq(size, bestSq_i);
+				// the multiplication is not a part of the time of the configuration
+				size_t mul_i = 0;
+				cl_ulong bestMulTime = cl_ulong(-1);
+				for (size_t i = 0, cnt = _plan.getMulSeqCount(); i < cnt; ++i)
+				{
+					initProfiling();
+					_plan.setMulSeq(_nttSize(), i);
+					setMultiplicand();
+					for (size_t j = 0; j < 16; ++j) mul();
+					const cl_ulong time = engine.getProfileTime();
+					if (time < bestMulTime)
+					{
+						bestMulTime = time;
+						mul_i = i;
+					}
+					engine.resetProfiles();
+				}
 
-			cl_ulong bestP2iTime = cl_ulong(-1);
-			for (size_t i = 0, cnt = _plan.getPoly2intCount(); i < cnt; ++i)
-			{
-				initProfiling();
-				_plan.setPoly2intFn(i);
-				for (size_t j = 0; j < 16; ++j) square();
-				const cl_ulong time = engine.getProfileTime();
-				if (time < bestP2iTime)
+				if (bestRedTime < bestTime)
 				{
-					bestP2iTime = time;
-					bestP2i_i = i;
+					bestTime = bestRedTime;
+					bestSq_i = sq_i;
+					bestP2i_i = p2i_i;
+					bestRed_i = red_i;
+					bestMul_i = mul_i;
+					best_c = c;
 				}
-				engine.resetProfiles();
 			}
+			_setTransform(configs[best_c]);
+			_plan.setSquareSeq(_nttSize(), bestSq_i);
+			_plan.setPoly2intFn(bestP2i_i);
+			_plan.setReduceFn(bestRed_i);
+			_plan.setMulSeq(_nttSize(), bestMul_i);
 
-			_clearEngine();
+			if (useCache)
+			{
+				plancache::getInstance().insert(planKey, plancache::entry(_ext512, _ext1024, bestSq_i, bestP2i_i, bestRed_i, bestMul_i, configs[best_c].arithmetic(), radix(_size),
+					_plan.getPlanString(_nttSize())));
+			}
 		}
 
+		_setTransform(configs[best_c]);
 		engine.setProfiling(profile);
 		_initEngine();
-		_plan.setSquareSeq(size, bestSq_i);
+		_plan.setSquareSeq(_nttSize(), bestSq_i);
 		_plan.setPoly2intFn(bestP2i_i);
+		_plan.setReduceFn(bestRed_i);
+		_plan.setMulSeq(_nttSize(), bestMul_i);
 	}
 
-public:
-	virtual ~gpmp()
+private:
+	// the radix-4 stages of the plan are the transforms of size L = size / radix
+	size_t _nttSize() const { return _size / radix(_size); }
+
+	void _setTransform(const config & c)
 	{
-		_clearEngine();
+		_size = c.size;
+		_digit_bit = c.digit_bit;
+		_balanced = c.balanced;
+		_goldilocks = c.goldilocks;
+		_rns3 = c.rns3;
+		_plan.init(_nttSize(), _hasExt512(), _hasExt1024(), radix(_size) == 1);
 	}
 
+	// the local memory of the kernels of squareNTT_512 and squareNTT_1024 is twice as large if RNS3 is defined
+	bool _hasExt512() const { return _ext512 && (!_rns3 || (_engine.getLocalMemSize() >= 32768)); }
+	bool _hasExt1024() const { return _ext1024 && (!_rns3 || (_engine.getLocalMemSize() >= 65536)); }
+
+public:
+	// the engine keeps the program and the buffers for the next candidate
+	virtual ~gpmp() {}
+
 public:
 	size_t getSize() const { return _size; }
+	std::string getSizeString() const
+	{
+		std::ostringstream ss;
+		if (radix(_size) != 1) ss << radix(_size) << "*";
+		ss << "2^" << arith::log2(_nttSize());
+		return ss.str();
+	}
+	size_t getBatchCount() const { return _batch.size(); }
 	size_t getDigitBit() const { return _digit_bit; }
 	size_t getDigits() const { return size_t(std::ceil(std::log10(_k) + _n * std::log10(2))); }
 
 public:
-	std::string getPlanString() const { return _plan.getPlanString(_size); }
+	std::string getPlanString() const
+	{
+		std::ostringstream ss;
+		if (_goldilocks) ss << "goldilocks ";
+		if (_rns3) ss << "rns3 ";
+		if (radix(_size) != 1) ss << "radix" << radix(_size) << " ";
+		ss << _plan.getPlanString(_nttSize());
+		return ss.str();
+	}
 	size_t getPlanSquareSeqCount() const { return _plan.getSquareSeqCount(); }
-	void setPlanSquareSeq(const size_t i) { _plan.setSquareSeq(_size, i); }
+	void setPlanSquareSeq(const size_t i) { _plan.setSquareSeq(_nttSize(), i); }
 	size_t getPlanPoly2intCount() const { return _plan.getPoly2intCount(); }
 	void setPlanPoly2intFn(const size_t i) { _plan.setPoly2intFn(i); }
+	size_t getPlanReduceCount() const { return _plan.getReduceCount(); }
+	void setPlanReduceFn(const size_t i) { _plan.setReduceFn(i); }
+	size_t getPlanMulSeqCount() const { return _plan.getMulSeqCount(); }
+	void setPlanMulSeq(const size_t i) { _plan.setMulSeq(_nttSize(), i); }
 
 public:
 	void display()
@@ -397,33 +829,43 @@ public:
 		pio::display(ss.str());
 	}
 
-public:
-	static void printRanges(const uint32_t k)
+private:
+	// range[log2(size)] is the range of n of the transform size
+	static void _ranges(const uint32_t k, const bool balanced, std::vector<std::pair<uint32_t, uint32_t>> & range)
 	{
-		std::vector<std::pair<uint32_t, uint32_t>> range(32, std::make_pair(0u, 0u));
+		range.assign(32, std::make_pair(0u, 0u));
 		uint32_t n_min = 100000, n_max = 2 * n_min;
 		while (n_max < 1000000000)
 		{
 			while (n_max - n_min > 1)
 			{
-				const size_t s_min = transformSize(k, n_min, digitBit(k, n_min));
-				const size_t s_max = transformSize(k, n_max, digitBit(k, n_max));
+				const size_t s_min = transformSize(k, n_min, digitBit(k, n_min, balanced));
+				const size_t s_max = transformSize(k, n_max, digitBit(k, n_max, balanced));
 
 				const uint32_t m = (n_min + n_max) / 2;
-				const size_t s = transformSize(k, m, digitBit(k, m));
+				const size_t s = transformSize(k, m, digitBit(k, m, balanced));
 				if (s == s_min) n_min = m;
 				if (s == s_max) n_max = m;
 			}
-			const size_t ls_min = arith::log2(transformSize(k, n_min, digitBit(k, n_min)));
-			const size_t ls_max = arith::log2(transformSize(k, n_max, digitBit(k, n_max)));
+			const size_t ls_min = arith::log2(transformSize(k, n_min, digitBit(k, n_min, balanced)));
+			const size_t ls_max = arith::log2(transformSize(k, n_max, digitBit(k, n_max, balanced)));
 			range[ls_min].second = n_min;
 			range[ls_max].first = n_max;
 			n_min = n_max; n_max = 2 * n_min + 1000;
 		}
+	}
+
+public:
+	static void printRanges(const uint32_t k)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> range, brange;
+		_ranges(k, false, range);
+		_ranges(k, true, brange);
 		std::stringstream ss;
 		for (size_t i = 17; i <= 24; ++i)
 		{
-			ss << "2^" << i << ": [" << range[i].first << "-" << range[i].second << "]" << std::endl;
+			ss << "2^" << i << ": [" << range[i].first << "-" << range[i].second << "], balanced digits: ["
+				<< brange[i].first << "-" << brange[i].second << "]" << std::endl;
 		}
 		pio::display(ss.str());
 	}
@@ -431,9 +873,17 @@ public:
 public:
 	int getError() const
 	{
-		cl_int err = 0;
-		_engine.readMemory_err(&err);
-		return int(err);
+		for (const int err : getErrors()) if (err != 0) return err;
+		return 0;
+	}
+
+public:
+	// an error flag per candidate
+	std::vector<int> getErrors() const
+	{
+		std::vector<cl_int> err(_batch.size(), 0);
+		_engine.readMemory_err(err.data());
+		return std::vector<int>(err.begin(), err.end());
 	}
 
 public:
@@ -469,6 +919,8 @@ private:
 public:
 	bool saveContext(const uint32_t i, const double elapsedTime, const char * const ext)
 	{
+		_Gerbicz_flush();
+
 		FILE * const cFile = pio::open(_filename(ext).c_str(), "wb");
 		if (cFile == nullptr)
 		{
@@ -503,9 +955,17 @@ public:
 		return true;
 	}
 
+public:
+	static void removeContext(const char * const ext)
+	{
+		std::remove(_filename(ext).c_str());
+	}
+
 public:
 	bool restoreContext(uint32_t & i, double & elapsedTime, const char * const ext, const bool restore_uv = true)
 	{
+		_GerbiczPending = false;
+
 		FILE * const cFile = pio::open(_filename(ext).c_str(), "rb");
 		if (cFile == nullptr) return false;
 
@@ -519,10 +979,12 @@ public:
 		if (!_readContext(cFile, reinterpret_cast<char *>(&elapsedTime), sizeof(elapsedTime))) return false;
 		uint32_t digit_bit = 0;
 		if (!_readContext(cFile, reinterpret_cast<char *>(&digit_bit), sizeof(digit_bit))) return false;
-		if (digit_bit != uint32_t(_digit_bit)) return false;
+		if ((digit_bit == 0) || (digit_bit > 29)) { std::fclose(cFile); return false; }
+		// The transform size and the arithmetic are selected by timing and may be different from those of the file.
+		// The digits of R and Y are converted to digit_bit, the digits beyond the half of the transform size must be zero.
 		uint32_t sz = 0;
 		if (!_readContext(cFile, reinterpret_cast<char *>(&sz), sizeof(sz))) return false;
-		if (sz != uint32_t(size)) return false;
+		if ((sz == 0) || (sz % 2 != 0)) { std::fclose(cFile); return false; }
 		uint32_t k = 0;
 		if (!_readContext(cFile, reinterpret_cast<char *>(&k), sizeof(k))) return false;
 		if (k != _k) return false;
@@ -532,13 +994,43 @@ public:
 
 		if (!_readContext(cFile, reinterpret_cast<char *>(&i), sizeof(i))) return false;
 
-		if (!_readContext(cFile, reinterpret_cast<char *>(mem), sizeof(cl_uint2) * size / 2)) return false;
+		const size_t fsize = sz / 2;
+		const uint32_t digit_mask = (uint32_t(1) << _digit_bit) - 1;
+		std::vector<cl_uint2> fmem(fsize);
+		// the number of digits is the same for x, u and v: the digits of the previous vector are overwritten
+		auto setDigit = [&](const size_t j, const size_t c, const uint32_t d) -> bool
+		{
+			if (j < size / 2) { mem[j].s[c] = d; return true; }
+			if (d != 0) { std::fclose(cFile); return false; }
+			return true;
+		};
+		auto readDigits = [&]() -> bool
+		{
+			if (!_readContext(cFile, reinterpret_cast<char *>(fmem.data()), sizeof(cl_uint2) * fsize)) return false;
+			for (size_t c = 0; c < 2; ++c)
+			{
+				uint64_t w = 0; uint32_t bit = 0; size_t j = 0;
+				for (size_t l = 0; l < fsize; ++l)
+				{
+					if ((fmem[l].s[c] >> digit_bit) != 0) { std::fclose(cFile); return false; }
+					w |= uint64_t(fmem[l].s[c]) << bit; bit += digit_bit;
+					for (; bit >= uint32_t(_digit_bit); bit -= _digit_bit, w >>= _digit_bit)
+					{
+						if (!setDigit(j++, c, uint32_t(w) & digit_mask)) return false;
+					}
+				}
+				if (!setDigit(j, c, uint32_t(w))) return false;
+			}
+			return true;
+		};
+
+		if (!readDigits()) return false;
 		_engine.writeMemory_x(mem);
 		if (restore_uv)
 		{
-			if (!_readContext(cFile, reinterpret_cast<char *>(mem), sizeof(cl_uint2) * size / 2)) return false;
+			if (!readDigits()) return false;
 			_engine.writeMemory_u(mem);
-			if (!_readContext(cFile, reinterpret_cast<char *>(mem), sizeof(cl_uint2) * size / 2)) return false;
+			if (!readDigits()) return false;
 			_engine.writeMemory_v(mem);
 		}
 
@@ -547,41 +1039,176 @@ public:
 	}
 
 public:
-	void init(const uint32_t x0, const uint32_t u0)
+	// x, u and v are copied on the device, no transfer. If an error is detected then the test is resumed from this point.
+	void saveSnapshot()
+	{
+		_Gerbicz_flush();
+		_engine.saveSnapshot();
+	}
+
+	void restoreSnapshot()
+	{
+		_GerbiczPending = false;
+		_engine.waitGerbicz();
+		_engine.restoreSnapshot();
+		resetError();
+		_resetChecksum();
+	}
+
+	// The squares are checked each CS_SLOTS squares, the sequence of the squares is broken if x is modified.
+	void setChecksum(const bool enable) { _checksum = enable; _resetChecksum(); }
+	bool isChecksumError() const { return _csError; }
+
+private:
+	void _resetChecksum()
+	{
+		_csError = _csPrevValid = false;
+		_csCount = 0;
+		_engine.clearMemory_cs();
+	}
+
+	void _verifyChecksum()
+	{
+		const uint64_t q = (uint64_t(1) << 31) - 1;
+		const uint64_t kn = (_k % q) * (uint64_t(1) << (_n % 31)) % q;	// k.2^n mod q
+
+		std::vector<cl_uint> cs(4 * engine::CS_SLOTS);
+		_engine.readMemory_cs(cs.data());
+		_engine.clearMemory_cs();
+
+		for (size_t i = 0; i < _csCount; ++i)
+		{
+			const uint64_t R = ((uint64_t(cs[4 * i + 1]) << 32) | cs[4 * i + 0]) % q;
+			const uint64_t Y = ((uint64_t(cs[4 * i + 3]) << 32) | cs[4 * i + 2]) % q;
+			if (_csPrevValid)
+			{
+				const uint64_t s = (R + Y * kn) % q, X = _csPrev, XN = (X + kn + 1) % q;
+				if ((s != X * X % q) && (s != XN * XN % q)) _csError = true;
+			}
+			_csPrev = uint32_t((R + q - Y) % q);
+			_csPrevValid = true;
+		}
+		_csCount = 0;
+	}
+
+public:
+
+	// the state is unchanged, the residue is computed by another sequence of kernels
+	void setFallbackPlan() { _plan.setFallback(_nttSize()); }
+
+private:
+	// the vector of a candidate is the integer val[b]
+	void _setMem(const std::vector<uint32_t> & val)
 	{
 		const size_t size = _size;
 
-		cl_uint2 * const x = _mem.data();
-		x[0] = set2(x0, 0);
-		for (size_t i = 1; i < size; ++i) x[i] = set2(0, 0);
-		_engine.writeMemory_x(x);
+		for (size_t b = 0; b < _batch.size(); ++b)
+		{
+			cl_uint2 * const x = &_mem[b * size];
+			x[0] = set2(val[b], 0);
+			for (size_t i = 1; i < size; ++i) x[i] = set2(0, 0);
+		}
+	}
 
-		cl_uint2 * const u = _mem.data();
-		u[0] = set2(u0, 0);
-		for (size_t i = 1; i < size; ++i) u[i] = set2(0, 0);
-		_engine.writeMemory_u(u);
+public:
+	void init(const uint32_t x0, const uint32_t u0)
+	{
+		init(std::vector<uint32_t>(_batch.size(), x0), std::vector<uint32_t>(_batch.size(), u0));
+	}
+
+	// the values are smaller than 2^digit_bit
+	void init(const std::vector<uint32_t> & x0, const std::vector<uint32_t> & u0)
+	{
+		_Gerbicz_flush();
+		_setMem(x0);
+		_engine.writeMemory_x(_mem.data());
+		init_u(u0);
+	}
+
+	void init_u(const std::vector<uint32_t> & u0)
+	{
+		_Gerbicz_flush();
+		_setMem(u0);
+		_engine.writeMemory_u(_mem.data());
 	}
 
 public:
 	void initProfiling()
 	{
+		_GerbiczPending = false;
+
 		const size_t size = _size;
 
+		for (size_t b = 0; b < _batch.size(); ++b)
+		{
+			cl_uint2 * const x = &_mem[b * size];
+			for (size_t i = 0; i < size / 2; ++i) x[i] = set2((uint32_t(1) << _digit_bit) - 1, 0);
+			for (size_t i = size / 2; i < size; ++i) x[i] = set2(0, 0);
+		}
+		_engine.writeMemory_x(_mem.data());
+
+		for (size_t b = 0; b < _batch.size(); ++b)
+		{
+			cl_uint2 * const u = &_mem[b * size];
+			for (size_t i = 0 * size / 4; i < 1 * size / 4; ++i) u[i] = set2((uint32_t(1) << _digit_bit) - 1, 0);
+			for (size_t i = 1 * size / 4; i < 2 * size / 4; ++i) u[i] = set2(0, (uint32_t(1) << _digit_bit) - 1);
+			for (size_t i = size / 2; i < size; ++i) u[i] = set2(0, 0);
+		}
+		_engine.writeMemory_u(_mem.data());
+	}
+
+public:
+	// the number of 32-bit words of a residue modulo k.2^n + 1
+	size_t getResidueWords() const { return (_n + arith::log2(_k) + 1 + 31) / 32; }
+
+	// x modulo k.2^n + 1, a little-endian array of 32-bit words
+	void getResidue(std::vector<uint32_t> & words)
+	{
+		norm();
+
+		_engine.copy_x_m1();
+		_engine.add1_m1(0);
+		_engine.reduce_z_m1();
+
+		const cl_uint2 * const res = _mem.data();
+		_engine.readMemory_m1(_mem.data());
+
+		words.assign(getResidueWords(), 0);
+		uint64_t w = 0; int bit = 0;
+		for (size_t i = 0, j = 0, n = _size / 2; (i < n) && (j < words.size()); ++i)
+		{
+			w |= uint64_t(res[i].s[0]) << bit;
+			bit += _digit_bit;
+			if (bit >= 32) { words[j++] = uint32_t(w); w >>= 32; bit -= 32; }
+			if ((i == n - 1) && (j < words.size())) words[j] = uint32_t(w);
+		}
+	}
+
+private:
+	void _setResidue(const std::vector<uint32_t> & words)
+	{
+		const uint32_t digit_mask = (uint32_t(1) << _digit_bit) - 1;
 		cl_uint2 * const x = _mem.data();
-		for (size_t i = 0; i < size / 2; ++i) x[i] = set2((uint32_t(1) << _digit_bit) - 1, 0);
-		for (size_t i = size / 2; i < size; ++i) x[i] = set2(0, 0);
-		_engine.writeMemory_x(x);
 
-		cl_uint2 * const u = _mem.data();
-		for (size_t i = 0 * size / 4; i < 1 * size / 4; ++i) u[i] = set2((uint32_t(1) << _digit_bit) - 1, 0);
-		for (size_t i = 1 * size / 4; i < 2 * size / 4; ++i) u[i] = set2(0, (uint32_t(1) << _digit_bit) - 1);
-		for (size_t i = size / 2; i < size; ++i) u[i] = set2(0, 0);
-		_engine.writeMemory_u(u);
-}
+		uint64_t w = 0; int bit = 0;
+		for (size_t i = 0, j = 0, n = _size / 2; i < n; ++i)
+		{
+			if ((bit < _digit_bit) && (j < words.size())) { w |= uint64_t(words[j++]) << bit; bit += 32; }
+			x[i] = set2(uint32_t(w) & digit_mask, 0);
+			w >>= _digit_bit; bit -= _digit_bit;
+		}
+		for (size_t i = _size / 2; i < _size; ++i) x[i] = set2(0, 0);
+	}
+
+public:
+	// the words are a residue read by getResidue
+	void setResidue_x(const std::vector<uint32_t> & words) { _Gerbicz_flush(); _setResidue(words); _engine.writeMemory_x(_mem.data()); }
+	void setResidue_u(const std::vector<uint32_t> & words) { _Gerbicz_flush(); _setResidue(words); _engine.writeMemory_u(_mem.data()); }
 
 public:
 	void set_bug()
 	{
+		_Gerbicz_flush();
 		cl_uint2 * const x = _mem.data();
 		_engine.readMemory_x(x);
 		x[_size / 3].s[0] += 1;
@@ -603,6 +1230,7 @@ public:
 	void copy_x_u() { _engine.copy_x_u(); }
 	void swap_x_v() { _engine.swap_x_v(); }
 	void copy_x_v() { _engine.copy_x_v(); }
+	void copy_u_x() { _engine.copy_u_x(); }
 	void copy_v_x() { _engine.copy_v_x(); }
 	void compare_x_v() { _engine.compare_x_v(); }
 
@@ -611,109 +1239,71 @@ public:
 	{
 		// x size is size / 2; _x[0] = R, _x[1] = Y; compute (R - Y)^2
 
-		_plan.execSquareSeq(_engine);
+		// If a Gerbicz step is pending then R - Y must be positive, tu is the forward transform of x
+		const bool keep = _GerbiczPending;
+		if (keep) { _engine.waitGerbicz(); _engine.set_positive(); _plan.execSquareKeepSeq(_engine); }
+		else _plan.execSquareSeq(_engine);
 		_plan.execPoly2intFn(_engine);
-		_engine.poly2int_fix();
 
 		// x size is size
 
-		split();
+		_engine.setChecksumSlot(_checksum ? cl_int(_csCount) : -1);
+		split(_plan.isPoly2intFused());
 
 		// Now x size is size / 2, _x[0] = R, _x[1] = Y such that X = R - Y and -k.2^n < R - Y < k.2^n
+
+		// u *= x: the multiplicand is set, the product overlaps the next squares
+		if (keep)
+		{
+			_GerbiczPending = false;
+			_engine.beginGerbicz();
+			mul();
+			_engine.endGerbicz();
+		}
+
+		if (_checksum && (++_csCount == engine::CS_SLOTS)) _verifyChecksum();
 	}
 
 public:
+	// tu is transformed with the slices of the plan, it is ready for mul()
 	void setMultiplicand()
 	{
+		_Gerbicz_flush();
+
 		_engine.copy_u_tu();
 		_engine.set_positive_tu();
 
-		_engine.sub_ntt64_u();
-
-		cl_uint m = cl_uint(_size / 4);
-		cl_uint rindex = (16 + 4 + 1) * (m / 16);
-		m /= 64;
-
-		for (; m > 256; m /= 64)
-		{
-			_engine.ntt64_u(m / 16, rindex);
-			rindex += (16 + 4 + 1) * (m / 16);
-		}
-
-		for (; m > 1; m /= 4)
-		{
-			_engine.ntt4_u(m, rindex);
-			rindex += m;
-		}
+		_plan.execMultiplicandSeq(_engine);
 	}
 
 public:
+	// x = x * u, the last stages and the pointwise product are computed by a mul kernel
 	void mul()
 	{
-		const size_t size = _size;
-
+		_Gerbicz_flush();
 		norm();
 
-		_engine.sub_ntt64_16(0, 0);
+		_plan.execMulSeq(_engine);
+		_plan.execMulPoly2intFn(_engine);
 
-		cl_uint m = cl_uint(size / 4);
-		cl_uint rindex = (16 + 4 + 1) * (m / 16);
-		m /= 64;
-
-		size_t n64 = 0;
-		for (; m > 256; m /= 64)
-		{
-			_engine.ntt64_16(m / 16, rindex);
-			rindex += (16 + 4 + 1) * (m / 16);
-			++n64;
-		}
-
-		size_t n4 = 0;
-		for (; m > 4; m /= 4)
-		{
-			_engine.ntt4(m, rindex);
-			rindex += m;
-			++n4;
-		}
-
-		_engine.ntt4(m, rindex);
-		if (m == 4) _engine.mul4(); else _engine.mul2();
-		_engine.intt4(m, rindex);
-
-		for (; n4 != 0; --n4)
-		{
-			m *= 4;
-			rindex -= m;
-			_engine.intt4(m, rindex);
-		}
-
-		for (; n64 != 0; --n64)
-		{
-			m *= 64;
-			rindex -= (16 + 4 + 1) * (m / 16);
-			_engine.intt64_16(m / 16, rindex);
-		}
-
-		_engine.lst_intt64_16(0, 0);
-
-		_engine.poly2int_16_16();
-
-		split();
+		_engine.setChecksumSlot(-1);
+		split(_plan.isPoly2intFused());
 	}
 
 public:
-	void pow(const uint32_t e)
+	void pow(const uint64_t e)
 	{
+		_Gerbicz_flush();
 		norm();
 
 		bool s = false;
 		_engine.copy_x_u();
 		setMultiplicand();
-		for (int b = 0; b < 32; ++b)
+		for (int b = 0; b < 64; ++b)
 		{
 			if (s) square();
 
-			if ((e & (uint32_t(1) << (31 - b))) != 0)
+			if ((e & (uint64_t(1) << (63 - b))) != 0)
 			{
 				if (s) mul();
 				s = true;
@@ -723,6 +1313,15 @@ public:
 
 public:
 	bool isMinusOne(uint64_t & res64)
+	{
+		std::vector<bool> isPrime;
+		std::vector<uint64_t> res64_b;
+		isMinusOne(isPrime, res64_b);
+		res64 = res64_b[0];
+		return isPrime[0];
+	}
+
+	void isMinusOne(std::vector<bool> & isPrime, std::vector<uint64_t> & res64)
 	{
 		norm();
 
@@ -731,22 +1330,27 @@ public:
 		_engine.add1_m1(1);
 		_engine.reduce_z_m1();
 
-		cl_uint2 * const res = _mem.data();
+		_engine.readMemory_m1(_mem.data());
 
-		_engine.readMemory_m1(res);
+		isPrime.resize(_batch.size());
+		res64.resize(_batch.size());
+		for (size_t c = 0; c < _batch.size(); ++c)
+		{
+			const cl_uint2 * const res = &_mem[c * _size];
 
-		bool isPrime = true;
-		for (size_t i = 0, n = _size / 2; i < n; ++i) isPrime &= (res[i].s[0] == 0);
+			bool isP = true;
+			for (size_t i = 0, n = _size / 2; i < n; ++i) isP &= (res[i].s[0] == 0);
 
-		uint64_t r = 0, b = 1;
-		for (size_t i = 0; b != 0; ++i)
-		{
-			r += res[i].s[0] * b;
-			b <<= _digit_bit;
-		}
+			uint64_t r = 0, b = 1;
+			for (size_t i = 0; b != 0; ++i)
+			{
+				r += res[i].s[0] * b;
+				b <<= _digit_bit;
+			}
 
-		res64 = r;
-		return isPrime;
+			isPrime[c] = isP;
+			res64[c] = r;
+		}
 	}
 
 public:
@@ -772,9 +1376,20 @@ public:
 	}
 
 public:
+	// u *= x. The forward transform of x is computed by the next square: the step is delayed.
 	void Gerbicz_step()
 	{
-		// u *= x;
+		_Gerbicz_flush();
+		_GerbiczPending = true;
+	}
+
+private:
+	// the delayed step is computed if x or u is read or modified before the next square
+	void _Gerbicz_flush()
+	{
+		_engine.waitGerbicz();
+		if (!_GerbiczPending) return;
+		_GerbiczPending = false;
 		swap_x_u();
 		setMultiplicand();
 		mul();
@@ -784,11 +1399,16 @@ public:
 public:
 	void Gerbicz_check(const size_t L)
 	{
+		_Gerbicz_flush();
+
 		// v * u^(2^L)
 		_engine.copy_u_m1();		// m1 = u
 		_engine.copy_x_m2();		// m1 = u, m2 = x
 		_engine.copy_u_x();
+		const bool checksum = _checksum;
+		_checksum = false;
 		for (size_t i = 0; i < L; ++i) square();	// x = u^(2^L)
+		_checksum = checksum;
 		_engine.copy_v_u();
 		setMultiplicand();
 		mul();			// x = v * u^(2^L)
@@ -807,7 +1427,8 @@ public:
 	}
 
 private:
-	void split()
+	// if fusedPoly2int then y was computed by poly2int
+	void split(const bool fusedPoly2int)
 	{
 		// Y = [X / k.2^n]
 		// X = Y * k.2^n + R, 0 <= R < k.2^n, 0 <= Y < k.2^n
@@ -823,40 +1444,43 @@ private:
 
 		// Daisuke Takahashi, A parallel algorithm for multiple-precision division by a single-precision integer.
 
-		_engine.reduce_i();
+		if (!fusedPoly2int) _engine.reduce_i();
 
 		// x size is size / 2, x = X mod B^(size / 2), y = X / (B^e * 2^s)
 
-		const cl_uint n = cl_uint(_size / 2);
-		cl_uint j = 4;		// alignment (cl_uint4)
-		cl_uint s = n / 4;
-		for (; s > 256; s /= 64)
+		// the remainders are computed by a single-pass scan or by the tree of the sweep kernels
+		if (!_plan.execScanFn(_engine))
 		{
-			_engine.reduce_upsweep64(s / 16, j);
-			j += 5 * (16 + 4 + 1) * (s / 16);
-		}
+			const cl_uint n = cl_uint(_size / 2);
+			cl_uint j = 4;		// alignment (cl_uint4)
+			cl_uint s = n / 4;
+			for (; s > 256; s /= 64)
+			{
+				_engine.reduce_upsweep64(s / 16, j);
+				j += 5 * (16 + 4 + 1) * (s / 16);
+			}
 
-		if (s == 256)        _engine.reduce_topsweep1024(j);
-		else if (s == 128)   _engine.reduce_topsweep512(j);
-		else if (s == 64)    _engine.reduce_topsweep256(j);
-		else if (s == 32)    _engine.reduce_topsweep128(j);
-		else if (s == 16)    _engine.reduce_topsweep64(j);
-		else /*if (s == 8)*/ _engine.reduce_topsweep32(j);
+			if (radix(_size) != 1) _engine.reduce_topsweep_r(s, j);
+			else if (s == 256)   _engine.reduce_topsweep1024(j);
+			else if (s == 128)   _engine.reduce_topsweep512(j);
+			else if (s == 64)    _engine.reduce_topsweep256(j);
+			else if (s == 32)    _engine.reduce_topsweep128(j);
+			else if (s == 16)    _engine.reduce_topsweep64(j);
+			else /*if (s == 8)*/ _engine.reduce_topsweep32(j);
 
-		while (s < n / 4)
-		{
-			s *= 64;
-			j -= 5 * (16 + 4 + 1) * (s / 16);
-			_engine.reduce_downsweep64(s / 16, j);
+			while (s < n / 4)
+			{
+				s *= 64;
+				j -= 5 * (16 + 4 + 1) * (s / 16);
+				_engine.reduce_downsweep64(s / 16, j);
+			}
 		}
 
 		// t[4 + k] remainders y[k + 1] / d, t[0] = remainder y[0] / d
 
-		_engine.reduce_o();
-
-		// x size is size / 2, x[0] = X mod B^n, x[1] = Y
+		// x[0] = X mod B^n, x[1] = Y then R = r * B^e + X_lo
 
-		_engine.reduce_f();
+		_plan.execReduceFn(_engine);
 
 		// x size is size / 2, _x[0] = R, _x[1] = Y
 	}
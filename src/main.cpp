@@ -7,8 +7,12 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 #include "pio.h"
 #include "ocl.h"
+#include "cpuengine.h"
 #include "proth.h"
 #include "proth_test.h"
+#include "worklist.h"
+#include "scheduler.h"
+#include "sieve.h"
 #include "boinc.h"
 
 #include <cstdlib>
@@ -30,6 +34,7 @@ private:
 	static void quit(int)
 	{
 		proth::getInstance().quit();
+		sieve::getInstance().quit();
 	}
 
 private:
@@ -101,9 +106,18 @@ private:
 		std::ostringstream ss;
 		ss << "Usage: proth20 [options]  options may be specified in any order" << std::endl;
 		ss << "  -q \"k*2^n+1\"            test expression (default primality)" << std::endl;
+		ss << "  -w <file>               primality test of a list of expressions, one per line ('-': standard input)" << std::endl;
+		ss << "  -s <k,k,...> <nmin> <nmax> <file>  sieve k*2^n+1, nmin <= n <= nmax, and write the remaining candidates to the worklist <file>" << std::endl;
+		ss << "  -sp <e>                 sieve bound: p < 2^e (default 40, 16 <= e <= 56)" << std::endl;
 		ss << "  -o <a>                  compute the multiplicative order of a modulo k*2^n+1" << std::endl;
 		ss << "  -f                      Fermat and Generalized Fermat factor test" << std::endl;
 		ss << "  -d <n> or --device <n>  set device number=<n> (default 0)" << std::endl;
+		ss << "  -d <n>,<m>,...          a worklist is tested concurrently on the devices <n>, <m>, ..." << std::endl;
+		ss << "  -b <n>                  the small candidates of a worklist are tested by batches of <n> (n < 200000)" << std::endl;
+		ss << "  -p <p>                  write a proof of power <p> (1 <= p <= 12) of the primality tests" << std::endl;
+		ss << "  -g <c>                  verify the residue at <c> intermediate points (default 16, 0: at the end only)" << std::endl;
+		ss << "  -verify <file>          check a proof, T/2^p squarings instead of a full test" << std::endl;
+		ss << "  -c <n>                  use the native CPU engine with <n> threads (0: all the cores)" << std::endl;
 		ss << "  -v or -V                print the startup banner and immediately exit" << std::endl;
 #ifdef BOINC
 		ss << "  -boinc                  operate as a BOINC client app" << std::endl;
@@ -134,7 +148,7 @@ public:
 		// if -v or -V then print header to stderr and exit
 		for (const std::string & arg : args)
 		{
-			if ((arg[0] == '-') && ((arg[1] == 'v') || (arg[1] == 'V')))
+			if ((arg[0] == '-') && ((arg[1] == 'v') || (arg[1] == 'V')) && (arg != "-verify"))
 			{
 				pio::error(header());
 				if (bBoinc) boinc_finish(EXIT_SUCCESS);
@@ -146,12 +160,14 @@ public:
 
 		if (args.empty()) pio::print(usage());	// print usage, display devices and exit
 
-		ocl::platform platform;
-		platform.displayDevices();
-
-		bool bPrime = false, bOrder = false, bGFN = false;
+		bool bPrime = false, bOrder = false, bGFN = false, bCPU = false;
 		uint32_t k = 0, n = 0, a = 0;
-		size_t d = 0;
+		size_t threadCount = 0, batchCount = 1;
+		uint32_t proofPower = 0, verifyCount = 16;
+		std::vector<size_t> devices;
+		std::string wFilename, vFilename, sFilename;
+		std::vector<uint32_t> sieveK;
+		uint32_t sieveNMin = 0, sieveNMax = 0, sievePLog2 = 40;
 		// parse args
 		for (size_t i = 0, size = args.size(); i < size; ++i)
 		{
@@ -161,18 +177,15 @@ public:
 			else if (arg.substr(0, 2) == "-q")
 			{
 				const std::string exp = ((arg == "-q") && (i + 1 < size)) ? args[++i] : arg.substr(2);
-				auto k_end = exp.find('*');
-				if (k_end != std::string::npos) k = std::atoi(exp.substr(0, k_end).c_str());
-				auto n_start = exp.find('^'), n_end = exp.find('+');
-				if ((n_start != std::string::npos) && (n_end != std::string::npos)) n = std::atoi(exp.substr(n_start + 1, n_end).c_str());
-				if (k > 0) while (k % 2 == 0) { k /= 2; ++n; }				
-				if ((k < 3) || (n < 32)) throw std::runtime_error("invalid expression");
-
+				if (!worklist::parse(exp, k, n)) throw std::runtime_error("invalid expression");
 				if (k > 99999999) throw std::runtime_error("k > 99999999 is not supported");
-				if (n > 99999999) throw std::runtime_error("n > 99999999 is not supported");
-
 				bPrime = true;
 			}
+			else if (arg.substr(0, 2) == "-w")
+			{
+				wFilename = ((arg == "-w") && (i + 1 < size)) ? args[++i] : arg.substr(2);
+				if (wFilename.empty()) throw std::runtime_error("-w: invalid file name");
+			}
 			else if (arg.substr(0, 2) == "-o")
 			{
 				const std::string dev = ((arg == "-o") && (i + 1 < size)) ? args[++i] : arg.substr(2);
@@ -183,17 +196,166 @@ public:
 			else if (arg.substr(0, 2) == "-d")
 			{
 				const std::string dev = ((arg == "-d") && (i + 1 < size)) ? args[++i] : arg.substr(2);
-				d = std::atoi(dev.c_str());
-				if (d >= platform.getDeviceCount()) throw std::runtime_error("invalid device number");
+				devices.clear();
+				std::istringstream ss(dev);
+				for (std::string d; std::getline(ss, d, ',');) devices.push_back(std::atoi(d.c_str()));
+			}
+			else if (arg == "-boinc") continue;	// see bBoinc
+			else if (arg.substr(0, 2) == "-b")
+			{
+				const std::string bc = ((arg == "-b") && (i + 1 < size)) ? args[++i] : arg.substr(2);
+				const int bCount = std::atoi(bc.c_str());
+				if (bCount < 1) throw std::runtime_error("-b: invalid batch size");
+				batchCount = size_t(bCount);
+			}
+			else if (arg == "-s")
+			{
+				if (i + 4 >= size) throw std::runtime_error("-s: <k,k,...> <nmin> <nmax> <file> are expected");
+				std::istringstream ss(args[++i]);
+				for (std::string ks; std::getline(ss, ks, ',');) sieveK.push_back(std::atoi(ks.c_str()));
+				sieveNMin = std::atoi(args[++i].c_str());
+				sieveNMax = std::atoi(args[++i].c_str());
+				sFilename = args[++i];
+				for (const uint32_t ks : sieveK) if ((ks < 3) || (ks % 2 == 0)) throw std::runtime_error("-s: k must be odd and >= 3");
+				if (sieveK.empty() || (sieveNMin < 32) || (sieveNMax < sieveNMin)) throw std::runtime_error("-s: invalid range");
+				worklist::check(*std::max_element(sieveK.begin(), sieveK.end()), sieveNMax);
+			}
+			else if (arg == "-sp")
+			{
+				if (i + 1 < size) sievePLog2 = std::atoi(args[++i].c_str());
+				if ((sievePLog2 < 16) || (sievePLog2 > 56)) throw std::runtime_error("-sp: invalid sieve bound");
+			}
+			else if (arg == "-verify")
+			{
+				if (i + 1 < size) vFilename = args[++i];
+				if (vFilename.empty()) throw std::runtime_error("-verify: invalid file name");
+			}
+			else if (arg.substr(0, 2) == "-p")
+			{
+				const std::string pp = ((arg == "-p") && (i + 1 < size)) ? args[++i] : arg.substr(2);
+				proofPower = std::atoi(pp.c_str());
+				if ((proofPower < 1) || (proofPower > proof::power_max)) throw std::runtime_error("-p: invalid proof power");
+			}
+			else if (arg.substr(0, 2) == "-g")
+			{
+				const std::string gc = ((arg == "-g") && (i + 1 < size)) ? args[++i] : arg.substr(2);
+				verifyCount = std::atoi(gc.c_str());
+			}
+			else if (arg.substr(0, 2) == "-c")
+			{
+				const std::string thd = ((arg == "-c") && (i + 1 < size)) ? args[++i] : arg.substr(2);
+				threadCount = std::atoi(thd.c_str());
+				bCPU = true;
 			}
 		}
 
+		// the native CPU engine doesn't need an OpenCL platform
+		std::unique_ptr<ocl::platform> pPlatform;
+		if (!bCPU)
+		{
+			pPlatform = std::unique_ptr<ocl::platform>(new ocl::platform());
+			pPlatform->displayDevices();
+		}
+		if (devices.empty() || bCPU) devices.assign(1, 0);
+		if (!bCPU) for (const size_t d : devices) if (d >= pPlatform->getDeviceCount()) throw std::runtime_error("invalid device number");
+
+		auto createEngine = [&](const size_t d) -> engine *
+		{
+			if (bCPU) return new cpuEngine(threadCount);
+			return new oclEngine(*pPlatform, d);
+		};
+
 		proth & p = proth::getInstance();
 		p.setBoinc(bBoinc);
+		p.setProofPower(proofPower);
+		p.setVerifyCount(verifyCount);
+
+		if (!wFilename.empty())
+		{
+			if (bBoinc || bPrime || bOrder || bGFN) throw std::runtime_error("-w: the worklist is a list of primality tests");
+
+			if ((batchCount > 1) && bCPU) throw std::runtime_error("-b: the native CPU engine doesn't support the batched mode");
+			if ((batchCount > 1) && (devices.size() > 1)) throw std::runtime_error("-b: a batched worklist is tested on a single device");
+			if ((batchCount > 1) && (proofPower != 0)) throw std::runtime_error("-b: the proof of a batch is not supported");
+
+			worklist wl(wFilename);
+			p.setWorklist(true);
+			if (devices.size() > 1)
+			{
+				// an engine per device, the candidates are shared
+				std::vector<std::unique_ptr<engine>> pEngines;
+				std::vector<engine *> engines;
+				for (const size_t d : devices) { pEngines.emplace_back(createEngine(d)); engines.push_back(pEngines.back().get()); }
+				scheduler sched(wl, p, engines.size());
+				sched.run(engines);
+			}
+			else
+			{
+				// the engine and its context are created once
+				std::unique_ptr<engine> pEngine(createEngine(devices[0]));
+				engine & engine = *pEngine;
+				// the digits of a batch are not balanced
+				auto isValid = [](const uint32_t k, const uint32_t n)
+				{
+					try { worklist::check(k, n); return true; }
+					catch (const std::runtime_error &) { return false; }
+				};
+
+				bool next = wl.next(k, n);
+				while (next)
+				{
+					try { worklist::check(k, n, engine.hasBalancedDigits(), engine.hasRNS3()); }
+					catch (const std::runtime_error & e)
+					{
+						std::ostringstream ss; ss << "warning: " << k << " * 2^" << n << " + 1: " << e.what() << ", skipped." << std::endl;
+						pio::error(ss.str());
+						wl.done();
+						next = wl.next(k, n);
+						continue;
+					}
+
+					// the next candidates of the list are added to the batch while they have the same transform size
+					std::vector<std::pair<uint32_t, uint32_t>> batch(1, std::make_pair(k, n));
+					std::vector<size_t> indices(1, wl.getIndex());
+					next = wl.next(k, n);
+					if ((batchCount > 1) && gpmp::isBatchable(batch[0].first, batch[0].second, batch[0].first, batch[0].second))
+					{
+						while (next && (batch.size() < batchCount) && isValid(k, n) && gpmp::isBatchable(batch[0].first, batch[0].second, k, n))
+						{
+							batch.push_back(std::make_pair(k, n));
+							indices.push_back(wl.getIndex());
+							next = wl.next(k, n);
+						}
+					}
+
+					const bool completed = (batch.size() == 1) ? p.check(batch[0].first, batch[0].second, engine) : p.check_batch(batch, engine);
+					if (!completed) break;
+					for (const size_t index : indices) wl.done(index);
+				}
+			}
+		}
+
+		if (!sFilename.empty())
+		{
+			if (bBoinc || bPrime || !wFilename.empty() || !vFilename.empty()) throw std::runtime_error("-s: the sieve is run alone");
+			std::unique_ptr<sieveEngine> pEngine;
+			if (bCPU) pEngine = std::unique_ptr<sieveEngine>(new cpuSieveEngine(threadCount));
+			else pEngine = std::unique_ptr<sieveEngine>(new oclSieveEngine(*pPlatform, devices[0]));
+			sieve::getInstance().run(sieveK, sieveNMin, sieveNMax, sievePLog2, sFilename, *pEngine);
+		}
+
+		if (!vFilename.empty())
+		{
+			if (bBoinc || bPrime || !wFilename.empty()) throw std::runtime_error("-verify: a proof is checked alone");
+			std::unique_ptr<engine> pEngine(createEngine(devices[0]));
+			if (!p.verify(vFilename, *pEngine)) throw std::runtime_error("the proof '" + vFilename + "' is not valid");
+		}
 
 		if (bPrime)
 		{
-			engine engine(platform, d);
+			std::unique_ptr<engine> pEngine(createEngine(devices[0]));
+			engine & engine = *pEngine;
+			worklist::check(k, n, engine.hasBalancedDigits(), engine.hasRNS3());
 			if (bOrder) p.check_order(k, n, a, engine);
 			else if (bGFN) p.check_gfn(k, n, engine);
 			else p.check(k, n, engine);
@@ -203,11 +365,13 @@ public:
 
 		// gpmp::printRanges(10000);
 
-		// engine engine0(platform, 0);
+		// oclEngine engine0(*pPlatform, 0);
 		// test Intel GPU
-		// engine engine1(platform, 1);
+		// oclEngine engine1(*pPlatform, 1);
 		// test CPU
-		// engine engine2(platform, 2);
+		// oclEngine engine2(*pPlatform, 2);
+		// native CPU engine
+		// cpuEngine engine3(0);
 
 		// function profiling
 		// proth_test::profile(13, 5523860, engine0);		// DIV
@@ -207,11 +207,15 @@ private:
 	cl_ulong _localMemSize = 0;
 	size_t _maxWorkGroupSize = 0;
 	cl_ulong _timerResolution = 0;
+	bool _isCPU = false;
 	cl_context _context = nullptr;
 	cl_command_queue _queueF = nullptr;
 	cl_command_queue _queueP = nullptr;
 	cl_command_queue _queue = nullptr;
+	cl_command_queue _queueS = nullptr;	// second queue, its commands overlap the commands of the main queue
+	cl_event _eventS = nullptr;			// the end of the commands of the second queue
 	cl_program _program = nullptr;
+	std::string _name, _deviceVersion, _driverVersion;
 
 	enum class EVendor { Unknown, NVIDIA, AMD, INTEL };
 
@@ -251,6 +255,12 @@ public:
 		cl_ulong memConstSize; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(memConstSize), &memConstSize, nullptr));
 		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(_maxWorkGroupSize), &_maxWorkGroupSize, nullptr));
 		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_PROFILING_TIMER_RESOLUTION, sizeof(_timerResolution), &_timerResolution, nullptr));
+		cl_device_type deviceType; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_TYPE, sizeof(deviceType), &deviceType, nullptr));
+		_isCPU = ((deviceType & CL_DEVICE_TYPE_CPU) != 0);
+
+		_name = deviceName;
+		_deviceVersion = deviceVersion;
+		_driverVersion = driverVersion;
 
 		std::ostringstream ssd;
 		ssd << "Running on device '" << deviceName<< "', vendor '" << deviceVendor
@@ -269,6 +279,8 @@ public:
 		_queueP = clCreateCommandQueue(_context, _device, CL_QUEUE_PROFILING_ENABLE, &err_ccq);
 		_queue = _queueF;	// default queue is fast
 		oclFatal(err_ccq);
+		_queueS = clCreateCommandQueue(_context, _device, 0, &err_ccq);
+		oclFatal(err_ccq);
 
 		if (getVendor(deviceVendor) != EVendor::NVIDIA) _isSync = true;
 	}
@@ -280,6 +292,8 @@ public:
 		std::ostringstream ss; ss << "Delete ocl device " << _d << "." << std::endl;
 		pio::display(ss.str());
 #endif
+		if (_eventS != nullptr) oclFatal(clReleaseEvent(_eventS));
+		oclFatal(clReleaseCommandQueue(_queueS));
 		oclFatal(clReleaseCommandQueue(_queue));
 		oclFatal(clReleaseContext(_context));
 	}
@@ -287,6 +301,9 @@ public:
 public:
 	size_t getMaxWorkGroupSize() const { return _maxWorkGroupSize; }
 	size_t getLocalMemSize() const { return _localMemSize; }
+	bool isCPU() const { return _isCPU; }
+	const std::string & getName() const { return _name; }
+	const std::string & getDriverVersion() const { return _driverVersion; }
 
 private:
 	static EVendor getVendor(const std::string & vendorString)
@@ -352,28 +369,42 @@ public:
 		resetProfiles();
 	}
 
-public:
-	void loadProgram(const std::string & programSrc)
+private:
+	// FNV-1a
+	static uint64_t _hash(const std::string & str, const uint64_t h0 = 14695981039346656037ull)
 	{
-#if defined (ocl_debug)
-		std::ostringstream ss; ss << "Load ocl program." << std::endl;
-		pio::display(ss.str());
-#endif
-		const char * src[1]; src[0] = programSrc.c_str();
-		cl_int err_cpws;
-		_program = clCreateProgramWithSource(_context, 1, src, nullptr, &err_cpws);
-		oclFatal(err_cpws);
+		uint64_t h = h0;
+		for (const char c : str) { h ^= uint8_t(c); h *= 1099511628211ull; }
+		h ^= 0; h *= 1099511628211ull;	// separator
+		return h;
+	}
 
-		char pgmOptions[1024];
-		strcpy(pgmOptions, "");
-#if defined (ocl_debug)
-		strcat(pgmOptions, " -cl-nv-verbose");
-#endif
+private:
+	uint64_t _programHash(const std::string & programSrc, const char * const pgmOptions) const
+	{
+		uint64_t h = _hash(programSrc);
+		h = _hash(pgmOptions, h);
+		h = _hash(_name, h);
+		h = _hash(_deviceVersion, h);
+		h = _hash(_driverVersion, h);
+		return h;
+	}
+
+private:
+	static std::string _binaryFilename(const uint64_t hash)
+	{
+		std::ostringstream ss; ss << "proth_" << std::hex << std::setfill('0') << std::setw(16) << hash << ".bin";
+		return ss.str();
+	}
+
+private:
+	cl_int _buildProgram(const char * const pgmOptions, const bool printLog)
+	{
 		const cl_int err = clBuildProgram(_program, 1, &_device, pgmOptions, nullptr, nullptr);
 
 #if !defined (ocl_debug)
-		if (err != CL_SUCCESS)
-#endif		
+		if ((err != CL_SUCCESS) && printLog)
+#endif
 		{
 			size_t logSize; clGetProgramBuildInfo(_program, _device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
 			if (logSize > 2)
@@ -391,14 +422,101 @@ public:
 			}
 		}
 
-		oclFatal(err);
+		return err;
+	}
+
+private:
+	std::vector<unsigned char> _getBinary() const
+	{
+		size_t binSize = 0;
+		if (!oclError(clGetProgramInfo(_program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binSize, nullptr)) || (binSize == 0)) return {};
+		std::vector<unsigned char> binary(binSize);
+		unsigned char * ptr = binary.data();
+		if (!oclError(clGetProgramInfo(_program, CL_PROGRAM_BINARIES, sizeof(unsigned char *), &ptr, nullptr))) return {};
+		return binary;
+	}
+
+private:
+	// The binary file is 'proth20b', the hash of the source and device and the binary. Any failure means the cache is invalid.
+	bool _loadBinary(const uint64_t hash, const char * const pgmOptions)
+	{
+		FILE * const binFile = pio::open(_binaryFilename(hash).c_str(), "rb");
+		if (binFile == nullptr) return false;
+
+		char magic[8]; uint64_t fhash = 0, binSize = 0;
+		bool success = (std::fread(magic, sizeof(char), 8, binFile) == 8) && (std::memcmp(magic, "proth20b", 8) == 0);
+		success &= (std::fread(&fhash, sizeof(fhash), 1, binFile) == 1) && (fhash == hash);
+		success &= (std::fread(&binSize, sizeof(binSize), 1, binFile) == 1) && (binSize != 0) && (binSize < (uint64_t(1) << 30));
+		std::vector<unsigned char> binary;
+		if (success)
+		{
+			binary.resize(size_t(binSize));
+			success = (std::fread(binary.data(), sizeof(unsigned char), binary.size(), binFile) == binary.size());
+		}
+		std::fclose(binFile);
+		if (!success) return false;
+
+		const size_t length = binary.size();
+		const unsigned char * bin[1]; bin[0] = binary.data();
+		cl_int binStatus, err_cpwb;
+		_program = clCreateProgramWithBinary(_context, 1, &_device, &length, bin, &binStatus, &err_cpwb);
+		if (!oclError(err_cpwb) || !oclError(binStatus) || !oclError(_buildProgram(pgmOptions, false)))
+		{
+			if (_program != nullptr) clReleaseProgram(_program);
+			_program = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	void _saveBinary(const uint64_t hash) const
+	{
+		const std::vector<unsigned char> binary = _getBinary();
+		if (binary.empty()) return;
+
+		FILE * const binFile = pio::open(_binaryFilename(hash).c_str(), "wb");
+		if (binFile == nullptr) return;		// the cache is optional
+
+		const uint64_t binSize = binary.size();
+		bool success = (std::fwrite("proth20b", sizeof(char), 8, binFile) == 8);
+		success &= (std::fwrite(&hash, sizeof(hash), 1, binFile) == 1);
+		success &= (std::fwrite(&binSize, sizeof(binSize), 1, binFile) == 1);
+		success &= (std::fwrite(binary.data(), sizeof(unsigned char), binary.size(), binFile) == binary.size());
+		std::fclose(binFile);
+		if (!success) std::remove(_binaryFilename(hash).c_str());
+	}
 
+public:
+	void loadProgram(const std::string & programSrc, const bool useCache = true)
+	{
 #if defined (ocl_debug)
-		size_t binSize; clGetProgramInfo(_program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binSize, nullptr);
-		std::vector<char> binary(binSize);
-		clGetProgramInfo(_program, CL_PROGRAM_BINARIES, sizeof(char *), &binary, nullptr);
+		std::ostringstream ss; ss << "Load ocl program." << std::endl;
+		pio::display(ss.str());
+#endif
+		char pgmOptions[1024];
+		strcpy(pgmOptions, "");
+#if defined (ocl_debug)
+		strcat(pgmOptions, " -cl-nv-verbose");
+#endif
+
+		// the key of the binary cache is the source (the preamble included), the options and the identity of the device
+		const uint64_t hash = _programHash(programSrc, pgmOptions);
+		if (useCache && _loadBinary(hash, pgmOptions)) return;
+
+		const char * src[1]; src[0] = programSrc.c_str();
+		cl_int err_cpws;
+		_program = clCreateProgramWithSource(_context, 1, src, nullptr, &err_cpws);
+		oclFatal(err_cpws);
+
+		oclFatal(_buildProgram(pgmOptions, true));
+
+		if (useCache) _saveBinary(hash);
+
+#if defined (ocl_debug)
+		const std::vector<unsigned char> binary = _getBinary();
 		std::ofstream fileOut("pgm.txt", std::ios::binary);
-		fileOut.write(binary.data(), binSize);
+		fileOut.write(reinterpret_cast<const char *>(binary.data()), binary.size());
 		fileOut.close();
 #endif	
 	}
@@ -422,6 +540,38 @@ private:
 		oclFatal(clFinish(_queue));
 	}
 
+protected:
+	// The next commands are enqueued on the second queue, they start after the commands of the main queue.
+	// The profiling queue is not duplicated: if profiling is enabled then the commands are serial.
+	void _beginSecondQueue()
+	{
+		if (_profile) return;
+		cl_event evt;
+		oclFatal(clEnqueueMarker(_queue, &evt));
+		oclFatal(clFlush(_queue));
+		_queue = _queueS;
+		oclFatal(clEnqueueWaitForEvents(_queue, 1, &evt));
+		oclFatal(clReleaseEvent(evt));
+	}
+
+	void _endSecondQueue()
+	{
+		if (_profile) return;
+		if (_eventS != nullptr) oclFatal(clReleaseEvent(_eventS));
+		oclFatal(clEnqueueMarker(_queue, &_eventS));
+		oclFatal(clFlush(_queue));
+		_queue = _queueF;
+	}
+
+	// the next commands of the main queue start after the commands of the second queue
+	void _waitSecondQueue()
+	{
+		if (_eventS == nullptr) return;
+		oclFatal(clEnqueueWaitForEvents(_queue, 1, &_eventS));
+		oclFatal(clReleaseEvent(_eventS));
+		_eventS = nullptr;
+	}
+
 protected:
 	cl_mem _createBuffer(const cl_mem_flags flags, const size_t size, const bool clear = true) const
 	{
@@ -494,14 +644,19 @@ protected:
 	}
 
 protected:
-	void _executeKernel(cl_kernel kernel, const size_t globalWorkSize, const size_t localWorkSize = 0)
+	// if batchCount > 1 then the range is two-dimensional and the second dimension is the index of the candidate
+	void _executeKernel(cl_kernel kernel, const size_t globalWorkSize, const size_t localWorkSize = 0, const size_t batchCount = 1)
 	{
+		const cl_uint workDim = (batchCount > 1) ? 2 : 1;
+		const size_t global[2] = { globalWorkSize, batchCount }, local[2] = { localWorkSize, 1 };
+		const size_t * const pLocal = (localWorkSize == 0) ? nullptr : local;
+
 		if (!_profile)
 		{
 #if !defined (ocl_fast_exec) || defined (ocl_debug)
 			cl_int err =
 #endif
-			clEnqueueNDRangeKernel(_queue, kernel, 1, nullptr, &globalWorkSize, (localWorkSize == 0) ? nullptr : &localWorkSize, 0, nullptr, nullptr);
+			clEnqueueNDRangeKernel(_queue, kernel, workDim, nullptr, global, pLocal, 0, nullptr, nullptr);
 #if !defined (ocl_fast_exec) || defined (ocl_debug)
 			oclFatal(err);
 #endif
@@ -515,7 +670,7 @@ protected:
 		{
 			_sync();
 			cl_event evt;
-			oclFatal(clEnqueueNDRangeKernel(_queue, kernel, 1, nullptr, &globalWorkSize, (localWorkSize == 0) ? nullptr : &localWorkSize, 0, nullptr, &evt));
+			oclFatal(clEnqueueNDRangeKernel(_queue, kernel, workDim, nullptr, global, pLocal, 0, nullptr, &evt));
 			cl_ulong dt = 0;
 			if (clWaitForEvents(1, &evt) == CL_SUCCESS)
 			{
@@ -18,33 +18,37 @@ static const char * const src_ocl_NTT = \
 "*/\n" \
 "\n" \
 "__kernel\n" \
-"void ntt4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)\n" \
+"void ntt4(__global rns * restrict x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"\n" \
 "	const size_t k = get_global_id(0);\n" \
 "\n" \
 "	const size_t i = k & (m - 1), j = 4 * k - 3 * i;\n" \
 "\n" \
-"	const uint2 r2_i = r2[rindex + i];\n" \
-"	const uint4 r1ir1_i = r1ir1[rindex + i];\n" \
+"	const rns r2_i = r2[rindex + i];\n" \
+"	const rns2 r1ir1_i = r1ir1[rindex + i];\n" \
 "\n" \
-"	const uint2 u0 = x[j + 0 * m], u2 = x[j + 2 * m], u1 = x[j + 1 * m], u3 = x[j + 3 * m];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = x[j + 0 * m], u2 = x[j + 2 * m], u1 = x[j + 1 * m], u3 = x[j + 3 * m];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	x[j + 0 * m] = addmod(v0, v1); x[j + 1 * m] = mulmod(submod(v0, v1), r2_i);\n" \
-"	x[j + 2 * m] = mulmod(addmod(v2, v3), r1ir1_i.s23); x[j + 3 * m] = mulmod(submod(v2, v3), r1ir1_i.s01);\n" \
+"	x[j + 2 * m] = mulmod(addmod(v2, v3), r1ir1_i.hi); x[j + 3 * m] = mulmod(submod(v2, v3), r1ir1_i.lo);\n" \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void intt4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)\n" \
+"void intt4(__global rns * restrict x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"\n" \
 "	const size_t k = get_global_id(0);\n" \
 "\n" \
 "	const size_t i = k & (m - 1), j = 4 * k - 3 * i;\n" \
 "\n" \
-"	const uint2 ir2_i = ir2[rindex + i];\n" \
-"	const uint4 r1ir1_i = r1ir1[rindex + i];\n" \
+"	const rns ir2_i = ir2[rindex + i];\n" \
+"	const rns2 r1ir1_i = r1ir1[rindex + i];\n" \
 "\n" \
-"	const uint2 v0 = x[j + 0 * m], v1 = mulmod(x[j + 1 * m], ir2_i), v2 = mulmod(x[j + 2 * m], r1ir1_i.s01), v3 = mulmod(x[j + 3 * m], r1ir1_i.s23);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = x[j + 0 * m], v1 = mulmod(x[j + 1 * m], ir2_i), v2 = mulmod(x[j + 2 * m], r1ir1_i.lo), v3 = mulmod(x[j + 3 * m], r1ir1_i.hi);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	x[j + 0 * m] = addmod(u0, u2); x[j + 2 * m] = submod(u0, u2);\n" \
 "	x[j + 1 * m] = addmod(u1, u3); x[j + 3 * m] = submod(u1, u3);\n" \
 "}\n" \
@@ -66,11 +70,16 @@ static const char * const src_ocl_NTT = \
 "	_backward4(M * CHUNK, &X[i * CHUNK | chunk_idx], ir2[R + j], r1ir1[R + j]); \\\n" \
 "}\n" \
 "\n" \
+"#if defined(RADIX)\n" \
+"// The first stage was computed by radix_sub: the input of the radix-4 stages is not zero-padded.\n" \
+"#define SUB_FORWARD4i(M, CHUNK)	FORWARD4i(M, CHUNK, 0)\n" \
+"#else\n" \
 "#define SUB_FORWARD4i(M, CHUNK) \\\n" \
 "{ \\\n" \
 "	const size_t j = threadIdx * m | bl_i; \\\n" \
-"	_sub_forward4i(M * CHUNK, &X[threadIdx * CHUNK | chunk_idx], M * m, &xo[j], r2[j], r1ir1[j]); \\\n" \
+"	_sub_forward4i(M * CHUNK, &X[threadIdx * CHUNK | chunk_idx], M * m, &xo[j], &bd[batch_offset(pconst_size / 2) + j], r2[j], r1ir1[j]); \\\n" \
 "}\n" \
+"#endif\n" \
 "\n" \
 "#define FORWARD4i(M, CHUNK, R) \\\n" \
 "{ \\\n" \
@@ -98,18 +107,38 @@ static const char * const src_ocl_NTT = \
 "\n" \
 "\n" \
 "#define SETVAR(M, CHUNK) \\\n" \
-"	__local uint2 X[M * CHUNK]; \\\n" \
+"	__local rns X[M * CHUNK]; \\\n" \
 "	const size_t local_id = get_local_id(0), chunk_idx = local_id % CHUNK, threadIdx = local_id / CHUNK, block_idx = get_group_id(0) * CHUNK;\n" \
 "\n" \
+"// If the size is RADIX * L then the first and the last stages are the transforms of the RADIX blocks of size L.\n" \
 "#define SETVAR_FL_NTT(M) \\\n" \
-"	__global uint2 * const xo = x; \\\n" \
-"	const size_t bl_i = block_idx | chunk_idx; \\\n" \
-"	const size_t m = (pconst_size / 4) / (M / 4);\n" \
+"	const size_t m = (pconst_L / 4) / (M / 4); \\\n" \
+"	__global rns * const xo = &x[batch_offset(pconst_size) + M * (block_idx & ~(m - 1))]; \\\n" \
+"	const size_t bl_i = (block_idx & (m - 1)) | chunk_idx;\n" \
 "\n" \
 "#define SETVAR_NTT(M) \\\n" \
-"	__global uint2 * const xo = &x[M * (block_idx & ~(m - 1))]; \\\n" \
+"	__global rns * const xo = &x[batch_offset(pconst_size) + M * (block_idx & ~(m - 1))]; \\\n" \
 "	const size_t bl_i = (block_idx & (m - 1)) | chunk_idx;\n" \
 "\n" \
+"// The last stage of the inverse transform is computed in local memory then the digits are converted as in poly2int0.\n" \
+"// X[i * CHUNK | c] is x[i * m | block_idx | c]: if CHUNK >= 4 then a block of 4 digits is contiguous in local memory.\n" \
+"#define P2I_LST(CHUNK) \\\n" \
+"{ \\\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE); \\\n" \
+"	const size_t i = (4 * local_id) / CHUNK, c = (4 * local_id) % CHUNK; \\\n" \
+"	const size_t k = i * m | block_idx | c; \\\n" \
+"	__local const rns * const Xk = &X[4 * local_id]; \\\n" \
+"	long l = 0; \\\n" \
+"	for (size_t j = 0; j < 4; ++j) \\\n" \
+"	{ \\\n" \
+"		uint d; const long h = getcarry(mulmod(Xk[j], pconst_norm), &d); \\\n" \
+"		l += d; \\\n" \
+"		xo[k + j].s0 = (uint)(l) & digit_mask; \\\n" \
+"		l = (l >> digit_bit) + h; \\\n" \
+"	} \\\n" \
+"	cr[batch_offset(pconst_size / 4) + ((k / 4 + 1) & (pconst_size / 4 - 1))] = l; \\\n" \
+"}\n" \
+"\n" \
 "\n" \
 "#define SUB_NTT64(CHUNK) \\\n" \
 "	SETVAR(64, CHUNK); \\\n" \
@@ -125,6 +154,14 @@ static const char * const src_ocl_NTT = \
 "	BACKWARD4(4, CHUNK, 16 * m); \\\n" \
 "	BACKWARD4o(16, CHUNK, 0);\n" \
 "\n" \
+"#define LST_INTT64_P2I(CHUNK) \\\n" \
+"	SETVAR(64, CHUNK); \\\n" \
+"	SETVAR_FL_NTT(64); \\\n" \
+"	BACKWARD4i(CHUNK, 16 * m + 4 * m); \\\n" \
+"	BACKWARD4(4, CHUNK, 16 * m); \\\n" \
+"	BACKWARD4(16, CHUNK, 0); \\\n" \
+"	P2I_LST(CHUNK);\n" \
+"\n" \
 "#define NTT64(CHUNK) \\\n" \
 "	SETVAR(64, CHUNK); \\\n" \
 "	SETVAR_NTT(64); \\\n" \
@@ -155,6 +192,15 @@ static const char * const src_ocl_NTT = \
 "	BACKWARD4(16, CHUNK, 64 * m); \\\n" \
 "	BACKWARD4o(64, CHUNK, 0);\n" \
 "\n" \
+"#define LST_INTT256_P2I(CHUNK) \\\n" \
+"	SETVAR(256, CHUNK); \\\n" \
+"	SETVAR_FL_NTT(256); \\\n" \
+"	BACKWARD4i(CHUNK, 64 * m + 16 * m + 4 * m); \\\n" \
+"	BACKWARD4(4, CHUNK, 64 * m + 16 * m); \\\n" \
+"	BACKWARD4(16, CHUNK, 64 * m); \\\n" \
+"	BACKWARD4(64, CHUNK, 0); \\\n" \
+"	P2I_LST(CHUNK);\n" \
+"\n" \
 "#define NTT256(CHUNK) \\\n" \
 "	SETVAR(256, CHUNK); \\\n" \
 "	SETVAR_NTT(256); \\\n" \
@@ -189,6 +235,16 @@ static const char * const src_ocl_NTT = \
 "	BACKWARD4(64, CHUNK, 256 * m); \\\n" \
 "	BACKWARD4o(256, CHUNK, 0);\n" \
 "\n" \
+"#define LST_INTT1024_P2I(CHUNK) \\\n" \
+"	SETVAR(1024, CHUNK); \\\n" \
+"	SETVAR_FL_NTT(1024); \\\n" \
+"	BACKWARD4i(CHUNK, 256 * m + 64 * m + 16 * m + 4 * m); \\\n" \
+"	BACKWARD4(4, CHUNK, 256 * m + 64 * m + 16 * m); \\\n" \
+"	BACKWARD4(16, CHUNK, 256 * m + 64 * m); \\\n" \
+"	BACKWARD4(64, CHUNK, 256 * m); \\\n" \
+"	BACKWARD4(256, CHUNK, 0); \\\n" \
+"	P2I_LST(CHUNK);\n" \
+"\n" \
 "#define NTT1024(CHUNK) \\\n" \
 "	SETVAR(1024, CHUNK); \\\n" \
 "	SETVAR_NTT(1024); \\\n" \
@@ -208,76 +264,188 @@ static const char * const src_ocl_NTT = \
 "	BACKWARD4o(256, CHUNK, rindex);\n" \
 "\n" \
 "\n" \
+"#if defined(BALANCED)\n" \
+"// The digits of R - Y are balanced before the forward transform: d = s0 - s1 is reduced into [-B/2, B/2[ and its carry\n" \
+"// is added to the next digit. The carry is not propagated further, then |d| <= B/2 + 1.\n" \
+"// x[k - 1] is read by the work-item k: x is not modified and the digits are written into bd, they are read by sub_ntt.\n" \
+"inline int _carry_b(const rns ab) { return ((int)(ab.s0) - (int)(ab.s1) + (int)(1u << (digit_bit - 1))) >> digit_bit; }\n" \
+"\n" \
+"__kernel\n" \
+"void balance(__global const rns * restrict x, __global int * restrict bd)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	bd += batch_offset(pconst_size / 2);\n" \
+"\n" \
+"	const size_t k = get_global_id(0);\n" \
+"	const rns ab = x[k];\n" \
+"	const int c = _carry_b(ab), c_prev = (k != 0) ? _carry_b(x[k - 1]) : 0;\n" \
+"	bd[k] = (int)(ab.s0) - (int)(ab.s1) - c * (int)(1u << digit_bit) + c_prev;\n" \
+"}\n" \
+"#endif\n" \
+"\n" \
+"#if defined(RADIX)\n" \
+"// The first stage of a transform of size RADIX * L, the elements j + t.L, 0 <= t < RADIX. The blocks [s.L, (s + 1).L) are\n" \
+"// then transformed by the radix-4 stages: x[j + s.L] = w^{j.s} sum_t x[j + t.L].w^{L.s.t}. The upper half of the input is zero.\n" \
+"// The last stage of the inverse transform is the forward DFT with the reversed outputs. w[i] = w^i, w is a root of order size.\n" \
+"// The arithmetic is modulo PG: w3^2 = -1 - w3 and, if s = 1 or 2, w5^s.a_1 + w5^-s.a_4 = u_s.(a_1 + a_4) + v_s.(a_1 - a_4),\n" \
+"// where u_s = (w5^s + w5^-s) / 2 and v_s = (w5^s - w5^-s) / 2.\n" \
+"inline uint2 halfmod(const uint2 lhs)\n" \
+"{\n" \
+"	const ulong l = as_ulong(lhs);\n" \
+"	return as_uint2((l >> 1) + (((l & 1) != 0) ? (PG + 1) / 2 : 0));\n" \
+"}\n" \
+"\n" \
+"inline void _dft(uint2 * const a, __global const uint2 * restrict const w)\n" \
+"{\n" \
+"#if RADIX == 3\n" \
+"	const uint2 d = mulmod(submod(a[1], a[2]), w[pconst_L]);\n" \
+"	const uint2 b0 = addmod(a[0], addmod(a[1], a[2])), b1 = addmod(submod(a[0], a[2]), d), b2 = submod(submod(a[0], a[1]), d);\n" \
+"	a[0] = b0; a[1] = b1; a[2] = b2;\n" \
+"#else\n" \
+"	const uint2 w1 = w[1 * pconst_L], w2 = w[2 * pconst_L], w3 = w[3 * pconst_L], w4 = w[4 * pconst_L];\n" \
+"	const uint2 u1 = halfmod(addmod(w1, w4)), u2 = halfmod(addmod(w2, w3)), v1 = halfmod(submod(w1, w4)), v2 = halfmod(submod(w2, w3));\n" \
+"	const uint2 b1 = addmod(a[1], a[4]), c1 = submod(a[1], a[4]), b2 = addmod(a[2], a[3]), c2 = submod(a[2], a[3]);\n" \
+"	const uint2 s1 = addmod(a[0], addmod(mulmod(u1, b1), mulmod(u2, b2)));\n" \
+"	const uint2 s2 = addmod(a[0], addmod(mulmod(u2, b1), mulmod(u1, b2)));\n" \
+"	const uint2 t1 = addmod(mulmod(v1, c1), mulmod(v2, c2)), t2 = submod(mulmod(v2, c1), mulmod(v1, c2));\n" \
+"	a[0] = addmod(a[0], addmod(b1, b2));\n" \
+"	a[1] = addmod(s1, t1); a[4] = submod(s1, t1);\n" \
+"	a[2] = addmod(s2, t2); a[3] = submod(s2, t2);\n" \
+"#endif\n" \
+"}\n" \
+"\n" \
+"// The digits of R - Y are read from x or, if they are balanced, from bd\n" \
+"__kernel\n" \
+"void radix_sub(__global uint2 * restrict x, __global const uint2 * restrict const w, __global const int * restrict const bd)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"\n" \
+"	const size_t j = get_global_id(0);\n" \
+"\n" \
+"	uint2 a[RADIX];\n" \
+"	for (size_t t = 0; t < RADIX; ++t)\n" \
+"	{\n" \
+"		const size_t k = j + t * pconst_L;\n" \
+"		if (k < pconst_size / 2)\n" \
+"		{\n" \
+"#if defined(BALANCED)\n" \
+"			a[t] = toModInt(bd[batch_offset(pconst_size / 2) + k]);\n" \
+"#else\n" \
+"			const uint2 ab = x[k];\n" \
+"			a[t] = submod(toMod(ab.s0), toMod(ab.s1));\n" \
+"#endif\n" \
+"		}\n" \
+"		else a[t] = toMod(0);\n" \
+"	}\n" \
+"\n" \
+"	_dft(a, w);\n" \
+"\n" \
+"	for (size_t s = 0; s < RADIX; ++s) x[j + s * pconst_L] = mulmod(a[s], w[j * s]);\n" \
+"}\n" \
+"\n" \
+"__kernel\n" \
+"void radix_lst(__global uint2 * restrict x, __global const uint2 * restrict const w, __global const uint2 * restrict const iw)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"\n" \
+"	const size_t j = get_global_id(0);\n" \
+"\n" \
+"	uint2 a[RADIX];\n" \
+"	for (size_t s = 0; s < RADIX; ++s) a[s] = mulmod(x[j + s * pconst_L], iw[j * s]);\n" \
+"\n" \
+"	_dft(a, w);\n" \
+"\n" \
+"	for (size_t t = 0; t < RADIX; ++t) x[j + t * pconst_L] = a[(RADIX - t) % RADIX];\n" \
+"}\n" \
+"#endif\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))\n" \
-"void sub_ntt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)\n" \
+"void sub_ntt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,\n" \
+"	__global const int * restrict const bd)\n" \
 "{\n" \
 "	SUB_NTT64(16);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))\n" \
-"void lst_intt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)\n" \
+"void lst_intt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)\n" \
 "{\n" \
 "	LST_INTT64(16);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))\n" \
-"void ntt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)\n" \
+"void lst_intt64_16_p2i(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2,\n" \
+"	__global long * restrict const cr)\n" \
+"{\n" \
+"	LST_INTT64_P2I(16);\n" \
+"}\n" \
+"\n" \
+"__kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))\n" \
+"void ntt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)\n" \
 "{\n" \
 "	NTT64(16);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(64 / 4 * 16, 1, 1)))\n" \
-"void intt64_16(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)\n" \
+"void intt64_16(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)\n" \
 "{\n" \
 "	INTT64(16);\n" \
 "}\n" \
 "\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))\n" \
-"void sub_ntt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)\n" \
+"void sub_ntt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,\n" \
+"	__global const int * restrict const bd)\n" \
 "{\n" \
 "	SUB_NTT256(4);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))\n" \
-"void lst_intt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)\n" \
+"void lst_intt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)\n" \
 "{\n" \
 "	LST_INTT256(4);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))\n" \
-"void ntt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)\n" \
+"void lst_intt256_4_p2i(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2,\n" \
+"	__global long * restrict const cr)\n" \
+"{\n" \
+"	LST_INTT256_P2I(4);\n" \
+"}\n" \
+"\n" \
+"__kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))\n" \
+"void ntt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)\n" \
 "{\n" \
 "	NTT256(4);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(256 / 4 * 4, 1, 1)))\n" \
-"void intt256_4(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)\n" \
+"void intt256_4(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)\n" \
 "{\n" \
 "	INTT256(4);\n" \
 "}\n" \
 "\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))\n" \
-"void sub_ntt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2)\n" \
+"void sub_ntt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2,\n" \
+"	__global const int * restrict const bd)\n" \
 "{\n" \
 "	SUB_NTT1024(1);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))\n" \
-"void lst_intt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2)\n" \
+"void lst_intt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2)\n" \
 "{\n" \
 "	LST_INTT1024(1);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))\n" \
-"void ntt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const r2, const uint m, const uint rindex)\n" \
+"void ntt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const r2, const uint m, const uint rindex)\n" \
 "{\n" \
 "	NTT1024(1);\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(1024 / 4 * 1, 1, 1)))\n" \
-"void intt1024_1(__global uint2 * restrict const x, __global const uint4 * restrict const r1ir1, __global const uint2 * restrict const ir2, const uint m, const uint rindex)\n" \
+"void intt1024_1(__global rns * restrict const x, __global const rns2 * restrict const r1ir1, __global const rns * restrict const ir2, const uint m, const uint rindex)\n" \
 "{\n" \
 "	INTT1024(1);\n" \
 "}\n" \
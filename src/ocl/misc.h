@@ -18,15 +18,20 @@ static const char * const src_ocl_misc = \
 "*/\n" \
 "\n" \
 "__kernel\n" \
-"void set_positive(__global uint2 * restrict const x)\n" \
+"void set_positive(__global rns * restrict x, __global const uint * restrict pc)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	// x.s0 = R, x.s1 = Y\n" \
 "	// if R < Y then add k.2^n + 1 to R.\n" \
 "\n" \
+"	const uint pconst_e = pc[0], pconst_s = pc[1], pconst_d = pc[2];\n" \
+"\n" \
 "	for (size_t i = 0; i < pconst_size / 2; ++i)\n" \
 "	{\n" \
 "		const size_t j = pconst_size / 2 - 1 - i;\n" \
-"		const uint2 x_j = x[j];\n" \
+"		const rns x_j = x[j];\n" \
 "		if (x_j.s0 > x_j.s1) return;\n" \
 "		if (x_j.s0 < x_j.s1)\n" \
 "		{\n" \
@@ -54,13 +59,18 @@ static const char * const src_ocl_misc = \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void add1(__global uint2 * restrict const x, const uint a)\n" \
+"void add1(__global rns * restrict x, __global const uint * restrict pc, const uint a)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	// s0: += a\n" \
 "	// s1: 0 => k.2^n + 1 for reduce_z step\n" \
 "\n" \
+"	const uint pconst_e = pc[0], pconst_s = pc[1], pconst_d = pc[2];\n" \
+"\n" \
 "	uint c = x[0].s0 + a;\n" \
-"	x[0] = (uint2)(c & digit_mask, 1);\n" \
+"	x[0] = digits(c & digit_mask, 1);\n" \
 "	c >>= digit_bit;\n" \
 "\n" \
 "	for (size_t k = 1; c != 0; ++k)\n" \
@@ -79,25 +89,35 @@ static const char * const src_ocl_misc = \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void swap(__global uint2 * restrict const x, __global uint2 * restrict const y)\n" \
+"void swap(__global rns * restrict x, __global rns * restrict y)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	y += batch_offset(pconst_size);\n" \
+"\n" \
 "	const size_t k = get_global_id(0);\n" \
-"	const uint2 x_k = x[k], y_k = y[k];\n" \
+"	const rns x_k = x[k], y_k = y[k];\n" \
 "	x[k] = y_k; y[k] = x_k;\n" \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void copy(__global uint2 * restrict const x, __global const uint2 * restrict const y)\n" \
+"void copy(__global rns * restrict x, __global const rns * restrict y)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	y += batch_offset(pconst_size);\n" \
+"\n" \
 "	const size_t k = get_global_id(0);\n" \
 "	x[k] = y[k];\n" \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void compare(__global const uint2 * restrict const x, __global const uint2 * restrict const y, __global int * const err)\n" \
+"void compare(__global const rns * restrict x, __global const rns * restrict y, __global int * err)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	y += batch_offset(pconst_size);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
 "	const size_t k = get_global_id(0);\n" \
-"	const uint2 x_k = x[k], y_k = y[k];\n" \
+"	const rns x_k = x[k], y_k = y[k];\n" \
 "	if ((x_k.s0 != y_k.s0) || (x_k.s1 != y_k.s1)) atomic_or(err, 1);\n" \
 "}\n" \
 "";
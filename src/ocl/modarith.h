@@ -23,6 +23,16 @@ static const char * const src_ocl_modarith = \
 "\n" \
 "#define digit_mask		((1u << digit_bit) - 1)\n" \
 "\n" \
+"// If the transform size is RADIX * L (RADIX = 3 or 5) then the radix-4 stages are the transforms of size L\n" \
+"#if defined(RADIX)\n" \
+"#define pconst_L		(pconst_size / RADIX)\n" \
+"#else\n" \
+"#define pconst_L		pconst_size\n" \
+"#endif\n" \
+"\n" \
+"// In batched mode, the buffers of the candidates are laid out back-to-back and get_global_id(1) is the index of the candidate.\n" \
+"inline size_t batch_offset(const size_t stride) { return get_global_id(1) * stride; }\n" \
+"\n" \
 "/*\n" \
 "Barrett's product/reduction, where P is such that h (the number of iterations in the 'while loop') is 0 or 1.\n" \
 "\n" \
@@ -34,21 +44,10 @@ static const char * const src_ocl_modarith = \
 "\n" \
 "P = 127 * 2^24 + 1 = 2130706433 => R = 2164392967, h < 1.56\n" \
 "P =  63 * 2^25 + 1 = 2113929217 => R = 2181570688, h < 2.51 NOK\n" \
+"P =  51 * 2^25 + 1 = 1711276033 => R = 2694881439, h < 1.68\n" \
 "P =  15 * 2^27 + 1 = 2013265921 => R = 2290649223, h < 1.93\n" \
 "*/\n" \
 "\n" \
-"#define	P1			2130706433u		// 127 * 2^24 + 1 = 2^31 - 2^24 + 1\n" \
-"#define	P2			2013265921u		//  15 * 2^27 + 1 = 2^31 - 2^27 + 1\n" \
-"#define	P1_INV		2164392967u		// 2^62 / P1\n" \
-"#define	P2_INV 		2290649223u		// 2^62 / P2\n" \
-"#define	P1_I		2113994754u		// P1_PRIM_ROOT = 3,  P1_PRIM_ROOT^((P1 - 1) / 4)\n" \
-"#define	P2_I		1728404513u		// P2_PRIM_ROOT = 31, P2_PRIM_ROOT^((P2 - 1) / 4)\n" \
-"#define	P1_Ip		4261280761u		// (P1_I * 2^32) / P1\n" \
-"#define	P2_Ip		3687262959u		// (P2_I * 2^32) / P2\n" \
-"#define	InvP2_P1	913159918u		// 1 / P2 mod P1\n" \
-"#define	InvP2_P1p	1840700306u		// (InvP2_P1 * 2^32) / P1\n" \
-"#define	P1P2		(P1 * (ulong)(P2))\n" \
-"\n" \
 "inline uint _rem(const ulong q, const uint d, const uint d_inv, const int d_shift)\n" \
 "{\n" \
 "	const uint q_d = mul_hi((uint)(q >> d_shift), d_inv);\n" \
@@ -57,18 +56,110 @@ static const char * const src_ocl_modarith = \
 "	return r - t;\n" \
 "}\n" \
 "\n" \
-"inline uint addmod_d(const uint lhs, const uint rhs)\n" \
+"inline uint addmod_d(const uint lhs, const uint rhs, const uint d)\n" \
 "{\n" \
 "	const uint r = lhs + rhs;\n" \
-"	const uint t = (r >= pconst_d) ? pconst_d : 0;\n" \
+"	const uint t = (r >= d) ? d : 0;\n" \
 "	return r - t;\n" \
 "}\n" \
 "\n" \
-"inline uint rem_d(const ulong q)\n" \
+"// rns is a residue, rns2 is a pair of residues or a residue and its Shoup's precomputation (.lo and .hi)\n" \
+"#if defined(RNS3)\n" \
+"typedef uint4	rns;\n" \
+"typedef uint8	rns2;\n" \
+"#else\n" \
+"typedef uint2	rns;\n" \
+"typedef uint4	rns2;\n" \
+"#endif\n" \
+"\n" \
+"// In the integer domain, the digits of R and Y are the components s0 and s1 of a vector\n" \
+"#if defined(RNS3)\n" \
+"inline rns digits(const uint r, const uint y) { return (uint4)(r, y, 0, 0); }\n" \
+"#else\n" \
+"inline rns digits(const uint r, const uint y) { return (uint2)(r, y); }\n" \
+"#endif\n" \
+"\n" \
+"#if defined(GOLDILOCKS)\n" \
+"\n" \
+"/*\n" \
+"p = 2^64 - 2^32 + 1. A residue is the ulong value of a uint2 vector, the NTT is computed modulo p.\n" \
+"We have 2^64 = 2^32 - 1 and 2^96 = -1 (mod p): the reduction of a 128-bit product is a sum of 32-bit words.\n" \
+"*/\n" \
+"\n" \
+"#define	PG			0xffffffff00000001ul\n" \
+"\n" \
+"inline ulong _reduce128(const ulong lo, const ulong hi)\n" \
+"{\n" \
+"	// lo + hi_lo.2^64 + hi_hi.2^96 = lo - hi_hi + hi_lo.(2^32 - 1)\n" \
+"	const ulong hi_hi = hi >> 32, hi_lo = hi & 0xffffffffu;\n" \
+"	const ulong t = lo - hi_hi - ((lo < hi_hi) ? 0xffffffffu : 0);\n" \
+"	const ulong u = hi_lo * 0xffffffffu;\n" \
+"	const ulong r = t + u + ((t + u < u) ? 0xffffffffu : 0);\n" \
+"	return (r >= PG) ? r - PG : r;\n" \
+"}\n" \
+"\n" \
+"inline uint2 toMod(const uint d) { return (uint2)(d, 0); }\n" \
+"\n" \
+"inline long getlong(const uint2 lhs)\n" \
+"{\n" \
+"	const ulong r = as_ulong(lhs);\n" \
+"	return (long)((r > PG / 2) ? r - PG : r);\n" \
+"}\n" \
+"\n" \
+"// getlong(lhs) = carry.B + digit, 0 <= digit < B\n" \
+"inline long getcarry(const uint2 lhs, uint * const digit)\n" \
+"{\n" \
+"	const long l = getlong(lhs);\n" \
+"	*digit = (uint)(l) & digit_mask;\n" \
+"	return l >> digit_bit;\n" \
+"}\n" \
+"\n" \
+"inline uint2 addmod(const uint2 lhs, const uint2 rhs)\n" \
+"{\n" \
+"	const ulong l = as_ulong(lhs), r = as_ulong(rhs);\n" \
+"	const ulong t = (l >= PG - r) ? PG : 0;\n" \
+"	return as_uint2(l + r - t);\n" \
+"}\n" \
+"\n" \
+"inline uint2 submod(const uint2 lhs, const uint2 rhs)\n" \
+"{\n" \
+"	const ulong l = as_ulong(lhs), r = as_ulong(rhs);\n" \
+"	const ulong t = (l < r) ? PG : 0;\n" \
+"	return as_uint2(l - r + t);\n" \
+"}\n" \
+"\n" \
+"inline uint2 mulmod(const uint2 lhs, const uint2 rhs)\n" \
+"{\n" \
+"	const ulong l = as_ulong(lhs), r = as_ulong(rhs);\n" \
+"	return as_uint2(_reduce128(l * r, mul_hi(l, r)));\n" \
+"}\n" \
+"\n" \
+"// No precomputation: rhs.lo is the root\n" \
+"inline uint2 mulmodp(const uint2 lhs, const uint4 rhs) { return mulmod(lhs, rhs.lo); }\n" \
+"\n" \
+"inline uint2 sqrmod(const uint2 lhs) { return mulmod(lhs, lhs); }\n" \
+"\n" \
+"// PG_PRIM_ROOT = 7, PG_PRIM_ROOT^((PG - 1) / 4) = 2^48\n" \
+"inline uint2 mulI(const uint2 lhs)\n" \
 "{\n" \
-"	return _rem(q, pconst_d, pconst_d_inv, pconst_d_shift);\n" \
+"	const ulong l = as_ulong(lhs);\n" \
+"	return as_uint2(_reduce128(l << 48, l >> 16));\n" \
 "}\n" \
 "\n" \
+"#else\n" \
+"\n" \
+"#define	P1			2130706433u		// 127 * 2^24 + 1 = 2^31 - 2^24 + 1\n" \
+"#define	P2			2013265921u		//  15 * 2^27 + 1 = 2^31 - 2^27 + 1\n" \
+"#define	P1_INV		2164392967u		// 2^62 / P1\n" \
+"#define	P2_INV 		2290649223u		// 2^62 / P2\n" \
+"#define	P1_I		2113994754u		// P1_PRIM_ROOT = 3,  P1_PRIM_ROOT^((P1 - 1) / 4)\n" \
+"#define	P2_I		1728404513u		// P2_PRIM_ROOT = 31, P2_PRIM_ROOT^((P2 - 1) / 4)\n" \
+"#define	P1_Ip		4261280761u		// (P1_I * 2^32) / P1\n" \
+"#define	P2_Ip		3687262959u		// (P2_I * 2^32) / P2\n" \
+"#define	InvP2_P1	913159918u		// 1 / P2 mod P1\n" \
+"#define	InvP2_P1p	1840700306u		// (InvP2_P1 * 2^32) / P1\n" \
+"#define	P1P2		(P1 * (ulong)(P2))\n" \
+"\n" \
 "inline uint _mulmodP1(const uint a, const uint b) { return _rem(a * (ulong)(b), P1, P1_INV, 30); }\n" \
 "inline uint _mulmodP2(const uint a, const uint b) { return _rem(a * (ulong)(b), P2, P2_INV, 30); }\n" \
 "\n" \
@@ -80,16 +171,106 @@ static const char * const src_ocl_modarith = \
 "	return r - t;\n" \
 "}\n" \
 "\n" \
+"// Garner Algorithm: x = u.P2 + a2 (mod P1P2), 0 <= u < P1\n" \
+"inline uint _garnerP2(const uint a1, const uint a2)\n" \
+"{\n" \
+"	uint d = a1 - a2; const uint t = (a1 < a2) ? P1 : 0; d += t;	// mod P1\n" \
+"	return _mulmodp(d, P1, InvP2_P1, InvP2_P1p);		// P2 < P1\n" \
+"}\n" \
+"\n" \
+"#if defined(RNS3)\n" \
+"\n" \
+"/*\n" \
+"A residue is a uint4 vector, the components s0, s1 and s2 are the residues modulo P1, P2 and P3, s3 is zero.\n" \
+"The coefficients of the products are in ]-P1P2P3 / 2, P1P2P3 / 2[ (P1P2P3 ~ 2^92.6): they are not 64-bit integers\n" \
+"but their carries are. getcarry splits a coefficient into a digit and a carry.\n" \
+"*/\n" \
+"\n" \
+"#define	P3			1711276033u		//  51 * 2^25 + 1 = 2^31 - 2^28 - 2^27 - 2^25 + 1\n" \
+"#define	P3_INV		2694881439u		// 2^62 / P3\n" \
+"#define	P3_I		1270877673u		// P3_PRIM_ROOT = 29, P3_PRIM_ROOT^((P3 - 1) / 4)\n" \
+"#define	P3_Ip		3189653765u		// (P3_I * 2^32) / P3\n" \
+"#define	InvP1P2_P3	616059395u		// 1 / (P1 * P2) mod P3\n" \
+"#define	InvP1P2_P3p	1546188284u		// (InvP1P2_P3 * 2^32) / P3\n" \
+"#define	InvP1_P3	1300569781u		// 1 / P1 mod P3\n" \
+"#define	InvP1_P3p	3264175134u		// (InvP1_P3 * 2^32) / P3\n" \
+"\n" \
+"inline uint _mulmodP3(const uint a, const uint b) { return _rem(a * (ulong)(b), P3, P3_INV, 30); }\n" \
+"\n" \
+"inline uint4 toMod(const uint d) { return (uint4)(d, d, d, 0); }\n" \
+"\n" \
+"// x = w.P1P2 + u.P2 + a2 and w = (a3 - a2).(1 / P1P2) - u.(1 / P1) (mod P3). The centered coefficient x = ws.P1P2 + r12,\n" \
+"// with -P3/2 < ws <= P3/2, is split: P1P2 = q.B + r then x = (q.ws + [(r.ws + r12) / B]).B + (r.ws + r12) mod B.\n" \
+"inline long getcarry(const uint4 lhs, uint * const digit)\n" \
+"{\n" \
+"	const uint u = _garnerP2(lhs.s0, lhs.s1);\n" \
+"	const ulong r12 = u * (ulong)(P2) + lhs.s1;\n" \
+"\n" \
+"	const uint a2 = lhs.s1 - ((lhs.s1 >= P3) ? P3 : 0);		// P2 < 2 * P3\n" \
+"	uint d = lhs.s2 - a2; const uint t = (lhs.s2 < a2) ? P3 : 0; d += t;\n" \
+"	const uint w1 = _mulmodp(d, P3, InvP1P2_P3, InvP1P2_P3p), w2 = _mulmodp(u, P3, InvP1_P3, InvP1_P3p);\n" \
+"	const uint w = w1 - w2 + ((w1 < w2) ? P3 : 0);\n" \
+"\n" \
+"	const bool neg = (w > P3 / 2) || ((w == P3 / 2) && (r12 > P1P2 / 2));\n" \
+"	const long ws = (long)(w) - (neg ? (long)(P3) : 0);\n" \
+"\n" \
+"	const long s = (long)(P1P2 & digit_mask) * ws + (long)(r12);	// |s| < 2^63\n" \
+"	*digit = (uint)(s) & digit_mask;\n" \
+"	// modulo 2^64, the carry is smaller than 2^63\n" \
+"	return (long)((P1P2 >> digit_bit) * (ulong)(ws) + (ulong)(s >> digit_bit));\n" \
+"}\n" \
+"\n" \
+"inline uint4 addmod(const uint4 lhs, const uint4 rhs)\n" \
+"{\n" \
+"	const uint4 r = lhs + rhs;\n" \
+"	const uint4 t = (uint4)((lhs.s0 >= P1 - rhs.s0) ? P1 : 0, (lhs.s1 >= P2 - rhs.s1) ? P2 : 0, (lhs.s2 >= P3 - rhs.s2) ? P3 : 0, 0);\n" \
+"	return r - t;\n" \
+"}\n" \
+"\n" \
+"inline uint4 submod(const uint4 lhs, const uint4 rhs)\n" \
+"{\n" \
+"	const uint4 r = lhs - rhs;\n" \
+"	const uint4 t = (uint4)((lhs.s0 < rhs.s0) ? P1 : 0, (lhs.s1 < rhs.s1) ? P2 : 0, (lhs.s2 < rhs.s2) ? P3 : 0, 0);\n" \
+"	return r + t;\n" \
+"}\n" \
+"\n" \
+"inline uint4 mulmod(const uint4 lhs, const uint4 rhs)\n" \
+"{\n" \
+"	return (uint4)(_mulmodP1(lhs.s0, rhs.s0), _mulmodP2(lhs.s1, rhs.s1), _mulmodP3(lhs.s2, rhs.s2), 0);\n" \
+"}\n" \
+"\n" \
+"// rhs.lo is the root, rhs.hi is its Shoup's precomputation\n" \
+"inline uint4 mulmodp(const uint4 lhs, const uint8 rhs)\n" \
+"{\n" \
+"	return (uint4)(_mulmodp(lhs.s0, P1, rhs.s0, rhs.s4), _mulmodp(lhs.s1, P2, rhs.s1, rhs.s5), _mulmodp(lhs.s2, P3, rhs.s2, rhs.s6), 0);\n" \
+"}\n" \
+"\n" \
+"inline uint4 sqrmod(const uint4 lhs) { return mulmod(lhs, lhs); }\n" \
+"\n" \
+"inline uint4 mulI(const uint4 lhs)\n" \
+"{\n" \
+"	return (uint4)(_mulmodp(lhs.s0, P1, P1_I, P1_Ip), _mulmodp(lhs.s1, P2, P2_I, P2_Ip), _mulmodp(lhs.s2, P3, P3_I, P3_Ip), 0);\n" \
+"}\n" \
+"\n" \
+"#else\n" \
+"\n" \
+"inline uint2 toMod(const uint d) { return (uint2)(d, d); }\n" \
+"\n" \
 "inline long getlong(const uint2 lhs)\n" \
 "{\n" \
-"	// Garner Algorithm\n" \
-"	uint d = lhs.s0 - lhs.s1; const uint t = (lhs.s0 < lhs.s1) ? P1 : 0; d += t;	// mod P1\n" \
-"	const uint u = _mulmodp(d, P1, InvP2_P1, InvP2_P1p);		// P2 < P1\n" \
-"	const ulong r = u * (ulong)(P2) + lhs.s1;\n" \
+"	const ulong r = _garnerP2(lhs.s0, lhs.s1) * (ulong)(P2) + lhs.s1;\n" \
 "	const ulong s = (r > P1P2 / 2) ? P1P2 : 0;\n" \
 "	return (long)(r - s);\n" \
 "}\n" \
 "\n" \
+"// getlong(lhs) = carry.B + digit, 0 <= digit < B\n" \
+"inline long getcarry(const uint2 lhs, uint * const digit)\n" \
+"{\n" \
+"	const long l = getlong(lhs);\n" \
+"	*digit = (uint)(l) & digit_mask;\n" \
+"	return l >> digit_bit;\n" \
+"}\n" \
+"\n" \
 "inline uint2 addmod(const uint2 lhs, const uint2 rhs)\n" \
 "{\n" \
 "	const uint2 r = lhs + rhs;\n" \
@@ -122,146 +303,210 @@ static const char * const src_ocl_modarith = \
 "	return (uint2)(_mulmodp(lhs.s0, P1, P1_I, P1_Ip), _mulmodp(lhs.s1, P2, P2_I, P2_Ip));\n" \
 "}\n" \
 "\n" \
-"inline void _sub_forward4i(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x, const uint2 r2, const uint4 r1ir1)\n" \
+"#endif\n" \
+"\n" \
+"#endif\n" \
+"\n" \
+"#if defined(BALANCED)\n" \
+"inline rns toModInt(const int d) { return (d >= 0) ? toMod((uint)(d)) : submod(toMod(0), toMod((uint)(-d))); }\n" \
+"#endif\n" \
+"\n" \
+"// If BALANCED is defined then the digits of R - Y were balanced by the kernel balance and are read from bd\n" \
+"inline void _sub_forward4i(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x,\n" \
+"	__global const int * restrict const bd, const rns r2, const rns2 r1ir1)\n" \
 "{\n" \
-"	const uint2 abi = x[0 * mg], abim = x[1 * mg];\n" \
-"	const uint2 abi0 = (uint2)(abi.s0, abi.s0), abi1 = (uint2)(abi.s1, abi.s1);\n" \
-"	const uint2 abim0 = (uint2)(abim.s0, abim.s0), abim1 = (uint2)(abim.s1, abim.s1);\n" \
-"	const uint2 u0 = submod(abi0, abi1), u1 = submod(abim0, abim1), u3 = mulI(u1);\n" \
+"#if defined(BALANCED)\n" \
+"	const rns u0 = toModInt(bd[0 * mg]), u1 = toModInt(bd[1 * mg]), u3 = mulI(u1);\n" \
+"#else\n" \
+"	const rns abi = x[0 * mg], abim = x[1 * mg];\n" \
+"	const rns u0 = submod(toMod(abi.s0), toMod(abi.s1)), u1 = submod(toMod(abim.s0), toMod(abim.s1)), u3 = mulI(u1);\n" \
+"#endif\n" \
 "	X[0 * ml] = addmod(u0, u1); X[1 * ml] = mulmod(submod(u0, u1), r2);\n" \
-"	X[2 * ml] = mulmod(submod(u0, u3), r1ir1.s23); X[3 * ml] = mulmod(addmod(u0, u3), r1ir1.s01);\n" \
+"	X[2 * ml] = mulmod(submod(u0, u3), r1ir1.hi); X[3 * ml] = mulmod(addmod(u0, u3), r1ir1.lo);\n" \
 "}\n" \
 "\n" \
-"inline void _forward4i(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x, const uint2 r2, const uint4 r1ir1)\n" \
+"inline void _forward4i(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x, const rns r2, const rns2 r1ir1)\n" \
 "{\n" \
-"	const uint2 u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	X[0 * ml] = addmod(v0, v1); X[1 * ml] = mulmod(submod(v0, v1), r2);\n" \
-"	X[2 * ml] = mulmod(addmod(v2, v3), r1ir1.s23); X[3 * ml] = mulmod(submod(v2, v3), r1ir1.s01);\n" \
+"	X[2 * ml] = mulmod(addmod(v2, v3), r1ir1.hi); X[3 * ml] = mulmod(submod(v2, v3), r1ir1.lo);\n" \
 "}\n" \
 "\n" \
-"inline void _forward4(const size_t m, __local uint2 * restrict const X, const uint2 r2, const uint4 r1ir1)\n" \
+"inline void _forward4(const size_t m, __local rns * restrict const X, const rns r2, const rns2 r1ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	X[0 * m] = addmod(v0, v1); X[1 * m] = mulmod(submod(v0, v1), r2);\n" \
-"	X[2 * m] = mulmod(addmod(v2, v3), r1ir1.s23); X[3 * m] = mulmod(submod(v2, v3), r1ir1.s01);\n" \
+"	X[2 * m] = mulmod(addmod(v2, v3), r1ir1.hi); X[3 * m] = mulmod(submod(v2, v3), r1ir1.lo);\n" \
 "}\n" \
 "\n" \
-"inline void _forward4o(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X, const uint2 r2, const uint4 r1ir1)\n" \
+"inline void _forward4o(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X, const rns r2, const rns2 r1ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	x[0 * mg] = addmod(v0, v1); x[1 * mg] = mulmod(submod(v0, v1), r2);\n" \
-"	x[2 * mg] = mulmod(addmod(v2, v3), r1ir1.s23); x[3 * mg] = mulmod(submod(v2, v3), r1ir1.s01);\n" \
+"	x[2 * mg] = mulmod(addmod(v2, v3), r1ir1.hi); x[3 * mg] = mulmod(submod(v2, v3), r1ir1.lo);\n" \
 "}\n" \
 "\n" \
-"inline void _backward4i(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x, const uint2 ir2, const uint4 r1ir1)\n" \
+"inline void _backward4i(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x, const rns ir2, const rns2 r1ir1)\n" \
 "{\n" \
-"	const uint2 v0 = x[0 * mg], v1 = mulmod(x[1 * mg], ir2), v2 = mulmod(x[2 * mg], r1ir1.s01), v3 = mulmod(x[3 * mg], r1ir1.s23);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = x[0 * mg], v1 = mulmod(x[1 * mg], ir2), v2 = mulmod(x[2 * mg], r1ir1.lo), v3 = mulmod(x[3 * mg], r1ir1.hi);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	X[0 * ml] = addmod(u0, u2); X[2 * ml] = submod(u0, u2); X[1 * ml] = addmod(u1, u3); X[3 * ml] = submod(u1, u3);\n" \
 "}\n" \
 "\n" \
-"inline void _backward4(const size_t m, __local uint2 * restrict const X, const uint2 ir2, const uint4 r1ir1)\n" \
+"inline void _backward4(const size_t m, __local rns * restrict const X, const rns ir2, const rns2 r1ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 v0 = X[0 * m], v1 = mulmod(X[1 * m], ir2), v2 = mulmod(X[2 * m], r1ir1.s01), v3 = mulmod(X[3 * m], r1ir1.s23);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = X[0 * m], v1 = mulmod(X[1 * m], ir2), v2 = mulmod(X[2 * m], r1ir1.lo), v3 = mulmod(X[3 * m], r1ir1.hi);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	X[0 * m] = addmod(u0, u2); X[2 * m] = submod(u0, u2); X[1 * m] = addmod(u1, u3); X[3 * m] = submod(u1, u3);\n" \
 "}\n" \
 "\n" \
-"inline void _backward4o(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X, const uint2 ir2, const uint4 r1ir1)\n" \
+"inline void _backward4o(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X, const rns ir2, const rns2 r1ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 v0 = X[0 * ml], v1 = mulmod(X[1 * ml], ir2), v2 = mulmod(X[2 * ml], r1ir1.s01), v3 = mulmod(X[3 * ml], r1ir1.s23);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = X[0 * ml], v1 = mulmod(X[1 * ml], ir2), v2 = mulmod(X[2 * ml], r1ir1.lo), v3 = mulmod(X[3 * ml], r1ir1.hi);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	x[0 * mg] = addmod(u0, u2); x[2 * mg] = submod(u0, u2); x[1 * mg] = addmod(u1, u3); x[3 * mg] = submod(u1, u3);\n" \
 "}\n" \
 "\n" \
-"inline void _forward4pi(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x,\n" \
-"	const uint4 r2, const uint4 r1, const uint4 ir1)\n" \
+"inline void _forward4pi(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x,\n" \
+"	const rns2 r2, const rns2 r1, const rns2 ir1)\n" \
 "{\n" \
-"	const uint2 u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = x[0 * mg], u2 = x[2 * mg], u1 = x[1 * mg], u3 = x[3 * mg];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	X[0 * ml] = addmod(v0, v1); X[1 * ml] = mulmodp(submod(v0, v1), r2);\n" \
 "	X[2 * ml] = mulmodp(addmod(v2, v3), ir1); X[3 * ml] = mulmodp(submod(v2, v3), r1);\n" \
 "}\n" \
 "\n" \
-"inline void _forward4p(const size_t m, __local uint2 * restrict const X,\n" \
-"	const uint4 r2, const uint4 r1, const uint4 ir1)\n" \
+"inline void _forward4p(const size_t m, __local rns * restrict const X,\n" \
+"	const rns2 r2, const rns2 r1, const rns2 ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = X[0 * m], u2 = X[2 * m], u1 = X[1 * m], u3 = X[3 * m];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	X[0 * m] = addmod(v0, v1); X[1 * m] = mulmodp(submod(v0, v1), r2);\n" \
 "	X[2 * m] = mulmodp(addmod(v2, v3), ir1); X[3 * m] = mulmodp(submod(v2, v3), r1);\n" \
 "}\n" \
 "\n" \
-"inline void _forward4po(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X,\n" \
-"	const uint4 r2, const uint4 r1, const uint4 ir1)\n" \
+"inline void _forward4po(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X,\n" \
+"	const rns2 r2, const rns2 r1, const rns2 ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns u0 = X[0 * ml], u2 = X[2 * ml], u1 = X[1 * ml], u3 = X[3 * ml];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
 "	x[0 * mg] = addmod(v0, v1); x[1 * mg] = mulmodp(submod(v0, v1), r2);\n" \
 "	x[2 * mg] = mulmodp(addmod(v2, v3), ir1); x[3 * mg] = mulmodp(submod(v2, v3), r1);\n" \
 "}\n" \
 "\n" \
-"inline void _backward4pi(const size_t ml, __local uint2 * restrict const X, const size_t mg, __global const uint2 * restrict const x,\n" \
-"	const uint4 ir2, const uint4 r1, const uint4 ir1)\n" \
+"inline void _backward4pi(const size_t ml, __local rns * restrict const X, const size_t mg, __global const rns * restrict const x,\n" \
+"	const rns2 ir2, const rns2 r1, const rns2 ir1)\n" \
 "{\n" \
-"	const uint2 v0 = x[0 * mg], v1 = mulmodp(x[1 * mg], ir2), v2 = mulmodp(x[2 * mg], r1), v3 = mulmodp(x[3 * mg], ir1);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = x[0 * mg], v1 = mulmodp(x[1 * mg], ir2), v2 = mulmodp(x[2 * mg], r1), v3 = mulmodp(x[3 * mg], ir1);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	X[0 * ml] = addmod(u0, u2); X[2 * ml] = submod(u0, u2); X[1 * ml] = addmod(u1, u3); X[3 * ml] = submod(u1, u3);\n" \
 "}\n" \
 "\n" \
-"inline void _backward4p(const size_t m, __local uint2 * restrict const X,\n" \
-"	const uint4 ir2, const uint4 r1, const uint4 ir1)\n" \
+"inline void _backward4p(const size_t m, __local rns * restrict const X,\n" \
+"	const rns2 ir2, const rns2 r1, const rns2 ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 v0 = X[0 * m], v1 = mulmodp(X[1 * m], ir2), v2 = mulmodp(X[2 * m], r1), v3 = mulmodp(X[3 * m], ir1);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = X[0 * m], v1 = mulmodp(X[1 * m], ir2), v2 = mulmodp(X[2 * m], r1), v3 = mulmodp(X[3 * m], ir1);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	X[0 * m] = addmod(u0, u2); X[2 * m] = submod(u0, u2); X[1 * m] = addmod(u1, u3); X[3 * m] = submod(u1, u3);\n" \
 "}\n" \
 "\n" \
-"inline void _backward4po(const size_t mg, __global uint2 * restrict const x, const size_t ml, __local const uint2 * restrict const X,\n" \
-"	const uint4 ir2, const uint4 r1, const uint4 ir1)\n" \
+"inline void _backward4po(const size_t mg, __global rns * restrict const x, const size_t ml, __local const rns * restrict const X,\n" \
+"	const rns2 ir2, const rns2 r1, const rns2 ir1)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 v0 = X[0 * ml], v1 = mulmodp(X[1 * ml], ir2), v2 = mulmodp(X[2 * ml], r1), v3 = mulmodp(X[3 * ml], ir1);\n" \
-"	const uint2 u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
+"	const rns v0 = X[0 * ml], v1 = mulmodp(X[1 * ml], ir2), v2 = mulmodp(X[2 * ml], r1), v3 = mulmodp(X[3 * ml], ir1);\n" \
+"	const rns u0 = addmod(v0, v1), u2 = addmod(v2, v3), u1 = submod(v0, v1), u3 = mulI(submod(v2, v3));\n" \
 "	x[0 * mg] = addmod(u0, u2); x[2 * mg] = submod(u0, u2); x[1 * mg] = addmod(u1, u3); x[3 * mg] = submod(u1, u3);\n" \
 "}\n" \
 "\n" \
-"inline void _square2(__local uint2 * restrict const X)\n" \
+"inline void _square2(__local rns * restrict const X)\n" \
+"{\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const rns u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];\n" \
+"	const rns v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);\n" \
+"	const rns s0 = sqrmod(v0), s1 = sqrmod(v1), s4 = sqrmod(v4), s5 = sqrmod(v5);\n" \
+"	X[0] = addmod(s0, s1); X[1] = submod(s0, s1); X[4] = addmod(s4, s5); X[5] = submod(s4, s5);\n" \
+"}\n" \
+"\n" \
+"inline void _square4(__local rns * restrict const X)\n" \
+"{\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const rns u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns s0 = sqrmod(addmod(v0, v1)), s1 = sqrmod(submod(v0, v1)), s2 = sqrmod(addmod(v2, v3)), s3 = sqrmod(submod(v2, v3));\n" \
+"	const rns t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));\n" \
+"	X[0] = addmod(t0, t2); X[2] = submod(t0, t2); X[1] = addmod(t1, t3); X[3] = submod(t1, t3);\n" \
+"}\n" \
+"\n" \
+"// The transformed x is the multiplicand y of mul2 or mul4, it is stored before the squaring.\n" \
+"inline void _square2_tu(__local rns * restrict const X, __global rns * restrict const y)\n" \
+"{\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const rns u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];\n" \
+"	y[0] = u0; y[1] = u1; y[4] = u4; y[5] = u5;\n" \
+"	const rns v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);\n" \
+"	const rns s0 = sqrmod(v0), s1 = sqrmod(v1), s4 = sqrmod(v4), s5 = sqrmod(v5);\n" \
+"	X[0] = addmod(s0, s1); X[1] = submod(s0, s1); X[4] = addmod(s4, s5); X[5] = submod(s4, s5);\n" \
+"}\n" \
+"\n" \
+"inline void _square4_tu(__local rns * restrict const X, __global rns * restrict const y)\n" \
+"{\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const rns u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];\n" \
+"	y[0] = u0; y[1] = u1; y[2] = u2; y[3] = u3;\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns s0 = sqrmod(addmod(v0, v1)), s1 = sqrmod(submod(v0, v1)), s2 = sqrmod(addmod(v2, v3)), s3 = sqrmod(submod(v2, v3));\n" \
+"	const rns t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));\n" \
+"	X[0] = addmod(t0, t2); X[2] = submod(t0, t2); X[1] = addmod(t1, t3); X[3] = submod(t1, t3);\n" \
+"}\n" \
+"\n" \
+"// The last stage of the forward transform of x and y, the pointwise product and the first stage of the inverse transform.\n" \
+"// y is the transformed multiplicand, see mul2 and mul4.\n" \
+"inline void _mul2(__local rns * restrict const X, __global const rns * restrict const y)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];\n" \
-"	const uint2 v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);\n" \
-"	const uint2 s0 = sqrmod(v0), s1 = sqrmod(v1), s4 = sqrmod(v4), s5 = sqrmod(v5);\n" \
+"	const rns u0 = X[0], u1 = X[1], u4 = X[4], u5 = X[5];\n" \
+"	const rns v0 = addmod(u0, u1), v1 = submod(u0, u1), v4 = addmod(u4, u5), v5 = submod(u4, u5);\n" \
+"	const rns uy0 = y[0], uy1 = y[1], uy4 = y[4], uy5 = y[5];\n" \
+"	const rns vy0 = addmod(uy0, uy1), vy1 = submod(uy0, uy1), vy4 = addmod(uy4, uy5), vy5 = submod(uy4, uy5);\n" \
+"	const rns s0 = mulmod(v0, vy0), s1 = mulmod(v1, vy1), s4 = mulmod(v4, vy4), s5 = mulmod(v5, vy5);\n" \
 "	X[0] = addmod(s0, s1); X[1] = submod(s0, s1); X[4] = addmod(s4, s5); X[5] = submod(s4, s5);\n" \
 "}\n" \
 "\n" \
-"inline void _square4(__local uint2 * restrict const X)\n" \
+"inline void _mul4(__local rns * restrict const X, __global const rns * restrict const y)\n" \
 "{\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint2 u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];\n" \
-"	const uint2 v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
-"	const uint2 s0 = sqrmod(addmod(v0, v1)), s1 = sqrmod(submod(v0, v1)), s2 = sqrmod(addmod(v2, v3)), s3 = sqrmod(submod(v2, v3));\n" \
-"	const uint2 t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));\n" \
+"	const rns u0 = X[0], u2 = X[2], u1 = X[1], u3 = X[3];\n" \
+"	const rns v0 = addmod(u0, u2), v2 = submod(u0, u2), v1 = addmod(u1, u3), v3 = mulI(submod(u3, u1));\n" \
+"	const rns uy0 = y[0], uy2 = y[2], uy1 = y[1], uy3 = y[3];\n" \
+"	const rns vy0 = addmod(uy0, uy2), vy2 = submod(uy0, uy2), vy1 = addmod(uy1, uy3), vy3 = mulI(submod(uy3, uy1));\n" \
+"	const rns s0 = mulmod(addmod(v0, v1), addmod(vy0, vy1)), s1 = mulmod(submod(v0, v1), submod(vy0, vy1));\n" \
+"	const rns s2 = mulmod(addmod(v2, v3), addmod(vy2, vy3)), s3 = mulmod(submod(v2, v3), submod(vy2, vy3));\n" \
+"	const rns t0 = addmod(s0, s1), t2 = addmod(s2, s3), t1 = submod(s0, s1), t3 = mulI(submod(s2, s3));\n" \
 "	X[0] = addmod(t0, t2); X[2] = submod(t0, t2); X[1] = addmod(t1, t3); X[3] = submod(t1, t3);\n" \
 "}\n" \
 "";
@@ -22,17 +22,19 @@ static const char * const src_ocl_poly2int = \
 "	__local uint X[P2I_WGS * P2I_BLK];\n" \
 " \n" \
 "inline void poly2int0(__local long * restrict const L, __local uint * restrict const X, const size_t P2I_BLK, const size_t P2I_WGS,\n" \
-" 	__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+" 	__global rns * restrict const x, __global long * restrict const cr)\n" \
 " {\n" \
 "	const size_t i = get_local_id(0), blk = get_group_id(0);\n" \
-"	const size_t kc = (get_global_id(0) + 1) & (get_global_size(0) - 1);\n" \
+"	const size_t kc = (get_global_id(0) + 1 != get_global_size(0)) ? get_global_id(0) + 1 : 0;	// the size is not a power of 2 if RADIX is defined\n" \
 "\n" \
-"	__global uint2 * const xo = &x[P2I_WGS * P2I_BLK * blk];\n" \
+"	__global rns * const xo = &x[P2I_WGS * P2I_BLK * blk];\n" \
 "\n" \
 "	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
 "	{\n" \
 "		const size_t k = P2I_WGS * j + i;\n" \
-"		L[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = getlong(mulmod(xo[k], pconst_norm));	// -n/2 . (B-1)^2 <= l <= n/2 . (B-1)^2\n" \
+"		// the coefficient is L.B + X, -n/2 . (B-1)^2 <= L.B + X <= n/2 . (B-1)^2\n" \
+"		uint d; L[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = getcarry(mulmod(xo[k], pconst_norm), &d);\n" \
+"		X[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = d;\n" \
 "	}\n" \
 "\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
@@ -41,9 +43,9 @@ static const char * const src_ocl_poly2int = \
 "//#pragma unroll\n" \
 "	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
 "	{\n" \
-"		l += L[P2I_WGS * j + i];\n" \
+"		l += X[P2I_WGS * j + i];\n" \
 "		X[P2I_WGS * j + i] = (uint)(l) & digit_mask;\n" \
-"	 	l >>= digit_bit;\n" \
+"	 	l = (l >> digit_bit) + L[P2I_WGS * j + i];\n" \
 "	}\n" \
 "	cr[kc] = l;\n" \
 "\n" \
@@ -57,11 +59,42 @@ static const char * const src_ocl_poly2int = \
 "	}\n" \
 "}\n" \
 "\n" \
-"inline void poly2int1(const size_t P2I_BLK, __global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)\n" \
+"// poly2int1 and reduce_i_N are not followed by a second pass: the groups are counted in lb[1], as in poly2int_lb.\n" \
+"// If the carry was propagated through a whole block then err[1] is set and the last group to complete\n" \
+"// normalizes the digits serially.\n" \
+"inline bool poly2int_last_group(__global uint * restrict const lb)\n" \
+"{\n" \
+"	barrier(CLK_GLOBAL_MEM_FENCE);\n" \
+"	if (get_local_id(0) != 0) return false;\n" \
+"	mem_fence(CLK_GLOBAL_MEM_FENCE);\n" \
+"	if (atomic_inc(&lb[1]) != get_num_groups(0) - 1) return false;\n" \
+"	lb[1] = 0;\n" \
+"	mem_fence(CLK_GLOBAL_MEM_FENCE);\n" \
+"	return true;\n" \
+"}\n" \
+"\n" \
+"inline bool poly2int_fix(__global rns * restrict const x, __global int * const err)\n" \
+"{\n" \
+"	if (atomic_xchg(&err[1], 0) == 0) return false;\n" \
+"\n" \
+"	int f = 0;\n" \
+"	for (size_t k = 0; k < pconst_size; ++k)\n" \
+"	{\n" \
+"		f += x[k].s0;\n" \
+"		x[k] = (uint)(f) & digit_mask;\n" \
+"		f >>= digit_bit;\n" \
+"	}\n" \
+"\n" \
+"	if (f != 0) err[0] = f;	// an error is not cleared before it is read\n" \
+"	return true;\n" \
+"}\n" \
+"\n" \
+"inline void poly2int1(const size_t P2I_BLK, __global rns * restrict const x, __global const long * restrict const cr,\n" \
+"	__global uint * restrict const lb, __global int * const err)\n" \
 "{\n" \
 "	const size_t k = get_global_id(0);\n" \
 "\n" \
-"	__global uint2 * const xi = &x[P2I_BLK * k];\n" \
+"	__global rns * const xi = &x[P2I_BLK * k];\n" \
 "\n" \
 "	long l = cr[k] + xi[0].s0;\n" \
 "	xi[0].s0 = (uint)(l) & digit_mask;\n" \
@@ -69,121 +102,393 @@ static const char * const src_ocl_poly2int = \
 "\n" \
 "	int f = (int)(l);\n" \
 "//#pragma unroll\n" \
-"	for (size_t j = 1; j < P2I_BLK - 1; ++j)\n" \
+"	for (size_t j = 1; (f != 0) && (j < P2I_BLK - 1); ++j)\n" \
 "	{\n" \
 "		f += xi[j].s0;\n" \
 "		xi[j].s0 = (uint)(f) & digit_mask;\n" \
 "		f >>= digit_bit;					// f = -1, 0 or 1\n" \
-"		if (f == 0) return;\n" \
 "	}\n" \
 "\n" \
-"	f += xi[P2I_BLK - 1].s0;\n" \
-"	xi[P2I_BLK - 1].s0 = (uint)(f);\n" \
-"	f >>= digit_bit;\n" \
-"	if (f != 0) atomic_or(&err[1], f);\n" \
+"	if (f != 0)\n" \
+"	{\n" \
+"		f += xi[P2I_BLK - 1].s0;\n" \
+"		xi[P2I_BLK - 1].s0 = (uint)(f);\n" \
+"		f >>= digit_bit;\n" \
+"		if (f != 0) atomic_or(&err[1], f);\n" \
+"	}\n" \
+"\n" \
+"	if (poly2int_last_group(lb)) poly2int_fix(x, err);\n" \
 "}\n" \
 "\n" \
-"__kernel\n" \
-"void poly2int2(__global uint2 * restrict const x, __global int * const err)\n" \
+"// Single-pass carry propagation with a decoupled look-back (D. Merrill, M. Garland, Single-pass Parallel Prefix Scan\n" \
+"// with Decoupled Look-back, 2016). The groups are processed in the order of a ticket: the group g only waits for\n" \
+"// the group g - 1, which was started. The carry of a group is normalized in local memory, |carry out| < B^3. If the digits\n" \
+"// 3, 4, ... of a group are neither all zero nor all B - 1 then the incoming carry cannot be propagated through the group:\n" \
+"// its carry out is published before the incoming carry is known. Otherwise the group waits for its incoming carry.\n" \
+"// lb[0] is the ticket counter, lb[1] counts the completed groups and lb[2 + g] is set if the carry out of g is in cr[g].\n" \
+"// The product is zero-padded then the carry out of the last group is zero.\n" \
+"\n" \
+"#define POLY2INT_LB_VAR(P2I_BLK, P2I_WGS) \\\n" \
+"	__local long L[P2I_WGS * P2I_BLK]; \\\n" \
+"	__local uint X[P2I_WGS * P2I_BLK]; \\\n" \
+"	__local long C[P2I_WGS]; \\\n" \
+"	__local uint S[4];\n" \
+"\n" \
+"inline void poly2int_lb(__local long * restrict const L, __local uint * restrict const X, __local long * restrict const C,\n" \
+"	__local uint * restrict const S, const size_t P2I_BLK, const size_t P2I_WGS,\n" \
+"	__global rns * restrict const x, __global long * restrict const cr, __global uint * restrict const lb, __global int * const err)\n" \
 "{\n" \
-"	if (err[1] == 0) return;\n" \
+"	const size_t i = get_local_id(0), G = pconst_size / (P2I_WGS * P2I_BLK);\n" \
 "\n" \
-"	int f = 0;\n" \
-"	for (size_t k = 0; k < pconst_size; ++k)\n" \
+"	if (i == 0)\n" \
 "	{\n" \
-"		f += x[k].s0;\n" \
-"		x[k] = (uint)(f) & digit_mask;\n" \
-"		f >>= digit_bit;\n" \
+"		S[0] = atomic_inc(&lb[0]);	// ticket\n" \
+"		S[1] = 0; S[2] = 0; S[3] = 0;	// propagation, a digit != 0, a digit != B - 1\n" \
 "	}\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const size_t g = S[0];\n" \
+"	__global rns * const xo = &x[P2I_WGS * P2I_BLK * g];\n" \
+"\n" \
+"	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
+"	{\n" \
+"		const size_t k = P2I_WGS * j + i;\n" \
+"		// the coefficient is L.B + X, -n/2 . (B-1)^2 <= L.B + X <= n/2 . (B-1)^2\n" \
+"		uint d; L[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = getcarry(mulmod(xo[k], pconst_norm), &d);\n" \
+"		X[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)] = d;\n" \
+"	}\n" \
+"\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	long l = 0;\n" \
+"	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
+"	{\n" \
+"		l += X[P2I_WGS * j + i];\n" \
+"		X[P2I_WGS * j + i] = (uint)(l) & digit_mask;\n" \
+"	 	l = (l >> digit_bit) + L[P2I_WGS * j + i];\n" \
+"	}\n" \
+"	C[i] = l;\n" \
+"\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	// the carries are propagated in the group, the carry out of a block is -1, 0 or 1 after the first round\n" \
+"	long c = (i != 0) ? C[i - 1] : 0, c_out = C[P2I_WGS - 1];\n" \
+"	while (true)\n" \
+"	{\n" \
+"		for (size_t j = 0; (c != 0) && (j < P2I_BLK); ++j)\n" \
+"		{\n" \
+"			c += X[P2I_WGS * j + i];\n" \
+"			X[P2I_WGS * j + i] = (uint)(c) & digit_mask;\n" \
+"			c >>= digit_bit;\n" \
+"		}\n" \
+"\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"		C[i] = c;\n" \
+"		if ((c != 0) && (i != P2I_WGS - 1)) S[1] = 1;\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"		const bool propagate = (S[1] != 0);\n" \
+"		c_out += C[P2I_WGS - 1];\n" \
+"		c = (i != 0) ? C[i - 1] : 0;\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"		if (!propagate) break;\n" \
+"		if (i == 0) S[1] = 0;\n" \
+"	}\n" \
+"\n" \
+"	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
+"	{\n" \
+"		const uint d = X[P2I_WGS * j + i];\n" \
+"		if (P2I_BLK * i + j >= 3)\n" \
+"		{\n" \
+"			if (d != 0) S[2] = 1;\n" \
+"			if (d != digit_mask) S[3] = 1;\n" \
+"		}\n" \
+"	}\n" \
+"\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	if (i == 0)\n" \
+"	{\n" \
+"		const bool independent = (S[2] != 0) && (S[3] != 0);\n" \
+"		if (independent && (g != G - 1))\n" \
+"		{\n" \
+"			cr[g] = c_out;\n" \
+"			mem_fence(CLK_GLOBAL_MEM_FENCE);\n" \
+"			atomic_xchg(&lb[2 + g], 1);\n" \
+"		}\n" \
+"\n" \
+"		long c_in = 0;\n" \
+"		if (g != 0)\n" \
+"		{\n" \
+"			while (atomic_or(&lb[2 + g - 1], 0) == 0) {}\n" \
+"			mem_fence(CLK_GLOBAL_MEM_FENCE);\n" \
+"			c_in = ((volatile __global long *)cr)[g - 1];\n" \
+"			lb[2 + g - 1] = 0;\n" \
+"		}\n" \
+"\n" \
+"		for (size_t k = 0; (c_in != 0) && (k < P2I_WGS * P2I_BLK); ++k)\n" \
+"		{\n" \
+"			const size_t j = P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK);\n" \
+"			c_in += X[j];\n" \
+"			X[j] = (uint)(c_in) & digit_mask;\n" \
+"			c_in >>= digit_bit;\n" \
+"		}\n" \
+"		c_out += c_in;\n" \
+"\n" \
+"		if (g == G - 1) { if (c_out != 0) atomic_or(&err[0], 1); }\n" \
+"		else if (!independent)\n" \
+"		{\n" \
+"			cr[g] = c_out;\n" \
+"			mem_fence(CLK_GLOBAL_MEM_FENCE);\n" \
+"			atomic_xchg(&lb[2 + g], 1);\n" \
+"		}\n" \
+"\n" \
+"		// the last group resets the counters\n" \
+"		if (atomic_inc(&lb[1]) == G - 1) { lb[0] = 0; lb[1] = 0; }\n" \
+"	}\n" \
+"\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	err[0] = f;\n" \
-"	err[1] = 0;\n" \
+"	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
+"	{\n" \
+"		const size_t k = P2I_WGS * j + i;\n" \
+"		xo[k].s0 = X[P2I_WGS * (k % P2I_BLK) + (k / P2I_BLK)];\n" \
+"	}\n" \
 "}\n" \
 "\n" \
 "// P2I_BLK = 4\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(16, 1, 1)))\n" \
-"void poly2int0_4_16(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_4_16(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(4, 16);\n" \
 "	poly2int0(L, X, 4, 16, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(16, 1, 1)))\n" \
+"void poly2int_lb_4_16(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(4, 16);\n" \
+"	poly2int_lb(L, X, C, S, 4, 16, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(32, 1, 1)))\n" \
-"void poly2int0_4_32(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_4_32(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(4, 32);\n" \
 "	poly2int0(L, X, 4, 32, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(32, 1, 1)))\n" \
+"void poly2int_lb_4_32(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(4, 32);\n" \
+"	poly2int_lb(L, X, C, S, 4, 32, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(64, 1, 1)))\n" \
-"void poly2int0_4_64(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_4_64(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(4, 64);\n" \
 "	poly2int0(L, X, 4, 64, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(64, 1, 1)))\n" \
+"void poly2int_lb_4_64(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(4, 64);\n" \
+"	poly2int_lb(L, X, C, S, 4, 64, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel\n" \
-"void poly2int1_4(__global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)\n" \
+"void poly2int1_4(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
 "{\n" \
-"	poly2int1(4, x, cr, err);\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	poly2int1(4, x, cr, lb, err);\n" \
 "}\n" \
 "\n" \
 "// P2I_BLK = 8\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(16, 1, 1)))\n" \
-"void poly2int0_8_16(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_8_16(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(8, 16);\n" \
 "	poly2int0(L, X, 8, 16, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(16, 1, 1)))\n" \
+"void poly2int_lb_8_16(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(8, 16);\n" \
+"	poly2int_lb(L, X, C, S, 8, 16, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(32, 1, 1)))\n" \
-"void poly2int0_8_32(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_8_32(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(8, 32);\n" \
 "	poly2int0(L, X, 8, 32, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(32, 1, 1)))\n" \
+"void poly2int_lb_8_32(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(8, 32);\n" \
+"	poly2int_lb(L, X, C, S, 8, 32, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(64, 1, 1)))\n" \
-"void poly2int0_8_64(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_8_64(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(8, 64);\n" \
 "	poly2int0(L, X, 8, 64, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(64, 1, 1)))\n" \
+"void poly2int_lb_8_64(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(8, 64);\n" \
+"	poly2int_lb(L, X, C, S, 8, 64, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel\n" \
-"void poly2int1_8(__global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)\n" \
+"void poly2int1_8(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
 "{\n" \
-"	poly2int1(8, x, cr, err);\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	poly2int1(8, x, cr, lb, err);\n" \
 "}\n" \
 "\n" \
 "// P2I_BLK = 16\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(8, 1, 1)))\n" \
-"void poly2int0_16_8(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_16_8(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(16, 8);\n" \
 "	poly2int0(L, X, 16, 8, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(8, 1, 1)))\n" \
+"void poly2int_lb_16_8(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(16, 8);\n" \
+"	poly2int_lb(L, X, C, S, 16, 8, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(16, 1, 1)))\n" \
-"void poly2int0_16_16(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_16_16(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(16, 16);\n" \
 "	poly2int0(L, X, 16, 16, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(16, 1, 1)))\n" \
+"void poly2int_lb_16_16(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(16, 16);\n" \
+"	poly2int_lb(L, X, C, S, 16, 16, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel __attribute__((reqd_work_group_size(32, 1, 1)))\n" \
-"void poly2int0_16_32(__global uint2 * restrict const x, __global long * restrict const cr)\n" \
+"void poly2int0_16_32(__global rns * restrict x, __global long * restrict cr)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"\n" \
 "	POLY2INT0_VAR(16, 32);\n" \
 "	poly2int0(L, X, 16, 32, x, cr);\n" \
 "}\n" \
 "\n" \
+"__kernel __attribute__((reqd_work_group_size(32, 1, 1)))\n" \
+"void poly2int_lb_16_32(__global rns * restrict x, __global long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	POLY2INT_LB_VAR(16, 32);\n" \
+"	poly2int_lb(L, X, C, S, 16, 32, x, cr, lb, err);\n" \
+"}\n" \
+"\n" \
 "__kernel\n" \
-"void poly2int1_16(__global uint2 * restrict const x, __global const long * restrict const cr, __global int * const err)\n" \
+"void poly2int1_16(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err)\n" \
 "{\n" \
-"	poly2int1(16, x, cr, err);\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
+"	poly2int1(16, x, cr, lb, err);\n" \
 "}\n" \
 "";
@@ -17,11 +17,17 @@ static const char * const src_ocl_reduce = \
 "Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.\n" \
 "*/\n" \
 "\n" \
+"// The constants of P = k.2^n + 1 = d.2^s * (2^digit_bit)^e + 1 are not compiled into the program, they are read from pc:\n" \
+"// pc[0] = e, pc[1] = s, pc[2] = d, pc[3] = d_inv, pc[4] = d_shift\n" \
+"\n" \
 "#define	R64		(RED_BLK * 64 / 4)\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(R64, 1, 1)))\n" \
-"void reduce_upsweep64(__global uint * restrict const t, const uint s, const uint j)\n" \
+"void reduce_upsweep64(__global uint * restrict t, __global const uint * restrict pc, const uint s, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint4 T_4[R64 / 4 + R64 / 16];	// alignment\n" \
 "	__local uint4 * const T2_4 = &T_4[R64 / 4];\n" \
 "	__local uint * const T = (__local uint *)T_4;\n" \
@@ -29,10 +35,11 @@ static const char * const src_ocl_reduce = \
 "\n" \
 "	const size_t i = get_local_id(0), blk = get_group_id(0), k = get_global_id(0);	// blk * R64 + i;\n" \
 "	__global uint * const tj = &t[j];\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
 "	__global const uint4 * const tj1_4 = (__global const uint4 *)&tj[0];\n" \
 "	const uint4 u = tj1_4[k];\n" \
-"	const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);\n" \
+"	const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);\n" \
 "	T[i] = u0123;\n" \
 "\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
@@ -43,7 +50,7 @@ static const char * const src_ocl_reduce = \
 "	{\n" \
 "		const size_t k_4 = blk * R64 / 4 + i;\n" \
 "		const uint4 u = T_4[i];\n" \
-"		const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);\n" \
+"		const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);\n" \
 "		tj[5 * (16 * s) + 4 * (4 * s) + k_4] = u23; tj[5 * (16 * s) + 5 * (4 * s) + k_4] = u0123; T_2[i] = u0123;\n" \
 "	}\n" \
 "\n" \
@@ -53,14 +60,17 @@ static const char * const src_ocl_reduce = \
 "	{\n" \
 "		const size_t k_16 = blk * R64 / 16 + i;\n" \
 "		const uint4 u = T2_4[i];\n" \
-"		const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);\n" \
+"		const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);\n" \
 "		tj[5 * (16 * s) + 5 * (4 * s) + 4 * s + k_16] = u23; tj[5 * (16 * s) + 5 * (4 * s) + 5 * s + k_16] = u0123;\n" \
 "	}\n" \
 "}\n" \
 "\n" \
 "__kernel __attribute__((reqd_work_group_size(R64, 1, 1)))\n" \
-"void reduce_downsweep64(__global uint * restrict const t, const uint s, const uint j)\n" \
+"void reduce_downsweep64(__global uint * restrict t, __global const uint * restrict pc, const uint s, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint4 T_4[R64 / 4 + R64 / 16];	// alignment\n" \
 "	__local uint4 * const T2_4 = &T_4[R64 / 4];\n" \
 "	__local uint * const T = (__local uint *)T_4;\n" \
@@ -68,14 +78,15 @@ static const char * const src_ocl_reduce = \
 "\n" \
 "	const size_t i = get_local_id(0), blk = get_group_id(0), k = get_global_id(0);	// blk * R64 + i;\n" \
 "	__global uint * const tj = &t[j];\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
 "	if (i < R64 / 16)\n" \
 "	{\n" \
 "		const size_t k_16 = blk * R64 / 16 + i;\n" \
 "		__global const uint4 * const tj16_4 = (__global uint4 *)&tj[5 * (16 * s) + 5 * (4 * s)];\n" \
-"		const uint u2 = tj[5 * (16 * s) + 5 * (4 * s) + 4 * s + k_16], u0 = tj[5 * (16 * s) + 5 * (4 * s) + 5 * s + k_16], u02 = addmod_d(u0, u2);\n" \
+"		const uint u2 = tj[5 * (16 * s) + 5 * (4 * s) + 4 * s + k_16], u0 = tj[5 * (16 * s) + 5 * (4 * s) + 5 * s + k_16], u02 = addmod_d(u0, u2, d);\n" \
 "		const uint4 u13 = tj16_4[k_16];\n" \
-"		const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);\n" \
+"		const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);\n" \
 "		T2_4[i] = (uint4)(u012, u02, u03, u0);\n" \
 "	}\n" \
 "\n" \
@@ -85,9 +96,9 @@ static const char * const src_ocl_reduce = \
 "	{\n" \
 "		const size_t k_4 = blk * R64 / 4 + i;\n" \
 "		__global const uint4 * const tj4_4 = (__global uint4 *)&tj[5 * (16 * s)];\n" \
-"		const uint u2 = tj[5 * (16 * s) + 4 * (4 * s) + k_4], u0 = T_2[i], u02 = addmod_d(u0, u2);\n" \
+"		const uint u2 = tj[5 * (16 * s) + 4 * (4 * s) + k_4], u0 = T_2[i], u02 = addmod_d(u0, u2, d);\n" \
 "		const uint4 u13 = tj4_4[k_4];\n" \
-"		const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);\n" \
+"		const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);\n" \
 "		T_4[i] = (uint4)(u012, u02, u03, u0);\n" \
 "	}\n" \
 "\n" \
@@ -97,232 +108,538 @@ static const char * const src_ocl_reduce = \
 "\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
 "\n" \
-"	const uint u0 = T[i], u02 = addmod_d(u0, u2);\n" \
-"	const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);\n" \
+"	const uint u0 = T[i], u02 = addmod_d(u0, u2, d);\n" \
+"	const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);\n" \
 "	tj1_4[k] = (uint4)(u012, u02, u03, u0);\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_upsweep4i(__local uint * restrict const T, __global const uint * restrict const t, const uint s, const size_t k)\n" \
+"inline void _reduce_upsweep4i(__local uint * restrict const T, __global const uint * restrict const t, const uint s, const size_t k, const uint d)\n" \
 "{\n" \
 "	__global const uint4 * const ti = (__global const uint4 *)&t[4 * k];\n" \
 "	__local uint * const To = &T[k];\n" \
 "\n" \
 "	const uint4 u = ti[0];\n" \
-"	const uint u01 = addmod_d(u.s0, u.s1), u23 = addmod_d(u.s2, u.s3), u0123 = addmod_d(u01, u23);\n" \
+"	const uint u01 = addmod_d(u.s0, u.s1, d), u23 = addmod_d(u.s2, u.s3, d), u0123 = addmod_d(u01, u23, d);\n" \
 "	To[0] = u23; To[s] = u0123;\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_upsweep4(__local uint * restrict const T, const uint s, const size_t k)\n" \
+"inline void _reduce_upsweep4(__local uint * restrict const T, const uint s, const size_t k, const uint d)\n" \
 "{\n" \
 "	__local const uint * const Ti = &T[0 * s + 4 * k];\n" \
 "	__local uint * const To = &T[4 * s + 1 * k];\n" \
 "\n" \
 "	const uint u0 = Ti[0], u1 = Ti[1], u2 = Ti[2], u3 = Ti[3];\n" \
-"	const uint u01 = addmod_d(u0, u1), u23 = addmod_d(u2, u3), u0123 = addmod_d(u01, u23);\n" \
+"	const uint u01 = addmod_d(u0, u1, d), u23 = addmod_d(u2, u3, d), u0123 = addmod_d(u01, u23, d);\n" \
 "	To[0] = u23; To[s] = u0123;\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_downsweep4(__local uint * restrict const T, const uint s, const size_t k)\n" \
+"inline void _reduce_downsweep4(__local uint * restrict const T, const uint s, const size_t k, const uint d)\n" \
 "{\n" \
 "	__local const uint * const Ti = &T[4 * s + 1 * k];\n" \
 "	__local uint * const To = &T[0 * s + 4 * k];\n" \
 "\n" \
-"	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2);\n" \
+"	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2, d);\n" \
 "	const uint u1 = To[1], u3 = To[3];\n" \
-"	const uint u012 = addmod_d(u02, u1), u03 = addmod_d(u0, u3);\n" \
+"	const uint u012 = addmod_d(u02, u1, d), u03 = addmod_d(u0, u3, d);\n" \
 "	To[0] = u012; To[1] = u02; To[2] = u03; To[3] = u0;\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_downsweep4o(__global uint * restrict const t, __local const uint * restrict const T, const uint s, const size_t k)\n" \
+"inline void _reduce_downsweep4o(__global uint * restrict const t, __local const uint * restrict const T, const uint s, const size_t k, const uint d)\n" \
 "{\n" \
 "	__local const uint * const Ti = &T[k];\n" \
 "	__global uint4 * const to = (__global uint4 *)&t[4 * k];\n" \
 "\n" \
-"	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2);\n" \
+"	const uint u2 = Ti[0], u0 = Ti[s], u02 = addmod_d(u0, u2, d);\n" \
 "	const uint4 u13 = to[0];\n" \
-"	const uint u012 = addmod_d(u02, u13.s1), u03 = addmod_d(u0, u13.s3);\n" \
+"	const uint u012 = addmod_d(u02, u13.s1, d), u03 = addmod_d(u0, u13.s3, d);\n" \
 "	to[0] = (uint4)(u012, u02, u03, u0);\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_topsweep2(__global uint * restrict const t, __local uint * restrict const T)\n" \
+"inline void _reduce_topsweep2(__global uint * restrict const t, __local uint * restrict const T, const uint d)\n" \
 "{\n" \
 "	const uint u0 = T[0], u1 = T[1];\n" \
-"	const uint u01 = addmod_d(u0, u1);\n" \
+"	const uint u01 = addmod_d(u0, u1, d);\n" \
 "	t[0] = u01;\n" \
 "	T[0] = u1; T[1] = 0;\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_topsweep4(__global uint * restrict const t, __local uint * restrict const T)\n" \
+"inline void _reduce_topsweep4(__global uint * restrict const t, __local uint * restrict const T, const uint d)\n" \
 "{\n" \
 "	const uint u0 = T[0], u1 = T[1], u2 = T[2], u3 = T[3];\n" \
-"	const uint u01 = addmod_d(u0, u1), u23 = addmod_d(u2, u3);\n" \
-"	const uint u123 = addmod_d(u1, u23), u0123 = addmod_d(u01, u23);\n" \
+"	const uint u01 = addmod_d(u0, u1, d), u23 = addmod_d(u2, u3, d);\n" \
+"	const uint u123 = addmod_d(u1, u23, d), u0123 = addmod_d(u01, u23, d);\n" \
 "	t[0] = u0123;\n" \
 "	T[0] = u123; T[1] = u23; T[2] = u3; T[3] = 0;\n" \
 "}\n" \
 "\n" \
 "#define	S32		(32 / 4)\n" \
 "__kernel __attribute__((reqd_work_group_size(S32, 1, 1)))\n" \
-"void reduce_topsweep32(__global uint * restrict const t, const uint j)\n" \
+"void reduce_topsweep32(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint T[64];	// 20\n" \
 "\n" \
 "	const size_t i = get_local_id(0);\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
-"	_reduce_upsweep4i(T, &t[j], S32, i);\n" \
+"	_reduce_upsweep4i(T, &t[j], S32, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S32 / 4) _reduce_upsweep4(&T[S32], S32 / 4, i);\n" \
+"	if (i < S32 / 4) _reduce_upsweep4(&T[S32], S32 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i == 0) _reduce_topsweep2(t, &T[S32 + 5 * (S32 / 4)]);\n" \
+"	if (i == 0) _reduce_topsweep2(t, &T[S32 + 5 * (S32 / 4)], d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S32 / 4) _reduce_downsweep4(&T[S32], S32 / 4, i);\n" \
+"	if (i < S32 / 4) _reduce_downsweep4(&T[S32], S32 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	_reduce_downsweep4o(&t[j], T, S32, i);\n" \
+"	_reduce_downsweep4o(&t[j], T, S32, i, d);\n" \
 "}\n" \
 "\n" \
 "#define	S64		(64 / 4)\n" \
 "__kernel __attribute__((reqd_work_group_size(S64, 1, 1)))\n" \
-"void reduce_topsweep64(__global uint * restrict const t, const uint j)\n" \
+"void reduce_topsweep64(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint T[64];	// 40\n" \
 "\n" \
 "	const size_t i = get_local_id(0);\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
-"	_reduce_upsweep4i(T, &t[j], S64, i);\n" \
+"	_reduce_upsweep4i(T, &t[j], S64, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S64 / 4) _reduce_upsweep4(&T[S64], S64 / 4, i);\n" \
+"	if (i < S64 / 4) _reduce_upsweep4(&T[S64], S64 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i == 0) _reduce_topsweep4(t, &T[S64 + 5 * (S64 / 4)]);\n" \
+"	if (i == 0) _reduce_topsweep4(t, &T[S64 + 5 * (S64 / 4)], d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S64 / 4) _reduce_downsweep4(&T[S64], S64 / 4, i);\n" \
+"	if (i < S64 / 4) _reduce_downsweep4(&T[S64], S64 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	_reduce_downsweep4o(&t[j], T, S64, i);\n" \
+"	_reduce_downsweep4o(&t[j], T, S64, i, d);\n" \
 "}\n" \
 "\n" \
 "#define	S128	(128 / 4)\n" \
 "__kernel __attribute__((reqd_work_group_size(S128, 1, 1)))\n" \
-"void reduce_topsweep128(__global uint * restrict const t, const uint j)\n" \
+"void reduce_topsweep128(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint T[128];	// 82\n" \
 "\n" \
 "	const size_t i = get_local_id(0);\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
-"	_reduce_upsweep4i(T, &t[j], S128, i);\n" \
+"	_reduce_upsweep4i(T, &t[j], S128, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S128 / 4) _reduce_upsweep4(&T[S128], S128 / 4, i);\n" \
+"	if (i < S128 / 4) _reduce_upsweep4(&T[S128], S128 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S128 / 16) _reduce_upsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i);\n" \
+"	if (i < S128 / 16) _reduce_upsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i == 0) _reduce_topsweep2(t, &T[S128 + 5 * (S128 / 4) + 5 * (S128 / 16)]);\n" \
+"	if (i == 0) _reduce_topsweep2(t, &T[S128 + 5 * (S128 / 4) + 5 * (S128 / 16)], d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S128 / 16) _reduce_downsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i);\n" \
+"	if (i < S128 / 16) _reduce_downsweep4(&T[S128 + 5 * (S128 / 4)], S128 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S128 / 4) _reduce_downsweep4(&T[S128], S128 / 4, i);\n" \
+"	if (i < S128 / 4) _reduce_downsweep4(&T[S128], S128 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	_reduce_downsweep4o(&t[j], T, S128, i);\n" \
+"	_reduce_downsweep4o(&t[j], T, S128, i, d);\n" \
 "}\n" \
 "\n" \
 "#define	S256	(256 / 4)\n" \
 "__kernel __attribute__((reqd_work_group_size(S256, 1, 1)))\n" \
-"void reduce_topsweep256(__global uint * restrict const t, const uint j)\n" \
+"void reduce_topsweep256(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint T[256];	// 168\n" \
 "\n" \
 "	const size_t i = get_local_id(0);\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
-"	_reduce_upsweep4i(T, &t[j], S256, i);\n" \
+"	_reduce_upsweep4i(T, &t[j], S256, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S256 / 4) _reduce_upsweep4(&T[S256], S256 / 4, i);\n" \
+"	if (i < S256 / 4) _reduce_upsweep4(&T[S256], S256 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S256 / 16) _reduce_upsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i);\n" \
+"	if (i < S256 / 16) _reduce_upsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i == 0) _reduce_topsweep4(t, &T[S256 + 5 * (S256 / 4) + 5 * (S256 / 16)]);\n" \
+"	if (i == 0) _reduce_topsweep4(t, &T[S256 + 5 * (S256 / 4) + 5 * (S256 / 16)], d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S256 / 16) _reduce_downsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i);\n" \
+"	if (i < S256 / 16) _reduce_downsweep4(&T[S256 + 5 * (S256 / 4)], S256 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S256 / 4) _reduce_downsweep4(&T[S256], S256 / 4, i);\n" \
+"	if (i < S256 / 4) _reduce_downsweep4(&T[S256], S256 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	_reduce_downsweep4o(&t[j], T, S256, i);\n" \
+"	_reduce_downsweep4o(&t[j], T, S256, i, d);\n" \
 "}\n" \
 "\n" \
 "#define	S512	(512 / 4)\n" \
 "__kernel __attribute__((reqd_work_group_size(S512, 1, 1)))\n" \
-"void reduce_topsweep512(__global uint * restrict const t, const uint j)\n" \
+"void reduce_topsweep512(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint T[512];	// 340\n" \
 "\n" \
 "	const size_t i = get_local_id(0);\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
-"	_reduce_upsweep4i(T, &t[j], S512, i);\n" \
+"	_reduce_upsweep4i(T, &t[j], S512, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S512 / 4) _reduce_upsweep4(&T[S512], S512 / 4, i);\n" \
+"	if (i < S512 / 4) _reduce_upsweep4(&T[S512], S512 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S512 / 16) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i);\n" \
+"	if (i < S512 / 16) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S512 / 64) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i);\n" \
+"	if (i < S512 / 64) _reduce_upsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i == 0) _reduce_topsweep2(t, &T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16) + 5 * (S512 / 64)]);\n" \
+"	if (i == 0) _reduce_topsweep2(t, &T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16) + 5 * (S512 / 64)], d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S512 / 64) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i);\n" \
+"	if (i < S512 / 64) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4) + 5 * (S512 / 16)], S512 / 64, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S512 / 16) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i);\n" \
+"	if (i < S512 / 16) _reduce_downsweep4(&T[S512 + 5 * (S512 / 4)], S512 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S512 / 4) _reduce_downsweep4(&T[S512], S512 / 4, i);\n" \
+"	if (i < S512 / 4) _reduce_downsweep4(&T[S512], S512 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	_reduce_downsweep4o(&t[j], T, S512, i);\n" \
+"	_reduce_downsweep4o(&t[j], T, S512, i, d);\n" \
 "}\n" \
 "\n" \
 "#define	S1024	(1024 / 4)\n" \
 "__kernel __attribute__((reqd_work_group_size(S1024, 1, 1)))\n" \
-"void reduce_topsweep1024(__global uint * restrict const t, const uint j)\n" \
+"void reduce_topsweep1024(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	__local uint T[1024];	// 680\n" \
 "\n" \
 "	const size_t i = get_local_id(0);\n" \
+"	const uint d = pc[2];\n" \
 "\n" \
-"	_reduce_upsweep4i(T, &t[j], S1024, i);\n" \
+"	_reduce_upsweep4i(T, &t[j], S1024, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S1024 / 4) _reduce_upsweep4(&T[S1024], S1024 / 4, i);\n" \
+"	if (i < S1024 / 4) _reduce_upsweep4(&T[S1024], S1024 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S1024 / 16) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i);\n" \
+"	if (i < S1024 / 16) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S1024 / 64) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i);\n" \
+"	if (i < S1024 / 64) _reduce_upsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i == 0) _reduce_topsweep4(t, &T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16) + 5 * (S1024 / 64)]);\n" \
+"	if (i == 0) _reduce_topsweep4(t, &T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16) + 5 * (S1024 / 64)], d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S1024 / 64) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i);\n" \
+"	if (i < S1024 / 64) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4) + 5 * (S1024 / 16)], S1024 / 64, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S1024 / 16) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i);\n" \
+"	if (i < S1024 / 16) _reduce_downsweep4(&T[S1024 + 5 * (S1024 / 4)], S1024 / 16, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	if (i < S1024 / 4) _reduce_downsweep4(&T[S1024], S1024 / 4, i);\n" \
+"	if (i < S1024 / 4) _reduce_downsweep4(&T[S1024], S1024 / 4, i, d);\n" \
 "	barrier(CLK_LOCAL_MEM_FENCE);\n" \
-"	_reduce_downsweep4o(&t[j], T, S1024, i);\n" \
+"	_reduce_downsweep4o(&t[j], T, S1024, i, d);\n" \
 "}\n" \
 "\n" \
+"// If the transform size is RADIX * 2^m then the top of the tree is 4.s remainders, s = RADIX * 2^i <= 256 is the local size.\n" \
+"// The sums are computed as in reduce_scan, by a single group.\n" \
 "__kernel\n" \
-"void reduce_i(__global const uint2 * restrict const x, __global uint * restrict const y, __global uint * restrict const t,\n" \
-"	__global const uint * restrict const bp)\n" \
+"void reduce_topsweep_r(__global uint * restrict t, __global const uint * restrict pc, const uint j)\n" \
 "{\n" \
-"	const size_t k = get_global_id(0);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	__local uint T[256];\n" \
+"\n" \
+"	const size_t i = get_local_id(0), s = get_local_size(0);\n" \
+"	const uint d = pc[2];\n" \
+"\n" \
+"	__global uint4 * const tj_4 = (__global uint4 *)&t[j];\n" \
+"	const uint4 u = tj_4[i];\n" \
+"	const uint u3 = u.s3, u23 = addmod_d(u.s2, u3, d), u123 = addmod_d(u.s1, u23, d);\n" \
 "\n" \
-"	const uint xs = ((x[pconst_e + k].s0 >> pconst_s) | (x[pconst_e + k + 1].s0 << (digit_bit - pconst_s))) & digit_mask;\n" \
-"	const uint u = rem_d(xs * (ulong)(bp[k]));\n" \
+"	// T[i] is the sum of the remainders of the work-items i, i + 1, ...\n" \
+"	T[i] = addmod_d(u.s0, u123, d);\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"	for (size_t m = 1; m < s; m *= 2)\n" \
+"	{\n" \
+"		const uint v = (i + m < s) ? T[i + m] : 0;\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"		T[i] = addmod_d(T[i], v, d);\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"	}\n" \
+"\n" \
+"	if (i == 0) t[0] = T[0];\n" \
+"	const uint u0 = (i + 1 < s) ? T[i + 1] : 0;\n" \
+"	tj_4[i] = (uint4)(addmod_d(u0, u123, d), addmod_d(u0, u23, d), addmod_d(u0, u3, d), u0);\n" \
+"}\n" \
+"\n" \
+"// Single-pass scan with a decoupled look-back (see poly2int_lb): the tree of the sweep kernels is replaced by one kernel.\n" \
+"// t[4 + k] is replaced by the sum of the remainders t[4 + l], l > k, and t[0] is the sum of the remainders, modulo d.\n" \
+"// The sum is computed from the top: the group of ticket g computes the block G - 1 - g. The status of a block is\n" \
+"// its aggregate or its inclusive prefix (bit 30) and an epoch bit (bit 31): the status of the previous scan is not ready.\n" \
+"// ls[0] is the ticket counter, ls[1] counts the completed groups, ls[2] is the epoch and ls[4 + b] is the status of the block b.\n" \
+"\n" \
+"#define REDUCE_SCAN_VAR(RS_WGS) \\\n" \
+"	__local uint T[RS_WGS]; \\\n" \
+"	__local uint S[2];\n" \
+"\n" \
+"inline void reduce_scan(__local uint * restrict const T, __local uint * restrict const S, const size_t RS_WGS,\n" \
+"	__global uint * restrict const t, __global uint * restrict const ls, __global const uint * restrict const pc)\n" \
+"{\n" \
+"	const size_t i = get_local_id(0), G = (pconst_size / 2) / (4 * RS_WGS);\n" \
+"	const uint d = pc[2];	// d < 2^29\n" \
+"\n" \
+"	if (i == 0) { S[0] = atomic_inc(&ls[0]); S[1] = ls[2]; }\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const size_t b = G - 1 - S[0];\n" \
+"	const uint epoch = (S[1] == 0) ? (1u << 31) : 0, inclusive = 1u << 30;\n" \
+"\n" \
+"	__global uint4 * const tb = (__global uint4 *)&t[4 + 4 * RS_WGS * b];\n" \
+"	const uint4 u = tb[i];\n" \
+"	const uint u3 = u.s3, u23 = addmod_d(u.s2, u3, d), u123 = addmod_d(u.s1, u23, d);\n" \
+"\n" \
+"	// T[i] is the sum of the remainders of the work-items i, i + 1, ...\n" \
+"	T[i] = addmod_d(u.s0, u123, d);\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"	for (size_t m = 1; m < RS_WGS; m *= 2)\n" \
+"	{\n" \
+"		const uint v = (i + m < RS_WGS) ? T[i + m] : 0;\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"		T[i] = addmod_d(T[i], v, d);\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"	}\n" \
+"\n" \
+"	if (i == 0)\n" \
+"	{\n" \
+"		const uint aggregate = T[0];\n" \
+"		uint prefix = 0;\n" \
+"		if (b == G - 1) atomic_xchg(&ls[4 + b], epoch | inclusive | aggregate);\n" \
+"		else\n" \
+"		{\n" \
+"			atomic_xchg(&ls[4 + b], epoch | aggregate);\n" \
+"			for (size_t l = b + 1; true; ++l)\n" \
+"			{\n" \
+"				uint status;\n" \
+"				do { status = atomic_or(&ls[4 + l], 0); } while ((status & (1u << 31)) != epoch);\n" \
+"				prefix = addmod_d(prefix, status & (inclusive - 1), d);\n" \
+"				if ((status & inclusive) != 0) break;\n" \
+"			}\n" \
+"			atomic_xchg(&ls[4 + b], epoch | inclusive | addmod_d(prefix, aggregate, d));\n" \
+"		}\n" \
+"		if (b == 0) t[0] = addmod_d(prefix, aggregate, d);\n" \
+"		S[0] = prefix;\n" \
+"\n" \
+"		// the last group resets the counters and changes the epoch\n" \
+"		if (atomic_inc(&ls[1]) == G - 1) { ls[0] = 0; ls[1] = 0; ls[2] = (S[1] == 0) ? 1 : 0; }\n" \
+"	}\n" \
+"	barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"\n" \
+"	const uint u0 = addmod_d(S[0], (i + 1 < RS_WGS) ? T[i + 1] : 0, d);\n" \
+"	tb[i] = (uint4)(addmod_d(u0, u123, d), addmod_d(u0, u23, d), addmod_d(u0, u3, d), u0);\n" \
+"}\n" \
+"\n" \
+"__kernel __attribute__((reqd_work_group_size(64, 1, 1)))\n" \
+"void reduce_scan_64(__global uint * restrict t, __global uint * restrict ls, __global const uint * restrict pc)\n" \
+"{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	ls += batch_offset(4 + pconst_size / 512);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	REDUCE_SCAN_VAR(64);\n" \
+"	reduce_scan(T, S, 64, t, ls, pc);\n" \
+"}\n" \
+"\n" \
+"__kernel __attribute__((reqd_work_group_size(128, 1, 1)))\n" \
+"void reduce_scan_128(__global uint * restrict t, __global uint * restrict ls, __global const uint * restrict pc)\n" \
+"{\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	ls += batch_offset(4 + pconst_size / 512);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	REDUCE_SCAN_VAR(128);\n" \
+"	reduce_scan(T, S, 128, t, ls, pc);\n" \
+"}\n" \
+"\n" \
+"// y[k] is extracted from the digits x[e + k] and x[e + k + 1]\n" \
+"inline void _reduce_i(__global uint * restrict const y, __global uint * restrict const t, __global const uint * restrict const bp,\n" \
+"	__global const uint * restrict const pc, const size_t k, const uint x_lo, const uint x_hi)\n" \
+"{\n" \
+"	const uint pconst_s = pc[1], pconst_d = pc[2], pconst_d_inv = pc[3], pconst_d_shift = pc[4];\n" \
+"\n" \
+"	const uint xs = ((x_lo >> pconst_s) | (x_hi << (digit_bit - pconst_s))) & digit_mask;\n" \
+"	const uint u = _rem(xs * (ulong)(bp[k]), pconst_d, pconst_d_inv, pconst_d_shift);\n" \
 "\n" \
 "	y[k] = xs;\n" \
 "	t[k + 4] = u;\n" \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void reduce_o(__global uint2 * restrict const x, __global const uint * restrict const y, __global const uint * restrict const t,\n" \
-"	__global const uint * restrict const ibp)\n" \
+"void reduce_i(__global const rns * restrict x, __global uint * restrict y, __global uint * restrict t,\n" \
+"	__global const uint * restrict bp, __global const uint * restrict pc)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	y += batch_offset(pconst_size / 2);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	bp += batch_offset(pconst_size / 2);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
 "	const size_t k = get_global_id(0);\n" \
+"	const uint pconst_e = pc[0];\n" \
+"\n" \
+"	_reduce_i(y, t, bp, pc, k, x[pconst_e + k].s0, x[pconst_e + k + 1].s0);\n" \
+"}\n" \
+"\n" \
+"// poly2int1 and reduce_i are fused: the digits of a block are read once, the carry is added and y is extracted.\n" \
+"// The pair (x[i], x[i + 1]) is processed by the block of x[i + 1]. x[i] is the last digit of the previous block,\n" \
+"// it is not modified by poly2int1 unless the carry is propagated through the whole block: then err[1] is set\n" \
+"// and the digits and y are recomputed serially by the last group.\n" \
+"inline void reduce_i_blk(const size_t P2I_BLK, __global rns * restrict const x, __global const long * restrict const cr,\n" \
+"	__global uint * restrict const lb, __global int * const err, __global uint * restrict const y, __global uint * restrict const t,\n" \
+"	__global const uint * restrict const bp, __global const uint * restrict const pc)\n" \
+"{\n" \
+"	const size_t k = get_global_id(0), i0 = P2I_BLK * k;\n" \
+"	const uint pconst_e = pc[0];\n" \
+"\n" \
+"	__global rns * const xi = &x[i0];\n" \
+"\n" \
+"	uint X[16];\n" \
+"	for (size_t j = 0; j < P2I_BLK; ++j) X[j] = xi[j].s0;\n" \
+"	const uint x_prev = (k != 0) ? x[i0 - 1].s0 : 0;\n" \
+"\n" \
+"	long l = cr[k] + X[0];\n" \
+"	X[0] = (uint)(l) & digit_mask;\n" \
+"	l >>= digit_bit;						// |l| < n/2\n" \
+"\n" \
+"	int f = (int)(l);\n" \
+"	size_t jf = 1;\n" \
+"	for (; (f != 0) && (jf < P2I_BLK - 1); ++jf)\n" \
+"	{\n" \
+"		f += X[jf];\n" \
+"		X[jf] = (uint)(f) & digit_mask;\n" \
+"		f >>= digit_bit;					// f = -1, 0 or 1\n" \
+"	}\n" \
+"\n" \
+"	if (f != 0)\n" \
+"	{\n" \
+"		X[P2I_BLK - 1] += (uint)(f);\n" \
+"		jf = P2I_BLK;\n" \
+"		atomic_or(&err[1], 1);\n" \
+"	}\n" \
+"\n" \
+"	for (size_t j = 0; j < jf; ++j) xi[j].s0 = X[j];\n" \
+"\n" \
+"	for (size_t j = 0; j < P2I_BLK; ++j)\n" \
+"	{\n" \
+"		const size_t i = i0 + j;	// x[i - 1], x[i]\n" \
+"		if ((i > pconst_e) && (i - 1 - pconst_e < pconst_size / 2)) _reduce_i(y, t, bp, pc, i - 1 - pconst_e, (j != 0) ? X[j - 1] : x_prev, X[j]);\n" \
+"	}\n" \
+"\n" \
+"	if (poly2int_last_group(lb) && poly2int_fix(x, err))\n" \
+"	{\n" \
+"		for (size_t k = 0; k < pconst_size / 2; ++k) _reduce_i(y, t, bp, pc, k, x[pconst_e + k].s0, x[pconst_e + k + 1].s0);\n" \
+"	}\n" \
+"}\n" \
+"\n" \
+"__kernel\n" \
+"void reduce_i_4(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err,\n" \
+"	__global uint * restrict y, __global uint * restrict t, __global const uint * restrict bp, __global const uint * restrict pc)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"	y += batch_offset(pconst_size / 2);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	bp += batch_offset(pconst_size / 2);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	reduce_i_blk(4, x, cr, lb, err, y, t, bp, pc);\n" \
+"}\n" \
+"\n" \
+"__kernel\n" \
+"void reduce_i_8(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err,\n" \
+"	__global uint * restrict y, __global uint * restrict t, __global const uint * restrict bp, __global const uint * restrict pc)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"	y += batch_offset(pconst_size / 2);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	bp += batch_offset(pconst_size / 2);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	reduce_i_blk(8, x, cr, lb, err, y, t, bp, pc);\n" \
+"}\n" \
+"\n" \
+"__kernel\n" \
+"void reduce_i_16(__global rns * restrict x, __global const long * restrict cr, __global uint * restrict lb, __global int * err,\n" \
+"	__global uint * restrict y, __global uint * restrict t, __global const uint * restrict bp, __global const uint * restrict pc)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	cr += batch_offset(pconst_size / 4);\n" \
+"	lb += batch_offset(2 + pconst_size / 64);\n" \
+"	err += batch_offset(2);\n" \
+"	y += batch_offset(pconst_size / 2);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	bp += batch_offset(pconst_size / 2);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	reduce_i_blk(16, x, cr, lb, err, y, t, bp, pc);\n" \
+"}\n" \
+"\n" \
+"// The checksums of R and Y modulo M31 = 2^31 - 1 are computed by the last reduce kernels of a square.\n" \
+"// B^k = 2^(digit_bit.k mod 31) (mod M31), a slot is two 64-bit accumulators (R, Y) stored as 32-bit words.\n" \
+"#define	M31		0x7fffffffu\n" \
+"\n" \
+"inline uint m31_mul_Bk(const uint a, const size_t k)\n" \
+"{\n" \
+"	const ulong t = (ulong)(a) << ((digit_bit * k) % 31);\n" \
+"	const ulong s = (t & M31) + (t >> 31);		// < 2^33\n" \
+"	const uint r = (uint)(s & M31) + (uint)(s >> 31);\n" \
+"	return (r >= M31) ? r - M31 : r;\n" \
+"}\n" \
+"\n" \
+"inline uint m31_add(const uint a, const uint b)\n" \
+"{\n" \
+"	const uint s = a + b;\n" \
+"	return (s >= M31) ? s - M31 : s;\n" \
+"}\n" \
+"\n" \
+"inline void cs_add(__global uint * const cs, const uint a)\n" \
+"{\n" \
+"	const uint prev = atomic_add(&cs[0], a);\n" \
+"	if (prev > ~a) atomic_inc(&cs[1]);		// carry\n" \
+"}\n" \
+"\n" \
+"inline void checksum(__global uint * const cs, const int cs_slot, __local uint2 * const T, const uint r, const uint y)\n" \
+"{\n" \
+"	const size_t i = get_local_id(0);\n" \
+"	T[i] = (uint2)(r, y);\n" \
+"	for (size_t m = CS_BLK / 2; m > 0; m /= 2)\n" \
+"	{\n" \
+"		barrier(CLK_LOCAL_MEM_FENCE);\n" \
+"		if (i < m) T[i] = (uint2)(m31_add(T[i].s0, T[i + m].s0), m31_add(T[i].s1, T[i + m].s1));\n" \
+"	}\n" \
+"	if (i == 0) { cs_add(&cs[4 * cs_slot + 0], T[0].s0); cs_add(&cs[4 * cs_slot + 2], T[0].s1); }\n" \
+"}\n" \
+"\n" \
+"// The digits of R are x[k].s0, k < e, the upper digits are computed by reduce_f\n" \
+"__kernel __attribute__((reqd_work_group_size(CS_BLK, 1, 1)))\n" \
+"void reduce_o(__global rns * restrict x, __global const uint * restrict y, __global const uint * restrict t,\n" \
+"	__global const uint * restrict ibp, __global const uint * restrict pc, __global uint * restrict cs, const int cs_slot)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	y += batch_offset(pconst_size / 2);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	ibp += batch_offset(pconst_size / 2);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	__local uint2 T[CS_BLK];\n" \
+"\n" \
+"	const size_t k = get_global_id(0);\n" \
+"	const uint pconst_e = pc[0], pconst_d = pc[2], pconst_d_inv = pc[3], pconst_d_shift = pc[4];\n" \
 "\n" \
 "	const uint tk = t[k + 4];\n" \
 "	//const uint rbk_prev = (k != pconst_size / 2 - 1) ? tk : 0;	// NVidia compiler generates a conditionnal branch instruction then the code must be written with a mask\n" \
 "	const uint mask = (k != pconst_size / 2 - 1) ? (uint)(-1) : 0;\n" \
 "	const uint rbk_prev = tk & mask;\n" \
-"	const uint r_prev = rem_d(rbk_prev * (ulong)(ibp[k]));\n" \
+"	const uint r_prev = _rem(rbk_prev * (ulong)(ibp[k]), pconst_d, pconst_d_inv, pconst_d_shift);\n" \
 "\n" \
 "	const ulong q = ((ulong)(r_prev) << digit_bit) | y[k];\n" \
 "\n" \
@@ -330,33 +647,92 @@ static const char * const src_ocl_reduce = \
 "	const uint r = (uint)(q) - q_d * pconst_d;\n" \
 "	const uint c = (r >= pconst_d) ? 1 : 0;\n" \
 "\n" \
-"	x[k] = (uint2)((k > pconst_e) ? 0 : x[k].s0, q_d + c);\n" \
+"	const uint x_k = (k > pconst_e) ? 0 : x[k].s0;\n" \
+"	x[k] = digits(x_k, q_d + c);\n" \
+"\n" \
+"	if (cs_slot >= 0) checksum(cs, cs_slot, T, (k < pconst_e) ? m31_mul_Bk(x_k, k) : 0, m31_mul_Bk(q_d + c, k));\n" \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void reduce_f(__global uint2 * restrict const x, __global const uint * restrict const t)\n" \
+"void reduce_f(__global rns * restrict x, __global const uint * restrict t, __global const uint * restrict pc,\n" \
+"	__global uint * restrict cs, const int cs_slot)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	const uint pconst_e = pc[0], pconst_s = pc[1];\n" \
+"\n" \
 "	const uint rs = x[pconst_e].s0 & ((1u << pconst_s) - 1);\n" \
 "	ulong l = ((ulong)(t[0]) << pconst_s) | rs;		// rds < 2^(29 + digit_bit - 1)\n" \
 "\n" \
-"	x[pconst_e].s0 = (uint)(l) & digit_mask;\n" \
+"	uint x_k = (uint)(l) & digit_mask;\n" \
+"	x[pconst_e].s0 = x_k;\n" \
+"	uint r = m31_mul_Bk(x_k, pconst_e);\n" \
 "	l >>= digit_bit;\n" \
 "\n" \
 "	for (size_t k = pconst_e + 1; l != 0; ++k)\n" \
 "	{\n" \
-"		x[k].s0 = (uint)(l) & digit_mask;\n" \
+"		x_k = (uint)(l) & digit_mask;\n" \
+"		x[k].s0 = x_k;\n" \
+"		r = m31_add(r, m31_mul_Bk(x_k, k));\n" \
 "		l >>= digit_bit;\n" \
 "	}\n" \
+"\n" \
+"	if (cs_slot >= 0) cs_add(&cs[4 * cs_slot + 0], r);\n" \
+"}\n" \
+"\n" \
+"// reduce_o and reduce_f are fused: the work-items k >= e compute the digits of r * 2^s + (X_lo mod 2^s).\n" \
+"// The s low bits of x[e] are not modified by the work-item e then they can be read by the other work-items.\n" \
+"__kernel __attribute__((reqd_work_group_size(CS_BLK, 1, 1)))\n" \
+"void reduce_of(__global rns * restrict x, __global const uint * restrict y, __global const uint * restrict t,\n" \
+"	__global const uint * restrict ibp, __global const uint * restrict pc, __global uint * restrict cs, const int cs_slot)\n" \
+"{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	y += batch_offset(pconst_size / 2);\n" \
+"	t += batch_offset(pconst_size);\n" \
+"	ibp += batch_offset(pconst_size / 2);\n" \
+"	pc += batch_offset(PC_SIZE);\n" \
+"\n" \
+"	__local uint2 T[CS_BLK];\n" \
+"\n" \
+"	const size_t k = get_global_id(0);\n" \
+"	const uint pconst_e = pc[0], pconst_s = pc[1], pconst_d = pc[2], pconst_d_inv = pc[3], pconst_d_shift = pc[4];\n" \
+"\n" \
+"	const uint tk = t[k + 4];\n" \
+"	const uint mask = (k != pconst_size / 2 - 1) ? (uint)(-1) : 0;\n" \
+"	const uint rbk_prev = tk & mask;\n" \
+"	const uint r_prev = _rem(rbk_prev * (ulong)(ibp[k]), pconst_d, pconst_d_inv, pconst_d_shift);\n" \
+"\n" \
+"	const ulong q = ((ulong)(r_prev) << digit_bit) | y[k];\n" \
+"\n" \
+"	const uint q_d = mul_hi((uint)(q >> pconst_d_shift), pconst_d_inv);	// d < 2^29\n" \
+"	const uint r = (uint)(q) - q_d * pconst_d;\n" \
+"	const uint c = (r >= pconst_d) ? 1 : 0;\n" \
+"\n" \
+"	uint x_k;\n" \
+"	if (k < pconst_e) x_k = x[k].s0;\n" \
+"	else\n" \
+"	{\n" \
+"		const uint rs = x[pconst_e].s0 & ((1u << pconst_s) - 1);\n" \
+"		const ulong l = ((ulong)(t[0]) << pconst_s) | rs;		// rds < 2^(29 + digit_bit - 1)\n" \
+"		const size_t shift = digit_bit * (k - pconst_e);\n" \
+"		x_k = (shift < 64) ? (uint)(l >> shift) & digit_mask : 0;\n" \
+"	}\n" \
+"\n" \
+"	x[k] = digits(x_k, q_d + c);\n" \
+"\n" \
+"	if (cs_slot >= 0) checksum(cs, cs_slot, T, m31_mul_Bk(x_k, k), m31_mul_Bk(q_d + c, k));\n" \
 "}\n" \
 "\n" \
-"inline void _reduce_x(__global uint2 * restrict const x, __global int * const err)\n" \
+"inline void _reduce_x(__global rns * restrict const x, __global int * const err)\n" \
 "{\n" \
 "	int c = 0;\n" \
 "	for (size_t k = 0; k < pconst_size / 2; ++k)\n" \
 "	{\n" \
-"		const uint2 x_k = x[k];\n" \
+"		const rns x_k = x[k];\n" \
 "		c += x_k.s0 - x_k.s1;\n" \
-"		x[k] = (uint2)((uint)(c) & digit_mask, 0);\n" \
+"		x[k] = digits((uint)(c) & digit_mask, 0);\n" \
 "		c >>= digit_bit;\n" \
 "	}\n" \
 "\n" \
@@ -364,20 +740,26 @@ static const char * const src_ocl_reduce = \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void reduce_x(__global uint2 * restrict const x, __global int * const err)\n" \
+"void reduce_x(__global rns * restrict x, __global int * err)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
 "	_reduce_x(x, err);\n" \
 "}\n" \
 "\n" \
 "__kernel\n" \
-"void reduce_z(__global uint2 * restrict const x, __global int * const err)\n" \
+"void reduce_z(__global rns * restrict x, __global int * err)\n" \
 "{\n" \
+"	x += batch_offset(pconst_size);\n" \
+"	err += batch_offset(2);\n" \
+"\n" \
 "	// s0 = x, s1 = k.2^n + 1\n" \
 "	// if s0 >= s1 then s0 -= s1;\n" \
 "\n" \
 "	for (size_t i = 0; i < pconst_size / 2; ++i)\n" \
 "	{\n" \
-"		const uint2 x_k = x[pconst_size / 2 - 1 - i];\n" \
+"		const rns x_k = x[pconst_size / 2 - 1 - i];\n" \
 "		if (x_k.s0 < x_k.s1) return;\n" \
 "		if (x_k.s0 > x_k.s1) break;\n" \
 "	}\n" \
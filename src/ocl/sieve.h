@@ -0,0 +1,117 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+static const char * const src_ocl_sieve = \
+"/*\n" \
+"Copyright 2020, Yves Gallot\n" \
+"\n" \
+"proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.\n" \
+"Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.\n" \
+"*/\n" \
+"\n" \
+"// Montgomery arithmetic modulo p, p < 2^63, q = -1/p mod 2^64 and r = x.2^64 mod p\n" \
+"\n" \
+"inline ulong m_add(const ulong a, const ulong b, const ulong p)\n" \
+"{\n" \
+"	const ulong c = (a >= p - b) ? p : 0;\n" \
+"	return a + b - c;\n" \
+"}\n" \
+"\n" \
+"inline ulong m_mul(const ulong a, const ulong b, const ulong p, const ulong q)\n" \
+"{\n" \
+"	const ulong ab_l = a * b, ab_h = mul_hi(a, b);\n" \
+"	// ab_l + (ab_l.q).p = 0 (mod 2^64)\n" \
+"	const ulong r = ab_h + mul_hi(ab_l * q, p) + ((ab_l != 0) ? 1 : 0);\n" \
+"	return (r >= p) ? r - p : r;\n" \
+"}\n" \
+"\n" \
+"inline ulong m_pow(const ulong a, const ulong e, const ulong one, const ulong p, const ulong q)\n" \
+"{\n" \
+"	if (e == 0) return one;\n" \
+"	ulong r = a;\n" \
+"	for (int b = 62 - (int)(clz(e)); b >= 0; --b)\n" \
+"	{\n" \
+"		r = m_mul(r, r, p, q);\n" \
+"		if ((e & ((ulong)(1) << b)) != 0) r = m_mul(r, a, p, q);\n" \
+"	}\n" \
+"	return r;\n" \
+"}\n" \
+"\n" \
+"inline void record(__global uint4 * restrict const factor, __global uint * restrict const factorCount, const ulong p, const uint i, const uint j)\n" \
+"{\n" \
+"	const uint pos = atomic_inc(factorCount);\n" \
+"	if (pos < FACTOR_MAX) factor[pos] = (uint4)((uint)(p), (uint)(p >> 32), i, N_MIN + j);\n" \
+"}\n" \
+"\n" \
+"// The solutions of k_i.2^(N_MIN + j) = -1 (mod p), 0 <= j < N_COUNT, are found with a baby-step giant-step algorithm.\n" \
+"// The baby steps 2^b, 0 <= b < BABY_STEPS, are stored in a hash table. If the order of 2 is smaller than BABY_STEPS\n" \
+"// then the solutions are periodic.\n" \
+"__kernel\n" \
+"void sieve(__global const ulong * restrict const prime, __constant uint * restrict const k,\n" \
+"	__global uint4 * restrict const factor, __global uint * restrict const factorCount)\n" \
+"{\n" \
+"	const ulong p = prime[get_global_id(0)];\n" \
+"\n" \
+"	ulong ip = p;	// p.p = 1 (mod 8)\n" \
+"	for (int i = 0; i < 5; ++i) ip *= 2 - p * ip;\n" \
+"	const ulong q = -ip;\n" \
+"\n" \
+"	const ulong one = (0 - p) % p, two = m_add(one, one, p);\n" \
+"	ulong r2 = one;\n" \
+"	for (int i = 0; i < 64; ++i) r2 = m_add(r2, r2, p);\n" \
+"\n" \
+"	ulong h_val[HASH_SIZE];\n" \
+"	uint h_idx[HASH_SIZE];\n" \
+"	for (size_t h = 0; h < HASH_SIZE; ++h) h_val[h] = 0;	// 2^b != 0\n" \
+"\n" \
+"	uint ord = 0;\n" \
+"	ulong x = one;\n" \
+"	for (uint b = 0; b < BABY_STEPS; ++b)\n" \
+"	{\n" \
+"		if ((b != 0) && (x == one)) { ord = b; break; }\n" \
+"		size_t h = (size_t)(x) % HASH_SIZE;\n" \
+"		while (h_val[h] != 0) h = (h + 1) % HASH_SIZE;\n" \
+"		h_val[h] = x; h_idx[h] = b;\n" \
+"		x = m_mul(x, two, p, q);\n" \
+"	}\n" \
+"\n" \
+"	// g = 2^-BABY_STEPS, t = 2^N_MIN\n" \
+"	const ulong g = m_pow(x, p - 2, one, p, q), t = m_pow(two, N_MIN, one, p, q);\n" \
+"\n" \
+"	for (uint i = 0; i < K_COUNT; ++i)\n" \
+"	{\n" \
+"		const ulong k_p = k[i] % p;\n" \
+"		if (k_p == 0) continue;\n" \
+"\n" \
+"		// c = -1 / (k.2^N_MIN)\n" \
+"		ulong c = p - m_pow(m_mul(m_mul(k_p, r2, p, q), t, p, q), p - 2, one, p, q);\n" \
+"\n" \
+"		if (ord == 0)\n" \
+"		{\n" \
+"			for (uint a = 0; a < N_COUNT; a += BABY_STEPS)\n" \
+"			{\n" \
+"				for (size_t h = (size_t)(c) % HASH_SIZE; h_val[h] != 0; h = (h + 1) % HASH_SIZE)\n" \
+"				{\n" \
+"					if ((h_val[h] == c) && (a + h_idx[h] < N_COUNT)) record(factor, factorCount, p, i, a + h_idx[h]);\n" \
+"				}\n" \
+"				c = m_mul(c, g, p, q);\n" \
+"			}\n" \
+"		}\n" \
+"		else\n" \
+"		{\n" \
+"			for (size_t h = (size_t)(c) % HASH_SIZE; h_val[h] != 0; h = (h + 1) % HASH_SIZE)\n" \
+"			{\n" \
+"				if (h_val[h] == c) for (uint j = h_idx[h]; j < N_COUNT; j += ord) record(factor, factorCount, p, i, j);\n" \
+"			}\n" \
+"		}\n" \
+"	}\n" \
+"}\n" \
+"";
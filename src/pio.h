@@ -12,6 +12,7 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include <iostream>
 #include <fstream>
 #include <cstdio>
+#include <mutex>
 
 #include "boinc.h"
 
@@ -35,6 +36,7 @@ public:
 
 private:
 	bool _isBoinc = false;
+	std::mutex _mutex;	// the outputs may be shared by several threads
 
 private:
 	// print: console: cout, boinc: stderr
@@ -119,12 +121,12 @@ private:
 	}
 
 public:
-	static void print(const std::string & str) { getInstance()._print(str); }
-	static void display(const std::string & str) { getInstance()._display(str); }
-	static void error(const std::string & str, const bool fatal = false) { getInstance()._error(str, fatal); }
-	static bool result(const std::string & str) { return getInstance()._result(str); }
-	static bool oresult(const std::string & str) { return getInstance()._oresult(str); }
-	static bool fresult(const std::string & str) { return getInstance()._fresult(str); }
+	static void print(const std::string & str) { pio & p = getInstance(); std::lock_guard<std::mutex> guard(p._mutex); p._print(str); }
+	static void display(const std::string & str) { pio & p = getInstance(); std::lock_guard<std::mutex> guard(p._mutex); p._display(str); }
+	static void error(const std::string & str, const bool fatal = false) { pio & p = getInstance(); std::lock_guard<std::mutex> guard(p._mutex); p._error(str, fatal); }
+	static bool result(const std::string & str) { pio & p = getInstance(); std::lock_guard<std::mutex> guard(p._mutex); return p._result(str); }
+	static bool oresult(const std::string & str) { pio & p = getInstance(); std::lock_guard<std::mutex> guard(p._mutex); return p._oresult(str); }
+	static bool fresult(const std::string & str) { pio & p = getInstance(); std::lock_guard<std::mutex> guard(p._mutex); return p._fresult(str); }
 
 	static FILE * open(const char * const filename, const char * const mode) { return getInstance()._open(filename, mode); }
 };
@@ -16,8 +16,9 @@ private:
 	{
 		uint32_t m;
 		uint32_t chunk;
+		bool p2i;	// the first slice computes poly2int0 with its last inverse stage
 
-		slice(const uint32_t m, const uint32_t chunk) : m(m), chunk(chunk) {}
+		slice(const uint32_t m, const uint32_t chunk, const bool p2i = false) : m(m), chunk(chunk), p2i(p2i) {}
 	};
 	typedef std::vector<slice> solution;
 
@@ -25,7 +26,7 @@ private:
 	class squareSplitter
 	{
 	private:
-		bool _b512 = false, _b1024 = false;
+		bool _b512 = false, _b1024 = false, _p2i = true;
 		std::vector<solution> _squareSet;
 
 	private:
@@ -36,6 +37,14 @@ private:
 				sol.push_back(slice(ms, chunk));
 				split(m / ms, i + 1, sol);
 				sol.pop_back();
+
+				// the blocks of poly2int0 are 4 contiguous digits
+				if (_p2i && (i == 0) && (chunk >= 4))
+				{
+					sol.push_back(slice(ms, chunk, true));
+					split(m / ms, i + 1, sol);
+					sol.pop_back();
+				}
 			}
 		}
 
@@ -63,21 +72,21 @@ private:
 		virtual ~squareSplitter() {}
 
 	public:
-		void init(const uint32_t n, const bool b512, const bool b1024)
+		void init(const uint32_t n, const bool b512, const bool b1024, const bool p2i)
 		{
-			_b512 = b512; _b1024 = b1024;
+			_b512 = b512; _b1024 = b1024; _p2i = p2i;
 			_squareSet.clear();
 			solution sol; split(n, 0, sol);
 		}
 
 		size_t getSquareSize() const { return _squareSet.size(); }
 		const solution & getSquareSeq(const size_t i) const { return _squareSet.at(i); }
-		std::string getString(const size_t size, const size_t i) const
+		std::string getString(const size_t size, const size_t i, const char * const center = "sq_") const
 		{
 			std::ostringstream ss;
 			size_t m = size;
-			for (const slice & s : _squareSet.at(i)) { ss << s.m << "_" << s.chunk << " "; m /= s.m; }
-			ss << "sq_" << m;
+			for (const slice & s : _squareSet.at(i)) { ss << s.m << "_" << s.chunk << (s.p2i ? "_p2i" : "") << " "; m /= s.m; }
+			ss << center << m;
  			return ss.str();
 		}
 	};
@@ -85,6 +94,10 @@ private:
 private:
 	class squareSeq
 	{
+	public:
+		// the square, the square storing the forward transform of x into tu, the product by tu or the forward transform of tu
+		enum class EMode { Square, SquareKeep, Mul, Multiplicand };
+
 	private:
 		struct func
 		{
@@ -97,14 +110,16 @@ private:
 		};
 		size_t _n;
 		func f[16];
+		bool _p2i;
 
 	public:
-		squareSeq() : _n(0) {}
+		squareSeq() : _n(0), _p2i(false) {}
 		virtual ~squareSeq() {}
 
 	public:
-		void init(const size_t size, const solution & sol)
+		void init(const size_t size, const solution & sol, const EMode mode = EMode::Square)
 		{
+			const bool u = (mode == EMode::Multiplicand);
 			size_t n = 0;
 
 			cl_uint m = cl_uint(size / 4);
@@ -113,23 +128,23 @@ private:
 			const slice & s = sol[0];
 			if (s.m == 1024)
 			{
-				if (s.chunk == 1) f[n] = func(&engine::sub_ntt1024_1);
-				if (s.chunk == 2) f[n] = func(&engine::sub_ntt1024_2);
-				if (s.chunk == 4) f[n] = func(&engine::sub_ntt1024_4);
+				if (s.chunk == 1) f[n] = func(u ? &engine::sub_ntt1024_1_u : &engine::sub_ntt1024_1);
+				if (s.chunk == 2) f[n] = func(u ? &engine::sub_ntt1024_2_u : &engine::sub_ntt1024_2);
+				if (s.chunk == 4) f[n] = func(u ? &engine::sub_ntt1024_4_u : &engine::sub_ntt1024_4);
 				rindex += (256 + 64 + 16 + 4 + 1) * (m / 256);
 				m /= 1024;
 			}
 			else if (s.m == 256)
 			{
-				if (s.chunk == 4) f[n] = func(&engine::sub_ntt256_4);
-				if (s.chunk == 8) f[n] = func(&engine::sub_ntt256_8);
-				if (s.chunk == 16) f[n] = func(&engine::sub_ntt256_16);
+				if (s.chunk == 4) f[n] = func(u ? &engine::sub_ntt256_4_u : &engine::sub_ntt256_4);
+				if (s.chunk == 8) f[n] = func(u ? &engine::sub_ntt256_8_u : &engine::sub_ntt256_8);
+				if (s.chunk == 16) f[n] = func(u ? &engine::sub_ntt256_16_u : &engine::sub_ntt256_16);
 				rindex += (64 + 16 + 4 + 1) * (m / 64);
 				m /= 256;
 			}
 			else if (s.m == 64)
 			{
-				if (s.chunk == 16) f[n] = func(&engine::sub_ntt64_16);
+				if (s.chunk == 16) f[n] = func(u ? &engine::sub_ntt64_u : &engine::sub_ntt64_16);
 				rindex += (16 + 4 + 1) * (m / 16);
 				m /= 64;
 			}
@@ -140,40 +155,80 @@ private:
 				const slice & s = sol[i];
 				if (s.m == 1024)
 				{
-					if (s.chunk == 1) f[n] = func(&engine::ntt1024_1, m / 256, rindex);
-					if (s.chunk == 2) f[n] = func(&engine::ntt1024_2, m / 256, rindex);
-					if (s.chunk == 4) f[n] = func(&engine::ntt1024_4, m / 256, rindex);
+					if (s.chunk == 1) f[n] = func(u ? &engine::ntt1024_1_u : &engine::ntt1024_1, m / 256, rindex);
+					if (s.chunk == 2) f[n] = func(u ? &engine::ntt1024_2_u : &engine::ntt1024_2, m / 256, rindex);
+					if (s.chunk == 4) f[n] = func(u ? &engine::ntt1024_4_u : &engine::ntt1024_4, m / 256, rindex);
 					rindex += (256 + 64 + 16 + 4 + 1) * (m / 256);
 					m /= 1024;
 				} 
 				else if (s.m == 256)
 				{
-					if (s.chunk == 4) f[n] = func(&engine::ntt256_4, m / 64, rindex);
-					if (s.chunk == 8) f[n] = func(&engine::ntt256_8, m / 64, rindex);
-					if (s.chunk == 16) f[n] = func(&engine::ntt256_16, m / 64, rindex);
+					if (s.chunk == 4) f[n] = func(u ? &engine::ntt256_4_u : &engine::ntt256_4, m / 64, rindex);
+					if (s.chunk == 8) f[n] = func(u ? &engine::ntt256_8_u : &engine::ntt256_8, m / 64, rindex);
+					if (s.chunk == 16) f[n] = func(u ? &engine::ntt256_16_u : &engine::ntt256_16, m / 64, rindex);
 					rindex += (64 + 16 + 4 + 1) * (m / 64);
 					m /= 256;
 				}
 				else if (s.m == 64)
 				{
-					if (s.chunk == 16) f[n] = func(&engine::ntt64_16, m / 16, rindex);
+					if (s.chunk == 16) f[n] = func(u ? &engine::ntt64_u : &engine::ntt64_16, m / 16, rindex);
 					rindex += (16 + 4 + 1) * (m / 16);
 					m /= 64;
 				}
 				++n;
 			}
 
-			if (m == 1024)       f[n] = func(&engine::square4096);
-			else if (m == 512)   f[n] = func(&engine::square2048);
-			else if (m == 256)   f[n] = func(&engine::square1024);
-			else if (m == 128)   f[n] = func(&engine::square512);
-			else if (m == 64)    f[n] = func(&engine::square256);
-			else if (m == 32)    f[n] = func(&engine::square128);
-			else if (m == 16)    f[n] = func(&engine::square64);
-			else if (m == 8)     f[n] = func(&engine::square32);
-			else if (m == 4)     f[n] = func(&engine::square16);
-			else /*if (m == 2)*/ f[n] = func(&engine::square8);
-			++n;
+			// tu is transformed down to the stage of mul2 or mul4
+			if (u)
+			{
+				for (; m > 1; m /= 4) { f[n] = func(&engine::ntt4_u, m, rindex); rindex += m; ++n; }
+				_n = n;
+				_p2i = false;
+				return;
+			}
+
+			if (mode == EMode::Mul)
+			{
+				if (m == 1024)       f[n] = func(&engine::mul4096);
+				else if (m == 512)   f[n] = func(&engine::mul2048);
+				else if (m == 256)   f[n] = func(&engine::mul1024);
+				else if (m == 128)   f[n] = func(&engine::mul512);
+				else if (m == 64)    f[n] = func(&engine::mul256);
+				else if (m == 32)    f[n] = func(&engine::mul128);
+				else if (m == 16)    f[n] = func(&engine::mul64);
+				else if (m == 8)     f[n] = func(&engine::mul32);
+				else if (m == 4)     f[n] = func(&engine::mul16);
+				else /*if (m == 2)*/ f[n] = func(&engine::mul8);
+				++n;
+			}
+			else if (mode == EMode::SquareKeep)
+			{
+				if (m == 1024)       f[n] = func(&engine::square4096_tu);
+				else if (m == 512)   f[n] = func(&engine::square2048_tu);
+				else if (m == 256)   f[n] = func(&engine::square1024_tu);
+				else if (m == 128)   f[n] = func(&engine::square512_tu);
+				else if (m == 64)    f[n] = func(&engine::square256_tu);
+				else if (m == 32)    f[n] = func(&engine::square128_tu);
+				else if (m == 16)    f[n] = func(&engine::square64_tu);
+				else if (m == 8)     f[n] = func(&engine::square32_tu);
+				else if (m == 4)     f[n] = func(&engine::square16_tu);
+				else /*if (m == 2)*/ f[n] = func(&engine::square8_tu);
+				++n;
+			}
+			else
+			{
+				if (m == 1024)       f[n] = func(&engine::square4096);
+				else if (m == 512)   f[n] = func(&engine::square2048);
+				else if (m == 256)   f[n] = func(&engine::square1024);
+				else if (m == 128)   f[n] = func(&engine::square512);
+				else if (m == 64)    f[n] = func(&engine::square256);
+				else if (m == 32)    f[n] = func(&engine::square128);
+				else if (m == 16)    f[n] = func(&engine::square64);
+				else if (m == 8)     f[n] = func(&engine::square32);
+				else if (m == 4)     f[n] = func(&engine::square16);
+				else /*if (m == 2)*/ f[n] = func(&engine::square8);
+				++n;
+			}
 
 			for (size_t i = sol.size() - 1; i >= 1; --i)
 			{
@@ -207,23 +262,26 @@ private:
 			{
 				if (s.chunk == 1) f[n] = func(&engine::lst_intt1024_1);
 				if (s.chunk == 2) f[n] = func(&engine::lst_intt1024_2);
-				if (s.chunk == 4) f[n] = func(&engine::lst_intt1024_4);
+				if (s.chunk == 4) f[n] = func(s.p2i ? &engine::lst_intt1024_4_p2i : &engine::lst_intt1024_4);
 			}
 			else if (s.m == 256)
 			{
-				if (s.chunk == 4) f[n] = func(&engine::lst_intt256_4);
-				if (s.chunk == 8) f[n] = func(&engine::lst_intt256_8);
-				if (s.chunk == 16) f[n] = func(&engine::lst_intt256_16);
+				if (s.chunk == 4) f[n] = func(s.p2i ? &engine::lst_intt256_4_p2i : &engine::lst_intt256_4);
+				if (s.chunk == 8) f[n] = func(s.p2i ? &engine::lst_intt256_8_p2i : &engine::lst_intt256_8);
+				if (s.chunk == 16) f[n] = func(s.p2i ? &engine::lst_intt256_16_p2i : &engine::lst_intt256_16);
 			}
 			else if (s.m == 64)
 			{
-				if (s.chunk == 16) f[n] = func(&engine::lst_intt64_16);
+				if (s.chunk == 16) f[n] = func(s.p2i ? &engine::lst_intt64_16_p2i : &engine::lst_intt64_16);
 			}
 			++n;
 
 			_n = n;
+			_p2i = s.p2i;
 		}
 
+		bool isPoly2int() const { return _p2i; }
+
 	public:
 		void exec(engine & engine) const
 		{
@@ -237,31 +295,42 @@ private:
 
 private:
 	squareSplitter _squareSplitter;
-	squareSeq _squareSeq;
+	squareSeq _squareSeq, _squareKeepSeq;	// the sequences are the same except the center kernel
 	size_t _square_i = 0;
+	// mul() and setMultiplicand() are tuned separately, their slices are the same
+	squareSeq _mulSeq, _multiplicandSeq;
+	size_t _mul_i = 0;
 
 	struct p2i
 	{
 		void(engine::*_fn)();
 		std::string _name;
+		bool _fused;	// reduce_i is computed with the carry propagation
 
-		p2i() : _fn(nullptr) {}
-		p2i(void(engine::*fn)(), const std::string & name) : _fn(fn), _name(name) {}
+		p2i() : _fn(nullptr), _fused(false) {}
+		p2i(void(engine::*fn)(), const std::string & name, const bool fused = false) : _fn(fn), _name(name), _fused(fused) {}
 	};
 
 	std::vector<p2i> _p2iFn;
 	void(engine::*_poly2intFn)() = nullptr;
 	size_t _poly2int_i = 0;
 
+	// the output of split() is computed by reduce_o and reduce_f or by the fused kernel reduce_of
+	bool _reduceFused = false;
+	// the remainders of split() are computed by the sweep kernels (0) or by a single-pass scan of 64 (1) or 128 (2) work-items
+	size_t _reduceScan = 0;
+
 public:
 	plan() {}
 	virtual ~plan() {}
 
 public:
-	void init(const size_t size, const bool b512, const bool b1024)
+	// If the transform size is radix * size then the last stage is the radix stage: poly2int0 is not fused with the radix-4 stages.
+	void init(const size_t size, const bool b512, const bool b1024, const bool fusedP2i)
 	{
-		_squareSplitter.init(size / 4, b512, b1024);
+		_squareSplitter.init(size / 4, b512, b1024, fusedP2i);
 
+		_p2iFn.clear();
 		_p2iFn.push_back(p2i(&engine::poly2int_4_16, "p2i_4_16"));
 		_p2iFn.push_back(p2i(&engine::poly2int_4_32, "p2i_4_32"));
 		_p2iFn.push_back(p2i(&engine::poly2int_4_64, "p2i_4_64"));
@@ -271,23 +340,110 @@ public:
 		_p2iFn.push_back(p2i(&engine::poly2int_16_8, "p2i_16_8"));
 		_p2iFn.push_back(p2i(&engine::poly2int_16_16, "p2i_16_16"));
 		_p2iFn.push_back(p2i(&engine::poly2int_16_32, "p2i_16_32"));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_4_16, "p2ir_4_16", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_4_32, "p2ir_4_32", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_4_64, "p2ir_4_64", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_8_16, "p2ir_8_16", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_8_32, "p2ir_8_32", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_8_64, "p2ir_8_64", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_16_8, "p2ir_16_8", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_16_16, "p2ir_16_16", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_red_16_32, "p2ir_16_32", true));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_4_16, "p2il_4_16"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_4_32, "p2il_4_32"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_4_64, "p2il_4_64"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_8_16, "p2il_8_16"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_8_32, "p2il_8_32"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_8_64, "p2il_8_64"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_16_8, "p2il_16_8"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_16_16, "p2il_16_16"));
+		_p2iFn.push_back(p2i(&engine::poly2int_lb_16_32, "p2il_16_32"));
 
 		setSquareSeq(size, 0);
+		setMulSeq(size, 0);
 		setPoly2intFn(0);
+		setReduceFn(0);
+	}
+
+public:
+	// After repeated errors, the next square sequence is selected and the carries and the remainders are computed by the first kernels
+	void setFallback(const size_t size)
+	{
+		const size_t i = (_square_i + 1) % getSquareSeqCount();
+		setSquareSeq(size, i);
+		setMulSeq(size, i);
+		setPoly2intFn(0);
+		setReduceFn(0);
 	}
 
 public:
 	size_t getSquareSeqCount() const { return _squareSplitter.getSquareSize(); }
-	void setSquareSeq(const size_t size, const size_t i) { _square_i = i; _squareSeq.init(size, _squareSplitter.getSquareSeq(i)); }
+	void setSquareSeq(const size_t size, const size_t i)
+	{
+		_square_i = i;
+		_squareSeq.init(size, _squareSplitter.getSquareSeq(i));
+		_squareKeepSeq.init(size, _squareSplitter.getSquareSeq(i), squareSeq::EMode::SquareKeep);
+	}
 	void execSquareSeq(engine & engine) { _squareSeq.exec(engine); }
+	// tu is the forward transform of x, it is the multiplicand of the next mul()
+	void execSquareKeepSeq(engine & engine) { _squareKeepSeq.exec(engine); }
 	std::string getSquareSeqString(const size_t size) const { return _squareSplitter.getString(size, _square_i); }
 
+public:
+	size_t getMulSeqCount() const { return _squareSplitter.getSquareSize(); }
+	void setMulSeq(const size_t size, const size_t i)
+	{
+		_mul_i = i;
+		_mulSeq.init(size, _squareSplitter.getSquareSeq(i), squareSeq::EMode::Mul);
+		_multiplicandSeq.init(size, _squareSplitter.getSquareSeq(i), squareSeq::EMode::Multiplicand);
+	}
+	void execMulSeq(engine & engine) { _mulSeq.exec(engine); }
+	void execMultiplicandSeq(engine & engine) { _multiplicandSeq.exec(engine); }
+	std::string getMulSeqString(const size_t size) const { return _squareSplitter.getString(size, _mul_i, "mul_"); }
+
 public:
 	size_t getPoly2intCount() const { return _p2iFn.size(); }
 	void setPoly2intFn(const size_t i) { _poly2int_i = i; _poly2intFn = _p2iFn[i]._fn; }
-	void execPoly2intFn(engine & engine) { (engine.*_poly2intFn)(); }
-	std::string getPoly2intString() const { return _p2iFn[_poly2int_i]._name; }
+	// the carry is propagated, if the function is fused then y of split() is computed.
+	// If the square sequence computed poly2int0 then only the carries of its blocks are propagated.
+	// The carries propagated through a whole block are fixed by the last group of poly2int1 and reduce_i.
+	void execPoly2intFn(engine & engine) { _execPoly2intFn(engine, _squareSeq); }
+	void execMulPoly2intFn(engine & engine) { _execPoly2intFn(engine, _mulSeq); }
+	bool isPoly2intFused() const { return _p2iFn[_poly2int_i]._fused; }
+	std::string getPoly2intString() const
+	{
+		if (_squareSeq.isPoly2int()) return isPoly2intFused() ? "p2ir_lst" : "p2i_lst";
+		return _p2iFn[_poly2int_i]._name;
+	}
+
+private:
+	void _execPoly2intFn(engine & engine, const squareSeq & seq)
+	{
+		if (seq.isPoly2int()) { if (_p2iFn[_poly2int_i]._fused) engine.poly2int_red_lst(); else engine.poly2int_lst(); }
+		else (engine.*_poly2intFn)();
+	}
 
 public:
-	std::string getPlanString(const size_t size) const { return getSquareSeqString(size) + " " + getPoly2intString(); }
+	size_t getReduceCount() const { return 6; }
+	void setReduceFn(const size_t i) { _reduceFused = (i % 2 != 0); _reduceScan = i / 2; }
+	size_t getReduceFn() const { return 2 * _reduceScan + (_reduceFused ? 1 : 0); }
+	// returns false if the remainders must be computed by the sweep kernels
+	bool execScanFn(engine & engine) const
+	{
+		if (_reduceScan == 1) engine.reduce_scan_64();
+		else if (_reduceScan == 2) engine.reduce_scan_128();
+		return (_reduceScan != 0);
+	}
+	void execReduceFn(engine & engine) const { if (_reduceFused) engine.reduce_of(); else { engine.reduce_o(); engine.reduce_f(); } }
+	std::string getReduceString() const
+	{
+		const std::string scan = (_reduceScan == 1) ? "scan64_" : ((_reduceScan == 2) ? "scan128_" : "");
+		return scan + (_reduceFused ? "red_of" : "red_o_f");
+	}
+
+public:
+	std::string getPlanString(const size_t size) const
+	{
+		return getSquareSeqString(size) + " " + getPoly2intString() + " " + getReduceString() + " " + getMulSeqString(size);
+	}
 };
@@ -0,0 +1,137 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <mutex>
+
+// Best plans found by the autotuner, saved in 'proth_plan.txt'.
+// A key is the device, the driver version, the transforms (size, arithmetic and digits of each one), the extensions and the kernel block sizes.
+class plancache
+{
+public:
+	struct entry
+	{
+		bool ext512, ext1024;	// the extensions may be disabled if they generated a runtime error
+		size_t square_i, poly2int_i, reduce_i, mul_i;
+		int arithmetic;			// 0: P1 and P2, 1: 2^64 - 2^32 + 1, 2: P1, P2 and P3
+		size_t radix;			// the transform size is radix * 2^m, radix = 1, 3 or 5
+		std::string planString;
+
+		entry() : ext512(false), ext1024(false), square_i(0), poly2int_i(0), reduce_i(0), mul_i(0), arithmetic(0), radix(1) {}
+		entry(const bool ext512, const bool ext1024, const size_t square_i, const size_t poly2int_i, const size_t reduce_i, const size_t mul_i,
+			  const int arithmetic, const size_t radix, const std::string & planString)
+			: ext512(ext512), ext1024(ext1024), square_i(square_i), poly2int_i(poly2int_i), reduce_i(reduce_i), mul_i(mul_i),
+			  arithmetic(arithmetic), radix(radix), planString(planString) {}
+	};
+
+private:
+	struct deleter { void operator()(const plancache * const p) { delete p; } };
+
+private:
+	const char * const _filename = "proth_plan.txt";
+	bool _isLoaded = false;
+	std::map<std::string, entry> _entries;
+	std::mutex _mutex;	// the engines of the scheduler share the cache
+
+public:
+	plancache() {}
+	virtual ~plancache() {}
+
+	static plancache & getInstance()
+	{
+		static std::unique_ptr<plancache, deleter> pInstance(new plancache());
+		return *pInstance;
+	}
+
+public:
+	static std::string key(const std::string & deviceName, const std::string & driverVersion, const std::string & transforms, const size_t batch,
+						   const bool ext512, const bool ext1024, const std::string & defines)
+	{
+		std::ostringstream ss;
+		ss << deviceName << "|" << driverVersion << "|" << transforms << "|";
+		if (batch > 1) ss << "b" << batch << "|";	// the best plan of a batch may be different
+		ss << (ext512 ? 1 : 0) << (ext1024 ? 1 : 0) << "|" << defines;
+		std::string str = ss.str();
+		// a key is a single field of a line
+		for (char & c : str) if ((c == '\t') || (c == '\n') || (c == '\r')) c = ' ';
+		return str;
+	}
+
+private:
+	void _load()
+	{
+		_isLoaded = true;
+		std::ifstream cacheFile(_filename);
+		if (!cacheFile.is_open()) return;
+
+		std::string line;
+		while (std::getline(cacheFile, line))
+		{
+			const size_t pos = line.find('\t');
+			if (pos == std::string::npos) continue;
+
+			std::istringstream ss(line.substr(pos + 1));
+			int ext512 = 0, ext1024 = 0;
+			entry e;
+			if (!(ss >> ext512 >> ext1024 >> e.square_i >> e.poly2int_i >> e.reduce_i >> e.mul_i >> e.arithmetic >> e.radix)) continue;
+			e.ext512 = (ext512 != 0); e.ext1024 = (ext1024 != 0);
+			ss >> std::ws; std::getline(ss, e.planString);
+			_entries[line.substr(0, pos)] = e;
+		}
+		cacheFile.close();
+	}
+
+private:
+	void _save() const
+	{
+		std::ofstream cacheFile(_filename);
+		if (!cacheFile.is_open()) return;	// the cache is optional
+
+		for (const auto & it : _entries)
+		{
+			const entry & e = it.second;
+			cacheFile << it.first << "\t" << (e.ext512 ? 1 : 0) << " " << (e.ext1024 ? 1 : 0) << " "
+				<< e.square_i << " " << e.poly2int_i << " " << e.reduce_i << " " << e.mul_i << " " << e.arithmetic << " " << e.radix << " " << e.planString << std::endl;
+		}
+		cacheFile.close();
+	}
+
+public:
+	bool find(const std::string & key, entry & e)
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		if (!_isLoaded) _load();
+		const auto it = _entries.find(key);
+		if (it == _entries.end()) return false;
+		e = it->second;
+		return true;
+	}
+
+public:
+	void insert(const std::string & key, const entry & e)
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		if (!_isLoaded) _load();
+		_entries[key] = e;
+		_save();
+	}
+
+public:
+	void erase(const std::string & key)
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		if (!_isLoaded) _load();
+		if (_entries.erase(key) != 0) _save();
+	}
+};
@@ -0,0 +1,289 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include "arith.h"
+#include "gpmp.h"
+#include "sha3.h"
+#include "pio.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+// Pietrzak's proof of the Proth test (K. Pietrzak, Simple Verifiable Delay Functions, 2018).
+// The test computes x_T = x_0^{2^T}, x_0 = a^k, where T is n - 1 rounded down to a multiple of 2^power.
+// The residues x_{j.T/2^power}, 1 <= j <= 2^power, are saved to disk during the test. The proof is x_T and
+// the power middles, the verifier computes T/2^power squarings and the n - 1 - T < 2^power last squarings.
+class proof
+{
+public:
+	static const uint32_t power_max = 12;
+
+private:
+	const uint32_t _k, _n, _a;
+	const uint32_t _power;
+	const uint32_t _step;		// T / 2^power
+
+public:
+	proof(const uint32_t k, const uint32_t n, const uint32_t a, const uint32_t power)
+		: _k(k), _n(n), _a(a), _power(validPower(n, power)), _step((n - 1) >> _power) {}
+	virtual ~proof() {}
+
+public:
+	// 1 <= power <= power_max and 2^power <= n - 1
+	static uint32_t validPower(const uint32_t n, const uint32_t power)
+	{
+		uint32_t p = std::min(std::max(power, uint32_t(1)), power_max);
+		while (((n - 1) >> p) == 0) --p;
+		return p;
+	}
+
+public:
+	uint32_t getPower() const { return _power; }
+	uint32_t getT() const { return _step << _power; }
+	uint32_t getStep() const { return _step; }
+
+	// x_i is saved
+	bool isPoint(const uint32_t i) const { return (i % _step == 0) && (i <= getT()); }
+
+private:
+	std::string _residueFilename(const uint32_t j) const
+	{
+		std::ostringstream ss; ss << "proth_" << _k << "_" << _n << "_" << j << ".res";
+		return ss.str();
+	}
+
+public:
+	std::string getFilename() const
+	{
+		std::ostringstream ss; ss << "proth_" << _k << "_" << _n << ".proof";
+		return ss.str();
+	}
+
+public:
+	// The disk cost of the residues
+	void printInfo(const size_t words) const
+	{
+		const double size = double(words) * sizeof(uint32_t) * (size_t(1) << _power);
+		std::ostringstream ss; ss << "Proof of power " << _power << ": " << (size_t(1) << _power) << " residues, "
+			<< std::setprecision(3) << size / (1024 * 1024) << " MB on disk" << std::endl;
+		pio::print(ss.str());
+	}
+
+private:
+	static void _write(FILE * const file, const void * const ptr, const size_t size, const std::string & filename)
+	{
+		if (std::fwrite(ptr, 1, size, file) != size) { std::fclose(file); throw std::runtime_error("cannot write '" + filename + "' file"); }
+	}
+
+	static bool _read(FILE * const file, void * const ptr, const size_t size)
+	{
+		if (std::fread(ptr, 1, size, file) == size) return true;
+		std::fclose(file);
+		return false;
+	}
+
+private:
+	bool _loadResidue(const uint32_t j, std::vector<uint32_t> & words) const
+	{
+		FILE * const file = pio::open(_residueFilename(j).c_str(), "rb");
+		if (file == nullptr) return false;
+
+		uint32_t k = 0, n = 0, size = 0;
+		if (!_read(file, &k, sizeof(k)) || !_read(file, &n, sizeof(n)) || !_read(file, &size, sizeof(size))) return false;
+		if ((k != _k) || (n != _n)) { std::fclose(file); return false; }
+		words.resize(size);
+		if (!_read(file, words.data(), size * sizeof(uint32_t))) return false;
+
+		std::fclose(file);
+		return true;
+	}
+
+public:
+	// x_i is saved, i is a point
+	void saveResidue(const uint32_t i, gpmp & X) const
+	{
+		std::vector<uint32_t> words;
+		X.getResidue(words);
+
+		const std::string filename = _residueFilename(i / _step);
+		FILE * const file = pio::open(filename.c_str(), "wb");
+		if (file == nullptr) throw std::runtime_error("cannot write '" + filename + "' file");
+
+		const uint32_t size = uint32_t(words.size());
+		_write(file, &_k, sizeof(_k), filename);
+		_write(file, &_n, sizeof(_n), filename);
+		_write(file, &size, sizeof(size), filename);
+		_write(file, words.data(), size * sizeof(uint32_t), filename);
+		std::fclose(file);
+	}
+
+public:
+	// the residues of the points i <= i0 were saved
+	bool hasResidues(const uint32_t i0) const
+	{
+		std::vector<uint32_t> words;
+		for (uint32_t j = 1; j * _step <= std::min(i0, getT()); ++j) if (!_loadResidue(j, words)) return false;
+		return true;
+	}
+
+public:
+	void removeResidues() const
+	{
+		for (uint32_t j = 1; j <= (uint32_t(1) << _power); ++j) std::remove(_residueFilename(j).c_str());
+	}
+
+protected:
+	// h_0 = H(k, n, a, power, x_T)
+	sha3::digest hashRoot(const std::vector<uint32_t> & A) const
+	{
+		sha3 h;
+		h.update(_k); h.update(_n); h.update(_a); h.update(_power);
+		h.update(A.data(), A.size());
+		return h.finalize();
+	}
+
+	// h_{i+1} = H(h_i, M_i)
+	static sha3::digest hashNext(const sha3::digest & hi, const std::vector<uint32_t> & M)
+	{
+		sha3 h;
+		h.update(hi.data(), hi.size());
+		h.update(M.data(), M.size());
+		return h.finalize();
+	}
+
+	// the challenge r_i is the first 64 bits of h_{i+1}
+	static uint64_t challenge(const sha3::digest & h)
+	{
+		uint64_t r = 0;
+		for (size_t i = 0; i < 8; ++i) r |= uint64_t(h[i]) << (8 * i);
+		return r;
+	}
+
+private:
+	// z = x^e * y
+	static void _powMul(gpmp & X, const std::vector<uint32_t> & x, const uint64_t e, const std::vector<uint32_t> & y, std::vector<uint32_t> & z)
+	{
+		X.setResidue_x(x);
+		X.pow(e);
+		X.setResidue_u(y);
+		X.setMultiplicand();
+		X.mul();
+		X.getResidue(z);
+	}
+
+private:
+	// The middle of the level i is M_i = prod_m x_{(2m + 1).T/2^{i+1}}^{e_m}, 0 <= m < 2^i,
+	// e_m is the product of the challenges r_{i-1-l} such that the bit l of m is zero.
+	// The product of the range [m0, m0 + count) is computed depth-first: M = M_left^{r_{i-d}} * M_right, count = 2^d.
+	void _middle(gpmp & X, const uint32_t i, const uint32_t m0, const uint32_t count, const std::vector<uint64_t> & r,
+		std::vector<uint32_t> & M) const
+	{
+		if (count == 1)
+		{
+			const uint32_t j = (2 * m0 + 1) << (_power - i - 1);
+			if (!_loadResidue(j, M)) throw std::runtime_error("cannot read '" + _residueFilename(j) + "' file");
+			return;
+		}
+
+		std::vector<uint32_t> right;
+		_middle(X, i, m0, count / 2, r, M);
+		_middle(X, i, m0 + count / 2, count / 2, r, right);
+		_powMul(X, M, r[i - arith::log2(count)], right, M);
+	}
+
+public:
+	// The proof is written next to the results, the residues are removed
+	void build(gpmp & X) const
+	{
+		std::vector<uint32_t> A;
+		if (!_loadResidue(uint32_t(1) << _power, A)) throw std::runtime_error("cannot read '" + _residueFilename(uint32_t(1) << _power) + "' file");
+
+		std::vector<std::vector<uint32_t>> M(_power);
+		std::vector<uint64_t> r;
+		sha3::digest h = hashRoot(A);
+		for (uint32_t i = 0; i < _power; ++i)
+		{
+			_middle(X, i, 0, uint32_t(1) << i, r, M[i]);
+			h = hashNext(h, M[i]);
+			r.push_back(challenge(h));
+		}
+		if (X.getError() != 0) throw std::runtime_error("GPU error detected");
+
+		const std::string filename = getFilename();
+		FILE * const file = pio::open(filename.c_str(), "wb");
+		if (file == nullptr) throw std::runtime_error("cannot write '" + filename + "' file");
+
+		const uint32_t version = 0, size = uint32_t(A.size());
+		_write(file, &version, sizeof(version), filename);
+		_write(file, &_k, sizeof(_k), filename);
+		_write(file, &_n, sizeof(_n), filename);
+		_write(file, &_a, sizeof(_a), filename);
+		_write(file, &_power, sizeof(_power), filename);
+		_write(file, &size, sizeof(size), filename);
+		_write(file, A.data(), size * sizeof(uint32_t), filename);
+		for (const auto & Mi : M) _write(file, Mi.data(), size * sizeof(uint32_t), filename);
+		std::fclose(file);
+
+		removeResidues();
+
+		std::ostringstream ss; ss << "Proof '" << filename << "' of power " << _power << " is written, "
+			<< (_power + 1) * size * sizeof(uint32_t) << " bytes" << std::endl;
+		pio::print(ss.str());
+	}
+
+public:
+	static bool read(const std::string & filename, uint32_t & k, uint32_t & n, uint32_t & a, uint32_t & power,
+		std::vector<uint32_t> & A, std::vector<std::vector<uint32_t>> & M)
+	{
+		FILE * const file = pio::open(filename.c_str(), "rb");
+		if (file == nullptr) return false;
+
+		uint32_t version = 0, size = 0;
+		if (!_read(file, &version, sizeof(version))) return false;
+		if (version != 0) { std::fclose(file); return false; }
+		if (!_read(file, &k, sizeof(k)) || !_read(file, &n, sizeof(n)) || !_read(file, &a, sizeof(a))) return false;
+		if (!_read(file, &power, sizeof(power)) || !_read(file, &size, sizeof(size))) return false;
+		if ((n < 2) || (power == 0) || (power > power_max) || (validPower(n, power) != power) || (size == 0) || (size > (n / 32 + 2))) { std::fclose(file); return false; }
+
+		A.resize(size);
+		if (!_read(file, A.data(), size * sizeof(uint32_t))) return false;
+		M.resize(power);
+		for (auto & Mi : M)
+		{
+			Mi.resize(size);
+			if (!_read(file, Mi.data(), size * sizeof(uint32_t))) return false;
+		}
+
+		std::fclose(file);
+		return true;
+	}
+
+public:
+	// The challenges are recomputed from the proof. B_0 = x_0, A_0 = x_T,
+	// B_{i+1} = B_i^{r_i}.M_i and A_{i+1} = M_i^{r_i}.A_i. The proof is valid if B_power^{2^step} = A_power.
+	void reduce(gpmp & X, const std::vector<uint32_t> & A0, const std::vector<std::vector<uint32_t>> & M,
+		std::vector<uint32_t> & A, std::vector<uint32_t> & B) const
+	{
+		A = A0;
+		sha3::digest h = hashRoot(A0);
+		for (uint32_t i = 0; i < _power; ++i)
+		{
+			h = hashNext(h, M[i]);
+			const uint64_t r = challenge(h);
+			_powMul(X, M[i], r, A, A);
+			_powMul(X, B, r, M[i], B);
+		}
+	}
+};
@@ -10,9 +10,12 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include "ocl.h"
 #include "arith.h"
 #include "gpmp.h"
+#include "proof.h"
 #include "pio.h"
 #include "timer.h"
 
+#include <vector>
+#include <algorithm>
 #include <thread>
 #include <chrono>
 
@@ -36,13 +39,20 @@ public:
 public:
 	void quit() { _quit = true; }
 	void setBoinc(const bool isBoinc) { _isBoinc = isBoinc; }
+	void setWorklist(const bool isWorklist) { _isWorklist = isWorklist; }
+	void setProofPower(const uint32_t proofPower) { _proofPower = proofPower; }
+	void setVerifyCount(const uint32_t verifyCount) { _verifyCount = verifyCount; }
 
 protected:
 	volatile bool _quit = false;
 private:
 	bool _isBoinc = false;
+	bool _isWorklist = false;	// a checkpoint file per candidate
+	uint32_t _proofPower = 0;	// no proof if 0
+	uint32_t _verifyCount = 16;	// the intermediate Gerbicz checks, no intermediate check if 0
 
 	static const uint32_t ord2_max = 30;
+	static const uint32_t retry_max = 4;	// the test fails after retry_max rollbacks to the same point
 
 private:
 	static constexpr uint32_t benchCount(const uint32_t n)
@@ -86,6 +96,18 @@ protected:
 		}
 	}
 
+protected:
+	static void checkError(gpmp & X, const std::vector<std::pair<uint32_t, uint32_t>> & batch)
+	{
+		const std::vector<int> err = X.getErrors();
+		std::ostringstream ss;
+		for (size_t b = 0; b < batch.size(); ++b)
+		{
+			if (err[b] != 0) ss << (ss.str().empty() ? "" : ", ") << batch[b].first << " * 2^" << batch[b].second << " + 1";
+		}
+		if (!ss.str().empty()) throw std::runtime_error("GPU error detected: " + ss.str());
+	}
+
 private:
 	static void gfnDivError() { throw std::runtime_error("GFN divisibility test failed"); }
 
@@ -93,7 +115,7 @@ private:
 	static void printStatus(gpmp & X, const bool found, const uint32_t k, const uint32_t n)
 	{
 		std::ostringstream ss; ss << (found ? "Resuming from a checkpoint " : "Testing ");
-		ss << k << " * 2^" << n << " + 1, " << X.getDigits() << " digits, size = 2^" << arith::log2(X.getSize())
+		ss << k << " * 2^" << n << " + 1, " << X.getDigits() << " digits, size = " << X.getSizeString()
 			<< " x " << X.getDigitBit() << " bits, plan: " << X.getPlanString() << std::endl;
 		pio::print(ss.str());
 	}
@@ -154,30 +176,129 @@ public:
 		return true;
 	}
 
-public:
-	bool check(const uint32_t k, const uint32_t n, engine & engine, const bool checkRes = false, const uint64_t r64 = 0)
+private:
+	// X = (a^c)^k, left-to-right algorithm. The candidates of a batch execute the same sequence of operations:
+	// the multiplicand is a if the bit of k is set and 1 otherwise.
+	bool apowk_batch(gpmp & X, const std::vector<uint32_t> & a, const std::vector<uint32_t> & k, const size_t c) const
 	{
-		uint32_t a = 0;
-		if (!arith::proth_prime_quad_nonres(k, n, 3, a))
+		const size_t count = a.size();
+		std::vector<uint32_t> u(count);
+
+		bool s = false;
+		X.init(std::vector<uint32_t>(count, 1), std::vector<uint32_t>(count, 1));	// x = 1
+		for (int b = 31; b >= 0; --b)
 		{
-			std::ostringstream ssr; ssr << k << " * 2^" << n << " + 1 is divisible by " << a << std::endl;
-			pio::display(ssr.str());
-			pio::result(ssr.str());
-			if (_isBoinc)
+			if (s) X.square();
+
+			bool m = false;
+			for (size_t i = 0; i < count; ++i)
+			{
+				const bool bit = ((k[i] & (uint32_t(1) << b)) != 0);
+				u[i] = bit ? a[i] : 1;
+				m |= bit;
+			}
+
+			if (m)
 			{
-				std::ostringstream sso; sso << k << " * 2^" << n << " + 1 is complete, a = " << a << ", time = " << timer::formatTime(0.0) << std::endl;
-				pio::print(sso.str());
+				X.init_u(u);
+				X.setMultiplicand();
+				for (size_t j = 0; j < c; ++j) X.mul();
+				s = true;
 			}
-			return true;
+
+			if (_quit) return false;
+		}
+		X.norm();
+		return true;
+	}
+
+public:
+	bool apowk(gpmp & X, const std::vector<uint32_t> & a, const std::vector<uint32_t> & k) const
+	{
+		// v = (a^2)^k
+		if (!apowk_batch(X, a, k, 2)) return false;
+		X.copy_x_v();
+
+		// x = a^k, u = x
+		if (!apowk_batch(X, a, k, 1)) return false;
+		X.copy_x_u();
+
+		// (a^k)^2 = (a^2)^k
+		X.square();
+		X.norm();
+		X.compare_x_v();
+
+		// x = u = v = a^k
+		X.copy_u_x();
+		X.copy_x_v();
+
+		return true;
+	}
+
+private:
+	// x, u and v are restored to the last verified point iv. If the iterations fail again then the plan is changed.
+	static void rollback(gpmp & X, const uint32_t i, const uint32_t iv, uint32_t & retryCount, uint32_t & rollbackCount, uint64_t & recomputed)
+	{
+		if (++retryCount > retry_max) throw std::runtime_error("GPU error detected");
+		++rollbackCount;
+		recomputed += i - iv;
+
+		X.restoreSnapshot();
+		std::ostringstream ss; ss << std::endl << "warning: error detected at iteration " << i << ", rollback to iteration " << iv;
+		if (retryCount >= 2)
+		{
+			X.setFallbackPlan();
+			ss << ", plan: " << X.getPlanString();
 		}
+		ss << "." << std::endl;
+		pio::error(ss.str());
+	}
+
+private:
+	// false if k.2^n + 1 is divisible by a, otherwise a is a quadratic non-residue
+	bool quadNonres(const uint32_t k, const uint32_t n, uint32_t & a) const
+	{
+		if (arith::proth_prime_quad_nonres(k, n, 3, a)) return true;
+
+		std::ostringstream ssr; ssr << k << " * 2^" << n << " + 1 is divisible by " << a << std::endl;
+		pio::display(ssr.str());
+		pio::result(ssr.str());
+		if (_isBoinc)
+		{
+			std::ostringstream sso; sso << k << " * 2^" << n << " + 1 is complete, a = " << a << ", time = " << timer::formatTime(0.0) << std::endl;
+			pio::print(sso.str());
+		}
+		return false;
+	}
+
+public:
+	bool check(const uint32_t k, const uint32_t n, engine & engine, const bool checkRes = false, const uint64_t r64 = 0)
+	{
+		uint32_t a = 0;
+		if (!quadNonres(k, n, a)) return true;
 
 		gpmp X(k, n, engine, _isBoinc);
 
+		const std::string ext = _isWorklist ? std::string("p_") + std::to_string(k) + "_" + std::to_string(n) : std::string("p");
 		chronometer chrono;
 		uint32_t i0;
-		const bool found = X.restoreContext(i0, chrono.previousTime, "p");
+		// if the checkpoint cannot be read then the test is resumed from the last verified point
+		const bool found = X.restoreContext(i0, chrono.previousTime, ext.c_str()) || X.restoreContext(i0, chrono.previousTime, (ext + "_v").c_str());
 		printStatus(X, found, k, n);
 
+		std::unique_ptr<proof> pProof;
+		if (_proofPower != 0)
+		{
+			pProof = std::unique_ptr<proof>(new proof(k, n, a, _proofPower));
+			if (found && !pProof->hasResidues(i0))
+			{
+				std::ostringstream ss; ss << "warning: the residues of the proof were not saved before the checkpoint, no proof." << std::endl;
+				pio::error(ss.str());
+				pProof.reset();
+			}
+			else pProof->printInfo(X.getResidueWords());
+		}
+
 		chrono.resetTime();
 
 		if (!found)
@@ -191,6 +312,14 @@ public:
 
 		const uint32_t L = 1 << (arith::log2(n) / 2);
 
+		// The residue is verified at the multiples of verifyStep. If a check fails or if an error is detected then x, u and v are
+		// restored from the snapshot and the iterations are computed again from the last verified point iv.
+		const uint32_t verifyStep = (_verifyCount == 0) ? 0 : L * std::max(n / (_verifyCount + 1) / L, uint32_t(1));
+		const std::string extVerified = ext + "_v";
+		uint32_t iv = i0, retryCount = 0, rollbackCount = 0;
+		uint64_t recomputed = 0;
+		X.saveSnapshot();
+
 		const uint32_t benchCnt = benchCount(n);
 		uint32_t benchIter = benchCnt;
 		chrono.resetBenchTime();
@@ -199,10 +328,18 @@ public:
 		if (_isBoinc) boinc_fraction_done(double(i0) / double(n));
 
 		// X = X^{2^{n - 1}}
-		for (uint32_t i = i0 + 1; i < n; ++i)
+	restart:
+		X.setChecksum(true);
+		for (uint32_t i = iv + 1; i < n; ++i)
 		{
 			X.square();
 
+			// the checksums of the squares are checked every CS_SLOTS iterations
+			if (X.isChecksumError()) { rollback(X, i, iv, retryCount, rollbackCount, recomputed); goto restart; }
+
+			// the residues of the proof are x_i, i = j.T/2^power
+			if (pProof && pProof->isPoint(i)) pProof->saveResidue(i, X);
+
 			if (--benchIter == 0)
 			{
 #ifdef quick_bench
@@ -219,8 +356,36 @@ public:
 
 			// Robert Gerbicz error checking algorithm
 			// u is d(t) and v is u(0). They must be set before the loop
-			// if (i == n - 1) X.set_bug();	// test
-			if ((i & (L - 1)) == 0) X.Gerbicz_step();
+			// if ((i == n / 2) && (rollbackCount == 0)) X.set_bug();	// test
+			if ((i & (L - 1)) == 0)
+			{
+				const bool verify = (verifyStep != 0) && (i % verifyStep == 0);
+				if (verify)
+				{
+					X.Gerbicz_check(L);
+					if (X.getError() != 0)
+					{
+						rollback(X, i, iv, retryCount, rollbackCount, recomputed);
+						goto restart;
+					}
+				}
+
+				X.Gerbicz_step();
+
+				if (verify)
+				{
+					iv = i;
+					retryCount = 0;
+					X.saveSnapshot();
+					// a BOINC client schedules the checkpoints
+					if (!_isBoinc) X.saveContext(i, chrono.getElapsedTime(), extVerified.c_str());
+					else if (boinc_time_to_checkpoint() != 0)
+					{
+						X.saveContext(i, chrono.getElapsedTime(), extVerified.c_str());
+						boinc_checkpoint_completed();
+					}
+				}
+			}
 
 			if (i % 1024 == 0)
 			{
@@ -231,8 +396,8 @@ public:
 					bool quit = boincQuitRequest(status);
 					if (quit || (status.suspended != 0))
 					{
-						checkError(X);
-						X.saveContext(i, chrono.getElapsedTime(), "p");
+						if (X.getError() != 0) { rollback(X, i, iv, retryCount, rollbackCount, recomputed); goto restart; }
+						X.saveContext(i, chrono.getElapsedTime(), ext.c_str());
 					}
 					if (quit) return false;
 						
@@ -254,8 +419,8 @@ public:
 
 					if (boinc_time_to_checkpoint() != 0)
 					{
-						checkError(X);
-						X.saveContext(i, chrono.getElapsedTime(), "p");
+						if (X.getError() != 0) { rollback(X, i, iv, retryCount, rollbackCount, recomputed); goto restart; }
+						X.saveContext(i, chrono.getElapsedTime(), ext.c_str());
 						boinc_checkpoint_completed();
 					}
 				}
@@ -264,8 +429,8 @@ public:
 					const double elapsedTime = chrono.getRecordTime();
 					if (elapsedTime > 600)
 					{
-						checkError(X);
-						X.saveContext(i, chrono.getElapsedTime(), "p");
+						if (X.getError() != 0) { rollback(X, i, iv, retryCount, rollbackCount, recomputed); goto restart; }
+						X.saveContext(i, chrono.getElapsedTime(), ext.c_str());
 						chrono.resetRecordTime();
 					}
 				}
@@ -273,15 +438,16 @@ public:
 
 			if (_quit)
 			{
-				checkError(X);
-				X.saveContext(i, chrono.getElapsedTime(), "p");
+				if (X.getError() != 0) { rollback(X, i, iv, retryCount, rollbackCount, recomputed); goto restart; }
+				X.saveContext(i, chrono.getElapsedTime(), ext.c_str());
 				return false;
 			}
 		}
 
+		X.setChecksum(false);
+
 		uint64_t res64;
 		const bool isPrime = X.isMinusOne(res64);
-		checkError(X);
 
 		// Gerbicz last check point is i % L == 0 and i >= n - L
 		// It is extended to i % L == 0 and i >= n
@@ -292,11 +458,22 @@ public:
 			if ((i & (L - 1)) == 0)
 			{
 				X.Gerbicz_check(L);
-				checkError(X);
+				if (X.getError() != 0)
+				{
+					rollback(X, i, iv, retryCount, rollbackCount, recomputed);
+					goto restart;
+				}
 				break;
 			}
 		}
 
+		if (rollbackCount != 0)
+		{
+			std::ostringstream ss; ss << k << " * 2^" << n << " + 1: " << rollbackCount << " rollback(s), "
+				<< recomputed << " iterations were computed again" << std::endl;
+			pio::print(ss.str());
+		}
+
 		if (_isBoinc) boinc_fraction_done(1.0);
 
 		const std::string res = (isPrime) ? "                        " : std::string(", RES64 = ") + res64String(res64);
@@ -307,6 +484,10 @@ public:
 
 		pio::display(std::string("\r") + ssr.str());
 		pio::result(ssr.str());
+		gpmp::removeContext(ext.c_str());
+		gpmp::removeContext(extVerified.c_str());
+
+		if (pProof) pProof->build(X);
 
 		if (_isBoinc)
 		{
@@ -323,6 +504,174 @@ public:
 		return true;
 	}
 
+public:
+	// The candidates have the same transform size. A kernel launch processes all of them, it fills the device if the transform is small.
+	// The squarings continue until the largest exponent, a batch is not checkpointed.
+	bool check_batch(const std::vector<std::pair<uint32_t, uint32_t>> & candidates, engine & engine)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> batch;
+		std::vector<uint32_t> a_b, k_b;
+		for (const auto & c : candidates)
+		{
+			uint32_t a = 0;
+			if (!quadNonres(c.first, c.second, a)) continue;
+			batch.push_back(c); a_b.push_back(a); k_b.push_back(c.first);
+		}
+		if (batch.empty()) return true;
+		if (batch.size() == 1) return check(batch[0].first, batch[0].second, engine);
+
+		const size_t count = batch.size();
+		uint32_t n_max = 0;
+		for (const auto & c : batch) n_max = std::max(n_max, c.second);
+
+		gpmp X(batch, engine, false);
+
+		std::ostringstream ss; ss << "Testing a batch of " << count << " candidates, n <= " << n_max << ", size = " << X.getSizeString()
+			<< " x " << X.getDigitBit() << " bits, plan: " << X.getPlanString() << std::endl;
+		pio::print(ss.str());
+
+		chronometer chrono;
+		chrono.previousTime = 0;
+		chrono.resetTime();
+
+		// X = a^k
+		if (!apowk(X, a_b, k_b)) return false;
+		checkError(X, batch);	// Sync GPU
+
+		const uint32_t L = 1 << (arith::log2(n_max) / 2);
+
+		const uint32_t benchCnt = benchCount(n_max);
+		uint32_t benchIter = benchCnt;
+		chrono.resetBenchTime();
+
+		std::vector<bool> isPrime(count), isPrime_i;
+		std::vector<uint64_t> res64(count), res64_i;
+
+		// X = X^{2^{n - 1}}, the residue of a candidate is read at its exponent
+		for (uint32_t i = 1; i < n_max; ++i)
+		{
+			X.square();
+
+			if (--benchIter == 0)
+			{
+				printProgress(chrono, i, n_max, benchCnt);
+				benchIter = benchCnt;
+			}
+
+			if ((i & (L - 1)) == 0) X.Gerbicz_step();
+
+			if (std::any_of(batch.begin(), batch.end(), [&](const std::pair<uint32_t, uint32_t> & c) { return c.second == i + 1; }))
+			{
+				X.isMinusOne(isPrime_i, res64_i);
+				for (size_t b = 0; b < count; ++b)
+				{
+					if (batch[b].second == i + 1) { isPrime[b] = isPrime_i[b]; res64[b] = res64_i[b]; }
+				}
+			}
+
+			if (_quit) return false;
+		}
+		checkError(X, batch);
+
+		for (uint32_t i = n_max; true; ++i)
+		{
+			X.square();
+
+			if ((i & (L - 1)) == 0)
+			{
+				X.Gerbicz_check(L);
+				checkError(X, batch);
+				break;
+			}
+		}
+
+		const std::string runtime = timer::formatTime(chrono.getElapsedTime());
+		for (size_t b = 0; b < count; ++b)
+		{
+			const std::string res = (isPrime[b]) ? "                        " : std::string(", RES64 = ") + res64String(res64[b]);
+			std::ostringstream ssr; ssr << batch[b].first << " * 2^" << batch[b].second << " + 1 is " << (isPrime[b] ? "prime" : "composite")
+				 << ", a = " << a_b[b] << ", time = " << runtime << res << std::endl;
+
+			pio::display(std::string("\r") + ssr.str());
+			pio::result(ssr.str());
+		}
+
+		return true;
+	}
+
+public:
+	// The proof is checked with step = T/2^power squarings, the result is x_T^{2^{n - 1 - T}}
+	bool verify(const std::string & filename, engine & engine)
+	{
+		uint32_t k, n, a, power;
+		std::vector<uint32_t> A0;
+		std::vector<std::vector<uint32_t>> M;
+		if (!proof::read(filename, k, n, a, power, A0, M)) throw std::runtime_error("invalid proof file '" + filename + "'");
+
+		uint32_t a_k = 0;
+		if (!arith::proth_prime_quad_nonres(k, n, 3, a_k) || (a != a_k)) throw std::runtime_error("invalid proof file '" + filename + "'");
+
+		gpmp X(k, n, engine, _isBoinc);
+		if (A0.size() != X.getResidueWords()) throw std::runtime_error("invalid proof file '" + filename + "'");
+
+		const proof P(k, n, a, power);
+		const uint32_t step = P.getStep(), T = P.getT();
+
+		std::ostringstream ss; ss << "Verifying the proof '" << filename << "' of power " << power << ", " << step << " squarings" << std::endl;
+		pio::print(ss.str());
+		printStatus(X, false, k, n);
+
+		chronometer chrono;
+		chrono.previousTime = 0;
+		chrono.resetTime();
+
+		// B_0 = a^k
+		if (!apowk(X, a, k)) return false;
+		std::vector<uint32_t> A, B;
+		X.getResidue(B);
+		P.reduce(X, A0, M, A, B);
+
+		const uint32_t benchCnt = benchCount(n);
+		uint32_t benchIter = benchCnt;
+		chrono.resetBenchTime();
+
+		// B_power^{2^step}
+		X.setResidue_x(B);
+		for (uint32_t i = 1; i <= step; ++i)
+		{
+			X.square();
+
+			if (--benchIter == 0)
+			{
+				printProgress(chrono, i, step, benchCnt);
+				benchIter = benchCnt;
+			}
+
+			if (_quit) return false;
+		}
+		X.getResidue(B);
+		const bool isValid = (B == A);
+
+		// x_{n-1} = x_T^{2^{n - 1 - T}}
+		X.setResidue_x(A0);
+		for (uint32_t i = T + 1; i < n; ++i) X.square();
+
+		uint64_t res64;
+		const bool isPrime = X.isMinusOne(res64);
+		checkError(X);
+
+		const std::string res = (isPrime) ? "" : std::string(", RES64 = ") + res64String(res64);
+		const std::string runtime = timer::formatTime(chrono.getElapsedTime());
+
+		std::ostringstream ssr; ssr << k << " * 2^" << n << " + 1 is " << (isPrime ? "prime" : "composite") << ", a = " << a << res
+			<< ", proof " << (isValid ? "passed" : "failed") << ", time = " << runtime << std::endl;
+
+		pio::display(std::string("\r") + ssr.str());
+		pio::result(ssr.str());
+
+		return isValid;
+	}
+
 public:
 	bool check_order(const uint32_t k, const uint32_t n, const uint32_t a, engine & engine)
 	{
@@ -26,15 +26,18 @@ public:
 		gpmp X(k, n, engine, false, false);
 
 		std::ostringstream sst;
-		sst << "Testing " << k << " * 2^" << n << " + 1, size = 2^" << arith::log2(X.getSize()) << " x " << X.getDigitBit() << " bits" << std::endl;
+		sst << "Testing " << k << " * 2^" << n << " + 1, size = " << X.getSizeString() << " x " << X.getDigitBit() << " bits" << std::endl;
 		pio::display(sst.str());
 
-		const size_t cntSq = X.getPlanSquareSeqCount(), cntP2i = X.getPlanPoly2intCount();
+		const size_t cntSq = X.getPlanSquareSeqCount(), cntP2i = X.getPlanPoly2intCount(), cntRed = X.getPlanReduceCount();
+		const size_t cntMul = X.getPlanMulSeqCount();
 
-		for (size_t j = 0, cnt = std::max(cntSq, cntP2i); j < cnt; ++j)
+		for (size_t j = 0, cnt = std::max(std::max(cntSq, cntP2i), std::max(cntRed, cntMul)); j < cnt; ++j)
 		{
 			X.setPlanSquareSeq(j % cntSq);
 			X.setPlanPoly2intFn(j % cntP2i);
+			X.setPlanReduceFn(j % cntRed);
+			X.setPlanMulSeq(j % cntMul);
 
 			pio::display(X.getPlanString());
 
@@ -0,0 +1,142 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include "engine.h"
+#include "proth.h"
+#include "worklist.h"
+#include "timer.h"
+#include "pio.h"
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <stdexcept>
+
+// The candidates of a worklist are tested concurrently, one thread per engine.
+// The next candidates are read in a window. Once the engines are timed, the largest candidates of the window are sent to the fastest engines.
+class scheduler
+{
+private:
+	struct candidate
+	{
+		uint32_t k, n;
+		size_t index;	// index in the worklist
+		size_t age;		// number of times the candidate was not selected
+	};
+
+private:
+	worklist & _wl;
+	proth & _p;
+	const size_t _windowSize;
+	std::mutex _mutex;
+	std::vector<candidate> _window;
+	bool _eof = false;
+	bool _stop = false;
+	std::vector<double> _cost;	// ms/mul / n of each engine, 0 if not measured
+	std::string _error;
+
+public:
+	scheduler(worklist & wl, proth & p, const size_t engineCount)
+		: _wl(wl), _p(p), _windowSize(2 * engineCount), _cost(engineCount, 0.0) {}
+	virtual ~scheduler() {}
+
+private:
+	// the candidate for the engine id, the mutex is locked
+	bool _next(const size_t id, candidate & c)
+	{
+		while (!_eof && (_window.size() < _windowSize))
+		{
+			candidate w;
+			if (_wl.next(w.k, w.n)) { w.index = _wl.getIndex(); w.age = 0; _window.push_back(w); }
+			else _eof = true;
+		}
+		if (_window.empty()) return false;
+
+		// the oldest candidate is selected, unless the engine was timed and a candidate of the window wasn't starved
+		size_t i = 0;
+		size_t rank = 0, count = 0;	// rank of the engine in the timed engines, 0 is the fastest
+		for (const double cost : _cost) if (cost > 0) { ++count; if (cost < _cost[id]) ++rank; }
+
+		const bool starved = std::any_of(_window.begin(), _window.end(), [&](const candidate & w) { return w.age >= _windowSize; });
+		if ((_cost[id] > 0) && (count > 1) && !starved)
+		{
+			std::vector<size_t> order(_window.size());
+			for (size_t j = 0; j < order.size(); ++j) order[j] = j;
+			std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return _window[a].n < _window[b].n; });
+			i = order[(order.size() - 1) * (count - 1 - rank) / (count - 1)];
+		}
+		else if (starved)
+		{
+			for (size_t j = 0; j < _window.size(); ++j) if (_window[j].age > _window[i].age) i = j;
+		}
+
+		c = _window[i];
+		_window.erase(_window.begin() + i);
+		for (candidate & w : _window) ++w.age;
+		return true;
+	}
+
+private:
+	void _run(const size_t id, engine & eng)
+	{
+		try
+		{
+			candidate c;
+			while (true)
+			{
+				{
+					std::lock_guard<std::mutex> guard(_mutex);
+					if (_stop || !_next(id, c)) break;
+				}
+
+				try { worklist::check(c.k, c.n, eng.hasBalancedDigits(), eng.hasRNS3()); }
+				catch (const std::runtime_error & e)
+				{
+					std::ostringstream ss; ss << "warning: " << c.k << " * 2^" << c.n << " + 1: " << e.what() << ", skipped." << std::endl;
+					pio::error(ss.str());
+					std::lock_guard<std::mutex> guard(_mutex);
+					_wl.done(c.index);
+					continue;
+				}
+
+				const timer::time t0 = timer::currentTime();
+				const bool completed = _p.check(c.k, c.n, eng);
+				const double time = timer::diffTime(timer::currentTime(), t0);
+
+				std::lock_guard<std::mutex> guard(_mutex);
+				if (!completed) { _stop = true; break; }
+				_wl.done(c.index);
+				// the cost of a multiplication is about proportional to n, small tests are not significant
+				if (time > 1) _cost[id] = time * 1e3 / c.n / c.n;
+			}
+		}
+		catch (const std::runtime_error & e)
+		{
+			// the other tests are interrupted and their contexts are saved
+			std::lock_guard<std::mutex> guard(_mutex);
+			if (_error.empty()) _error = e.what();
+			_stop = true;
+			_p.quit();
+		}
+	}
+
+public:
+	void run(const std::vector<engine *> & engines)
+	{
+		std::vector<std::thread> threads;
+		for (size_t id = 0; id < engines.size(); ++id) threads.push_back(std::thread(&scheduler::_run, this, id, std::ref(*engines[id])));
+		for (std::thread & t : threads) t.join();
+
+		if (!_error.empty()) throw std::runtime_error(_error);
+	}
+};
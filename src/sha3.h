@@ -0,0 +1,111 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+// SHA3-256 (FIPS 202), the challenges of the proofs are derived from it.
+class sha3
+{
+public:
+	typedef std::array<uint8_t, 32> digest;
+
+private:
+	static const size_t rate = 136;		// 1600 - 2 * 256 bits
+	uint64_t _st[25];
+	size_t _pos = 0;
+
+private:
+	static uint64_t rotl(const uint64_t x, const int s) { return (x << s) | (x >> (64 - s)); }
+
+	static void keccakf(uint64_t st[25])
+	{
+		static const uint64_t rc[24] =
+		{
+			0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808aull, 0x8000000080008000ull,
+			0x000000000000808bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+			0x000000000000008aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000aull,
+			0x000000008000808bull, 0x800000000000008bull, 0x8000000000008089ull, 0x8000000000008003ull,
+			0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800aull, 0x800000008000000aull,
+			0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull
+		};
+		static const int rotc[24] = { 1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44 };
+		static const int piln[24] = { 10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1 };
+
+		for (size_t r = 0; r < 24; ++r)
+		{
+			// theta
+			uint64_t bc[5];
+			for (size_t i = 0; i < 5; ++i) bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+			for (size_t i = 0; i < 5; ++i)
+			{
+				const uint64_t t = bc[(i + 4) % 5] ^ rotl(bc[(i + 1) % 5], 1);
+				for (size_t j = 0; j < 25; j += 5) st[j + i] ^= t;
+			}
+
+			// rho and pi
+			uint64_t t = st[1];
+			for (size_t i = 0; i < 24; ++i)
+			{
+				const int j = piln[i];
+				const uint64_t s = st[j];
+				st[j] = rotl(t, rotc[i]);
+				t = s;
+			}
+
+			// chi
+			for (size_t j = 0; j < 25; j += 5)
+			{
+				for (size_t i = 0; i < 5; ++i) bc[i] = st[j + i];
+				for (size_t i = 0; i < 5; ++i) st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+			}
+
+			// iota
+			st[0] ^= rc[r];
+		}
+	}
+
+	void absorb(const uint8_t b)
+	{
+		_st[_pos / 8] ^= uint64_t(b) << (8 * (_pos % 8));
+		if (++_pos == rate) { keccakf(_st); _pos = 0; }
+	}
+
+public:
+	sha3() { for (size_t i = 0; i < 25; ++i) _st[i] = 0; }
+	virtual ~sha3() {}
+
+public:
+	void update(const void * const data, const size_t size)
+	{
+		const uint8_t * const ptr = static_cast<const uint8_t *>(data);
+		for (size_t i = 0; i < size; ++i) absorb(ptr[i]);
+	}
+
+	// the words are little-endian
+	void update(const uint32_t * const data, const size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) for (size_t j = 0; j < 4; ++j) absorb(uint8_t(data[i] >> (8 * j)));
+	}
+
+	void update(const uint32_t w) { update(&w, size_t(1)); }
+
+public:
+	digest finalize()
+	{
+		_st[_pos / 8] ^= uint64_t(0x06) << (8 * (_pos % 8));
+		_st[(rate - 1) / 8] ^= uint64_t(0x80) << (8 * ((rate - 1) % 8));
+		keccakf(_st);
+
+		digest d;
+		for (size_t i = 0; i < d.size(); ++i) d[i] = uint8_t(_st[i / 8] >> (8 * (i % 8)));
+		return d;
+	}
+};
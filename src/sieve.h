@@ -0,0 +1,438 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include "ocl.h"
+#include "gpmp.h"
+#include "cpuengine.h"
+#include "pio.h"
+#include "timer.h"
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+#include "ocl/sieve.h"
+
+// Montgomery arithmetic modulo p, p < 2^63 (see sieve.cl)
+class mont64
+{
+private:
+	const uint64_t _p, _q;
+	uint64_t _one, _r2;
+
+private:
+	static uint64_t mulhi(const uint64_t a, const uint64_t b) { return arith::mulhi(a, b); }
+
+	static uint64_t invert(const uint64_t p)
+	{
+		uint64_t ip = p;	// p.p = 1 (mod 8)
+		for (size_t i = 0; i < 5; ++i) ip *= 2 - p * ip;
+		return ip;
+	}
+
+public:
+	mont64(const uint64_t p) : _p(p), _q(0 - invert(p))
+	{
+		_one = (0 - p) % p;
+		_r2 = _one;
+		for (size_t i = 0; i < 64; ++i) _r2 = add(_r2, _r2);
+	}
+
+public:
+	uint64_t one() const { return _one; }
+	uint64_t toMont(const uint64_t a) const { return mul(a % _p, _r2); }
+
+	uint64_t add(const uint64_t a, const uint64_t b) const { return a + b - ((a >= _p - b) ? _p : 0); }
+	uint64_t neg(const uint64_t a) const { return (a == 0) ? 0 : _p - a; }
+
+	uint64_t mul(const uint64_t a, const uint64_t b) const
+	{
+		const uint64_t ab_l = a * b, ab_h = mulhi(a, b);
+		const uint64_t r = ab_h + mulhi(ab_l * _q, _p) + ((ab_l != 0) ? 1 : 0);
+		return (r >= _p) ? r - _p : r;
+	}
+
+	uint64_t pow(const uint64_t a, const uint64_t e) const
+	{
+		if (e == 0) return _one;
+		int t = 63;
+		while ((e >> t) == 0) --t;
+		uint64_t r = a;
+		for (int b = t - 1; b >= 0; --b)
+		{
+			r = mul(r, r);
+			if ((e & (uint64_t(1) << b)) != 0) r = mul(r, a);
+		}
+		return r;
+	}
+
+	uint64_t inv(const uint64_t a) const { return pow(a, _p - 2); }
+};
+
+// The primes p that divide some k_i.2^n + 1, nMin <= n < nMin + nCount
+class sieveEngine
+{
+public:
+	struct factor { uint64_t p; uint32_t i, n; };
+
+	static const uint32_t baby_steps = 64, hash_size = 128;
+
+public:
+	virtual ~sieveEngine() {}
+
+	virtual std::string getName() const = 0;
+	virtual void init(const std::vector<uint32_t> & k, const uint32_t nMin, const uint32_t nCount) = 0;
+	// false if the factors of the primes are not complete
+	virtual bool run(const std::vector<uint64_t> & primes, std::vector<factor> & factors) = 0;
+};
+
+// The host implementation of the kernel. It is also the fallback of the OpenCL engine if the factors don't fit in its buffer.
+class cpuSieveEngine : public sieveEngine
+{
+private:
+	threadPool _pool;
+	std::vector<uint32_t> _k;
+	uint32_t _nMin = 0, _nCount = 0;
+
+public:
+	cpuSieveEngine(const size_t threadCount) : _pool((threadCount == 0) ? std::max(std::thread::hardware_concurrency(), 1u) : threadCount) {}
+	virtual ~cpuSieveEngine() {}
+
+public:
+	std::string getName() const override
+	{
+		std::ostringstream ss; ss << "CPU (" << _pool.getCount() << " threads)";
+		return ss.str();
+	}
+
+	void init(const std::vector<uint32_t> & k, const uint32_t nMin, const uint32_t nCount) override
+	{
+		_k = k; _nMin = nMin; _nCount = nCount;
+	}
+
+public:
+	// baby-step giant-step algorithm, see sieve.cl
+	static void sievePrime(const uint64_t p, const std::vector<uint32_t> & k, const uint32_t nMin, const uint32_t nCount, std::vector<factor> & factors)
+	{
+		const mont64 m(p);
+		const uint64_t one = m.one(), two = m.add(one, one);
+
+		uint64_t h_val[hash_size];
+		uint32_t h_idx[hash_size];
+		for (size_t h = 0; h < hash_size; ++h) h_val[h] = 0;
+
+		uint32_t ord = 0;
+		uint64_t x = one;
+		for (uint32_t b = 0; b < baby_steps; ++b)
+		{
+			if ((b != 0) && (x == one)) { ord = b; break; }
+			size_t h = size_t(x % hash_size);
+			while (h_val[h] != 0) h = (h + 1) % hash_size;
+			h_val[h] = x; h_idx[h] = b;
+			x = m.mul(x, two);
+		}
+
+		const uint64_t g = m.inv(x), t = m.pow(two, nMin);
+
+		for (uint32_t i = 0; i < uint32_t(k.size()); ++i)
+		{
+			if (k[i] % p == 0) continue;
+
+			uint64_t c = m.neg(m.inv(m.mul(m.toMont(k[i]), t)));
+
+			if (ord == 0)
+			{
+				for (uint32_t a = 0; a < nCount; a += baby_steps)
+				{
+					for (size_t h = size_t(c % hash_size); h_val[h] != 0; h = (h + 1) % hash_size)
+					{
+						if ((h_val[h] == c) && (a + h_idx[h] < nCount)) factors.push_back(factor{ p, i, nMin + a + h_idx[h] });
+					}
+					c = m.mul(c, g);
+				}
+			}
+			else
+			{
+				for (size_t h = size_t(c % hash_size); h_val[h] != 0; h = (h + 1) % hash_size)
+				{
+					if (h_val[h] == c) for (uint32_t j = h_idx[h]; j < nCount; j += ord) factors.push_back(factor{ p, i, nMin + j });
+				}
+			}
+		}
+	}
+
+public:
+	bool run(const std::vector<uint64_t> & primes, std::vector<factor> & factors) override
+	{
+		const size_t count = _pool.getCount();
+		std::vector<std::vector<factor>> f(count);
+		_pool.run([&](const size_t id)
+		{
+			for (size_t j = id; j < primes.size(); j += count) sievePrime(primes[j], _k, _nMin, _nCount, f[id]);
+		});
+		for (const auto & fi : f) factors.insert(factors.end(), fi.begin(), fi.end());
+		return true;
+	}
+};
+
+class oclSieveEngine : public sieveEngine, public ocl::device
+{
+private:
+	static const size_t factor_max = 65536;
+
+	size_t _primeMax = 0;
+	cl_mem _prime = nullptr, _k = nullptr, _factor = nullptr, _factorCount = nullptr;
+	cl_kernel _sieve = nullptr;
+
+public:
+	oclSieveEngine(const ocl::platform & platform, const size_t d) : ocl::device(platform, d) {}
+	virtual ~oclSieveEngine() { _clear(); }
+
+private:
+	void _clear()
+	{
+		if (_sieve == nullptr) return;
+		_releaseKernel(_sieve);
+		_releaseBuffer(_prime); _releaseBuffer(_k); _releaseBuffer(_factor); _releaseBuffer(_factorCount);
+		clearProgram();
+	}
+
+public:
+	std::string getName() const override { return ocl::device::getName(); }
+
+	void init(const std::vector<uint32_t> & k, const uint32_t nMin, const uint32_t nCount) override
+	{
+		_clear();
+
+		std::stringstream src;
+		src << "#define\tK_COUNT\t" << k.size() << "u" << std::endl;
+		src << "#define\tN_MIN\t" << nMin << "u" << std::endl;
+		src << "#define\tN_COUNT\t" << nCount << "u" << std::endl;
+		src << "#define\tBABY_STEPS\t" << baby_steps << "u" << std::endl;
+		src << "#define\tHASH_SIZE\t" << hash_size << "u" << std::endl;
+		src << "#define\tFACTOR_MAX\t" << factor_max << "u" << std::endl;
+		src << std::endl;
+
+		// if sieve.cl file is not found then source is src_ocl_sieve string in src/ocl/sieve.h
+		if (!gpmp::readOpenCLFile("ocl/sieve.cl", "src/ocl/sieve.h", "src_ocl_sieve", src)) src << src_ocl_sieve;
+
+		loadProgram(src.str());
+
+		_primeMax = getPrimeCount();
+		_prime = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_ulong) * _primeMax);
+		_k = _createBuffer(CL_MEM_READ_ONLY, sizeof(cl_uint) * k.size());
+		_factor = _createBuffer(CL_MEM_WRITE_ONLY, sizeof(cl_uint4) * factor_max);
+		_factorCount = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_uint));
+		_writeBuffer(_k, k.data(), sizeof(cl_uint) * k.size());
+
+		_sieve = _createKernel("sieve");
+		_setKernelArg(_sieve, 0, sizeof(cl_mem), &_prime);
+		_setKernelArg(_sieve, 1, sizeof(cl_mem), &_k);
+		_setKernelArg(_sieve, 2, sizeof(cl_mem), &_factor);
+		_setKernelArg(_sieve, 3, sizeof(cl_mem), &_factorCount);
+	}
+
+public:
+	// the number of primes of a kernel launch
+	static size_t getPrimeCount() { return size_t(1) << 18; }
+
+	bool run(const std::vector<uint64_t> & primes, std::vector<factor> & factors) override
+	{
+		if (primes.empty()) return true;
+		if (primes.size() > _primeMax) throw std::runtime_error("too many primes");
+
+		const cl_uint zero = 0;
+		_writeBuffer(_factorCount, &zero, sizeof(zero));
+		_writeBuffer(_prime, primes.data(), sizeof(cl_ulong) * primes.size());
+		_executeKernel(_sieve, primes.size());
+
+		cl_uint count = 0;
+		_readBuffer(_factorCount, &count, sizeof(count));
+		if (count > factor_max) return false;
+
+		std::vector<cl_uint4> f(count);
+		if (count > 0) _readBuffer(_factor, f.data(), sizeof(cl_uint4) * count);
+		for (const cl_uint4 & fi : f) factors.push_back(factor{ fi.s[0] | (uint64_t(fi.s[1]) << 32), fi.s[2], fi.s[3] });
+		return true;
+	}
+};
+
+// The odd primes of [start, end), segmented sieve of Eratosthenes
+class primeGenerator
+{
+private:
+	static const size_t segment_size = size_t(1) << 16;	// odd numbers
+
+	std::vector<uint32_t> _base;	// odd primes <= sqrt(end)
+	uint64_t _start;
+	const uint64_t _end;
+	std::vector<bool> _seg;
+
+public:
+	primeGenerator(const uint64_t start, const uint64_t end) : _start(std::max(start, uint64_t(3)) | 1), _end(end), _seg(segment_size)
+	{
+		const uint32_t sq = uint32_t(std::sqrt(double(end))) + 1;
+		std::vector<bool> composite(sq + 1, false);
+		for (uint32_t q = 3; q <= sq; q += 2)
+		{
+			if (composite[q]) continue;
+			_base.push_back(q);
+			for (uint64_t j = uint64_t(q) * q; j <= sq; j += 2 * q) composite[size_t(j)] = true;
+		}
+	}
+
+	virtual ~primeGenerator() {}
+
+public:
+	uint64_t getPosition() const { return _start; }
+
+	// the primes of the next segment, false if end is reached
+	bool next(std::vector<uint64_t> & primes, const size_t countMax)
+	{
+		primes.clear();
+		while ((primes.size() + segment_size <= countMax) && (_start < _end))
+		{
+			const uint64_t start = _start, end = std::min(_end, start + 2 * segment_size);
+			const size_t count = size_t((end - start + 1) / 2);
+			for (size_t i = 0; i < count; ++i) _seg[i] = false;
+
+			for (const uint32_t q : _base)
+			{
+				const uint64_t q2 = uint64_t(q) * q;
+				if (q2 >= end) break;
+				// the first odd multiple of q >= max(start, q^2)
+				uint64_t j = std::max(q2, ((start + q - 1) / q) * q);
+				if (j % 2 == 0) j += q;
+				for (; j < end; j += 2 * q) _seg[size_t((j - start) / 2)] = true;
+			}
+
+			for (size_t i = 0; i < count; ++i) if (!_seg[i]) primes.push_back(start + 2 * i);
+			_start = end | 1;
+		}
+		return !primes.empty();
+	}
+};
+
+// The candidates k.2^n + 1 with a factor p < p_max are removed, the remaining candidates are a worklist.
+class sieve
+{
+private:
+	struct deleter { void operator()(const sieve * const p) { delete p; } };
+
+public:
+	sieve() {}
+	virtual ~sieve() {}
+
+	static sieve & getInstance()
+	{
+		static std::unique_ptr<sieve, deleter> pInstance(new sieve());
+		return *pInstance;
+	}
+
+public:
+	void quit() { _quit = true; }
+
+private:
+	volatile bool _quit = false;
+
+	static constexpr uint64_t p_host = uint64_t(1) << 16;	// the small primes have many factors, they are sieved by the host
+
+public:
+	bool run(const std::vector<uint32_t> & k, const uint32_t nMin, const uint32_t nMax, const uint32_t pMaxLog2,
+		const std::string & filename, sieveEngine & engine)
+	{
+		const uint32_t nCount = nMax - nMin + 1;
+		const uint64_t pMax = uint64_t(1) << pMaxLog2;
+
+		std::ostringstream ss; ss << "Sieving " << k.size() << " k, " << nMin << " <= n <= " << nMax << ", p < 2^" << pMaxLog2
+			<< " on " << engine.getName() << std::endl;
+		pio::print(ss.str());
+
+		chronometer chrono;
+		chrono.previousTime = 0;
+		chrono.resetTime();
+		chrono.resetBenchTime();
+
+		engine.init(k, nMin, nCount);
+
+		std::vector<bool> removed(k.size() * size_t(nCount), false);
+		size_t removedCount = 0;
+		auto remove = [&](const std::vector<sieveEngine::factor> & factors)
+		{
+			for (const auto & f : factors)
+			{
+				// the candidate is not a factor of itself
+				const uint32_t ki = k[f.i];
+				if ((int(f.n) < 62 - arith::log2(ki)) && ((uint64_t(ki) << f.n) + 1 == f.p)) continue;
+				const size_t j = f.i * size_t(nCount) + (f.n - nMin);
+				if (!removed[j]) { removed[j] = true; ++removedCount; }
+			}
+		};
+
+		std::vector<uint64_t> primes;
+		std::vector<sieveEngine::factor> factors;
+
+		primeGenerator smallPrimes(3, std::min(p_host, pMax));
+		while (smallPrimes.next(primes, oclSieveEngine::getPrimeCount()))
+		{
+			factors.clear();
+			for (const uint64_t p : primes) cpuSieveEngine::sievePrime(p, k, nMin, nCount, factors);
+			remove(factors);
+		}
+
+		uint64_t pEnd = std::min(p_host, pMax);
+		primeGenerator largePrimes(pEnd, pMax);
+		while (!_quit && largePrimes.next(primes, oclSieveEngine::getPrimeCount()))
+		{
+			factors.clear();
+			if (!engine.run(primes, factors))
+			{
+				factors.clear();
+				for (const uint64_t p : primes) cpuSieveEngine::sievePrime(p, k, nMin, nCount, factors);
+			}
+			remove(factors);
+			pEnd = largePrimes.getPosition();
+
+			if (chrono.getBenchTime() > 1)
+			{
+				std::ostringstream ssp; ssp << std::setprecision(3) << " p = 2^" << std::log2(double(pEnd)) << ", "
+					<< removedCount << " candidates removed.        \r";
+				pio::display(ssp.str());
+				chrono.resetBenchTime();
+			}
+		}
+		if (_quit) pEnd = largePrimes.getPosition();
+
+		std::ofstream file(filename);
+		if (!file.is_open()) throw std::runtime_error("cannot write worklist file '" + filename + "'");
+		file << "# sieved to p = " << pEnd << std::endl;
+		size_t count = 0;
+		for (uint32_t n = nMin; n <= nMax; ++n)
+		{
+			for (size_t i = 0; i < k.size(); ++i)
+			{
+				if (!removed[i * size_t(nCount) + (n - nMin)]) { file << k[i] << "*2^" << n << "+1" << std::endl; ++count; }
+			}
+		}
+		file.close();
+
+		std::ostringstream ssr; ssr << "\r" << removedCount << " candidates removed, p < " << pEnd << ", " << count
+			<< " candidates written to '" << filename << "', time = " << timer::formatTime(chrono.getElapsedTime()) << std::endl;
+		pio::print(ssr.str());
+
+		return !_quit;
+	}
+};
@@ -0,0 +1,130 @@
+/*
+Copyright 2020, Yves Gallot
+
+proth20 is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include "gpmp.h"
+#include "pio.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// A list of "k*2^n+1" expressions, one per line. Empty lines and lines starting with '#' are ignored.
+// If the file name is "-" then the list is read from the standard input.
+// The number of completed candidates is saved in '<file>.pos' such that a restart resumes the list.
+// The candidates may be completed out of order, the position is the number of leading completed candidates.
+class worklist
+{
+private:
+	const std::string _filename;
+	const bool _isStdin;
+	std::ifstream _file;
+	size_t _pos = 0;		// number of completed candidates
+	size_t _index = 0;		// number of candidates read
+	std::set<size_t> _completed;	// candidates completed after the position
+
+public:
+	worklist(const std::string & filename) : _filename(filename), _isStdin(filename == "-")
+	{
+		if (!_isStdin)
+		{
+			_file.open(filename);
+			if (!_file.is_open()) throw std::runtime_error("cannot open worklist file '" + filename + "'");
+
+			std::ifstream posFile(_posFilename());
+			if (posFile.is_open()) { posFile >> _pos; posFile.close(); }
+		}
+	}
+
+	virtual ~worklist() {}
+
+private:
+	std::string _posFilename() const { return _filename + ".pos"; }
+
+public:
+	// Parse "k*2^n+1", k is odd
+	static bool parse(const std::string & exp, uint32_t & k, uint32_t & n)
+	{
+		k = 0; n = 0;
+		auto k_end = exp.find('*');
+		if (k_end != std::string::npos) k = std::atoi(exp.substr(0, k_end).c_str());
+		auto n_start = exp.find('^'), n_end = exp.find('+');
+		if ((n_start != std::string::npos) && (n_end != std::string::npos)) n = std::atoi(exp.substr(n_start + 1, n_end).c_str());
+		if (k > 0) while (k % 2 == 0) { k /= 2; ++n; }
+		return (k >= 3) && (n >= 32);
+	}
+
+public:
+	// balanced is true if the engine converts the digits to balanced digits, see engine::hasBalancedDigits
+	static void check(const uint32_t k, const uint32_t n, const bool balanced = false, const bool rns3 = false)
+	{
+		if (k > 99999999) throw std::runtime_error("k > 99999999 is not supported");
+		if (!gpmp::isSupported(k, n, balanced, rns3))
+		{
+			std::ostringstream ss; ss << k << "*2^" << n << "+1: the transform size is larger than 2^24";
+			throw std::runtime_error(ss.str());
+		}
+	}
+
+public:
+	// next candidate of the list, the candidates completed in a previous run are skipped
+	bool next(uint32_t & k, uint32_t & n)
+	{
+		std::istream & is = _isStdin ? std::cin : static_cast<std::istream &>(_file);
+		std::string line;
+		while (std::getline(is, line))
+		{
+			const size_t start = line.find_first_not_of(" \t\r");
+			if ((start == std::string::npos) || (line[start] == '#')) continue;
+
+			if (!parse(line.substr(start), k, n))
+			{
+				std::ostringstream ss; ss << "warning: invalid expression '" << line << "' in worklist, skipped." << std::endl;
+				pio::error(ss.str());
+				continue;
+			}
+
+			++_index;
+			if (_index <= _pos) continue;
+			return true;
+		}
+		return false;
+	}
+
+public:
+	// index of the last candidate read
+	size_t getIndex() const { return _index; }
+
+public:
+	// the current candidate is completed
+	void done() { done(_index); }
+
+	// the candidate 'index' is completed
+	void done(const size_t index)
+	{
+		_completed.insert(index);
+		const size_t pos = _pos;
+		while (!_completed.empty() && (*_completed.begin() == _pos + 1)) { _completed.erase(_completed.begin()); ++_pos; }
+		if (_isStdin || (_pos == pos)) return;
+
+		std::ofstream posFile(_posFilename());
+		if (!posFile.is_open())
+		{
+			std::ostringstream ss; ss << "cannot write '" << _posFilename() << "' file " << std::endl;
+			pio::error(ss.str());
+			return;
+		}
+		posFile << _pos << std::endl;
+		posFile.close();
+	}
+};